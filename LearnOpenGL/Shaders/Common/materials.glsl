@@ -0,0 +1,20 @@
+// The materials and the per draw block shared by the passes that shade renderers. Included, see Shader.
+
+struct Material {
+	vec3 diffuseColor;
+	float diffuseReflectivity;
+	vec3 specularColor;
+	float specularDiffusion;
+	float specularReflectivity;
+	float emissivity;
+	float refractiveIndex;
+	float transparency;
+};
+
+// The material of every renderer (ShaderBlocks::Material), this draw's is at materialIndex.
+layout(std430, binding = 3) readonly buffer Materials { Material materials[]; };
+// Per draw constants written by Graphics::renderQueue (ShaderBlocks::Draw).
+layout(std140, binding = 4) uniform Draw {
+	mat4 M;
+	int materialIndex;
+};
@@ -0,0 +1,9 @@
+// Writes the guides for depth-aware upsampling: world space normal and linear view depth (0 = background).
+#version 450 core
+
+in vec3 normalFrag;
+in float viewDepthFrag;
+
+out vec4 color;
+
+void main(){ color = vec4(normalize(normalFrag), viewDepthFrag); }
@@ -0,0 +1,33 @@
+// Shared by the reduced resolution indirect diffuse passes (see Graphics::renderReducedIndirectDiffuse).
+#version 450 core
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 normal;
+
+// Per draw constants written by Graphics::renderQueue (ShaderBlocks::Draw).
+layout(std140, binding = 4) uniform Draw {
+	mat4 M;
+	int materialIndex;
+};
+
+// Per frame constants written by Graphics::uploadShaderBlocks (ShaderBlocks::Frame).
+layout(std140, binding = 1) uniform Frame {
+	mat4 V;
+	mat4 P;
+	vec3 cameraPosition;
+	int state;
+	ivec2 screenSize;
+	int numberOfLights;
+};
+
+out vec3 worldPositionFrag;
+out vec3 normalFrag;
+out float viewDepthFrag;
+
+void main(){
+	worldPositionFrag = vec3(M * vec4(position, 1));
+	normalFrag = normalize(mat3(transpose(inverse(M))) * normal);
+	const vec4 viewPosition = V * vec4(worldPositionFrag, 1);
+	viewDepthFrag = -viewPosition.z;
+	gl_Position = P * viewPosition;
+}
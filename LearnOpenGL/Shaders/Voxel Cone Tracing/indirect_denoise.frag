@@ -0,0 +1,44 @@
+// One iteration of the edge-avoiding a-trous wavelet filter over the reduced resolution indirect diffuse light
+// (see Graphics::denoiseIndirectDiffuse). A 5x5 B3 spline kernel with taps stepSize pixels apart, weighted down
+// across depth, normal and luminance edges. Uses the same weights as AtrousFilter.cpp.
+#version 450 core
+
+#define DEPTH_SIGMA 0.02		// Relative depth difference where a tap's weight drops to 1/e.
+#define NORMAL_POWER 64.0
+#define LUMINANCE_SIGMA 4.0		// Relative to the center's luminance.
+
+uniform sampler2D source;		// Linear light, number of accumulated frames in alpha (filtered along).
+uniform sampler2D guide;		// Normal and view depth (0 = background).
+uniform int stepSize;
+
+out vec4 color;
+
+float luminance(const vec3 c) { return dot(c, vec3(0.2126, 0.7152, 0.0722)); }
+
+void main(){
+	const float KERNEL[3] = { 3.0 / 8.0, 1.0 / 4.0, 1.0 / 16.0 };
+	const ivec2 pixel = ivec2(gl_FragCoord.xy);
+	const ivec2 size = textureSize(source, 0);
+	const vec4 center = texelFetch(guide, pixel, 0);
+	const vec4 centerColor = texelFetch(source, pixel, 0);
+	if(center.a <= 0.0) { color = centerColor; return; }
+	const float centerLuminance = luminance(centerColor.rgb);
+
+	vec4 sum = vec4(0);
+	float weightSum = 0;
+	for(int dy = -2; dy <= 2; ++dy) for(int dx = -2; dx <= 2; ++dx) {
+		const ivec2 tap = pixel + ivec2(dx, dy) * stepSize;
+		if(any(lessThan(tap, ivec2(0))) || any(greaterThanEqual(tap, size))) continue;
+		const vec4 g = texelFetch(guide, tap, 0);
+		if(g.a <= 0.0) continue;
+		const vec4 c = texelFetch(source, tap, 0);
+
+		const float depthWeight = exp(-abs(center.a - g.a) / (DEPTH_SIGMA * center.a));
+		const float normalWeight = pow(max(dot(center.xyz, g.xyz), 0.0), NORMAL_POWER);
+		const float luminanceWeight = exp(-abs(centerLuminance - luminance(c.rgb)) / (LUMINANCE_SIGMA * centerLuminance + 1e-4));
+		const float w = KERNEL[abs(dx)] * KERNEL[abs(dy)] * depthWeight * normalWeight * luminanceWeight;
+		sum += w * c;
+		weightSum += w;
+	}
+	color = sum / weightSum; // The center tap always has a positive weight.
+}
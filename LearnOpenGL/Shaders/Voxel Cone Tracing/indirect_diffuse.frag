@@ -0,0 +1,193 @@
+// Indirect diffuse light only, traced at a reduced resolution and upsampled by 'indirect_upsample.frag'.
+// The cones are ConeSets::DIFFUSE_CONES (the 9 cones of 'voxel_cone_tracing.frag' by default), read from the 'ConeTables' block.
+// Output is linear and already scaled the way the forward pass would add it to the pixel.
+// Fewer ring cones than the whole ring are rotated per pixel with a blue noise table (and denoised by 'indirect_denoise.frag').
+// In temporal mode (TEMPORAL, see Graphics::temporalIndirectDiffuse), the rotations also change every frame and the light is
+// accumulated with the reprojected history, and alpha holds the number of accumulated frames.
+// With irradiance probes (IRRADIANCE_PROBES, see Graphics::irradianceProbesEnabled), the light is interpolated from the probes
+// written by 'irradiance_probes.comp' instead, and the cones are only traced where no probe contributes.
+// Both features are defined to 1 or 0 by MaterialStore::findPermutation, so the disabled ones are compiled out.
+#version 450 core
+
+#define ISQRT2 0.707106
+#define VOXEL_SIZE (1/64.0)
+#define DIFFUSE_INDIRECT_FACTOR 0.52f
+#define PI 3.14159265f
+#define MAX_HISTORY 16.0f
+#define HISTORY_DEPTH_TOLERANCE 0.05f	// Relative view depth difference.
+#define HISTORY_NORMAL_TOLERANCE 0.9f	// Minimum cosine between the normals.
+#define SH_Y0 0.282095f
+#define SH_Y1 0.488603f
+#define DIFFUSE_CONE_SCALE 9.0f	// The indirect factor was tuned with 9 equally weighted cones (see ConeSets::DIFFUSE_CONE_SCALE).
+#define PROBE_BACKFACE_WEIGHT 0.2f
+
+#include "../Common/materials.glsl"
+uniform sampler3D texture3D;
+
+uniform int ringCones;
+uniform sampler2D blueNoise;
+uniform float frameOffset;			// Golden ratio sequence, added to the blue noise.
+uniform bool historyValid;
+uniform mat4 previousViewProjection;
+uniform sampler2D history;			// Accumulated light and number of frames.
+uniform sampler2D previousGuide;	// Normal and view depth.
+
+uniform int probesPerAxis;
+uniform sampler3D probeRed;			// L1 coefficients (L0, L1x, L1y, L1z) of every color channel.
+uniform sampler3D probeGreen;
+uniform sampler3D probeBlue;
+uniform sampler3D probeWeight;		// 1 for placed probes.
+
+// Cone sets and march tables generated at compile time by 'ConeSets.h' (ConeSets::UniformBlock), see Graphics::initConeTables.
+layout(std140, binding = 0) uniform ConeTables {
+	vec4 diffuseCones[32];		// Direction (tangent space, z along the normal) and weight, then offset, per cone.
+	ivec4 diffuseConeCount;
+	vec4 diffuseConeSums;		// Scaled weight sum and normal sum (for the probes' closed form).
+	vec4 diffuseMarch[16];		// Distance, lod and weight per step.
+	ivec4 diffuseMarchSteps;
+	vec4 shadowMarch[256];		// Distance, near lod and far lod per step.
+	ivec4 shadowMarchSteps;
+	vec4 probeDirections[32];
+};
+
+in vec3 worldPositionFrag;
+in vec3 normalFrag;
+
+out vec4 color;
+
+vec3 normal = normalize(normalFrag);
+Material material;
+
+vec3 orthogonal(vec3 u){
+	u = normalize(u);
+	vec3 v = vec3(0.99146, 0.11664, 0.05832); // Any normalized vector.
+	return abs(dot(u, v)) > 0.99999f ? cross(u, vec3(0, 1, 0)) : cross(u, v);
+}
+
+vec3 scaleAndBias(const vec3 p) { return 0.5f * p + vec3(0.5f); }
+
+vec3 traceDiffuseVoxelCone(const vec3 from, vec3 direction){
+	direction = normalize(direction);
+	vec4 acc = vec4(0.0f);
+	for(int i = 0; i < diffuseMarchSteps.x && acc.a < 1; ++i){
+		const vec4 s = diffuseMarch[i];
+		vec4 voxel = textureLod(texture3D, scaleAndBias(from + s.x * direction), s.y);
+		acc += s.z * voxel * pow(1 - voxel.a, 2);
+	}
+	return pow(acc.rgb * 2.0, vec3(1.5));
+}
+
+// A tangent space vector of the cone table, rotated around the normal by an angle (its cosine and sine), in world space.
+vec3 toWorld(const vec3 v, const vec2 rotation, const vec3 ortho, const vec3 ortho2){
+	return (rotation.x * v.x - rotation.y * v.y) * ortho + (rotation.y * v.x + rotation.x * v.y) * ortho2 + v.z * normal;
+}
+
+// Traces cone i of the table, rotated around the normal, and returns its weighted light.
+vec3 traceDiffuseCone(const int i, const float weight, const vec3 origin, const vec2 rotation, const vec3 ortho, const vec3 ortho2){
+	const float CONE_OFFSET = -0.01;
+	const vec4 cone = diffuseCones[2 * i];
+	const vec3 offset = toWorld(diffuseCones[2 * i + 1].xyz, rotation, ortho, ortho2);
+	return weight * cone.w * traceDiffuseVoxelCone(origin + CONE_OFFSET * offset, toWorld(cone.xyz, rotation, ortho, ortho2));
+}
+
+vec3 indirectDiffuseLight(){
+	const vec3 ortho = normalize(orthogonal(normal));
+	const vec3 ortho2 = normalize(cross(ortho, normal));
+
+	const vec3 N_OFFSET = normal * (1 + 4 * ISQRT2) * VOXEL_SIZE;
+	const vec3 C_ORIGIN = worldPositionFrag + N_OFFSET;
+
+	// The whole ring, or a subset spread evenly around it and weighted to the same total,
+	// rotated per pixel (and per frame in temporal mode).
+	const int ringSize = diffuseConeCount.x - 1;
+	const bool jitter = TEMPORAL != 0 || ringCones < ringSize;
+	const ivec2 noiseTexel = ivec2(gl_FragCoord.xy) % textureSize(blueNoise, 0);
+	const float u = jitter ? ringSize * fract(texelFetch(blueNoise, noiseTexel, 0).r + frameOffset) : 0.0f;
+	const float angle = fract(u) * 2 * PI / ringSize;
+	const vec2 rotation = vec2(cos(angle), sin(angle));
+
+	vec3 acc = traceDiffuseCone(0, DIFFUSE_CONE_SCALE, C_ORIGIN, rotation, ortho, ortho2);
+	for(int i = 0; i < ringCones; ++i) {
+		const int k = (int(u) + i * ringSize / ringCones) % ringSize;
+		acc += traceDiffuseCone(1 + k, DIFFUSE_CONE_SCALE * ringSize / ringCones, C_ORIGIN, rotation, ortho, ortho2);
+	}
+
+	return DIFFUSE_INDIRECT_FACTOR * material.diffuseReflectivity * acc * (material.diffuseColor + vec3(0.001f));
+}
+
+#if IRRADIANCE_PROBES
+// Interpolates the 8 probes around the fragment (moved half a probe spacing along the normal), like IrradianceProbeGrid::sample,
+// and adds up the L1 radiance of the cones of indirectDiffuseLight in closed form. Returns false if no probe contributes.
+bool indirectDiffuseProbeLight(out vec3 light){
+	const float spacing = 2.0f / probesPerAxis;
+	const vec3 grid = (worldPositionFrag + 0.5f * spacing * normal + vec3(1.0f)) / spacing - vec3(0.5f);
+	const ivec3 base = ivec3(floor(grid));
+	const vec3 f = grid - vec3(base);
+
+	vec4 red = vec4(0), green = vec4(0), blue = vec4(0);
+	float weightSum = 0.0f;
+	for(int corner = 0; corner < 8; ++corner) {
+		const ivec3 offset = ivec3(corner & 1, (corner >> 1) & 1, corner >> 2);
+		const ivec3 p = base + offset;
+		if(any(lessThan(p, ivec3(0))) || any(greaterThanEqual(p, ivec3(probesPerAxis)))) continue;
+		if(texelFetch(probeWeight, p, 0).r <= 0) continue;
+
+		// Trilinear weight, lowered for probes behind the surface.
+		const vec3 trilinear = mix(vec3(1) - f, f, vec3(offset));
+		float weight = trilinear.x * trilinear.y * trilinear.z;
+		const vec3 toProbe = (vec3(p) + 0.5f) * spacing - 1.0f - worldPositionFrag;
+		if(length(toProbe) > 1e-6f) {
+			const float facing = 0.5f * (dot(normalize(toProbe), normal) + 1.0f);
+			weight *= facing * facing + PROBE_BACKFACE_WEIGHT;
+		}
+		red += weight * texelFetch(probeRed, p, 0);
+		green += weight * texelFetch(probeGreen, p, 0);
+		blue += weight * texelFetch(probeBlue, p, 0);
+		weightSum += weight;
+	}
+	if(weightSum < 1e-6f) return false;
+
+	const vec4 basis = vec4(diffuseConeSums.x * SH_Y0, diffuseConeSums.y * SH_Y1 * normal);
+	const vec3 acc = max(vec3(dot(red, basis), dot(green, basis), dot(blue, basis)) / weightSum, vec3(0));
+	light = DIFFUSE_INDIRECT_FACTOR * material.diffuseReflectivity * acc * (material.diffuseColor + vec3(0.001f));
+	return true;
+}
+#endif
+
+#if TEMPORAL
+// Reprojects the fragment into the previous frame and returns the accumulated light there (rgb) and its
+// number of frames (a), or zero if the history is disoccluded (off screen, or a different depth or normal).
+vec4 fetchHistory(){
+	if(!historyValid) return vec4(0);
+	const vec4 previousClip = previousViewProjection * vec4(worldPositionFrag, 1);
+	if(previousClip.w <= 0) return vec4(0);
+	const vec2 uv = 0.5f * previousClip.xy / previousClip.w + 0.5f;
+	if(any(lessThan(uv, vec2(0))) || any(greaterThanEqual(uv, vec2(1)))) return vec4(0);
+
+	const ivec2 texel = ivec2(uv * textureSize(history, 0));
+	const vec4 g = texelFetch(previousGuide, texel, 0);
+	if(g.a <= 0 || abs(g.a - previousClip.w) > HISTORY_DEPTH_TOLERANCE * previousClip.w) return vec4(0);
+	if(dot(g.xyz, normal) < HISTORY_NORMAL_TOLERANCE) return vec4(0);
+	return texelFetch(history, texel, 0);
+}
+#endif
+
+void main(){
+	material = materials[materialIndex];
+	color = vec4(0, 0, 0, 1);
+	if(material.diffuseReflectivity * (1.0f - material.transparency) > 0.01f) {
+#if IRRADIANCE_PROBES
+		vec3 probeLight;
+		color.rgb = indirectDiffuseProbeLight(probeLight) ? probeLight : indirectDiffuseLight();
+#else
+		color.rgb = indirectDiffuseLight();
+#endif
+		if(material.transparency > 0.01f) color.rgb *= 1.0f - material.transparency; // The forward pass mixes in refraction.
+	}
+#if TEMPORAL
+	// Exponential moving average over at most MAX_HISTORY frames. Alpha is the per-pixel reuse statistic.
+	const vec4 previous = fetchHistory();
+	const float frames = min(previous.a + 1, MAX_HISTORY);
+	color = vec4(mix(previous.rgb, color.rgb, 1.0f / frames), frames);
+#endif
+}
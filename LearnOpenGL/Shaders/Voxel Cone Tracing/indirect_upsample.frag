@@ -0,0 +1,58 @@
+// Joint bilateral upsampling of the reduced resolution indirect diffuse light, guided by normals and view depth,
+// composited onto the forward pass (which was rendered without indirect diffuse light).
+// Also adds the full resolution indirect specular light of 'specular_reflections.frag' (when the forward pass was rendered without it).
+// Uses the same weights as VoxelConeTracer::render.
+#version 450 core
+
+#define GAMMA 2.2
+#define DEPTH_SIGMA 0.05		// Relative depth difference where a sample's weight drops to 1/e.
+#define NORMAL_POWER 16.0
+#define MAX_HISTORY 16.0		// See 'indirect_diffuse.frag'.
+
+uniform sampler2D sceneColor;			// Full resolution, gamma corrected.
+uniform sampler2D guide;				// Full resolution normal and view depth.
+uniform sampler2D lowResolutionGuide;	// Reduced resolution normal and view depth.
+uniform sampler2D indirectDiffuse;		// Reduced resolution, linear, number of accumulated frames in alpha.
+uniform sampler2D specular;				// Full resolution, linear.
+uniform int resolutionFactor;
+uniform bool reducedIndirectDiffuse;
+uniform bool specularReflections;
+uniform bool visualizeTemporalReuse;	// Shows the accumulated frames from red (none reused) to green (MAX_HISTORY).
+
+out vec4 color;
+
+void main(){
+	const ivec2 pixel = ivec2(gl_FragCoord.xy);
+	const vec3 scene = texelFetch(sceneColor, pixel, 0).rgb;
+	const vec4 center = texelFetch(guide, pixel, 0);
+	if(center.a <= 0.0) { color = vec4(scene, 1); return; } // Background.
+	const vec3 reflected = specularReflections ? texelFetch(specular, pixel, 0).rgb : vec3(0);
+	if(!reducedIndirectDiffuse) { color = vec4(pow(pow(scene, vec3(GAMMA)) + reflected, vec3(1.0 / GAMMA)), 1); return; }
+
+	const ivec2 lowSize = textureSize(indirectDiffuse, 0);
+	const vec2 lowPosition = gl_FragCoord.xy / float(resolutionFactor) - 0.5;
+	const ivec2 base = ivec2(floor(lowPosition));
+	const vec2 f = lowPosition - vec2(base);
+
+	vec4 sum = vec4(0);
+	float weightSum = 0;
+	for(int i = 0; i < 4; ++i) {
+		const ivec2 offset = ivec2(i & 1, i >> 1);
+		const ivec2 tap = clamp(base + offset, ivec2(0), lowSize - 1);
+		const vec4 g = texelFetch(lowResolutionGuide, tap, 0);
+		if(g.a <= 0.0) continue;
+		const float bilinear = (offset.x == 1 ? f.x : 1 - f.x) * (offset.y == 1 ? f.y : 1 - f.y);
+		const float depthWeight = exp(-abs(center.a - g.a) / (DEPTH_SIGMA * center.a));
+		const float normalWeight = pow(max(dot(center.xyz, g.xyz), 0.0), NORMAL_POWER);
+		const float w = max(bilinear, 1e-3) * depthWeight * normalWeight;
+		sum += w * texelFetch(indirectDiffuse, tap, 0);
+		weightSum += w;
+	}
+	const vec4 indirect = weightSum > 1e-6 ? sum / weightSum : vec4(0, 0, 0, 1);
+	if(visualizeTemporalReuse) {
+		const float reuse = clamp((indirect.a - 1) / (MAX_HISTORY - 1), 0, 1);
+		color = vec4(1 - reuse, reuse, 0, 1);
+		return;
+	}
+	color = vec4(pow(pow(scene, vec3(GAMMA)) + indirect.rgb + reflected, vec3(1.0 / GAMMA)), 1);
+}
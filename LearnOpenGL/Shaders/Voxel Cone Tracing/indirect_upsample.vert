@@ -0,0 +1,5 @@
+#version 450 core
+
+layout(location = 0) in vec3 position;
+
+void main(){ gl_Position = vec4(position.xy, 0, 1); }
@@ -0,0 +1,171 @@
+// Indirect specular light only, composited by 'indirect_upsample.frag' onto the forward pass (which was rendered without it).
+// Glossy enough opaque materials (specular diffusion up to the cutoff) first march their reflection through the hierarchical
+// view depth built by 'hi_z.comp' and reflect the lit scene where it hits; everything else, and every miss, traces the
+// specular cone of 'voxel_cone_tracing.frag'. Same march as HiZBuffer::trace and VoxelConeTracer::screenSpaceReflection.
+// Output is linear and already scaled the way the forward pass would add it to the pixel.
+#version 450 core
+
+#define GAMMA 2.2
+#define VOXEL_SIZE (1/64.0)
+#define MIPMAP_HARDCAP 5.4f
+#define MAX_ITERATIONS 256
+#define CELL_EPSILON 1e-3f				// In pixels, past the cell boundary.
+#define REFLECTION_MAX_DISTANCE 3.4641016f	// Diagonal of the voxel volume.
+#define REFLECTION_THICKNESS 0.1f		// In view depth, how far behind a surface a ray still hits it.
+#define REFLECTION_NEAR 0.01f			// Rays are clipped to this view depth.
+#define DEPTH_TOLERANCE 0.01f			// Relative view depth difference to the guide of the visible fragment.
+
+#include "../Common/materials.glsl"
+
+// Per frame constants written by Graphics::uploadShaderBlocks (ShaderBlocks::Frame).
+layout(std140, binding = 1) uniform Frame {
+	mat4 V;
+	mat4 P;
+	vec3 cameraPosition;
+	int state;
+	ivec2 screenSize;
+	int numberOfLights;
+};
+uniform sampler3D texture3D;
+
+uniform float reflectionDiffusionCutoff;
+uniform sampler2D hiZ;			// Closest view depth per level, padded to power of 2 sizes.
+uniform sampler2D sceneColor;	// The forward pass, gamma corrected.
+uniform sampler2D guide;		// Normal and view depth (0 = background).
+
+// Rays marched and rays that hit, read back by Graphics::renderSpecularReflections.
+layout(std430, binding = 2) buffer ReflectionCounters { uint reflectionRays; uint reflectionHits; };
+
+in vec3 worldPositionFrag;
+in vec3 normalFrag;
+in float viewDepthFrag;
+
+out vec4 color;
+
+vec3 normal = normalize(normalFrag);
+Material material;
+
+vec3 scaleAndBias(const vec3 p) { return 0.5f * p + vec3(0.5f); }
+
+bool isInsideCube(const vec3 p, float e) { return abs(p.x) < 1 + e && abs(p.y) < 1 + e && abs(p.z) < 1 + e; }
+
+vec3 traceSpecularVoxelCone(vec3 from, vec3 direction){
+	direction = normalize(direction);
+	const float OFFSET = 8 * VOXEL_SIZE;
+	const float STEP = VOXEL_SIZE;
+	const float MAX_DISTANCE = distance(abs(worldPositionFrag), vec3(-1));
+
+	from += OFFSET * normal;
+	vec4 acc = vec4(0.0f);
+	float dist = OFFSET;
+	while(dist < MAX_DISTANCE && acc.a < 1){
+		const vec3 p = from + dist * direction;
+		if(!isInsideCube(p, 0)) break;
+		const float level = 0.1f * material.specularDiffusion * log2(1 + dist / VOXEL_SIZE);
+		const vec4 voxel = textureLod(texture3D, scaleAndBias(p), min(level, MIPMAP_HARDCAP));
+		const float f = 1 - acc.a;
+		acc.rgb += 0.25f * (1 + material.specularDiffusion) * voxel.rgb * voxel.a * f;
+		acc.a += 0.25f * voxel.a * f;
+		dist += STEP * (1.0f + 0.125f * level);
+	}
+	return pow(material.specularDiffusion + 1, 0.8f) * acc.rgb;
+}
+
+// Parameter along the segment where it leaves the cell of a level around a point.
+float cellExit(const vec2 start, const vec2 delta, const vec2 p, const int level){
+	const float size = float(1 << level);
+	float exit = 1.0f;
+	for(int axis = 0; axis < 2; ++axis) {
+		if(delta[axis] == 0.0f) continue;
+		const float cell = floor(p[axis] / size);
+		const float boundary = (delta[axis] > 0.0f ? cell + 1.0f : cell) * size;
+		exit = min(exit, (boundary - start[axis]) / delta[axis]);
+	}
+	return exit;
+}
+
+// Marches a screen space segment (in pixels) through the hierarchical depth, see HiZBuffer::trace.
+bool traceHiZ(const vec2 start, const vec2 end, const float startInverseDepth, const float endInverseDepth, out ivec2 hit){
+	const vec2 delta = end - start;
+	const float len = max(abs(delta.x), abs(delta.y));
+	if(len < 1.0f) return false;
+	const float epsilon = CELL_EPSILON / len;
+	const vec2 size = vec2(textureSize(guide, 0));
+	const int levelCount = textureQueryLevels(hiZ);
+
+	// Leave the start pixel first, its surface is where the segment starts.
+	float t = cellExit(start, delta, start, 0) + epsilon;
+	int level = 0;
+	for(int i = 0; i < MAX_ITERATIONS && t < 1.0f; ++i) {
+		const vec2 p = start + t * delta;
+		if(any(lessThan(p, vec2(0))) || any(greaterThanEqual(p, size))) return false;
+
+		const ivec2 cell = ivec2(p) >> level;
+		const float exit = cellExit(start, delta, p, level);
+		const float depth0 = 1.0f / mix(startInverseDepth, endInverseDepth, t), depth1 = 1.0f / mix(startInverseDepth, endInverseDepth, exit);
+		const float surface = texelFetch(hiZ, cell, level).r;
+
+		// In front of every surface of the cell: skip it and try a coarser level.
+		if(max(depth0, depth1) < surface) {
+			t = exit + epsilon;
+			level = min(level + 1, levelCount - 1);
+			continue;
+		}
+		if(level > 0) { --level; continue; }
+
+		// A pixel the segment reaches: a hit, unless the segment passes more than the thickness behind its surface.
+		if(min(depth0, depth1) <= surface + REFLECTION_THICKNESS) {
+			hit = cell;
+			return true;
+		}
+		t = exit + epsilon;
+	}
+	return false;
+}
+
+// The reflection of the lit scene, or false if the ray leaves the screen or hits nothing facing it.
+bool screenSpaceReflection(const vec3 reflection, out vec3 light){
+	const mat4 viewProjection = P * V;
+	const vec3 from = worldPositionFrag + VOXEL_SIZE * normal;
+	const vec4 start = viewProjection * vec4(from, 1);
+	vec4 end = viewProjection * vec4(from + REFLECTION_MAX_DISTANCE * reflection, 1);
+	if(start.w <= REFLECTION_NEAR) return false;
+	if(end.w < REFLECTION_NEAR) end = mix(start, end, (start.w - REFLECTION_NEAR) / (start.w - end.w));
+
+	const vec2 size = vec2(textureSize(guide, 0));
+	ivec2 pixel;
+	if(!traceHiZ((0.5f * start.xy / start.w + 0.5f) * size, (0.5f * end.xy / end.w + 0.5f) * size, 1.0f / start.w, 1.0f / end.w, pixel)) return false;
+
+	// Only surfaces facing the ray reflect what they show on screen.
+	const vec4 g = texelFetch(guide, pixel, 0);
+	if(g.a <= 0 || dot(g.xyz, reflection) >= 0) return false;
+
+	// As bright as a specular cone gets on an opaque surface, so hits and misses match (see traceSpecularVoxelCone).
+	const float gain = pow(material.specularDiffusion + 1, 1.8f);
+	light = gain * pow(texelFetch(sceneColor, pixel, 0).rgb, vec3(GAMMA));
+	return true;
+}
+
+void main(){
+	material = materials[materialIndex];
+
+	// Only the visible fragment of every pixel (the guide holds its depth).
+	const float visibleDepth = texelFetch(guide, ivec2(gl_FragCoord.xy), 0).a;
+	if(abs(viewDepthFrag - visibleDepth) > DEPTH_TOLERANCE * visibleDepth) discard;
+
+	color = vec4(0, 0, 0, 1);
+	if(material.specularReflectivity * (1.0f - material.transparency) <= 0.01f) return;
+
+	const vec3 reflection = normalize(reflect(normalize(worldPositionFrag - cameraPosition), normal));
+	vec3 light;
+	bool hit = false;
+	if(material.specularDiffusion <= reflectionDiffusionCutoff && material.transparency <= 0.01f) {
+		hit = screenSpaceReflection(reflection, light);
+		atomicAdd(reflectionRays, 1);
+		if(hit) atomicAdd(reflectionHits, 1);
+	}
+	if(!hit) light = traceSpecularVoxelCone(worldPositionFrag, reflection);
+
+	color.rgb = material.specularReflectivity * material.specularColor * light;
+	if(material.transparency > 0.01f) color.rgb *= 1.0f - material.transparency; // The forward pass mixes in refraction.
+}
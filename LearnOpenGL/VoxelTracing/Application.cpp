@@ -3,7 +3,11 @@
 // Standard library.
 #include <iostream>
 #include <iomanip>
+#include <fstream>
+#include <string>
 #include <time.h>
+#include <chrono>
+#include <algorithm>
 
 // External.
 #define GLEW_STATIC
@@ -16,12 +20,20 @@
 #include "Graphic\Graphics.h"
 #include "Graphic\Material\MaterialStore.h"
 #include "Graphic\Renderer\MeshRenderer.h"
+#include "Graphic\GLState.h"
+#include "Graphic\Device\NullDevice.h"
+#include "Graphic\Device\RecordingDevice.h"
 #include "Time\Time.h"
+#include "Benchmark\Benchmark.h"
 
 #define __LOG_INTERVAL 0 /* How often we should log frame rate info to the console. = 0 means don't log. */
 #if __LOG_INTERVAL > 0
 constexpr float __LOG_INTERVAL_TIME_GUARD = 1.0f;
 #endif
+#define __RUN_BENCHMARKS 0 /* Runs the CPU benchmarks (see Benchmark.h) before initialization if > 0. */
+#define __HEADLESS_FRAMES 0 /* Profiles this many frames on the null device (see runHeadless) instead of opening a window if > 0. */
+#define __CAPTURE_FRAME 0 /* Headless runs write the GL calls of this frame (1 is the first) to __CAPTURE_PATH (see RecordingDevice) if > 0. */
+#define __CAPTURE_PATH "capture.txt"
 
 using __DEFAULT_LEVEL = GlassScene; // The scene that will be loaded on startup.
 // (see ScenePack.h for more scenes)
@@ -32,6 +44,13 @@ Application & Application::getInstance() {
 }
 
 void Application::init() {
+#if __RUN_BENCHMARKS > 0
+	Benchmark::runAll();
+#endif
+#if __HEADLESS_FRAMES > 0
+	runHeadless(__HEADLESS_FRAMES);
+	return;
+#endif
 	std::cout << "Initialization started." << std::endl;
 
 	// -------------------------------------
@@ -102,6 +121,7 @@ void Application::init() {
 	scene = new __DEFAULT_LEVEL();
 	scene->init(w, h);
 	std::cout << "[3] : Scene initialized." << std::endl;
+	MaterialStore::getInstance().report(); // Shaders compiled while the scene loaded.
 
 	// -------------------------------------
 	// Initialize AntTweakBar.
@@ -113,15 +133,30 @@ void Application::init() {
 	// Main bar.
 	mainTweakBar = TwNewBar("Rendering settings");
 	TwType renderingMode = TwDefineEnum("RenderingMode", NULL, 0);
+	TwType indirectDiffuseResolution = TwDefineEnum("IndirectDiffuseResolution", NULL, 0);
 	for (auto * meshRenderer : scene->renderers) if (meshRenderer->tweakable) tweakableRenderers.push_back(meshRenderer);
 	TwAddVarRW(mainTweakBar, "Application state", TW_TYPE_INT32, &state, "label='State' group=Rendering");
 	TwAddVarRW(mainTweakBar, "Rendering mode", renderingMode, &currentRenderingMode, "enum='0 {Voxel Visualization}, 1 {Voxel Cone Tracing}' group=Rendering");
+	TwAddVarRO(mainTweakBar, "State changes", TW_TYPE_UINT32, &GLState::getInstance().lastFrameStateChanges, "group=Rendering");
+	TwAddVarRO(mainTweakBar, "Redundant state changes", TW_TYPE_UINT32, &GLState::getInstance().lastFrameRedundantChanges, "label='Filtered state changes' group=Rendering");
 	auto temp = "mainsep1";
 	TwAddSeparator(mainTweakBar, temp, NULL);
 	TwAddVarRW(mainTweakBar, "Shadows", TW_TYPE_BOOL8, &graphics.shadows, "group=Settings");
 	TwAddVarRW(mainTweakBar, "Direct light", TW_TYPE_BOOL8, &graphics.directLight, "group=Settings");
 	TwAddVarRW(mainTweakBar, "Indirect diffuse light", TW_TYPE_BOOL8, &graphics.indirectDiffuseLight, "group=Settings");
+	TwAddVarRW(mainTweakBar, "Indirect diffuse resolution", indirectDiffuseResolution, &graphics.indirectDiffuseResolution, "enum='1 {Full}, 2 {Half}, 4 {Quarter}' group=Settings");
+	TwAddVarRW(mainTweakBar, "Temporal indirect diffuse", TW_TYPE_BOOL8, &graphics.temporalIndirectDiffuse, "group=Settings");
+	const std::string ringCones = "min=1 max=" + std::to_string(ConeSets::DIFFUSE_RING_CONES) + " group=Settings";
+	TwAddVarRW(mainTweakBar, "Diffuse ring cones", TW_TYPE_INT32, &graphics.indirectDiffuseRingCones, ringCones.c_str());
+	TwAddVarRW(mainTweakBar, "Denoiser iterations", TW_TYPE_INT32, &graphics.denoiserIterations, "min=0 max=5 group=Settings");
+	TwAddVarRW(mainTweakBar, "Temporal reuse view", TW_TYPE_BOOL8, &graphics.visualizeTemporalReuse, "group=Settings");
+	TwAddVarRW(mainTweakBar, "Irradiance probes", TW_TYPE_BOOL8, &graphics.irradianceProbesEnabled, "group=Settings");
+	TwAddVarRW(mainTweakBar, "Probes per frame", TW_TYPE_INT32, &graphics.irradianceProbeBatch, "min=64 max=4096 step=64 group=Settings");
 	TwAddVarRW(mainTweakBar, "Indirect specular light", TW_TYPE_BOOL8, &graphics.indirectSpecularLight, "group=Settings");
+	TwAddVarRW(mainTweakBar, "Screen space reflections", TW_TYPE_BOOL8, &graphics.screenSpaceReflections, "group=Settings");
+	TwAddVarRW(mainTweakBar, "Reflection cutoff", TW_TYPE_FLOAT, &graphics.reflectionDiffusionCutoff, "min=0 max=16 step=0.1 group=Settings");
+	TwAddVarRO(mainTweakBar, "Reflection rays", TW_TYPE_UINT32, &graphics.reflectionRays, "group=Settings");
+	TwAddVarRO(mainTweakBar, "Reflection hit rate", TW_TYPE_FLOAT, &graphics.reflectionHitRate, "precision=1 group=Settings");
 
 	temp = "mainsep2";
 	TwAddSeparator(mainTweakBar, temp, NULL);
@@ -130,6 +165,9 @@ void Application::init() {
 	TwAddVarRW(mainTweakBar, "Voxelization sparsity", TW_TYPE_INT32, &graphics.voxelizationSparsity, "group=Voxelization");
 	TwAddVarRW(mainTweakBar, "Autogen mipmap", TW_TYPE_BOOL8, &graphics.automaticallyRegenerateMipmap, "group=Voxelization");
 	TwAddVarRW(mainTweakBar, "Queue mipmap gen", TW_TYPE_BOOL8, &graphics.regenerateMipmapQueued, "group=Voxelization");
+	TwAddVarRW(mainTweakBar, "Incremental mipmap", TW_TYPE_BOOL8, &graphics.incrementalMipmapping, "group=Voxelization");
+	TwAddVarRW(mainTweakBar, "Distance field", TW_TYPE_BOOL8, &graphics.distanceFieldEnabled, "group=Voxelization");
+	TwAddVarRW(mainTweakBar, "Occupancy bitmask", TW_TYPE_BOOL8, &graphics.occupancyEnabled, "group=Voxelization");
 
 	// Point lights.
 	TwStructMember pointMembers[] = {
@@ -174,7 +212,7 @@ void Application::init() {
 	std::cout << "Initialization finished (" << timeElapsed << " seconds)!" << std::endl;
 	glfwSetTime(0);
 
-	std::cout << "Using OpenGL version " << glGetString(GL_VERSION) << std::endl;
+	std::cout << "Using OpenGL version " << gl::getString(GL_VERSION) << std::endl;
 }
 
 void Application::UpdateObjectTweakbar() {
@@ -247,6 +285,9 @@ void Application::UpdateObjectTweakbar() {
 
 void Application::run()
 {
+#if __HEADLESS_FRAMES > 0
+	return;
+#endif
 	std::cout << "Application is now running.\n" << std::endl;
 	std::cout << " :: Use R to switch between rendering modes.\n";
 	// std::cout << " :: Use T to switch between interaction modes." << std::endl;
@@ -302,11 +343,13 @@ void Application::run()
 			graphics.render(*scene, viewportWidth, viewportHeight, currentRenderingMode);
 
 		}
+		MaterialStore::getInstance().poll(); // Programs still compiling after startup.
 
 		// --------------------------------------------------
 		// Tweakbar.
 		// --------------------------------------------------
 		TwDraw(); // Draw AntTweakBar.
+		GLState::getInstance().forgetTweakBarState(); // TwDraw changes state behind the cache's back.
 
 		// --------------------------------------------------
 		// Swap buffers and update timers.
@@ -357,6 +400,88 @@ void Application::run()
 	std::cout << "Application has now terminated." << std::endl;
 }
 
+void Application::runHeadless(const unsigned int frames)
+{
+	using Clock = std::chrono::high_resolution_clock;
+	using Milliseconds = std::chrono::duration<double, std::milli>;
+
+	std::cout << "Headless run started (" << frames << " frames)." << std::endl;
+
+	// GL objects are still deleted at exit, so the device is never deleted.
+	NullDevice * device = new NullDevice();
+	GLDevice::setCurrent(device);
+	currentInputState = InputState::TWEAK_BAR; // No window to read input from.
+	glfwInit(); // Timers only, no window is created.
+
+	const unsigned int w = DEFAULT_WINDOW_WIDTH, h = DEFAULT_WINDOW_HEIGHT;
+	MaterialStore::getInstance();
+	graphics.init(w, h);
+	scene = new __DEFAULT_LEVEL();
+	scene->init(w, h);
+	srand(0);
+	Time::time = 0;
+	initialized = Time::initialized = true;
+	const unsigned long long initializationCalls = device->getTotalCalls();
+	device->resetCalls();
+
+	// Fixed time steps, so runs are comparable.
+	double updateCost = 0, renderCost = 0;
+	for (unsigned int frame = 0; frame < frames; ++frame) {
+		Time::deltaTime = Time::smoothedDeltaTime = 1.0 / 60.0;
+		Time::time += Time::deltaTime;
+		Time::framesPerSecond = 60.0;
+
+		// The captured frame's render time includes writing the capture.
+		const bool capture = __CAPTURE_FRAME > 0 && frame + 1 == __CAPTURE_FRAME;
+		std::ofstream captureFile;
+		RecordingDevice * recorder = nullptr;
+		if (capture) {
+			captureFile.open(__CAPTURE_PATH, std::ios::out | std::ios::trunc);
+			recorder = new RecordingDevice(*device, captureFile);
+			GLDevice::setCurrent(recorder);
+		}
+
+		const auto start = Clock::now();
+		scene->update();
+		const auto updated = Clock::now();
+		graphics.render(*scene, w, h, currentRenderingMode);
+		const auto rendered = Clock::now();
+
+		if (capture) {
+			GLDevice::setCurrent(device);
+			delete recorder;
+			std::cout << "Frame " << frame + 1 << " captured to '" << __CAPTURE_PATH << "'." << std::endl;
+		}
+
+		updateCost += Milliseconds(updated - start).count();
+		renderCost += Milliseconds(rendered - updated).count();
+		Time::frameCount++;
+	}
+
+	// Report.
+	using namespace std;
+	const double n = frames > 0 ? double(frames) : 1.0;
+	cout << setprecision(4) << fixed;
+	cout << "Update: " << updateCost / n << " ms/frame, render: " << renderCost / n << " ms/frame (CPU only)." << endl;
+	cout << "GL calls: " << initializationCalls << " during initialization, " << device->getTotalCalls() / n << " per frame." << endl;
+
+	vector<GLDevice::Function> functions;
+	for (int i = 0; i < GLDevice::FUNCTION_COUNT; ++i) {
+		if (device->getCalls(GLDevice::Function(i)) > 0) functions.push_back(GLDevice::Function(i));
+	}
+	sort(functions.begin(), functions.end(), [device](GLDevice::Function a, GLDevice::Function b) { return device->getCalls(a) > device->getCalls(b); });
+	const size_t MOST_CALLED = 10;
+	for (size_t i = 0; i < functions.size() && i < MOST_CALLED; ++i) {
+		cout << "  " << setw(28) << left << GLDevice::getFunctionName(functions[i]) << right << setprecision(1) << device->getCalls(functions[i]) / n << endl;
+	}
+
+	const GLState & glState = GLState::getInstance();
+	cout << "State changes: " << glState.lastFrameStateChanges << ", filtered: " << glState.lastFrameRedundantChanges << " (previous to last frame)." << endl;
+	cout << "Validation errors: " << device->getErrors() << endl;
+
+	exitQueued = true;
+}
+
 void Application::UpdateGlobalInputParameters() {
 	if (glfwGetKey(currentWindow, GLFW_KEY_ESCAPE)) {
 		exitQueued = true;
@@ -48,6 +48,10 @@ public:
 	/// <summary> Runs the application. </summary>
 	void run();
 
+	/// <summary> Renders frames of the default scene on a NullDevice, without a window or GPU, and prints
+	/// the CPU cost and GL call counts per frame. Used instead of init and run when __HEADLESS_FRAMES > 0. </summary>
+	void runHeadless(const unsigned int frames);
+
 	/// <summary> Sets the window mode to be borderless fullscreen. </summary>
 	void SetBorderlessFullscreenMode();
 
@@ -0,0 +1,66 @@
+#include "Benchmark.h"
+
+#include <iostream>
+#include <random>
+#include <cmath>
+#include <cstdint>
+
+#include <glm.hpp>
+
+#include "../Graphic/Voxel/VoxelMipChain.h"
+#include "../Utility/Half.h"
+
+void Benchmark::runAll()
+{
+	std::cout << "Running benchmarks." << std::endl;
+	voxelMipChain();
+	distanceField();
+	voxelOccupancy();
+	voxelConeTracer();
+	voxelConeMarcher();
+	ringBuffer();
+	std::cout << "Benchmarks finished." << std::endl;
+}
+
+void Benchmark::fillCornellBox(VoxelMipChain & volume)
+{
+	const int size = volume.getSize();
+	const int bpv = volume.getBytesPerVoxel();
+	unsigned char * voxels = volume.getLevelData(0);
+	for (int z = 0; z < size; ++z) for (int y = 0; y < size; ++y) for (int x = 0; x < size; ++x) {
+		// Voxel center in world space [-1, 1]^3, like the voxelization.
+		const glm::vec3 p = (glm::vec3(x, y, z) + 0.5f) / float(size) * 2.0f - 1.0f;
+		const float wall = 0.95f;
+		glm::vec3 color(0.0f);
+		if (p.x < -wall) color = glm::vec3(0.8f, 0.1f, 0.1f);
+		else if (p.x > wall) color = glm::vec3(0.1f, 0.8f, 0.1f);
+		else if (p.y < -wall || p.y > wall || p.z < -wall) color = glm::vec3(0.8f);
+		else if (glm::length(p - glm::vec3(0.35f, -0.6f, 0.1f)) < 0.35f) color = glm::vec3(0.9f);
+		else if (std::abs(p.x + 0.4f) < 0.25f && std::abs(p.y + 0.45f) < 0.5f && std::abs(p.z + 0.3f) < 0.25f) color = glm::vec3(0.7f);
+		else continue;
+
+		const float rgba[4] = { color.r, color.g, color.b, 1.0f };
+		unsigned char * voxel = voxels + ((size_t(z) * size + y) * size + x) * bpv;
+		for (int c = 0; c < 4; ++c) {
+			if (volume.getFormat() == VoxelMipChain::Format::RGBA8) voxel[c] = (unsigned char)(rgba[c] * 255.0f + 0.5f);
+			else reinterpret_cast<uint16_t *>(voxel)[c] = Half::fromFloat(rgba[c]);
+		}
+	}
+}
+
+void Benchmark::createEmptySpaceRays(const VoxelMipChain & volume, const int rayCount, std::vector<glm::vec3> & origins, std::vector<glm::vec3> & directions)
+{
+	std::mt19937 random(0);
+	std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+	std::normal_distribution<float> normal;
+	const int size = volume.getSize();
+	origins.clear();
+	directions.clear();
+	while (int(origins.size()) < rayCount) {
+		const glm::vec3 origin = glm::vec3(uniform(random), uniform(random), uniform(random)) * float(size);
+		const glm::ivec3 voxel = glm::min(glm::ivec3(origin), glm::ivec3(size - 1));
+		if (volume.getVoxel(0, voxel.x, voxel.y, voxel.z)[3] > 0) continue; // RGBA8 alpha.
+		origins.push_back(origin);
+		directions.push_back(glm::normalize(glm::vec3(normal(random), normal(random), normal(random))));
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+
+#include <glm.hpp>
+
+class VoxelMipChain;
+
+/// <summary> CPU benchmarks for the voxel pipeline. None of them need a GL context.
+/// Enable __RUN_BENCHMARKS in 'Application.cpp' to run them on startup. </summary>
+namespace Benchmark {
+	/// <summary> Runs every benchmark and prints the results to the console. </summary>
+	void runAll();
+
+	/// <summary> Mip chain generation throughput (see 'VoxelMipChain.h'). </summary>
+	void voxelMipChain();
+
+	/// <summary> Distance field build time and ray marching steps with and without it (see 'VoxelDistanceField.h'). </summary>
+	void distanceField();
+
+	/// <summary> Occupancy bitmask size, build time and ray traversal steps (see 'VoxelOccupancy.h'). </summary>
+	void voxelOccupancy();
+
+	/// <summary> CPU reference cone tracing time and steps per pixel for each cone type (see 'VoxelConeTracer.h'). </summary>
+	void voxelConeTracer();
+
+	/// <summary> Cones per second of the packet cone marcher against its scalar path (see 'VoxelConeMarcher.h'). </summary>
+	void voxelConeMarcher();
+
+	/// <summary> Checks the wraparound, stalls, growth and retirement of a RingBuffer on a MockBackend, and times its allocations (see 'RingBuffer.h'). </summary>
+	void ringBuffer();
+
+	/// <summary> Fills level 0 of a volume with a voxelized Cornell box: five walls, a sphere and a box, all opaque. </summary>
+	void fillCornellBox(VoxelMipChain & volume);
+
+	/// <summary> Creates reproducible random rays (in voxel coordinates) that start in empty voxels of level 0. </summary>
+	void createEmptySpaceRays(const VoxelMipChain & volume, const int rayCount, std::vector<glm::vec3> & origins, std::vector<glm::vec3> & directions);
+
+	/// <summary> Returns the average time in seconds of a number of calls to a function. </summary>
+	template<typename Function>
+	double measure(Function function, const int repetitions = 5) {
+		using Clock = std::chrono::high_resolution_clock;
+		function(); // Warm up.
+		auto start = Clock::now();
+		for (int i = 0; i < repetitions; ++i) function();
+		return std::chrono::duration<double>(Clock::now() - start).count() / repetitions;
+	}
+}
@@ -0,0 +1,82 @@
+#include "Benchmark.h"
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <cstdint>
+
+#include "../Graphic/Buffer/RingBuffer.h"
+
+void Benchmark::ringBuffer()
+{
+	std::cout << "--- Ring buffer ---" << std::endl;
+	int failures = 0;
+	auto check = [&failures](const bool condition, const std::string & what) {
+		if (condition) return;
+		std::cout << "FAILED: " << what << "." << std::endl;
+		++failures;
+	};
+
+	// Three regions of 1 KB. The ring buffer owns the backend, the mock stays readable through this pointer.
+	MockBackend * mock = new MockBackend();
+	RingBuffer ring(1024, mock);
+	const size_t regionSize = ring.getRegionSize();
+	check(regionSize == 1024 && mock->getSize() == RingBuffer::REGIONS * regionSize, "a buffer of 3 regions of 1 KB");
+
+	// Three laps around the ring. The GPU catches up with every region one frame after it was fenced, except the
+	// first region of the second lap, which is still in flight when it comes around again.
+	unsigned int frame = 0;
+	for (int lap = 0; lap < 3; ++lap) {
+		for (unsigned int region = 0; region < RingBuffer::REGIONS; ++region, ++frame) {
+			ring.beginFrame();
+			check(ring.getRegion() == region, "frame " + std::to_string(frame) + " writes region " + std::to_string(region));
+			const RingBuffer::Allocation first = ring.write(uint32_t(frame), 4);
+			const RingBuffer::Allocation second = ring.allocate(100, 256);
+			check(first.offset == region * regionSize && second.offset == region * regionSize + 256,
+				"frame " + std::to_string(frame) + " allocates from the start of its region, aligned");
+			check(*reinterpret_cast<const uint32_t *>(first.data) == frame && first.buffer == 1, "frame " + std::to_string(frame) + " writes the mapping");
+			check(ring.getFrameBytes() == 356, "frame " + std::to_string(frame) + " counts its bytes with the alignment");
+			ring.endFrame();
+			check(mock->isInFlight(region), "frame " + std::to_string(frame) + " fences its region");
+
+			const unsigned int previous = (region + RingBuffer::REGIONS - 1) % RingBuffer::REGIONS;
+			if (frame > 0 && !(lap == 0 && previous == 0)) mock->complete(previous);
+		}
+	}
+	check(mock->fences == frame, "one fence per frame");
+	check(ring.getStalls() == 1 && mock->stalls == 1, "only the region that was still in flight stalls (" + std::to_string(ring.getStalls()) + " stalls)");
+
+	// A frame that doesn't fit grows the buffer. The old one is retired until every region was waited for.
+	for (unsigned int region = 0; region < RingBuffer::REGIONS; ++region) mock->complete(region);
+	ring.beginFrame();
+	const unsigned int grownRegion = ring.getRegion();
+	ring.allocate(512, 4);
+	const RingBuffer::Allocation large = ring.allocate(1500, 256);
+	ring.endFrame();
+	check(ring.getGrowths() == 1 && ring.getRegionSize() == 2048 && mock->getSize() == RingBuffer::REGIONS * 2048, "growth doubles the regions");
+	check(large.buffer == 2 && large.offset == grownRegion * 2048, "the frame continues at the start of its region in the new buffer");
+	check(mock->getRetiredCount() == 1, "the old buffer is retired");
+	for (unsigned int i = 1; i <= RingBuffer::REGIONS; ++i) {
+		mock->complete((grownRegion + i - 1) % RingBuffer::REGIONS);
+		ring.beginFrame();
+		const RingBuffer::Allocation allocation = ring.allocate(16, 16);
+		ring.endFrame();
+		check(allocation.buffer == 2 && allocation.offset == (grownRegion + i) % RingBuffer::REGIONS * 2048, "frames after the growth write the new buffer");
+		check(mock->getRetiredCount() == (i < RingBuffer::REGIONS ? 1u : 0u),
+			"the old buffer is deleted " + std::to_string(RingBuffer::REGIONS) + " frames after the growth, not after " + std::to_string(i));
+	}
+	check(ring.getStalls() == 1, "no stalls around the growth");
+	std::cout << (failures == 0 ? "Wraparound, stalls, growth and retirement checks passed." : "Ring buffer checks failed.") << std::endl;
+
+	// Allocation cost: per frame and per draw blocks of a large scene.
+	const int drawsPerFrame = 4096;
+	RingBuffer stream(drawsPerFrame * 256 + 256, new MockBackend());
+	const double seconds = measure([&] {
+		stream.beginFrame();
+		stream.allocate(256, 256);
+		for (int draw = 0; draw < drawsPerFrame; ++draw) stream.write(draw, 256);
+		stream.endFrame();
+	}, 50);
+	std::cout << std::fixed << std::setprecision(2)
+		<< drawsPerFrame << " draw blocks per frame: " << seconds * 1e9 / (drawsPerFrame + 1) << " ns per allocation." << std::endl;
+}
@@ -0,0 +1,55 @@
+#include "Benchmark.h"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include <glm.hpp>
+
+#include "../Graphic/Voxel/VoxelMipChain.h"
+#include "../Graphic/Voxel/VoxelConeMarcher.h"
+
+void Benchmark::voxelConeMarcher()
+{
+	std::cout << "--- Voxel cone marcher ---" << std::endl;
+	for (int size : { 64, 128, 256 }) {
+		VoxelMipChain volume(size, VoxelMipChain::Format::RGBA8);
+		fillCornellBox(volume);
+		volume.generateMipmaps(VoxelMipChain::Filter::BOX);
+		VoxelConeMarcher marcher(volume);
+
+		// Cones from empty space, in texture space.
+		const int coneCount = 1 << 15;
+		std::vector<glm::vec3> origins, directions;
+		createEmptySpaceRays(volume, coneCount, origins, directions);
+
+		for (float aperture : { 0.577f, 0.1f }) { // Diffuse (60 degrees) and glossy cones.
+			std::vector<VoxelConeMarcher::Cone> cones(coneCount);
+			for (int i = 0; i < coneCount; ++i) {
+				cones[i].origin = origins[i] / float(size);
+				cones[i].direction = directions[i];
+				cones[i].aperture = aperture;
+				cones[i].startDistance = 1.0f / size;
+			}
+
+			std::vector<VoxelConeMarcher::Result> scalar(coneCount), packets(coneCount);
+			double scalarSeconds = measure([&] { marcher.marchScalar(cones.data(), scalar.data(), coneCount); }, 2);
+			double packetSeconds = measure([&] { marcher.march(cones.data(), packets.data(), coneCount); }, 2);
+
+			long long steps = 0;
+			float maxError = 0.0f;
+			for (int i = 0; i < coneCount; ++i) {
+				steps += scalar[i].steps;
+				const glm::vec4 d = glm::abs(scalar[i].color - packets[i].color);
+				maxError = std::max(maxError, std::max(std::max(d.x, d.y), std::max(d.z, d.w)));
+			}
+			std::cout << std::fixed << std::setprecision(2)
+				<< size << "^3, aperture " << aperture << ": " << double(steps) / coneCount << " steps per cone, scalar "
+				<< coneCount / scalarSeconds / 1e6 << " Mcones/s, " << (marcher.usesPackets() ? "packets " : "packets (unavailable, scalar) ")
+				<< coneCount / packetSeconds / 1e6 << " Mcones/s (" << scalarSeconds / packetSeconds << "x), max difference "
+				<< std::setprecision(5) << maxError << "." << std::endl;
+		}
+	}
+}
@@ -0,0 +1,346 @@
+#include "Benchmark.h"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include <glm.hpp>
+
+#include "../Graphic/Voxel/VoxelMipChain.h"
+#include "../Graphic/Voxel/VoxelConeTracer.h"
+#include "../Graphic/Voxel/IrradianceProbeGrid.h"
+#include "../Graphic/Voxel/VoxelLightVisibility.h"
+#include "../Graphic/Camera/PerspectiveCamera.h"
+#include "../Graphic/Lighting/PointLight.h"
+#include "../Graphic/Material/MaterialSetting.h"
+#include "../Graphic/Denoising/AtrousFilter.h"
+#include "../Utility/Parallel.h"
+
+namespace {
+	/// <summary> Casts a ray against the analytic version of Benchmark::fillCornellBox. Returns the closest hit distance or a negative value. </summary>
+	float intersectCornellBox(const glm::vec3 & origin, const glm::vec3 & direction, glm::vec3 & normal, int & materialIndex) {
+		const float wall = 0.95f;
+		float closest = -1.0f;
+		auto consider = [&](const float t, const glm::vec3 & n, const int m) {
+			if (t > 1e-4f && (closest < 0.0f || t < closest)) { closest = t; normal = n; materialIndex = m; }
+		};
+
+		// Inner faces of the walls (the front is open).
+		const struct { int axis; float side; int material; } walls[] = { { 0, -1, 1 }, { 0, 1, 2 }, { 1, -1, 0 }, { 1, 1, 0 }, { 2, -1, 0 } };
+		for (const auto & w : walls) {
+			if (direction[w.axis] == 0.0f) continue;
+			const float t = (w.side * wall - origin[w.axis]) / direction[w.axis];
+			const glm::vec3 p = origin + t * direction;
+			if (std::abs(p.x) <= 1.0f && std::abs(p.y) <= 1.0f && std::abs(p.z) <= 1.0f) {
+				glm::vec3 n(0.0f);
+				n[w.axis] = -w.side;
+				consider(t, n, w.material);
+			}
+		}
+
+		// Sphere.
+		const glm::vec3 center(0.35f, -0.6f, 0.1f);
+		const float radius = 0.35f;
+		const glm::vec3 oc = origin - center;
+		const float b = glm::dot(oc, direction), c = glm::dot(oc, oc) - radius * radius, d = b * b - c;
+		if (d >= 0.0f) {
+			const float t = -b - std::sqrt(d);
+			consider(t, glm::normalize(origin + t * direction - center), 3);
+		}
+
+		// Box.
+		const glm::vec3 boxCenter(-0.4f, -0.45f, -0.3f), halfSize(0.25f, 0.5f, 0.25f);
+		float tNear = -1e30f, tFar = 1e30f;
+		int nearAxis = 0;
+		for (int axis = 0; axis < 3; ++axis) {
+			if (direction[axis] == 0.0f) {
+				if (std::abs(origin[axis] - boxCenter[axis]) > halfSize[axis]) tNear = 1e30f;
+				continue;
+			}
+			float t0 = (boxCenter[axis] - halfSize[axis] - origin[axis]) / direction[axis];
+			float t1 = (boxCenter[axis] + halfSize[axis] - origin[axis]) / direction[axis];
+			if (t0 > t1) std::swap(t0, t1);
+			if (t0 > tNear) { tNear = t0; nearAxis = axis; }
+			tFar = std::min(tFar, t1);
+		}
+		if (tNear <= tFar) {
+			glm::vec3 n(0.0f);
+			n[nearAxis] = direction[nearAxis] > 0.0f ? -1.0f : 1.0f;
+			consider(tNear, n, 0);
+		}
+		return closest;
+	}
+
+	/// <summary> Rasterizes the analytic Cornell box for a camera looking down -z (top row first). </summary>
+	void createCornellBoxGBuffer(const Camera & camera, const float fov, const int width, const int height,
+		const MaterialSetting * materials, std::vector<VoxelConeTracer::GBufferTexel> & gBuffer) {
+		const float tanHalfFov = std::tan(0.5f * fov);
+		gBuffer.assign(size_t(width) * height, VoxelConeTracer::GBufferTexel());
+		for (int y = 0; y < height; ++y) for (int x = 0; x < width; ++x) {
+			const glm::vec2 ndc((x + 0.5f) / width * 2.0f - 1.0f, 1.0f - (y + 0.5f) / height * 2.0f);
+			const glm::vec3 direction = glm::normalize(glm::vec3(ndc.x * tanHalfFov * width / float(height), ndc.y * tanHalfFov, -1.0f));
+			glm::vec3 normal;
+			int material = 0;
+			const float t = intersectCornellBox(camera.position, direction, normal, material);
+			if (t < 0.0f) continue;
+			auto & texel = gBuffer[size_t(y) * width + x];
+			texel.position = camera.position + t * direction;
+			texel.normal = normal;
+			texel.material = &materials[material];
+		}
+	}
+
+	/// <summary> Returns the PSNR (in dB) of an image against a reference, with colors clamped to [0, 1]. </summary>
+	double psnr(const std::vector<glm::vec3> & image, const std::vector<glm::vec3> & reference) {
+		double squaredError = 0.0;
+		for (size_t i = 0; i < image.size(); ++i) {
+			const glm::vec3 d = glm::clamp(image[i], 0.0f, 1.0f) - glm::clamp(reference[i], 0.0f, 1.0f);
+			squaredError += glm::dot(d, d) / 3.0;
+		}
+		const double mse = squaredError / image.size();
+		return mse > 0.0 ? 10.0 * std::log10(1.0 / mse) : INFINITY;
+	}
+
+	/// <summary> Returns the PSNR (in dB) of an image against a reference over the pixels that differ only, without clamping
+	/// (bright reflections saturate either way once clamped). The peak is the brightest reference channel. </summary>
+	double changedPsnr(const std::vector<glm::vec3> & image, const std::vector<glm::vec3> & reference, size_t & changed) {
+		double squaredError = 0.0, peak = 0.0;
+		changed = 0;
+		for (size_t i = 0; i < image.size(); ++i) {
+			peak = std::max(peak, double(glm::max(reference[i].x, glm::max(reference[i].y, reference[i].z))));
+			const glm::vec3 d = image[i] - reference[i];
+			if (glm::max(glm::abs(d.x), glm::max(glm::abs(d.y), glm::abs(d.z))) <= 1e-4f) continue;
+			squaredError += glm::dot(d, d) / 3.0;
+			++changed;
+		}
+		if (changed == 0 || squaredError <= 0.0) return INFINITY;
+		return 10.0 * std::log10(peak * peak / (squaredError / changed));
+	}
+}
+
+void Benchmark::voxelConeTracer()
+{
+	const int size = 64, width = 128, height = 128;
+	VoxelMipChain volume(size, VoxelMipChain::Format::RGBA8);
+	fillCornellBox(volume);
+	volume.generateMipmaps(VoxelMipChain::Filter::BOX);
+
+	// Materials: white, red, green and a glossy sphere.
+	MaterialSetting materials[4] = {
+		MaterialSetting(glm::vec3(0.97f)), MaterialSetting(glm::vec3(1.0f, 0.26f, 0.27f)),
+		MaterialSetting(glm::vec3(0.27f, 1.0f, 0.26f)), MaterialSetting(glm::vec3(0.97f), 0.0f, 0.8f, 0.2f)
+	};
+	materials[3].specularDiffusion = 0.5f;
+
+	// G-buffer seen from in front of the open side of the box.
+	PerspectiveCamera camera(0.7f, width / float(height));
+	camera.position = glm::vec3(0.0f, 0.0f, 3.0f);
+	camera.updateViewMatrix();
+	std::vector<VoxelConeTracer::GBufferTexel> gBuffer;
+	createCornellBoxGBuffer(camera, 0.7f, width, height, materials, gBuffer);
+	const std::vector<PointLight> lights = { PointLight(glm::vec3(0.0f, 0.75f, 0.0f), glm::vec3(1.0f)) };
+
+	std::vector<unsigned int> threadCounts = { 1 };
+	if (Parallel::hardwareThreadCount() > 1) threadCounts.push_back(Parallel::hardwareThreadCount());
+
+	// Every cone type on its own, then everything together.
+	std::cout << "--- Voxel cone tracer (CPU reference) ---" << std::endl;
+	const char * names[] = { "direct + shadows", "indirect diffuse", "indirect specular", "all" };
+	for (int configuration = 0; configuration < 4; ++configuration) {
+		VoxelConeTracer::Settings settings;
+		settings.directLight = settings.shadows = configuration == 0 || configuration == 3;
+		settings.indirectDiffuseLight = configuration == 1 || configuration == 3;
+		settings.indirectSpecularLight = configuration == 2 || configuration == 3;
+
+		VoxelConeTracer tracer(volume);
+		VoxelConeTracer::Image image;
+		for (unsigned int threads : threadCounts) {
+			double seconds = measure([&] { tracer.render(gBuffer, width, height, camera, lights, settings, image, threads); }, 2);
+			unsigned long long steps = 0;
+			unsigned int maxSteps = 0;
+			for (unsigned int s : image.steps) { steps += s; maxSteps = std::max(maxSteps, s); }
+			std::cout << std::fixed << std::setprecision(2)
+				<< width << "x" << height << " " << names[configuration] << ", " << threads << " thread(s): " << seconds * 1000.0 << " ms, "
+				<< double(steps) / image.steps.size() << " steps per pixel (max " << maxSteps << ")." << std::endl;
+		}
+	}
+
+	// Indirect diffuse light at reduced resolutions, compared to full resolution.
+	VoxelConeTracer tracer(volume);
+	VoxelConeTracer::Settings settings;
+	VoxelConeTracer::Image reference, image;
+	tracer.render(gBuffer, width, height, camera, lights, settings, reference);
+	for (int factor : { 1, 2, 4 }) {
+		settings.indirectDiffuseResolution = factor;
+		double seconds = measure([&] { tracer.render(gBuffer, width, height, camera, lights, settings, image, threadCounts.back()); }, 2);
+		unsigned long long steps = 0;
+		for (unsigned int s : image.steps) steps += s;
+		std::cout << std::fixed << std::setprecision(2)
+			<< width << "x" << height << " all, indirect diffuse at 1/" << factor << " resolution: " << seconds * 1000.0 << " ms, "
+			<< double(steps) / image.steps.size() << " steps per pixel, PSNR " << psnr(image.color, reference.color) << " dB." << std::endl;
+	}
+
+	// Temporal accumulation while the camera slides sideways, compared to tracing every frame from scratch.
+	settings.indirectDiffuseResolution = 1;
+	VoxelConeTracer::Settings temporalSettings = settings;
+	temporalSettings.temporalIndirectDiffuse = true;
+	temporalSettings.ringCones = 2;
+	VoxelConeTracer::History history;
+	const int frames = 32;
+	double seconds = 0.0;
+	for (int frame = 1; frame <= frames; ++frame) {
+		camera.position = glm::vec3(0.4f * frame / frames, 0.0f, 3.0f);
+		camera.updateViewMatrix();
+		createCornellBoxGBuffer(camera, 0.7f, width, height, materials, gBuffer);
+		VoxelConeTracer::History next; // Every measured run starts from the same history.
+		seconds += measure([&] { next = history; tracer.render(gBuffer, width, height, camera, lights, temporalSettings, image, threadCounts.back(), &next); }, 1);
+		history = next;
+		if ((frame & (frame - 1)) != 0) continue; // Report powers of two.
+
+		tracer.render(gBuffer, width, height, camera, lights, settings, reference, threadCounts.back());
+		unsigned long long steps = 0;
+		for (unsigned int s : image.steps) steps += s;
+		int surfaces = 0, reused = 0;
+		double accumulated = 0.0;
+		for (size_t i = 0; i < history.indirect.size(); ++i) if (history.guide[i].material != nullptr) {
+			++surfaces;
+			reused += history.indirect[i].w > 1.0f;
+			accumulated += history.indirect[i].w;
+		}
+		std::cout << std::fixed << std::setprecision(2)
+			<< width << "x" << height << " all, temporal indirect diffuse (" << temporalSettings.ringCones << " ring cones), frame " << frame << ": "
+			<< seconds / frame * 1000.0 << " ms per frame, " << double(steps) / image.steps.size() << " steps per pixel, "
+			<< 100.0 * reused / std::max(surfaces, 1) << "% reused (" << accumulated / std::max(surfaces, 1) << " frames), PSNR "
+			<< psnr(image.color, reference.color) << " dB." << std::endl;
+	}
+
+	// Fewer diffuse cones rotated with blue noise and denoised, against all 9 cones (indirect diffuse light only).
+	camera.position = glm::vec3(0.0f, 0.0f, 3.0f);
+	camera.updateViewMatrix();
+	createCornellBoxGBuffer(camera, 0.7f, width, height, materials, gBuffer);
+	VoxelConeTracer::Settings diffuseOnly;
+	diffuseOnly.directLight = diffuseOnly.shadows = diffuseOnly.indirectSpecularLight = false;
+	const double fullSeconds = measure([&] { tracer.render(gBuffer, width, height, camera, lights, diffuseOnly, reference, threadCounts.back()); }, 2);
+	std::cout << std::fixed << std::setprecision(2) << width << "x" << height << " indirect diffuse, 8 ring cones: " << fullSeconds * 1000.0 << " ms." << std::endl;
+	for (int ringCones : { 2, 1 }) {
+		for (int iterations : { 0, 3, 5 }) {
+			VoxelConeTracer::Settings sparse = diffuseOnly;
+			sparse.ringCones = ringCones;
+			sparse.denoiseIterations = iterations;
+			seconds = measure([&] { tracer.render(gBuffer, width, height, camera, lights, sparse, image, threadCounts.back()); }, 2);
+			unsigned long long steps = 0;
+			for (unsigned int s : image.steps) steps += s;
+			std::cout << std::fixed << std::setprecision(2)
+				<< width << "x" << height << " indirect diffuse, " << ringCones << " ring cone(s), " << iterations << " a-trous iteration(s): "
+				<< seconds * 1000.0 << " ms, " << double(steps) / image.steps.size() << " steps per pixel, PSNR "
+				<< psnr(image.color, reference.color) << " dB." << std::endl;
+		}
+	}
+
+	// Global cone budgets: the farthest tiles drop to cheaper cone sets first.
+	VoxelConeTracer::Settings unlimited;
+	VoxelConeTracer::Image full;
+	const double unlimitedSeconds = measure([&] { tracer.render(gBuffer, width, height, camera, lights, unlimited, full, threadCounts.back()); }, 2);
+	unsigned long long fullCones = 0;
+	for (unsigned long long c : full.cones) fullCones += c;
+	for (int percent : { 100, 75, 50, 25 }) {
+		VoxelConeTracer::Settings budgeted = unlimited;
+		budgeted.coneBudget = percent == 100 ? 0 : fullCones * percent / 100;
+		seconds = percent == 100 ? unlimitedSeconds :
+			measure([&] { tracer.render(gBuffer, width, height, camera, lights, budgeted, image, threadCounts.back()); }, 2);
+		const VoxelConeTracer::Image & result = percent == 100 ? full : image;
+		unsigned long long cones = 0;
+		for (unsigned long long c : result.cones) cones += c;
+		int levels[ConeBudget::LEVEL_COUNT] = {};
+		for (int level : result.tileLevels) ++levels[level];
+		std::cout << std::fixed << std::setprecision(2)
+			<< width << "x" << height << " all, cone budget " << percent << "%: " << seconds * 1000.0 << " ms, " << cones << " cones ("
+			<< result.cones[ConeBudget::DIFFUSE] << " diffuse, " << result.cones[ConeBudget::SPECULAR] << " specular, "
+			<< result.cones[ConeBudget::REFRACTION] << " refraction, " << result.cones[ConeBudget::SHADOW] << " shadow), tiles per level "
+			<< levels[0] << "/" << levels[1] << "/" << levels[2] << "/" << levels[3] << ", PSNR " << psnr(result.color, full.color) << " dB." << std::endl;
+	}
+
+	// Irradiance probes: placed and traced once for the volume, then interpolated per pixel at any resolution.
+	IrradianceProbeGrid probeGrid(16);
+	const double placementSeconds = measure([&] { probeGrid.invalidate(volume); }, 1);
+	const int placedProbes = probeGrid.getPlacedProbeCount();
+	seconds = measure([&] { probeGrid.invalidate(volume); probeGrid.update(tracer, 0, threadCounts.back()); }, 1) - placementSeconds;
+	std::cout << std::fixed << std::setprecision(2) << "Irradiance probes: " << placedProbes << " of " << probeGrid.getProbeCount() << " placed in "
+		<< placementSeconds * 1000.0 << " ms, traced in " << seconds * 1000.0 << " ms (" << seconds * 1e6 / std::max(placedProbes, 1)
+		<< " us per probe, " << IrradianceProbeGrid::DIRECTION_COUNT << " cones each)." << std::endl;
+	tracer.setIrradianceProbes(&probeGrid);
+	VoxelConeTracer::Settings probeSettings = diffuseOnly;
+	probeSettings.irradianceProbes = true;
+	for (int resolution : { 128, 256, 512 }) {
+		std::vector<VoxelConeTracer::GBufferTexel> probeGBuffer;
+		createCornellBoxGBuffer(camera, 0.7f, resolution, resolution, materials, probeGBuffer);
+		VoxelConeTracer::Image traced;
+		const double tracedSeconds = measure([&] { tracer.render(probeGBuffer, resolution, resolution, camera, lights, diffuseOnly, traced, threadCounts.back()); }, 1);
+		seconds = measure([&] { tracer.render(probeGBuffer, resolution, resolution, camera, lights, probeSettings, image, threadCounts.back()); }, 2);
+		std::cout << std::fixed << std::setprecision(2)
+			<< resolution << "x" << resolution << " indirect diffuse, cones per pixel: " << tracedSeconds * 1000.0 << " ms, irradiance probes: "
+			<< seconds * 1000.0 << " ms, " << image.cones[ConeBudget::DIFFUSE] << " diffuse cones, PSNR " << psnr(image.color, traced.color) << " dB." << std::endl;
+	}
+	tracer.setIrradianceProbes(nullptr);
+
+	// Cached light visibility: shadow cones marched once per cell near a surface, then one fetch per pixel and light.
+	VoxelConeTracer::Settings directOnly;
+	directOnly.indirectDiffuseLight = directOnly.indirectSpecularLight = false;
+	VoxelConeTracer::Image shadowCones;
+	const double shadowConeSeconds = measure([&] { tracer.render(gBuffer, width, height, camera, lights, directOnly, shadowCones, threadCounts.back()); }, 2);
+	std::cout << std::fixed << std::setprecision(2) << width << "x" << height << " direct + shadow cones: " << shadowConeSeconds * 1000.0 << " ms." << std::endl;
+	for (int resolution : { 32, 64 }) {
+		VoxelLightVisibility visibility(resolution);
+		const double invalidateSeconds = measure([&] { visibility.invalidate(volume); }, 1);
+		seconds = measure([&] { visibility.invalidate(volume); visibility.update(tracer, lights, threadCounts.back()); }, 1) - invalidateSeconds;
+		tracer.setLightVisibility(&visibility);
+		VoxelConeTracer::Settings cached = directOnly;
+		cached.cachedShadows = true;
+		const double cachedSeconds = measure([&] { tracer.render(gBuffer, width, height, camera, lights, cached, image, threadCounts.back()); }, 2);
+		std::cout << std::fixed << std::setprecision(2)
+			<< width << "x" << height << " direct + cached shadows (" << resolution << "^3 cells, " << visibility.getMarchedCellCount() << " marched): "
+			<< cachedSeconds * 1000.0 << " ms, " << seconds * 1000.0 << " ms per light update, " << invalidateSeconds * 1000.0
+			<< " ms to find the cells, " << image.cones[ConeBudget::SHADOW] << " shadow cones, PSNR " << psnr(image.color, shadowCones.color) << " dB." << std::endl;
+		tracer.setLightVisibility(nullptr);
+	}
+
+	// Hybrid reflections: glossy white surfaces (the walls and the box) with the dragon's specular diffusion, screen space first.
+	MaterialSetting glossyMaterials[4] = { materials[0], materials[1], materials[2], materials[3] };
+	glossyMaterials[0].specularReflectivity = 0.4f;
+	glossyMaterials[0].specularDiffusion = 2.0f;
+	std::vector<VoxelConeTracer::GBufferTexel> glossyGBuffer;
+	createCornellBoxGBuffer(camera, 0.7f, width, height, glossyMaterials, glossyGBuffer);
+	VoxelConeTracer::Settings specularCones;
+	VoxelConeTracer::Image coneReflections;
+	const double coneSeconds = measure([&] { tracer.render(glossyGBuffer, width, height, camera, lights, specularCones, coneReflections, threadCounts.back()); }, 2);
+	std::cout << std::fixed << std::setprecision(2) << width << "x" << height << " all, glossy walls, specular cones: " << coneSeconds * 1000.0
+		<< " ms, " << coneReflections.cones[ConeBudget::SPECULAR] << " specular cones." << std::endl;
+	for (float cutoff : { 0.5f, 2.0f }) {
+		VoxelConeTracer::Settings hybrid = specularCones;
+		hybrid.screenSpaceReflections = true;
+		hybrid.reflectionDiffusionCutoff = cutoff;
+		seconds = measure([&] { tracer.render(glossyGBuffer, width, height, camera, lights, hybrid, image, threadCounts.back()); }, 2);
+		size_t changed = 0;
+		const double quality = changedPsnr(image.color, coneReflections.color, changed);
+		std::cout << std::fixed << std::setprecision(2)
+			<< width << "x" << height << " all, glossy walls, screen space reflections up to diffusion " << cutoff << ": " << seconds * 1000.0 << " ms, "
+			<< image.reflectionHits << " of " << image.reflectionRays << " rays hit (" << 100.0 * image.reflectionHits / std::max(image.reflectionRays, 1ull)
+			<< "%), " << image.cones[ConeBudget::SPECULAR] << " specular cones, PSNR " << quality << " dB over the " << changed
+			<< " pixels that differ from the specular cones (unclamped)." << std::endl;
+	}
+
+	// The filter on its own.
+	std::vector<AtrousFilter::GuideTexel> guide(gBuffer.size());
+	for (size_t i = 0; i < gBuffer.size(); ++i) if (gBuffer[i].material != nullptr) {
+		guide[i].normal = glm::normalize(gBuffer[i].normal);
+		guide[i].depth = glm::length(gBuffer[i].position - camera.position);
+	}
+	std::vector<glm::vec4> noisy(gBuffer.size(), glm::vec4(0.5f)), filtered;
+	for (int iterations : { 1, 3, 5 }) {
+		seconds = measure([&] { filtered = noisy; AtrousFilter::apply(filtered, guide, width, height, iterations, threadCounts.back()); });
+		std::cout << std::fixed << std::setprecision(2)
+			<< width << "x" << height << " a-trous filter, " << iterations << " iteration(s): " << seconds * 1000.0 << " ms." << std::endl;
+	}
+}
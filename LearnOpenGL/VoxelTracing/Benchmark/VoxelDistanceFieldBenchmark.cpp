@@ -0,0 +1,66 @@
+#include "Benchmark.h"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+
+#include <glm.hpp>
+
+#include "../Graphic/Voxel/VoxelMipChain.h"
+#include "../Graphic/Voxel/VoxelDistanceField.h"
+#include "../Utility/Parallel.h"
+
+namespace {
+	struct MarchResult {
+		long long steps = 0;
+		int hits = 0;
+	};
+
+	/// <summary> Marches a ray (in voxels) until it enters an occupied voxel or leaves the volume.
+	/// Without a field it takes fixed steps of one voxel, with a field it jumps by the free radius when there is one. </summary>
+	bool march(const VoxelMipChain & volume, const VoxelDistanceField * field, glm::vec3 position, const glm::vec3 & direction, long long & steps) {
+		const int size = volume.getSize();
+		for (;;) {
+			const glm::ivec3 voxel = glm::ivec3(glm::floor(position));
+			if (voxel.x < 0 || voxel.y < 0 || voxel.z < 0 || voxel.x >= size || voxel.y >= size || voxel.z >= size) return false;
+			++steps;
+			if (volume.getVoxel(0, voxel.x, voxel.y, voxel.z)[3] > 0) return true;
+			const int radius = field ? field->getDistance(voxel.x, voxel.y, voxel.z) : 0;
+			position += direction * float(std::max(1, radius));
+		}
+	}
+}
+
+void Benchmark::distanceField()
+{
+	std::vector<unsigned int> threadCounts = { 1 };
+	if (Parallel::hardwareThreadCount() > 1) threadCounts.push_back(Parallel::hardwareThreadCount());
+
+	std::cout << "--- Voxel distance field ---" << std::endl;
+	for (int size : { 64, 128, 256 }) {
+		VoxelMipChain volume(size, VoxelMipChain::Format::RGBA8);
+		fillCornellBox(volume);
+		VoxelDistanceField field(size);
+		for (unsigned int threads : threadCounts) {
+			double seconds = measure([&] { field.build(volume, 0.0f, threads); }, size >= 256 ? 2 : 5);
+			std::cout << std::fixed << std::setprecision(2)
+				<< size << "^3 build, " << threads << " thread(s): " << seconds * 1000.0 << " ms." << std::endl;
+		}
+
+		// The same rays with and without the field.
+		const int rayCount = 20000;
+		std::vector<glm::vec3> origins, directions;
+		createEmptySpaceRays(volume, rayCount, origins, directions);
+
+		MarchResult fixed, skipping;
+		for (int i = 0; i < rayCount; ++i) {
+			fixed.hits += march(volume, nullptr, origins[i], directions[i], fixed.steps);
+			skipping.hits += march(volume, &field, origins[i], directions[i], skipping.steps);
+		}
+		std::cout << std::fixed << std::setprecision(2)
+			<< size << "^3 steps per ray: " << double(fixed.steps) / rayCount << " fixed, "
+			<< double(skipping.steps) / rayCount << " with distance field ("
+			<< double(fixed.steps) / double(skipping.steps) << "x fewer), hits " << fixed.hits << " / " << skipping.hits << "." << std::endl;
+	}
+}
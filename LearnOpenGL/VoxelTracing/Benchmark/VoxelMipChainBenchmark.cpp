@@ -0,0 +1,71 @@
+#include "Benchmark.h"
+
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <vector>
+
+#include "../Graphic/Voxel/VoxelMipChain.h"
+#include "../Graphic/Voxel/VoxelBrickTracker.h"
+#include "../Utility/Parallel.h"
+
+namespace {
+	/// <summary> Fills level 0 with a sparse volume, roughly like a voxelized scene (mostly empty). </summary>
+	void fillSparse(VoxelMipChain & volume) {
+		std::mt19937 random(0);
+		unsigned char * voxels = volume.getLevelData(0);
+		const size_t bytes = volume.getLevelByteSize(0), bpv = volume.getBytesPerVoxel();
+		for (size_t i = 0; i < bytes; i += bpv) {
+			if (random() % 8 != 0) continue;
+			for (size_t c = 0; c < bpv; ++c) voxels[i + c] = (unsigned char)(random());
+			if (volume.getFormat() == VoxelMipChain::Format::RGBA16F) { // Keep halves finite and in [0, 2).
+				for (size_t c = 1; c < bpv; c += 2) voxels[i + c] &= 0x3f;
+			}
+		}
+	}
+}
+
+void Benchmark::voxelMipChain()
+{
+	using F = VoxelMipChain::Filter;
+	const char * formatNames[] = { "RGBA8", "RGBA16F" };
+	const char * filterNames[] = { "box", "alpha weighted", "premultiplied" };
+	std::vector<unsigned int> threadCounts = { 1 };
+	if (Parallel::hardwareThreadCount() > 1) threadCounts.push_back(Parallel::hardwareThreadCount());
+
+	std::cout << "--- Voxel mip chain ---" << std::endl;
+	for (int size : { 64, 128, 256 }) {
+		for (int format = 0; format < 2; ++format) {
+			VoxelMipChain volume(size, VoxelMipChain::Format(format));
+			fillSparse(volume);
+			for (int filter = 0; filter < 3; ++filter) {
+				for (unsigned int threads : threadCounts) {
+					double seconds = measure([&] { volume.generateMipmaps(F(filter), threads); }, size >= 256 ? 2 : 5);
+					double voxels = double(size) * size * size;
+					std::cout << std::fixed << std::setprecision(2)
+						<< size << "^3 " << formatNames[format] << ", " << filterNames[filter] << ", " << threads << " thread(s): "
+						<< seconds * 1000.0 << " ms, " << voxels / seconds / 1e6 << " Mvoxels/s, "
+						<< volume.getLevelByteSize(0) / seconds / 1e9 << " GB/s read." << std::endl;
+				}
+			}
+		}
+	}
+
+	// Incremental regeneration after a local edit (see 'VoxelBrickTracker.h').
+	std::cout << "--- Voxel mip chain, local edits ---" << std::endl;
+	for (int size : { 64, 128, 256 }) {
+		VoxelMipChain volume(size, VoxelMipChain::Format::RGBA8);
+		VoxelBrickTracker bricks(size, volume.getLevelCount());
+		fillSparse(volume);
+		double full = measure([&] { volume.generateMipmaps(F::BOX, 1); }, 3);
+		for (int edit : { 4, 16, 32 }) {
+			double incremental = measure([&] {
+				bricks.markDirty(glm::ivec3(size / 2), glm::ivec3(size / 2 + edit - 1));
+				volume.generateMipmaps(bricks, F::BOX, 1);
+			}, 20);
+			std::cout << std::fixed << std::setprecision(3)
+				<< size << "^3, " << edit << "^3 edit: " << incremental * 1000.0 << " ms (full rebuild " << full * 1000.0 << " ms, "
+				<< std::setprecision(1) << full / incremental << "x faster)." << std::endl;
+		}
+	}
+}
@@ -0,0 +1,60 @@
+#include "Benchmark.h"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+#include <glm.hpp>
+
+#include "../Graphic/Voxel/VoxelMipChain.h"
+#include "../Graphic/Voxel/VoxelOccupancy.h"
+#include "../Utility/Parallel.h"
+
+void Benchmark::voxelOccupancy()
+{
+	std::vector<unsigned int> threadCounts = { 1 };
+	if (Parallel::hardwareThreadCount() > 1) threadCounts.push_back(Parallel::hardwareThreadCount());
+
+	std::cout << "--- Voxel occupancy bitmask ---" << std::endl;
+	for (int size : { 64, 128, 256 }) {
+		VoxelMipChain volume(size, VoxelMipChain::Format::RGBA8);
+		fillCornellBox(volume);
+		std::vector<unsigned char> occupancy;
+		volume.getOccupancy(occupancy);
+
+		VoxelOccupancy bitmask(size);
+		for (unsigned int threads : threadCounts) {
+			double seconds = measure([&] { bitmask.build(occupancy, threads); }, size >= 256 ? 2 : 5);
+			std::cout << std::fixed << std::setprecision(2)
+				<< size << "^3 build, " << threads << " thread(s): " << seconds * 1000.0 << " ms." << std::endl;
+		}
+
+		size_t occupied = 0;
+		double countSeconds = measure([&] { occupied = bitmask.countOccupied(); });
+		const double voxels = double(size) * size * size;
+		std::cout << std::fixed << std::setprecision(2)
+			<< size << "^3 size: " << bitmask.getByteSize() / 1024.0 << " KB (" << bitmask.getLevelCount() << " levels), vs "
+			<< voxels / 1024.0 << " KB R8 distance field and " << volume.getLevelByteSize(0) / 1024.0 << " KB RGBA8. "
+			<< occupied << " occupied voxels counted in " << countSeconds * 1000.0 << " ms." << std::endl;
+
+		// Rays from empty voxels, every sample skips the largest empty cell around it.
+		const int rayCount = 20000;
+		std::vector<glm::vec3> origins, directions;
+		createEmptySpaceRays(volume, rayCount, origins, directions);
+		long long steps = 0;
+		int hits = 0;
+		double traceSeconds = measure([&] {
+			steps = 0;
+			hits = 0;
+			for (int i = 0; i < rayCount; ++i) {
+				glm::ivec3 hit;
+				int raySteps;
+				hits += bitmask.raycast(origins[i], directions[i], hit, &raySteps);
+				steps += raySteps;
+			}
+		}, 3);
+		std::cout << std::fixed << std::setprecision(2)
+			<< size << "^3 traversal: " << double(steps) / rayCount << " steps per ray, " << hits << " hits, "
+			<< rayCount / traceSeconds / 1e6 << " Mrays/s." << std::endl;
+	}
+}
@@ -0,0 +1,141 @@
+#include "RingBuffer.h"
+
+#include <cassert>
+#include <algorithm>
+
+#include "../Device/GLDevice.h"
+
+namespace {
+	size_t roundUp(const size_t value, const size_t multiple) { return (value + multiple - 1) / multiple * multiple; }
+
+	// Region starts must satisfy every offset alignment (GL requires at most 256 bytes).
+	const size_t REGION_ALIGNMENT = 256;
+}
+
+// ----------------------
+// Ring buffer.
+// ----------------------
+RingBuffer::RingBuffer(const size_t _regionSize, Backend * _backend) : backend(_backend ? _backend : new GLBackend())
+{
+	regionSize = roundUp(std::max<size_t>(_regionSize, 1), REGION_ALIGNMENT);
+	mapping = backend->create(REGIONS * regionSize);
+}
+
+RingBuffer::~RingBuffer()
+{
+	delete backend;
+}
+
+void RingBuffer::beginFrame()
+{
+	// The GPU may still read what was written REGIONS frames ago.
+	if (fenced[region] && backend->wait(region)) ++stalls;
+	fenced[region] = false;
+	used = 0;
+
+	if (framesUntilDeleteRetired > 0 && --framesUntilDeleteRetired == 0) backend->deleteRetired();
+}
+
+RingBuffer::Allocation RingBuffer::allocate(const size_t size, const size_t alignment)
+{
+	assert(alignment > 0 && alignment <= REGION_ALIGNMENT);
+	size_t offset = roundUp(used, alignment);
+	if (offset + size > regionSize) {
+		grow(offset + size);
+		offset = 0;
+	}
+	used = offset + size;
+
+	Allocation allocation;
+	allocation.offset = region * regionSize + offset;
+	allocation.data = mapping + allocation.offset;
+	allocation.buffer = backend->buffer();
+	allocation.size = size;
+	return allocation;
+}
+
+void RingBuffer::endFrame()
+{
+	backend->fence(region);
+	fenced[region] = true;
+	region = (region + 1) % REGIONS;
+}
+
+void RingBuffer::grow(const size_t minimumRegionSize)
+{
+	// The commands of this frame and of the last REGIONS - 1 frames may still read the old buffer, so it is retired.
+	// None of the regions of the new buffer is in use, so its fences are not needed, but waiting on them costs nothing.
+	regionSize = roundUp(std::max(2 * regionSize, minimumRegionSize), REGION_ALIGNMENT);
+	mapping = backend->create(REGIONS * regionSize);
+	framesUntilDeleteRetired = REGIONS;
+	++growths;
+}
+
+// ----------------------
+// GL backend.
+// ----------------------
+unsigned char * GLBackend::create(const size_t size)
+{
+	if (current) retired.push_back(current);
+
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	gl::genBuffers(1, &current);
+	gl::bindBuffer(GL_COPY_WRITE_BUFFER, current);
+	gl::bufferStorage(GL_COPY_WRITE_BUFFER, size, nullptr, flags);
+	unsigned char * mapping = static_cast<unsigned char *>(gl::mapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags));
+	gl::bindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	assert(mapping != nullptr);
+	return mapping;
+}
+
+void GLBackend::deleteRetired()
+{
+	// Deleting a buffer also unmaps it.
+	if (!retired.empty()) gl::deleteBuffers(GLsizei(retired.size()), retired.data());
+	retired.clear();
+}
+
+void GLBackend::fence(const unsigned int region)
+{
+	if (fences[region]) gl::deleteSync(fences[region]);
+	fences[region] = gl::fenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+bool GLBackend::wait(const unsigned int region)
+{
+	if (!fences[region]) return false;
+
+	// Poll first, only flush and block if the GPU is behind.
+	GLenum result = gl::clientWaitSync(fences[region], 0, 0);
+	const bool blocked = result == GL_TIMEOUT_EXPIRED;
+	while (result == GL_TIMEOUT_EXPIRED) result = gl::clientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1 ms.
+	gl::deleteSync(fences[region]);
+	fences[region] = nullptr;
+	return blocked;
+}
+
+GLBackend::~GLBackend()
+{
+	for (GLsync fence : fences) if (fence) gl::deleteSync(fence);
+	deleteRetired();
+	if (current) gl::deleteBuffers(1, &current);
+}
+
+// ----------------------
+// Mock backend.
+// ----------------------
+unsigned char * MockBackend::create(const size_t size)
+{
+	if (!buffers.empty()) retired.push_back(buffer());
+	buffers.emplace_back(size);
+	return buffers.back().data();
+}
+
+bool MockBackend::wait(const unsigned int region)
+{
+	++waits;
+	if (!inFlight[region]) return false;
+	++stalls;
+	inFlight[region] = false;
+	return true;
+}
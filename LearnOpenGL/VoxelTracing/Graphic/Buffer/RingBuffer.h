@@ -0,0 +1,110 @@
+#pragma once
+
+#include <vector>
+#include <cstring>
+
+#define GLEW_STATIC
+#include <glew.h>
+
+/// <summary> A streaming allocator for data the CPU writes once per use: per frame blocks, per draw blocks and dynamic vertices.
+/// One persistently and coherently mapped buffer is split into REGIONS frame regions. A frame allocates linearly from its region
+/// and fences it at the end, the region is written again REGIONS frames later, after waiting for that fence.
+/// There is no orphaning (glBufferData) and no implicit synchronization (glBufferSubData) on the way.
+/// A frame that needs more than a region moves to a buffer with twice as large regions; the old buffer lives until the GPU is done with it. </summary>
+class RingBuffer {
+public:
+	static const unsigned int REGIONS = 3;
+
+	/// <summary> Where the memory and the fences come from: GLBackend maps a GL buffer, MockBackend emulates one on the CPU. </summary>
+	class Backend {
+	public:
+		virtual ~Backend() {}
+		/// <summary> Creates a buffer of size bytes and returns its persistent mapping. The previous buffer is retired, not deleted. </summary>
+		virtual unsigned char * create(const size_t size) = 0;
+		/// <summary> Deletes the retired buffers. Only called once every command that read them completed. </summary>
+		virtual void deleteRetired() = 0;
+		virtual GLuint buffer() const = 0;
+		/// <summary> Fences the commands submitted so far, the ones that read a region. </summary>
+		virtual void fence(const unsigned int region) = 0;
+		/// <summary> Waits until the commands fenced for a region completed. Returns true if it had to block. </summary>
+		virtual bool wait(const unsigned int region) = 0;
+	};
+
+	struct Allocation {
+		unsigned char * data = nullptr;
+		GLuint buffer = 0;
+		size_t offset = 0; // In bytes, from the start of the buffer.
+		size_t size = 0;
+	};
+
+	/// <summary> Takes ownership of the backend (a GLBackend if none). </summary>
+	RingBuffer(const size_t regionSize, Backend * backend = nullptr);
+	~RingBuffer();
+
+	/// <summary> Starts writing the next region, waits for the GPU if it still reads it. </summary>
+	void beginFrame();
+	/// <summary> Reserves size bytes of the current region at an offset that is a multiple of alignment. </summary>
+	Allocation allocate(const size_t size, const size_t alignment);
+	template<typename T> Allocation write(const T & value, const size_t alignment) { return write(&value, sizeof(T), alignment); }
+	Allocation write(const void * data, const size_t size, const size_t alignment) {
+		Allocation allocation = allocate(size, alignment);
+		std::memcpy(allocation.data, data, size);
+		return allocation;
+	}
+	/// <summary> Fences the region written since beginFrame. </summary>
+	void endFrame();
+
+	// ----------------
+	// Accessors.
+	// ----------------
+	size_t getRegionSize() const { return regionSize; }
+	unsigned int getRegion() const { return region; }
+	size_t getFrameBytes() const { return used; } // Written since beginFrame, including alignment.
+	unsigned int getStalls() const { return stalls; } // Frames that waited for the GPU.
+	unsigned int getGrowths() const { return growths; }
+private:
+	Backend * backend;
+	unsigned char * mapping = nullptr;
+	size_t regionSize = 0, used = 0;
+	unsigned int region = 0;
+	bool fenced[REGIONS] = {};
+	unsigned int framesUntilDeleteRetired = 0; // The retired buffers are done once every region was waited for after the growth.
+	unsigned int stalls = 0, growths = 0;
+	void grow(const size_t minimumRegionSize);
+};
+
+/// <summary> A GL buffer created with glBufferStorage and mapped with GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT, fenced with glFenceSync. </summary>
+class GLBackend : public RingBuffer::Backend {
+public:
+	unsigned char * create(const size_t size) override;
+	void deleteRetired() override;
+	GLuint buffer() const override { return current; }
+	void fence(const unsigned int region) override;
+	bool wait(const unsigned int region) override;
+	~GLBackend();
+private:
+	GLuint current = 0;
+	std::vector<GLuint> retired;
+	GLsync fences[RingBuffer::REGIONS] = {};
+};
+
+/// <summary> CPU memory and emulated fences, to check the wraparound and fencing of a RingBuffer without a GPU.
+/// A fenced region stays in flight until complete is called (the GPU got to it); waiting for it first counts as a stall and completes it. </summary>
+class MockBackend : public RingBuffer::Backend {
+public:
+	unsigned char * create(const size_t size) override;
+	void deleteRetired() override { retired.clear(); }
+	GLuint buffer() const override { return GLuint(buffers.size()); } // Numbered from 1, like GL names.
+	void fence(const unsigned int region) override { inFlight[region] = true; ++fences; }
+	bool wait(const unsigned int region) override;
+
+	void complete(const unsigned int region) { inFlight[region] = false; }
+	bool isInFlight(const unsigned int region) const { return inFlight[region]; }
+	size_t getSize() const { return buffers.empty() ? 0 : buffers.back().size(); }
+	size_t getRetiredCount() const { return retired.size(); }
+	unsigned int fences = 0, waits = 0, stalls = 0;
+private:
+	std::vector<std::vector<unsigned char>> buffers; // Never shrinks, so mappings stay valid.
+	std::vector<GLuint> retired;
+	bool inFlight[RingBuffer::REGIONS] = {};
+};
@@ -7,6 +7,8 @@ class Camera {
 public:
 	glm::vec3 up = { 0,1,0 }, rotation = { 0,0,-1 }, position = { 0,0,0 };
 	glm::mat4 viewMatrix;
+	glm::mat4 previousViewProjectionMatrix = glm::mat4(1); // The view-projection matrix of the last rendered frame (set by Graphics).
+	glm::mat4 getViewProjectionMatrix() const { return projectionMatrix * viewMatrix; }
 	const glm::mat4 & getProjectionMatrix() const;
 	void setProjectionMatrix(glm::mat4 projectionMatrix);
 	virtual void updateViewMatrix();
@@ -0,0 +1,65 @@
+#include "AtrousFilter.h"
+
+// Stdlib.
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+
+// Internal.
+#include "../../Utility/Parallel.h"
+
+namespace {
+	// ----------------
+	// Shader constants (see 'indirect_denoise.frag').
+	// ----------------
+	const float KERNEL[3] = { 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f }; // B3 spline, by distance to the center tap.
+	const float DEPTH_SIGMA = 0.02f; // Relative depth difference where a tap's weight drops to 1/e.
+	const float NORMAL_POWER = 64.0f;
+	const float LUMINANCE_SIGMA = 4.0f; // Relative to the center's luminance.
+
+	inline float luminance(const glm::vec4 & c) { return 0.2126f * c.x + 0.7152f * c.y + 0.0722f * c.z; }
+}
+
+void AtrousFilter::apply(std::vector<glm::vec4> & image, const std::vector<GuideTexel> & guide,
+	const int width, const int height, const int iterations, const unsigned int threadCount)
+{
+	assert(image.size() == size_t(width) * height && guide.size() == image.size());
+	std::vector<glm::vec4> scratch(image.size());
+	for (int i = 0; i < iterations; ++i) {
+		iterate(image, scratch, guide, width, height, 1 << i, threadCount);
+		image.swap(scratch);
+	}
+}
+
+void AtrousFilter::iterate(const std::vector<glm::vec4> & source, std::vector<glm::vec4> & destination,
+	const std::vector<GuideTexel> & guide, const int width, const int height, const int stepSize, const unsigned int threadCount)
+{
+	Parallel::forEachTask(height, [&](int y) {
+		for (int x = 0; x < width; ++x) {
+			const size_t i = size_t(y) * width + x;
+			const GuideTexel & center = guide[i];
+			const glm::vec4 & centerColor = source[i];
+			if (center.depth <= 0.0f) { destination[i] = centerColor; continue; }
+			const float centerLuminance = luminance(centerColor);
+
+			glm::vec4 sum(0.0f);
+			float weightSum = 0.0f;
+			for (int dy = -2; dy <= 2; ++dy) for (int dx = -2; dx <= 2; ++dx) {
+				const int tx = x + dx * stepSize, ty = y + dy * stepSize;
+				if (tx < 0 || ty < 0 || tx >= width || ty >= height) continue;
+				const size_t tap = size_t(ty) * width + tx;
+				const GuideTexel & g = guide[tap];
+				if (g.depth <= 0.0f) continue;
+				const glm::vec4 & color = source[tap];
+
+				const float depthWeight = std::exp(-std::abs(center.depth - g.depth) / (DEPTH_SIGMA * center.depth));
+				const float normalWeight = std::pow(std::max(glm::dot(center.normal, g.normal), 0.0f), NORMAL_POWER);
+				const float luminanceWeight = std::exp(-std::abs(centerLuminance - luminance(color)) / (LUMINANCE_SIGMA * centerLuminance + 1e-4f));
+				const float w = KERNEL[std::abs(dx)] * KERNEL[std::abs(dy)] * depthWeight * normalWeight * luminanceWeight;
+				sum += w * color;
+				weightSum += w;
+			}
+			destination[i] = sum / weightSum; // The center tap always has a positive weight.
+		}
+	}, threadCount);
+}
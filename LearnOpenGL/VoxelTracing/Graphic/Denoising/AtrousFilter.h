@@ -0,0 +1,25 @@
+#pragma once
+
+#include <vector>
+
+#include <glm.hpp>
+
+/// <summary> A CPU reference of 'indirect_denoise.frag': an edge-avoiding a-trous wavelet filter.
+/// Every iteration convolves with a 5x5 B3 spline kernel whose taps are 2^iteration pixels apart,
+/// weighted down across depth, normal and luminance edges. Keep the constants in 'AtrousFilter.cpp' in sync with the shader. </summary>
+class AtrousFilter {
+public:
+	/// <summary> The edge-stopping guide of one pixel: normal and linear depth (0 = background, left unfiltered). </summary>
+	struct GuideTexel {
+		glm::vec3 normal;
+		float depth = 0.0f;
+	};
+
+	/// <summary> Filters a width x height image (row by row) in place with a number of iterations.
+	/// Alpha is filtered along. A thread count of 0 uses all hardware threads. </summary>
+	static void apply(std::vector<glm::vec4> & image, const std::vector<GuideTexel> & guide,
+		const int width, const int height, const int iterations, const unsigned int threadCount = 0);
+private:
+	static void iterate(const std::vector<glm::vec4> & source, std::vector<glm::vec4> & destination,
+		const std::vector<GuideTexel> & guide, const int width, const int height, const int stepSize, const unsigned int threadCount);
+};
@@ -0,0 +1,23 @@
+#include "GLDevice.h"
+
+#include <cassert>
+
+// Never deleted, objects destroyed at exit still make GL calls.
+GLDevice * GLDevice::currentDevice = new OpenGLDevice();
+
+const char * GLDevice::getFunctionName(const Function function)
+{
+	static const char * names[] = {
+#define GL_DEVICE_NAME(R, name, glName, parameters, arguments) #glName,
+		GL_DEVICE_FUNCTIONS(GL_DEVICE_NAME)
+#undef GL_DEVICE_NAME
+	};
+	assert(int(function) >= 0 && int(function) < FUNCTION_COUNT);
+	return names[int(function)];
+}
+
+void GLDevice::setCurrent(GLDevice * device)
+{
+	assert(device != nullptr);
+	currentDevice = device;
+}
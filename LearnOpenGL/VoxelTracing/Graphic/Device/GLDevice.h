@@ -0,0 +1,150 @@
+#pragma once
+
+#define GLEW_STATIC
+#include <glew.h>
+
+// Every GL function the renderer calls: X(return type, device function, GL function, (parameters), (arguments)).
+// Add a function here to make it available as gl::function on every device.
+#define GL_DEVICE_FUNCTIONS(X) \
+	/* State. */ \
+	X(void, enable, glEnable, (GLenum capability), (capability)) \
+	X(void, disable, glDisable, (GLenum capability), (capability)) \
+	X(void, blendFunc, glBlendFunc, (GLenum source, GLenum destination), (source, destination)) \
+	X(void, cullFace, glCullFace, (GLenum mode), (mode)) \
+	X(void, viewport, glViewport, (GLint x, GLint y, GLsizei width, GLsizei height), (x, y, width, height)) \
+	X(void, colorMask, glColorMask, (GLboolean r, GLboolean g, GLboolean b, GLboolean a), (r, g, b, a)) \
+	X(void, depthMask, glDepthMask, (GLboolean flag), (flag)) \
+	X(void, clearColor, glClearColor, (GLfloat r, GLfloat g, GLfloat b, GLfloat a), (r, g, b, a)) \
+	X(void, hint, glHint, (GLenum target, GLenum mode), (target, mode)) \
+	X(void, pixelStorei, glPixelStorei, (GLenum name, GLint value), (name, value)) \
+	X(void, getIntegerv, glGetIntegerv, (GLenum name, GLint * data), (name, data)) \
+	X(const GLubyte *, getString, glGetString, (GLenum name), (name)) \
+	/* Drawing and compute. */ \
+	X(void, clear, glClear, (GLbitfield mask), (mask)) \
+	X(void, drawElements, glDrawElements, (GLenum mode, GLsizei count, GLenum type, const void * indices), (mode, count, type, indices)) \
+	X(void, dispatchCompute, glDispatchCompute, (GLuint x, GLuint y, GLuint z), (x, y, z)) \
+	X(void, memoryBarrier, glMemoryBarrier, (GLbitfield barriers), (barriers)) \
+	/* Synchronization. */ \
+	X(GLsync, fenceSync, glFenceSync, (GLenum condition, GLbitfield flags), (condition, flags)) \
+	X(GLenum, clientWaitSync, glClientWaitSync, (GLsync sync, GLbitfield flags, GLuint64 timeout), (sync, flags, timeout)) \
+	X(void, deleteSync, glDeleteSync, (GLsync sync), (sync)) \
+	/* Programs and shaders. */ \
+	X(GLuint, createProgram, glCreateProgram, (), ()) \
+	X(void, deleteProgram, glDeleteProgram, (GLuint program), (program)) \
+	X(void, attachShader, glAttachShader, (GLuint program, GLuint shader), (program, shader)) \
+	X(void, linkProgram, glLinkProgram, (GLuint program), (program)) \
+	X(void, useProgram, glUseProgram, (GLuint program), (program)) \
+	X(void, getProgramiv, glGetProgramiv, (GLuint program, GLenum name, GLint * values), (program, name, values)) \
+	X(void, getProgramInfoLog, glGetProgramInfoLog, (GLuint program, GLsizei size, GLsizei * length, GLchar * log), (program, size, length, log)) \
+	X(void, getProgramInterfaceiv, glGetProgramInterfaceiv, (GLuint program, GLenum programInterface, GLenum name, GLint * values), (program, programInterface, name, values)) \
+	X(void, getProgramResourceiv, glGetProgramResourceiv, (GLuint program, GLenum programInterface, GLuint index, GLsizei propertyCount, const GLenum * properties, GLsizei size, GLsizei * length, GLint * values), (program, programInterface, index, propertyCount, properties, size, length, values)) \
+	X(void, programParameteri, glProgramParameteri, (GLuint program, GLenum name, GLint value), (program, name, value)) \
+	X(void, getProgramBinary, glGetProgramBinary, (GLuint program, GLsizei size, GLsizei * length, GLenum * binaryFormat, void * binary), (program, size, length, binaryFormat, binary)) \
+	X(void, programBinary, glProgramBinary, (GLuint program, GLenum binaryFormat, const void * binary, GLsizei length), (program, binaryFormat, binary, length)) \
+	X(void, getProgramResourceName, glGetProgramResourceName, (GLuint program, GLenum programInterface, GLuint index, GLsizei size, GLsizei * length, GLchar * name), (program, programInterface, index, size, length, name)) \
+	X(GLint, getUniformLocation, glGetUniformLocation, (GLuint program, const GLchar * name), (program, name)) \
+	X(void, maxShaderCompilerThreadsKHR, glMaxShaderCompilerThreadsKHR, (GLuint count), (count)) \
+	X(GLuint, createShader, glCreateShader, (GLenum type), (type)) \
+	X(void, deleteShader, glDeleteShader, (GLuint shader), (shader)) \
+	X(void, shaderSource, glShaderSource, (GLuint shader, GLsizei count, const GLchar * const * source, const GLint * length), (shader, count, source, length)) \
+	X(void, compileShader, glCompileShader, (GLuint shader), (shader)) \
+	X(void, getShaderiv, glGetShaderiv, (GLuint shader, GLenum name, GLint * values), (shader, name, values)) \
+	X(void, getShaderInfoLog, glGetShaderInfoLog, (GLuint shader, GLsizei size, GLsizei * length, GLchar * log), (shader, size, length, log)) \
+	/* Uniforms. */ \
+	X(void, uniform1i, glUniform1i, (GLint location, GLint value), (location, value)) \
+	X(void, programUniform1i, glProgramUniform1i, (GLuint program, GLint location, GLint value), (program, location, value)) \
+	X(void, programUniform1f, glProgramUniform1f, (GLuint program, GLint location, GLfloat value), (program, location, value)) \
+	X(void, programUniform2fv, glProgramUniform2fv, (GLuint program, GLint location, GLsizei count, const GLfloat * values), (program, location, count, values)) \
+	X(void, programUniform3fv, glProgramUniform3fv, (GLuint program, GLint location, GLsizei count, const GLfloat * values), (program, location, count, values)) \
+	X(void, programUniform4fv, glProgramUniform4fv, (GLuint program, GLint location, GLsizei count, const GLfloat * values), (program, location, count, values)) \
+	X(void, programUniformMatrix4fv, glProgramUniformMatrix4fv, (GLuint program, GLint location, GLsizei count, GLboolean transpose, const GLfloat * values), (program, location, count, transpose, values)) \
+	/* Buffers. */ \
+	X(void, genBuffers, glGenBuffers, (GLsizei count, GLuint * buffers), (count, buffers)) \
+	X(void, deleteBuffers, glDeleteBuffers, (GLsizei count, const GLuint * buffers), (count, buffers)) \
+	X(void, bindBuffer, glBindBuffer, (GLenum target, GLuint buffer), (target, buffer)) \
+	X(void, bindBufferBase, glBindBufferBase, (GLenum target, GLuint index, GLuint buffer), (target, index, buffer)) \
+	X(void, bindBufferRange, glBindBufferRange, (GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size), (target, index, buffer, offset, size)) \
+	X(void, bufferData, glBufferData, (GLenum target, GLsizeiptr size, const void * data, GLenum usage), (target, size, data, usage)) \
+	X(void, bufferStorage, glBufferStorage, (GLenum target, GLsizeiptr size, const void * data, GLbitfield flags), (target, size, data, flags)) \
+	X(void, bufferSubData, glBufferSubData, (GLenum target, GLintptr offset, GLsizeiptr size, const void * data), (target, offset, size, data)) \
+	X(void, copyBufferSubData, glCopyBufferSubData, (GLenum readTarget, GLenum writeTarget, GLintptr readOffset, GLintptr writeOffset, GLsizeiptr size), (readTarget, writeTarget, readOffset, writeOffset, size)) \
+	X(void, getBufferSubData, glGetBufferSubData, (GLenum target, GLintptr offset, GLsizeiptr size, void * data), (target, offset, size, data)) \
+	X(void, clearBufferData, glClearBufferData, (GLenum target, GLenum internalFormat, GLenum format, GLenum type, const void * data), (target, internalFormat, format, type, data)) \
+	X(void *, mapBufferRange, glMapBufferRange, (GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access), (target, offset, length, access)) \
+	/* Vertex arrays. */ \
+	X(void, genVertexArrays, glGenVertexArrays, (GLsizei count, GLuint * arrays), (count, arrays)) \
+	X(void, deleteVertexArrays, glDeleteVertexArrays, (GLsizei count, const GLuint * arrays), (count, arrays)) \
+	X(void, bindVertexArray, glBindVertexArray, (GLuint array), (array)) \
+	X(void, enableVertexAttribArray, glEnableVertexAttribArray, (GLuint index), (index)) \
+	X(void, vertexAttribFormat, glVertexAttribFormat, (GLuint index, GLint size, GLenum type, GLboolean normalized, GLuint offset), (index, size, type, normalized, offset)) \
+	X(void, vertexAttribBinding, glVertexAttribBinding, (GLuint index, GLuint binding), (index, binding)) \
+	X(void, bindVertexBuffer, glBindVertexBuffer, (GLuint binding, GLuint buffer, GLintptr offset, GLsizei stride), (binding, buffer, offset, stride)) \
+	/* Textures. */ \
+	X(void, genTextures, glGenTextures, (GLsizei count, GLuint * textures), (count, textures)) \
+	X(void, deleteTextures, glDeleteTextures, (GLsizei count, const GLuint * textures), (count, textures)) \
+	X(void, activeTexture, glActiveTexture, (GLenum unit), (unit)) \
+	X(void, bindTexture, glBindTexture, (GLenum target, GLuint texture), (target, texture)) \
+	X(void, bindImageTexture, glBindImageTexture, (GLuint unit, GLuint texture, GLint level, GLboolean layered, GLint layer, GLenum access, GLenum format), (unit, texture, level, layered, layer, access, format)) \
+	X(void, texParameteri, glTexParameteri, (GLenum target, GLenum name, GLint value), (target, name, value)) \
+	X(void, texImage2D, glTexImage2D, (GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void * pixels), (target, level, internalFormat, width, height, border, format, type, pixels)) \
+	X(void, texStorage2D, glTexStorage2D, (GLenum target, GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height), (target, levels, internalFormat, width, height)) \
+	X(void, texStorage3D, glTexStorage3D, (GLenum target, GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height, GLsizei depth), (target, levels, internalFormat, width, height, depth)) \
+	X(void, texSubImage3D, glTexSubImage3D, (GLenum target, GLint level, GLint x, GLint y, GLint z, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void * pixels), (target, level, x, y, z, width, height, depth, format, type, pixels)) \
+	X(void, clearTexImage, glClearTexImage, (GLuint texture, GLint level, GLenum format, GLenum type, const void * data), (texture, level, format, type, data)) \
+	X(void, clearTexSubImage, glClearTexSubImage, (GLuint texture, GLint level, GLint x, GLint y, GLint z, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void * data), (texture, level, x, y, z, width, height, depth, format, type, data)) \
+	X(void, generateMipmap, glGenerateMipmap, (GLenum target), (target)) \
+	X(void, generateTextureMipmap, glGenerateTextureMipmap, (GLuint texture), (texture)) \
+	/* Framebuffers. */ \
+	X(void, genFramebuffers, glGenFramebuffers, (GLsizei count, GLuint * framebuffers), (count, framebuffers)) \
+	X(void, deleteFramebuffers, glDeleteFramebuffers, (GLsizei count, const GLuint * framebuffers), (count, framebuffers)) \
+	X(void, bindFramebuffer, glBindFramebuffer, (GLenum target, GLuint framebuffer), (target, framebuffer)) \
+	X(void, framebufferTexture2D, glFramebufferTexture2D, (GLenum target, GLenum attachment, GLenum textureTarget, GLuint texture, GLint level), (target, attachment, textureTarget, texture, level)) \
+	X(void, framebufferRenderbuffer, glFramebufferRenderbuffer, (GLenum target, GLenum attachment, GLenum renderbufferTarget, GLuint renderbuffer), (target, attachment, renderbufferTarget, renderbuffer)) \
+	X(GLenum, checkFramebufferStatus, glCheckFramebufferStatus, (GLenum target), (target)) \
+	X(void, genRenderbuffers, glGenRenderbuffers, (GLsizei count, GLuint * renderbuffers), (count, renderbuffers)) \
+	X(void, bindRenderbuffer, glBindRenderbuffer, (GLenum target, GLuint renderbuffer), (target, renderbuffer)) \
+	X(void, renderbufferStorage, glRenderbufferStorage, (GLenum target, GLenum internalFormat, GLsizei width, GLsizei height), (target, internalFormat, width, height))
+
+/// <summary> The device the renderer sends its GL calls to (through the gl:: functions below).
+/// OpenGLDevice is the driver, NullDevice validates and counts the calls without a GPU,
+/// RecordingDevice writes the command stream out before passing it on to another device. </summary>
+class GLDevice {
+public:
+	/// <summary> One per function of GL_DEVICE_FUNCTIONS, to count calls by. </summary>
+	enum class Function {
+#define GL_DEVICE_ENUM(R, name, glName, parameters, arguments) name,
+		GL_DEVICE_FUNCTIONS(GL_DEVICE_ENUM)
+#undef GL_DEVICE_ENUM
+	};
+#define GL_DEVICE_ONE(R, name, glName, parameters, arguments) + 1
+	static const int FUNCTION_COUNT = 0 GL_DEVICE_FUNCTIONS(GL_DEVICE_ONE);
+#undef GL_DEVICE_ONE
+	static const char * getFunctionName(const Function function);
+
+#define GL_DEVICE_DECLARE(R, name, glName, parameters, arguments) virtual R name parameters = 0;
+	GL_DEVICE_FUNCTIONS(GL_DEVICE_DECLARE)
+#undef GL_DEVICE_DECLARE
+
+	virtual ~GLDevice() {}
+
+	/// <summary> The device gl:: calls go to. An OpenGLDevice until another one is set. Devices are not owned. </summary>
+	static GLDevice & current() { return *currentDevice; }
+	static void setCurrent(GLDevice * device);
+private:
+	static GLDevice * currentDevice;
+};
+
+/// <summary> Forwards every call to the driver. </summary>
+class OpenGLDevice : public GLDevice {
+public:
+#define GL_DEVICE_FORWARD(R, name, glName, parameters, arguments) R name parameters override { return glName arguments; }
+	GL_DEVICE_FUNCTIONS(GL_DEVICE_FORWARD)
+#undef GL_DEVICE_FORWARD
+};
+
+/// <summary> gl::bindTexture(...) and so on: the GL functions, sent to the current device. </summary>
+namespace gl {
+#define GL_DEVICE_CALL(R, name, glName, parameters, arguments) inline R name parameters { return GLDevice::current().name arguments; }
+	GL_DEVICE_FUNCTIONS(GL_DEVICE_CALL)
+#undef GL_DEVICE_CALL
+}
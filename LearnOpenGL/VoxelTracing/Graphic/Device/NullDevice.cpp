@@ -0,0 +1,595 @@
+#include "NullDevice.h"
+
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <iostream>
+#include <sstream>
+#include <regex>
+#include <algorithm>
+#include <functional>
+
+unsigned long long CountingDevice::getTotalCalls() const
+{
+	unsigned long long total = 0;
+	for (const unsigned long long functionCalls : calls) total += functionCalls;
+	return total;
+}
+
+// ----------------------
+// State.
+// ----------------------
+void NullDevice::viewport(GLint, GLint, GLsizei width, GLsizei height)
+{
+	countCall(Function::viewport);
+	if (width < 0 || height < 0) error("glViewport: negative size");
+}
+
+void NullDevice::getIntegerv(GLenum name, GLint * data)
+{
+	countCall(Function::getIntegerv);
+	switch (name) {
+	case GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT: *data = UNIFORM_BUFFER_OFFSET_ALIGNMENT; break;
+	case GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT: *data = SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT; break;
+	case GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS: *data = TEXTURE_UNITS; break;
+	case GL_MAX_IMAGE_UNITS: *data = IMAGE_UNITS; break;
+	case GL_MAX_UNIFORM_BUFFER_BINDINGS: case GL_MAX_SHADER_STORAGE_BUFFER_BINDINGS: *data = BUFFER_BINDINGS; break;
+	default: *data = 0; break;
+	}
+}
+
+const GLubyte * NullDevice::getString(GLenum)
+{
+	countCall(Function::getString);
+	return reinterpret_cast<const GLubyte *>("Null device");
+}
+
+// ----------------------
+// Drawing and compute.
+// ----------------------
+void NullDevice::drawElements(GLenum, GLsizei elements, GLenum, const void *)
+{
+	countCall(Function::drawElements);
+	if (elements < 0) error("glDrawElements: negative count");
+	if (program == 0) error("glDrawElements: no program in use");
+	if (vertexArray == 0) error("glDrawElements: no vertex array bound");
+}
+
+void NullDevice::dispatchCompute(GLuint x, GLuint y, GLuint z)
+{
+	countCall(Function::dispatchCompute);
+	const GLuint MAX_GROUPS = 65535;
+	if (x == 0 || y == 0 || z == 0) error("glDispatchCompute: empty dispatch");
+	if (x > MAX_GROUPS || y > MAX_GROUPS || z > MAX_GROUPS) error("glDispatchCompute: too many work groups");
+	if (program == 0) error("glDispatchCompute: no program in use");
+}
+
+// ----------------------
+// Synchronization.
+// ----------------------
+GLsync NullDevice::fenceSync(GLenum, GLbitfield)
+{
+	countCall(Function::fenceSync);
+	return reinterpret_cast<GLsync>(uintptr_t(nextName++));
+}
+
+GLenum NullDevice::clientWaitSync(GLsync sync, GLbitfield, GLuint64)
+{
+	countCall(Function::clientWaitSync);
+	if (sync == nullptr) error("glClientWaitSync: null sync");
+	return GL_ALREADY_SIGNALED;
+}
+
+// ----------------------
+// Programs and shaders.
+// ----------------------
+GLuint NullDevice::createProgram()
+{
+	countCall(Function::createProgram);
+	programs.insert(nextName);
+	return nextName++;
+}
+
+void NullDevice::deleteProgram(GLuint _program)
+{
+	countCall(Function::deleteProgram);
+	if (_program != 0) checkName("glDeleteProgram", _program, programs);
+	programs.erase(_program);
+	attachedShaders.erase(_program);
+	reflections.erase(_program);
+}
+
+void NullDevice::attachShader(GLuint _program, GLuint shader)
+{
+	countCall(Function::attachShader);
+	checkName("glAttachShader", _program, programs);
+	checkName("glAttachShader", shader, shaders);
+	attachedShaders[_program].push_back(shader);
+}
+
+void NullDevice::useProgram(GLuint _program)
+{
+	countCall(Function::useProgram);
+	if (_program != 0) checkName("glUseProgram", _program, programs);
+	program = _program;
+}
+
+void NullDevice::getProgramiv(GLuint _program, GLenum name, GLint * values)
+{
+	countCall(Function::getProgramiv);
+	checkName("glGetProgramiv", _program, programs);
+	*values = (name == GL_LINK_STATUS || name == GL_VALIDATE_STATUS) ? GL_TRUE : 0;
+}
+
+void NullDevice::getProgramInfoLog(GLuint, GLsizei size, GLsizei * length, GLchar * log)
+{
+	countCall(Function::getProgramInfoLog);
+	if (length) *length = 0;
+	if (size > 0) log[0] = '\0';
+}
+
+void NullDevice::linkProgram(GLuint _program)
+{
+	countCall(Function::linkProgram);
+	checkName("glLinkProgram", _program, programs);
+	Reflection & reflection = reflections[_program];
+	reflection = Reflection();
+	for (const GLuint shader : attachedShaders[_program]) reflect(shaderSources[shader], reflection);
+
+	// Locations in declaration order, arrays of basic types take consecutive ones.
+	GLint location = 0;
+	for (Reflection::Uniform & uniform : reflection.uniforms) {
+		uniform.location = location;
+		location += uniform.arraySize;
+	}
+}
+
+void NullDevice::getProgramInterfaceiv(GLuint _program, GLenum programInterface, GLenum name, GLint * values)
+{
+	countCall(Function::getProgramInterfaceiv);
+	*values = 0;
+	const Reflection * reflection = findReflection("glGetProgramInterfaceiv", _program);
+	if (!reflection || name != GL_ACTIVE_RESOURCES) return;
+	switch (programInterface) {
+	case GL_UNIFORM: *values = GLint(reflection->uniforms.size()); break;
+	case GL_UNIFORM_BLOCK: *values = GLint(reflection->uniformBlocks.size()); break;
+	case GL_SHADER_STORAGE_BLOCK: *values = GLint(reflection->storageBlocks.size()); break;
+	}
+}
+
+void NullDevice::getProgramResourceiv(GLuint _program, GLenum programInterface, GLuint index, GLsizei propertyCount, const GLenum * properties,
+	GLsizei size, GLsizei * length, GLint * values)
+{
+	countCall(Function::getProgramResourceiv);
+	if (length) *length = 0;
+	const Reflection * reflection = findReflection("glGetProgramResourceiv", _program);
+	if (!reflection) return;
+	const size_t count = programInterface == GL_UNIFORM ? reflection->uniforms.size() :
+		programInterface == GL_UNIFORM_BLOCK ? reflection->uniformBlocks.size() : reflection->storageBlocks.size();
+	if (index >= count) { error("glGetProgramResourceiv: index out of range"); return; }
+
+	const std::string & name = programInterface == GL_UNIFORM ? reflection->uniforms[index].name :
+		programInterface == GL_UNIFORM_BLOCK ? reflection->uniformBlocks[index] : reflection->storageBlocks[index];
+	GLsizei written = 0;
+	for (; written < propertyCount && written < size; ++written) {
+		GLint & value = values[written];
+		switch (properties[written]) {
+		case GL_NAME_LENGTH: value = GLint(name.size() + 1); break;
+		case GL_LOCATION: value = programInterface == GL_UNIFORM ? reflection->uniforms[index].location : -1; break;
+		case GL_ARRAY_SIZE: value = programInterface == GL_UNIFORM ? reflection->uniforms[index].arraySize : 1; break;
+		case GL_BLOCK_INDEX: value = -1; break; // Block members aren't reported.
+		default: value = 0; break;
+		}
+	}
+	if (length) *length = written;
+}
+
+void NullDevice::getProgramResourceName(GLuint _program, GLenum programInterface, GLuint index, GLsizei size, GLsizei * length, GLchar * name)
+{
+	countCall(Function::getProgramResourceName);
+	if (length) *length = 0;
+	if (size > 0) name[0] = '\0';
+	const Reflection * reflection = findReflection("glGetProgramResourceName", _program);
+	if (!reflection) return;
+	const std::vector<std::string> & blocks = programInterface == GL_UNIFORM_BLOCK ? reflection->uniformBlocks : reflection->storageBlocks;
+	if (index >= (programInterface == GL_UNIFORM ? reflection->uniforms.size() : blocks.size())) {
+		error("glGetProgramResourceName: index out of range");
+		return;
+	}
+	const std::string & resource = programInterface == GL_UNIFORM ? reflection->uniforms[index].name : blocks[index];
+	if (size <= 0) return;
+	const size_t copied = std::min(resource.size(), size_t(size - 1));
+	std::memcpy(name, resource.data(), copied);
+	name[copied] = '\0';
+	if (length) *length = GLsizei(copied);
+}
+
+GLint NullDevice::getUniformLocation(GLuint _program, const GLchar * name)
+{
+	countCall(Function::getUniformLocation);
+	const Reflection * reflection = findReflection("glGetUniformLocation", _program);
+	if (!reflection) return -1;
+
+	// "name", "name[0]" and "name[i]" of arrays of basic types are reported once, as "name[0]".
+	std::string base = name;
+	GLint element = 0;
+	if (!base.empty() && base.back() == ']') {
+		const size_t open = base.rfind('[');
+		element = std::atoi(base.c_str() + open + 1);
+		base.erase(open);
+	}
+	for (const Reflection::Uniform & uniform : reflection->uniforms) {
+		if (uniform.name == name) return uniform.location;
+		if (uniform.name.size() == base.size() + 3 && uniform.name.compare(0, base.size(), base) == 0 &&
+			uniform.name.compare(base.size(), 3, "[0]") == 0 && element < uniform.arraySize) return uniform.location + element;
+	}
+	return -1;
+}
+
+const NullDevice::Reflection * NullDevice::findReflection(const char * function, const GLuint _program)
+{
+	checkName(function, _program, programs);
+	auto it = reflections.find(_program);
+	return it == reflections.end() ? nullptr : &it->second;
+}
+
+void NullDevice::reflect(const std::string & _source, Reflection & reflection)
+{
+	// Without comments.
+	std::string source;
+	for (size_t i = 0; i < _source.size(); ++i) {
+		if (_source.compare(i, 2, "//") == 0) i = std::min(_source.find('\n', i), _source.size()) - 1;
+		else if (_source.compare(i, 2, "/*") == 0) i = std::min(_source.find("*/", i + 2), _source.size() - 2) + 1;
+		else source += _source[i];
+	}
+
+	// Array sizes may be integer macros, struct types are expanded member by member.
+	std::unordered_map<std::string, GLint> defines;
+	const std::regex define("#define\\s+(\\w+)\\s+(\\d+)");
+	for (std::sregex_iterator it(source.begin(), source.end(), define), end; it != end; ++it) defines[(*it)[1]] = std::stoi((*it)[2]);
+	struct Declaration { std::string type, name; GLint arraySize; }; // 0 if not an array.
+	const auto declarations = [&defines](const std::string & type, const std::string & declarators, std::vector<Declaration> & result) {
+		std::stringstream list(declarators);
+		std::string declarator;
+		while (std::getline(list, declarator, ',')) {
+			declarator = declarator.substr(0, declarator.find('=')); // Initializers.
+			std::smatch match;
+			if (!std::regex_search(declarator, match, std::regex("(\\w+)\\s*(?:\\[\\s*(\\w*)\\s*\\])?"))) continue;
+			GLint arraySize = 0;
+			if (match[2].matched) {
+				const std::string size = match[2];
+				arraySize = defines.count(size) ? defines[size] : std::isdigit(size.empty() ? 'x' : size[0]) ? std::stoi(size) : 1;
+			}
+			result.push_back({ type, match[1], arraySize });
+		}
+	};
+	std::unordered_map<std::string, std::vector<Declaration>> structs;
+	const std::regex structDefinition("\\bstruct\\s+(\\w+)\\s*\\{([^}]*)\\}"), member("(\\w+)\\s+([^;]+);");
+	for (std::sregex_iterator it(source.begin(), source.end(), structDefinition), end; it != end; ++it) {
+		const std::string body = (*it)[2];
+		std::vector<Declaration> & members = structs[(*it)[1]];
+		for (std::sregex_iterator m(body.begin(), body.end(), member); m != end; ++m) declarations((*m)[1], (*m)[2], members);
+	}
+
+	const auto addBlock = [](std::vector<std::string> & blocks, const std::string & name) {
+		if (std::find(blocks.begin(), blocks.end(), name) == blocks.end()) blocks.push_back(name);
+	};
+	const std::regex block("\\b(uniform|buffer)\\s+(\\w+)\\s*\\{");
+	for (std::sregex_iterator it(source.begin(), source.end(), block), end; it != end; ++it)
+		addBlock((*it)[1] == "uniform" ? reflection.uniformBlocks : reflection.storageBlocks, (*it)[2]);
+
+	// Every stage declares the uniforms it reads, a uniform shared by stages is one resource.
+	std::function<void(const Declaration &, const std::string &)> add = [&](const Declaration & declaration, const std::string & name) {
+		auto type = structs.find(declaration.type);
+		if (type == structs.end()) {
+			const std::string reported = declaration.arraySize > 0 ? name + "[0]" : name;
+			for (const Reflection::Uniform & uniform : reflection.uniforms) if (uniform.name == reported) return;
+			reflection.uniforms.push_back({ reported, 0, std::max(declaration.arraySize, 1) });
+			return;
+		}
+		for (GLint element = 0; element < std::max(declaration.arraySize, 1); ++element) {
+			const std::string prefix = declaration.arraySize > 0 ? name + "[" + std::to_string(element) + "]" : name;
+			for (const Declaration & structMember : type->second) add(structMember, prefix + "." + structMember.name);
+		}
+	};
+	const std::regex uniform("\\buniform\\s+(?:(?:lowp|mediump|highp|readonly|writeonly|coherent|volatile|restrict)\\s+)*(\\w+)\\s+([^;{]+);");
+	for (std::sregex_iterator it(source.begin(), source.end(), uniform), end; it != end; ++it) {
+		std::vector<Declaration> declared;
+		declarations((*it)[1], (*it)[2], declared);
+		for (const Declaration & declaration : declared) add(declaration, declaration.name);
+	}
+}
+
+GLuint NullDevice::createShader(GLenum)
+{
+	countCall(Function::createShader);
+	shaders.insert(nextName);
+	return nextName++;
+}
+
+void NullDevice::deleteShader(GLuint shader)
+{
+	countCall(Function::deleteShader);
+	if (shader != 0) checkName("glDeleteShader", shader, shaders);
+	shaders.erase(shader);
+	shaderSources.erase(shader);
+}
+
+void NullDevice::shaderSource(GLuint shader, GLsizei count, const GLchar * const * source, const GLint * length)
+{
+	countCall(Function::shaderSource);
+	checkName("glShaderSource", shader, shaders);
+	std::string & contents = shaderSources[shader];
+	contents.clear();
+	for (GLsizei i = 0; i < count; ++i) contents += length && length[i] >= 0 ? std::string(source[i], size_t(length[i])) : std::string(source[i]);
+}
+
+void NullDevice::getShaderiv(GLuint shader, GLenum name, GLint * values)
+{
+	countCall(Function::getShaderiv);
+	checkName("glGetShaderiv", shader, shaders);
+	*values = name == GL_COMPILE_STATUS ? GL_TRUE : 0;
+}
+
+void NullDevice::getShaderInfoLog(GLuint, GLsizei size, GLsizei * length, GLchar * log)
+{
+	countCall(Function::getShaderInfoLog);
+	if (length) *length = 0;
+	if (size > 0) log[0] = '\0';
+}
+
+// ----------------------
+// Buffers.
+// ----------------------
+void NullDevice::genBuffers(GLsizei n, GLuint * names)
+{
+	countCall(Function::genBuffers);
+	generate(n, names, buffers);
+}
+
+void NullDevice::deleteBuffers(GLsizei n, const GLuint * names)
+{
+	countCall(Function::deleteBuffers);
+	release(n, names, buffers);
+	for (GLsizei i = 0; i < n; ++i) {
+		bufferContents.erase(names[i]);
+		for (auto & bound : boundBuffers) if (bound.second == names[i]) bound.second = 0;
+	}
+}
+
+void NullDevice::bindBuffer(GLenum target, GLuint buffer)
+{
+	countCall(Function::bindBuffer);
+	if (buffer != 0) checkName("glBindBuffer", buffer, buffers);
+	boundBuffers[target] = buffer;
+}
+
+void NullDevice::bindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+	countCall(Function::bindBufferBase);
+	if (index >= GLuint(BUFFER_BINDINGS)) error("glBindBufferBase: binding out of range");
+	if (buffer != 0) checkName("glBindBufferBase", buffer, buffers);
+	boundBuffers[target] = buffer;
+}
+
+void NullDevice::bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+	countCall(Function::bindBufferRange);
+	if (index >= GLuint(BUFFER_BINDINGS)) error("glBindBufferRange: binding out of range");
+	checkName("glBindBufferRange", buffer, buffers);
+	const GLint alignment = target == GL_UNIFORM_BUFFER ? UNIFORM_BUFFER_OFFSET_ALIGNMENT : target == GL_SHADER_STORAGE_BUFFER ? SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT : 1;
+	if (offset % alignment != 0) error("glBindBufferRange: misaligned offset");
+	if (size <= 0) error("glBindBufferRange: empty range");
+	auto contents = bufferContents.find(buffer);
+	if (contents != bufferContents.end()) checkRange("glBindBufferRange", contents->second, offset, size);
+	boundBuffers[target] = buffer;
+}
+
+void NullDevice::bufferData(GLenum target, GLsizeiptr size, const void * data, GLenum)
+{
+	countCall(Function::bufferData);
+	if (size < 0) { error("glBufferData: negative size"); return; }
+	std::vector<unsigned char> * storage = boundStorage("glBufferData", target);
+	if (!storage) return;
+	storage->assign(size_t(size), 0);
+	if (data) std::memcpy(storage->data(), data, size_t(size));
+}
+
+void NullDevice::bufferStorage(GLenum target, GLsizeiptr size, const void * data, GLbitfield)
+{
+	countCall(Function::bufferStorage);
+	if (size <= 0) { error("glBufferStorage: empty storage"); return; }
+	std::vector<unsigned char> * storage = boundStorage("glBufferStorage", target);
+	if (!storage) return;
+	if (!storage->empty()) { error("glBufferStorage: storage is immutable"); return; }
+	storage->assign(size_t(size), 0);
+	if (data) std::memcpy(storage->data(), data, size_t(size));
+}
+
+void NullDevice::bufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void * data)
+{
+	countCall(Function::bufferSubData);
+	std::vector<unsigned char> * storage = boundStorage("glBufferSubData", target);
+	if (storage && checkRange("glBufferSubData", *storage, offset, size) && data) std::memcpy(storage->data() + offset, data, size_t(size));
+}
+
+void NullDevice::copyBufferSubData(GLenum readTarget, GLenum writeTarget, GLintptr readOffset, GLintptr writeOffset, GLsizeiptr size)
+{
+	countCall(Function::copyBufferSubData);
+	std::vector<unsigned char> * source = boundStorage("glCopyBufferSubData", readTarget);
+	std::vector<unsigned char> * destination = boundStorage("glCopyBufferSubData", writeTarget);
+	if (!source || !destination || !checkRange("glCopyBufferSubData", *source, readOffset, size) ||
+		!checkRange("glCopyBufferSubData", *destination, writeOffset, size)) return;
+	std::memmove(destination->data() + writeOffset, source->data() + readOffset, size_t(size));
+}
+
+void NullDevice::getBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, void * data)
+{
+	countCall(Function::getBufferSubData);
+	std::vector<unsigned char> * storage = boundStorage("glGetBufferSubData", target);
+	if (storage && checkRange("glGetBufferSubData", *storage, offset, size)) std::memcpy(data, storage->data() + offset, size_t(size));
+}
+
+void * NullDevice::mapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield)
+{
+	countCall(Function::mapBufferRange);
+	std::vector<unsigned char> * storage = boundStorage("glMapBufferRange", target);
+	if (!storage || !checkRange("glMapBufferRange", *storage, offset, length)) return nullptr;
+	return storage->data() + offset;
+}
+
+// ----------------------
+// Vertex arrays.
+// ----------------------
+void NullDevice::genVertexArrays(GLsizei n, GLuint * names)
+{
+	countCall(Function::genVertexArrays);
+	generate(n, names, vertexArrays);
+}
+
+void NullDevice::deleteVertexArrays(GLsizei n, const GLuint * names)
+{
+	countCall(Function::deleteVertexArrays);
+	release(n, names, vertexArrays);
+	for (GLsizei i = 0; i < n; ++i) if (vertexArray == names[i]) vertexArray = 0;
+}
+
+void NullDevice::bindVertexArray(GLuint array)
+{
+	countCall(Function::bindVertexArray);
+	if (array != 0) checkName("glBindVertexArray", array, vertexArrays);
+	vertexArray = array;
+}
+
+void NullDevice::bindVertexBuffer(GLuint, GLuint buffer, GLintptr offset, GLsizei stride)
+{
+	countCall(Function::bindVertexBuffer);
+	if (vertexArray == 0) error("glBindVertexBuffer: no vertex array bound");
+	if (buffer != 0) checkName("glBindVertexBuffer", buffer, buffers);
+	if (offset < 0 || stride < 0) error("glBindVertexBuffer: negative offset or stride");
+}
+
+// ----------------------
+// Textures.
+// ----------------------
+void NullDevice::genTextures(GLsizei n, GLuint * names)
+{
+	countCall(Function::genTextures);
+	generate(n, names, textures);
+}
+
+void NullDevice::deleteTextures(GLsizei n, const GLuint * names)
+{
+	countCall(Function::deleteTextures);
+	release(n, names, textures);
+}
+
+void NullDevice::activeTexture(GLenum unit)
+{
+	countCall(Function::activeTexture);
+	if (unit < GL_TEXTURE0 || unit >= GLenum(GL_TEXTURE0 + TEXTURE_UNITS)) error("glActiveTexture: unit out of range");
+}
+
+void NullDevice::bindTexture(GLenum, GLuint texture)
+{
+	countCall(Function::bindTexture);
+	if (texture != 0) checkName("glBindTexture", texture, textures);
+}
+
+void NullDevice::bindImageTexture(GLuint unit, GLuint texture, GLint level, GLboolean, GLint, GLenum, GLenum)
+{
+	countCall(Function::bindImageTexture);
+	if (unit >= GLuint(IMAGE_UNITS)) error("glBindImageTexture: unit out of range");
+	if (texture != 0) checkName("glBindImageTexture", texture, textures);
+	if (level < 0) error("glBindImageTexture: negative level");
+}
+
+// ----------------------
+// Framebuffers.
+// ----------------------
+void NullDevice::genFramebuffers(GLsizei n, GLuint * names)
+{
+	countCall(Function::genFramebuffers);
+	generate(n, names, framebuffers);
+}
+
+void NullDevice::deleteFramebuffers(GLsizei n, const GLuint * names)
+{
+	countCall(Function::deleteFramebuffers);
+	release(n, names, framebuffers);
+}
+
+void NullDevice::bindFramebuffer(GLenum, GLuint framebuffer)
+{
+	countCall(Function::bindFramebuffer);
+	if (framebuffer != 0) checkName("glBindFramebuffer", framebuffer, framebuffers);
+}
+
+GLenum NullDevice::checkFramebufferStatus(GLenum)
+{
+	countCall(Function::checkFramebufferStatus);
+	return GL_FRAMEBUFFER_COMPLETE;
+}
+
+void NullDevice::genRenderbuffers(GLsizei n, GLuint * names)
+{
+	countCall(Function::genRenderbuffers);
+	generate(n, names, renderbuffers);
+}
+
+void NullDevice::bindRenderbuffer(GLenum, GLuint renderbuffer)
+{
+	countCall(Function::bindRenderbuffer);
+	if (renderbuffer != 0) checkName("glBindRenderbuffer", renderbuffer, renderbuffers);
+}
+
+// ----------------------
+// Validation.
+// ----------------------
+void NullDevice::error(const std::string & message)
+{
+	if (errors++ < PRINTED_ERRORS) std::cerr << "Null device: " << message << std::endl;
+}
+
+void NullDevice::generate(GLsizei n, GLuint * names, std::unordered_set<GLuint> & objects)
+{
+	if (n < 0) { error("glGen*: negative count"); return; }
+	for (GLsizei i = 0; i < n; ++i) {
+		names[i] = nextName++;
+		objects.insert(names[i]);
+	}
+}
+
+void NullDevice::release(GLsizei n, const GLuint * names, std::unordered_set<GLuint> & objects)
+{
+	if (n < 0) { error("glDelete*: negative count"); return; }
+	for (GLsizei i = 0; i < n; ++i) objects.erase(names[i]); // Unknown names are silently ignored, as in GL.
+}
+
+void NullDevice::checkName(const char * function, const GLuint name, const std::unordered_set<GLuint> & objects)
+{
+	if (objects.count(name)) return;
+	std::ostringstream message;
+	message << function << ": unknown name " << name;
+	error(message.str());
+}
+
+std::vector<unsigned char> * NullDevice::boundStorage(const char * function, const GLenum target)
+{
+	auto bound = boundBuffers.find(target);
+	if (bound == boundBuffers.end() || bound->second == 0) {
+		error(std::string(function) + ": no buffer bound");
+		return nullptr;
+	}
+	return &bufferContents[bound->second];
+}
+
+bool NullDevice::checkRange(const char * function, const std::vector<unsigned char> & storage, const GLintptr offset, const GLsizeiptr size)
+{
+	if (offset >= 0 && size >= 0 && size_t(offset) + size_t(size) <= storage.size()) return true;
+	std::ostringstream message;
+	message << function << ": range [" << offset << ", " << offset + size << ") outside of " << storage.size() << " bytes";
+	error(message.str());
+	return false;
+}
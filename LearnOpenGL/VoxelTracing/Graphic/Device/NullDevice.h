@@ -0,0 +1,143 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "GLDevice.h"
+
+/// <summary> Counts every call and does nothing else. The base of NullDevice. </summary>
+class CountingDevice : public GLDevice {
+public:
+#define GL_DEVICE_COUNT(R, name, glName, parameters, arguments) R name parameters override { countCall(Function::name); ignore arguments; return defaultResult<R>(); }
+	GL_DEVICE_FUNCTIONS(GL_DEVICE_COUNT)
+#undef GL_DEVICE_COUNT
+
+	unsigned long long getCalls(const Function function) const { return calls[int(function)]; }
+	unsigned long long getTotalCalls() const;
+	void resetCalls() { calls.fill(0); }
+protected:
+	void countCall(const Function function) { ++calls[int(function)]; }
+	template<typename R> static R defaultResult() { return R(); }
+	template<typename... Arguments> static void ignore(const Arguments & ...) {}
+private:
+	std::array<unsigned long long, FUNCTION_COUNT> calls = {};
+};
+
+/// <summary> A device without a GPU, to run and profile the renderer's CPU side headless.
+/// Hands out object names, keeps buffer contents in memory (so mapping and readbacks work), reports success for
+/// every compile, link, framebuffer and fence, and checks arguments: unknown names, out of range units and
+/// buffer ranges, misaligned block offsets, draws without a program or vertex array. Shaders are not compiled, but
+/// linking reads the declarations of their sources, so programs report their blocks and uniforms (struct members and
+/// arrays expanded like a driver does) and take the same paths as on a GPU. Every declared uniform is active,
+/// and #if is not evaluated. </summary>
+class NullDevice : public CountingDevice {
+public:
+	static const GLint UNIFORM_BUFFER_OFFSET_ALIGNMENT = 256, SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT = 256;
+	static const GLint TEXTURE_UNITS = 32, IMAGE_UNITS = 8, BUFFER_BINDINGS = 16;
+
+	/// <summary> Argument errors found so far. The first few are also printed. </summary>
+	unsigned long long getErrors() const { return errors; }
+
+	// State.
+	void viewport(GLint x, GLint y, GLsizei width, GLsizei height) override;
+	void getIntegerv(GLenum name, GLint * data) override;
+	const GLubyte * getString(GLenum name) override;
+
+	// Drawing and compute.
+	void drawElements(GLenum mode, GLsizei count, GLenum type, const void * indices) override;
+	void dispatchCompute(GLuint x, GLuint y, GLuint z) override;
+
+	// Synchronization.
+	GLsync fenceSync(GLenum condition, GLbitfield flags) override;
+	GLenum clientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout) override;
+
+	// Programs and shaders.
+	GLuint createProgram() override;
+	void deleteProgram(GLuint program) override;
+	void attachShader(GLuint program, GLuint shader) override;
+	void useProgram(GLuint program) override;
+	void getProgramiv(GLuint program, GLenum name, GLint * values) override;
+	void getProgramInfoLog(GLuint program, GLsizei size, GLsizei * length, GLchar * log) override;
+	void linkProgram(GLuint program) override;
+	void getProgramInterfaceiv(GLuint program, GLenum programInterface, GLenum name, GLint * values) override;
+	void getProgramResourceiv(GLuint program, GLenum programInterface, GLuint index, GLsizei propertyCount, const GLenum * properties,
+		GLsizei size, GLsizei * length, GLint * values) override;
+	void getProgramResourceName(GLuint program, GLenum programInterface, GLuint index, GLsizei size, GLsizei * length, GLchar * name) override;
+	GLint getUniformLocation(GLuint program, const GLchar * name) override;
+	GLuint createShader(GLenum type) override;
+	void deleteShader(GLuint shader) override;
+	void shaderSource(GLuint shader, GLsizei count, const GLchar * const * source, const GLint * length) override;
+	void getShaderiv(GLuint shader, GLenum name, GLint * values) override;
+	void getShaderInfoLog(GLuint shader, GLsizei size, GLsizei * length, GLchar * log) override;
+
+	// Buffers.
+	void genBuffers(GLsizei count, GLuint * buffers) override;
+	void deleteBuffers(GLsizei count, const GLuint * buffers) override;
+	void bindBuffer(GLenum target, GLuint buffer) override;
+	void bindBufferBase(GLenum target, GLuint index, GLuint buffer) override;
+	void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) override;
+	void bufferData(GLenum target, GLsizeiptr size, const void * data, GLenum usage) override;
+	void bufferStorage(GLenum target, GLsizeiptr size, const void * data, GLbitfield flags) override;
+	void bufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void * data) override;
+	void copyBufferSubData(GLenum readTarget, GLenum writeTarget, GLintptr readOffset, GLintptr writeOffset, GLsizeiptr size) override;
+	void getBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, void * data) override;
+	void * mapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) override;
+
+	// Vertex arrays.
+	void genVertexArrays(GLsizei count, GLuint * arrays) override;
+	void deleteVertexArrays(GLsizei count, const GLuint * arrays) override;
+	void bindVertexArray(GLuint array) override;
+	void bindVertexBuffer(GLuint binding, GLuint buffer, GLintptr offset, GLsizei stride) override;
+
+	// Textures.
+	void genTextures(GLsizei count, GLuint * textures) override;
+	void deleteTextures(GLsizei count, const GLuint * textures) override;
+	void activeTexture(GLenum unit) override;
+	void bindTexture(GLenum target, GLuint texture) override;
+	void bindImageTexture(GLuint unit, GLuint texture, GLint level, GLboolean layered, GLint layer, GLenum access, GLenum format) override;
+
+	// Framebuffers.
+	void genFramebuffers(GLsizei count, GLuint * framebuffers) override;
+	void deleteFramebuffers(GLsizei count, const GLuint * framebuffers) override;
+	void bindFramebuffer(GLenum target, GLuint framebuffer) override;
+	GLenum checkFramebufferStatus(GLenum target) override;
+	void genRenderbuffers(GLsizei count, GLuint * renderbuffers) override;
+	void bindRenderbuffer(GLenum target, GLuint renderbuffer) override;
+private:
+	static const int PRINTED_ERRORS = 16;
+
+	void error(const std::string & message);
+	void generate(GLsizei count, GLuint * names, std::unordered_set<GLuint> & objects);
+	void release(GLsizei count, const GLuint * names, std::unordered_set<GLuint> & objects);
+	void checkName(const char * function, const GLuint name, const std::unordered_set<GLuint> & objects);
+
+	/// <summary> The storage of the buffer bound to target, null (and an error) if there is none. </summary>
+	std::vector<unsigned char> * boundStorage(const char * function, const GLenum target);
+	bool checkRange(const char * function, const std::vector<unsigned char> & storage, const GLintptr offset, const GLsizeiptr size);
+
+	/// <summary> The active resources of a linked program, read from the declarations of its shaders. </summary>
+	struct Reflection {
+		struct Uniform {
+			std::string name; // As a driver reports it: "settings.shadows", "pointLights[1].color", "lightVisibility[0]".
+			GLint location, arraySize;
+		};
+		std::vector<Uniform> uniforms;
+		std::vector<std::string> uniformBlocks, storageBlocks;
+	};
+	static void reflect(const std::string & source, Reflection & reflection);
+	/// <summary> The reflection of a program, null (and an error) if the program is unknown. </summary>
+	const Reflection * findReflection(const char * function, const GLuint program);
+
+	GLuint nextName = 1;
+	std::unordered_set<GLuint> programs, shaders, buffers, vertexArrays, textures, framebuffers, renderbuffers;
+	std::unordered_map<GLuint, std::vector<unsigned char>> bufferContents;
+	std::unordered_map<GLenum, GLuint> boundBuffers;
+	std::unordered_map<GLuint, std::string> shaderSources;
+	std::unordered_map<GLuint, std::vector<GLuint>> attachedShaders;
+	std::unordered_map<GLuint, Reflection> reflections;
+	GLuint program = 0, vertexArray = 0;
+	unsigned long long errors = 0;
+};
@@ -0,0 +1,265 @@
+#include "RecordingDevice.h"
+
+#include <cstring>
+#include <iomanip>
+#include <limits>
+
+namespace {
+	uint64_t hash(const void * data, const size_t size) {
+		uint64_t h = 14695981039346656037ull;
+		for (size_t i = 0; i < size; ++i) h = (h ^ static_cast<const unsigned char *>(data)[i]) * 1099511628211ull; // FNV-1a.
+		return h;
+	}
+
+	/// <summary> The size of a pixel the application passes in (tightly packed), 0 for formats the renderer doesn't use. </summary>
+	size_t pixelSize(const GLenum format, const GLenum type) {
+		size_t components;
+		switch (format) {
+		case GL_RED: case GL_RED_INTEGER: case GL_DEPTH_COMPONENT: case GL_DEPTH_STENCIL: components = 1; break;
+		case GL_RG: case GL_RG_INTEGER: components = 2; break;
+		case GL_RGB: case GL_RGB_INTEGER: components = 3; break;
+		case GL_RGBA: case GL_RGBA_INTEGER: components = 4; break;
+		default: return 0;
+		}
+		switch (type) {
+		case GL_UNSIGNED_BYTE: case GL_BYTE: return components;
+		case GL_UNSIGNED_SHORT: case GL_SHORT: case GL_HALF_FLOAT: return 2 * components;
+		case GL_UNSIGNED_INT: case GL_INT: case GL_FLOAT: return 4 * components;
+		case GL_UNSIGNED_INT_24_8: return 4;
+		default: return 0;
+		}
+	}
+}
+
+PassThroughRecorder::PassThroughRecorder(GLDevice & _device, std::ostream & _stream) : device(_device), stream(_stream)
+{
+	stream << std::setprecision(std::numeric_limits<float>::max_digits10); // Floats are written exactly.
+}
+
+void PassThroughRecorder::write(const GLchar * value)
+{
+	if (value) stream << '"' << value << '"';
+	else stream << "null";
+}
+
+void PassThroughRecorder::write(const GLsync sync)
+{
+	const auto it = syncs.find(sync);
+	if (it != syncs.end()) stream << "sync " << it->second;
+	else stream << (sync ? "unknown sync" : "null");
+}
+
+void PassThroughRecorder::write(const Payload & payload)
+{
+	if (!payload.data) { stream << "null"; return; }
+	if (payload.size == 0) { stream << "data"; return; }
+	stream << "<" << payload.size << " bytes " << std::hex << std::setw(16) << std::setfill('0') << hash(payload.data, payload.size)
+		<< std::dec << std::setfill(' ') << ">";
+}
+
+// ----------------------
+// Drawing.
+// ----------------------
+void RecordingDevice::drawElements(GLenum mode, GLsizei count, GLenum type, const void * indices)
+{
+	// Indices are an offset into the element buffer.
+	record(Function::drawElements, [&] { device.drawElements(mode, count, type, indices); },
+		[&] { writeArguments(mode, count, type, reinterpret_cast<uintptr_t>(indices)); });
+}
+
+// ----------------------
+// Synchronization.
+// ----------------------
+GLsync RecordingDevice::fenceSync(GLenum condition, GLbitfield flags)
+{
+	return record(Function::fenceSync, [&] {
+		const GLsync sync = device.fenceSync(condition, flags);
+		syncs[sync] = nextSync++;
+		return sync;
+	}, [&] { writeArguments(condition, flags); });
+}
+
+void RecordingDevice::deleteSync(GLsync sync)
+{
+	record(Function::deleteSync, [&] { device.deleteSync(sync); }, [&] { writeArguments(sync); });
+	syncs.erase(sync);
+}
+
+// ----------------------
+// Programs and shaders.
+// ----------------------
+void RecordingDevice::getProgramResourceiv(GLuint program, GLenum programInterface, GLuint index, GLsizei propertyCount, const GLenum * properties,
+	GLsizei size, GLsizei * length, GLint * values)
+{
+	record(Function::getProgramResourceiv, [&] { device.getProgramResourceiv(program, programInterface, index, propertyCount, properties, size, length, values); },
+		[&] { writeArguments(program, programInterface, index, propertyCount, array(properties, propertyCount), size, length, array<GLint>(values, length ? *length : size)); });
+}
+
+void RecordingDevice::programBinary(GLuint program, GLenum binaryFormat, const void * binary, GLsizei length)
+{
+	record(Function::programBinary, [&] { device.programBinary(program, binaryFormat, binary, length); },
+		[&] { writeArguments(program, binaryFormat, Payload{ binary, size_t(length) }, length); });
+}
+
+void RecordingDevice::shaderSource(GLuint shader, GLsizei count, const GLchar * const * source, const GLint * length)
+{
+	record(Function::shaderSource, [&] { device.shaderSource(shader, count, source, length); }, [&] {
+		writeArguments(shader, count);
+		stream << ", [";
+		for (GLsizei i = 0; i < count; ++i) {
+			const size_t size = length && length[i] >= 0 ? size_t(length[i]) : std::strlen(source[i]);
+			stream << (i > 0 ? ", " : "");
+			write(Payload{ source[i], size });
+		}
+		stream << "], ";
+		write(array(length, size_t(count)));
+	});
+}
+
+// ----------------------
+// Uniforms.
+// ----------------------
+void RecordingDevice::programUniform2fv(GLuint program, GLint location, GLsizei count, const GLfloat * values)
+{
+	record(Function::programUniform2fv, [&] { device.programUniform2fv(program, location, count, values); },
+		[&] { writeArguments(program, location, count, array(values, 2 * size_t(count))); });
+}
+
+void RecordingDevice::programUniform3fv(GLuint program, GLint location, GLsizei count, const GLfloat * values)
+{
+	record(Function::programUniform3fv, [&] { device.programUniform3fv(program, location, count, values); },
+		[&] { writeArguments(program, location, count, array(values, 3 * size_t(count))); });
+}
+
+void RecordingDevice::programUniform4fv(GLuint program, GLint location, GLsizei count, const GLfloat * values)
+{
+	record(Function::programUniform4fv, [&] { device.programUniform4fv(program, location, count, values); },
+		[&] { writeArguments(program, location, count, array(values, 4 * size_t(count))); });
+}
+
+void RecordingDevice::programUniformMatrix4fv(GLuint program, GLint location, GLsizei count, GLboolean transpose, const GLfloat * values)
+{
+	record(Function::programUniformMatrix4fv, [&] { device.programUniformMatrix4fv(program, location, count, transpose, values); },
+		[&] { writeArguments(program, location, count, transpose, array(values, 16 * size_t(count))); });
+}
+
+// ----------------------
+// Buffers.
+// ----------------------
+void RecordingDevice::genBuffers(GLsizei count, GLuint * buffers)
+{
+	record(Function::genBuffers, [&] { device.genBuffers(count, buffers); }, [&] { writeArguments(count, array<GLuint>(buffers, count)); });
+}
+
+void RecordingDevice::deleteBuffers(GLsizei count, const GLuint * buffers)
+{
+	record(Function::deleteBuffers, [&] { device.deleteBuffers(count, buffers); }, [&] { writeArguments(count, array(buffers, count)); });
+}
+
+void RecordingDevice::bufferData(GLenum target, GLsizeiptr size, const void * data, GLenum usage)
+{
+	record(Function::bufferData, [&] { device.bufferData(target, size, data, usage); },
+		[&] { writeArguments(target, size, Payload{ data, size_t(size) }, usage); });
+}
+
+void RecordingDevice::bufferStorage(GLenum target, GLsizeiptr size, const void * data, GLbitfield flags)
+{
+	record(Function::bufferStorage, [&] { device.bufferStorage(target, size, data, flags); },
+		[&] { writeArguments(target, size, Payload{ data, size_t(size) }, flags); });
+}
+
+void RecordingDevice::bufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void * data)
+{
+	record(Function::bufferSubData, [&] { device.bufferSubData(target, offset, size, data); },
+		[&] { writeArguments(target, offset, size, Payload{ data, size_t(size) }); });
+}
+
+void RecordingDevice::clearBufferData(GLenum target, GLenum internalFormat, GLenum format, GLenum type, const void * data)
+{
+	record(Function::clearBufferData, [&] { device.clearBufferData(target, internalFormat, format, type, data); },
+		[&] { writeArguments(target, internalFormat, format, type, Payload{ data, pixelSize(format, type) }); });
+}
+
+void * RecordingDevice::mapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access)
+{
+	void * mapped = device.mapBufferRange(target, offset, length, access);
+	if (!paused) {
+		stream << getFunctionName(Function::mapBufferRange) << "(";
+		writeArguments(target, offset, length, access);
+		stream << ") = " << (mapped ? "mapped" : "null") << "\n";
+	}
+	return mapped;
+}
+
+// ----------------------
+// Vertex arrays.
+// ----------------------
+void RecordingDevice::genVertexArrays(GLsizei count, GLuint * arrays)
+{
+	record(Function::genVertexArrays, [&] { device.genVertexArrays(count, arrays); }, [&] { writeArguments(count, array<GLuint>(arrays, count)); });
+}
+
+void RecordingDevice::deleteVertexArrays(GLsizei count, const GLuint * arrays)
+{
+	record(Function::deleteVertexArrays, [&] { device.deleteVertexArrays(count, arrays); }, [&] { writeArguments(count, array(arrays, count)); });
+}
+
+// ----------------------
+// Textures.
+// ----------------------
+void RecordingDevice::genTextures(GLsizei count, GLuint * textures)
+{
+	record(Function::genTextures, [&] { device.genTextures(count, textures); }, [&] { writeArguments(count, array<GLuint>(textures, count)); });
+}
+
+void RecordingDevice::deleteTextures(GLsizei count, const GLuint * textures)
+{
+	record(Function::deleteTextures, [&] { device.deleteTextures(count, textures); }, [&] { writeArguments(count, array(textures, count)); });
+}
+
+void RecordingDevice::texImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLint border, GLenum format,
+	GLenum type, const void * pixels)
+{
+	const size_t size = size_t(width) * size_t(height) * pixelSize(format, type);
+	record(Function::texImage2D, [&] { device.texImage2D(target, level, internalFormat, width, height, border, format, type, pixels); },
+		[&] { writeArguments(target, level, internalFormat, width, height, border, format, type, Payload{ pixels, size }); });
+}
+
+void RecordingDevice::texSubImage3D(GLenum target, GLint level, GLint x, GLint y, GLint z, GLsizei width, GLsizei height, GLsizei depth,
+	GLenum format, GLenum type, const void * pixels)
+{
+	const size_t size = size_t(width) * size_t(height) * size_t(depth) * pixelSize(format, type);
+	record(Function::texSubImage3D, [&] { device.texSubImage3D(target, level, x, y, z, width, height, depth, format, type, pixels); },
+		[&] { writeArguments(target, level, x, y, z, width, height, depth, format, type, Payload{ pixels, size }); });
+}
+
+void RecordingDevice::clearTexImage(GLuint texture, GLint level, GLenum format, GLenum type, const void * data)
+{
+	record(Function::clearTexImage, [&] { device.clearTexImage(texture, level, format, type, data); },
+		[&] { writeArguments(texture, level, format, type, Payload{ data, pixelSize(format, type) }); });
+}
+
+void RecordingDevice::clearTexSubImage(GLuint texture, GLint level, GLint x, GLint y, GLint z, GLsizei width, GLsizei height, GLsizei depth,
+	GLenum format, GLenum type, const void * data)
+{
+	record(Function::clearTexSubImage, [&] { device.clearTexSubImage(texture, level, x, y, z, width, height, depth, format, type, data); },
+		[&] { writeArguments(texture, level, x, y, z, width, height, depth, format, type, Payload{ data, pixelSize(format, type) }); });
+}
+
+// ----------------------
+// Framebuffers.
+// ----------------------
+void RecordingDevice::genFramebuffers(GLsizei count, GLuint * framebuffers)
+{
+	record(Function::genFramebuffers, [&] { device.genFramebuffers(count, framebuffers); }, [&] { writeArguments(count, array<GLuint>(framebuffers, count)); });
+}
+
+void RecordingDevice::deleteFramebuffers(GLsizei count, const GLuint * framebuffers)
+{
+	record(Function::deleteFramebuffers, [&] { device.deleteFramebuffers(count, framebuffers); }, [&] { writeArguments(count, array(framebuffers, count)); });
+}
+
+void RecordingDevice::genRenderbuffers(GLsizei count, GLuint * renderbuffers)
+{
+	record(Function::genRenderbuffers, [&] { device.genRenderbuffers(count, renderbuffers); }, [&] { writeArguments(count, array<GLuint>(renderbuffers, count)); });
+}
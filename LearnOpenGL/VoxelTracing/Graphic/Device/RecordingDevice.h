@@ -0,0 +1,137 @@
+#pragma once
+
+#include <ostream>
+#include <cstdint>
+#include <type_traits>
+#include <unordered_map>
+
+#include "GLDevice.h"
+
+/// <summary> Passes every call on to another device, then writes it as a line "glName(arguments)" (and " = result") to a stream.
+/// The base of RecordingDevice: names, enums and values are written as is, other pointers only as 'out' or 'data'. </summary>
+class PassThroughRecorder : public GLDevice {
+public:
+	PassThroughRecorder(GLDevice & device, std::ostream & stream);
+
+#define GL_DEVICE_RECORD(R, name, glName, parameters, arguments) R name parameters override { \
+		return record(Function::name, [&] { return device.name arguments; }, [&] { writeArguments arguments; }); }
+	GL_DEVICE_FUNCTIONS(GL_DEVICE_RECORD)
+#undef GL_DEVICE_RECORD
+
+	/// <summary> Stops writing calls (they are still passed on). </summary>
+	void setPaused(const bool _paused) { paused = _paused; }
+protected:
+	GLDevice & device;
+	std::ostream & stream;
+	bool paused = false;
+
+	/// <summary> Bytes read from a pointer, written as their size and FNV-1a hash (the same data always writes the same). </summary>
+	struct Payload { const void * data; size_t size; };
+	/// <summary> Values read from a pointer, written as a list. </summary>
+	template<typename T> struct Array { const T * values; size_t count; };
+	template<typename T> static Array<T> array(const T * values, const size_t count) { return { values, count }; }
+
+	/// <summary> Makes the call, then writes it with its arguments (after the call, so names the call returns can be written). </summary>
+	template<typename Call, typename Arguments> auto record(const Function function, Call call, Arguments arguments)
+		-> typename std::enable_if<std::is_void<decltype(call())>::value>::type {
+		call();
+		if (paused) return;
+		stream << getFunctionName(function) << "(";
+		arguments();
+		stream << ")\n";
+	}
+	template<typename Call, typename Arguments> auto record(const Function function, Call call, Arguments arguments)
+		-> typename std::enable_if<!std::is_void<decltype(call())>::value, decltype(call())>::type {
+		const auto result = call();
+		if (paused) return result;
+		stream << getFunctionName(function) << "(";
+		arguments();
+		stream << ") = ";
+		write(result);
+		stream << "\n";
+		return result;
+	}
+
+	void writeArguments() {}
+	template<typename First, typename... Rest> void writeArguments(const First & first, const Rest &... rest) {
+		write(first);
+		if (sizeof...(rest) > 0) stream << ", ";
+		writeArguments(rest...);
+	}
+
+	template<typename T> void write(const T & value) { stream << value; }
+	template<typename T> void write(T * value) { stream << (value ? "out" : "null"); } // Written by the call, see the overrides.
+	template<typename T> void write(const T * value) { stream << (value ? "data" : "null"); } // Unknown size, see the overrides.
+	void write(const GLboolean value) { stream << (value ? "GL_TRUE" : "GL_FALSE"); }
+	void write(const GLchar * value);
+	void write(const GLubyte * value) { write(reinterpret_cast<const GLchar *>(value)); }
+	void write(const GLsync sync);
+	void write(const Payload & payload);
+	template<typename T> void write(const Array<T> & values) {
+		if (!values.values) { stream << "null"; return; }
+		stream << "[";
+		for (size_t i = 0; i < values.count; ++i) stream << (i > 0 ? ", " : "") << values.values[i];
+		stream << "]";
+	}
+
+	/// <summary> Fences are numbered in the order they are created, so two captures write the same ids. </summary>
+	std::unordered_map<GLsync, unsigned int> syncs;
+	unsigned int nextSync = 1;
+};
+
+/// <summary> Writes the command stream of another device to a stream, one call per line, in a form two captures can be
+/// diffed by (and a replay could rebuild the calls from): data arguments are written as their size and hash, uniform values
+/// and object names as lists, fences as ids, and mapped pointers as 'mapped'. Set it as the current device around a frame
+/// to capture that frame (see Application::runHeadless, which wraps the NullDevice). </summary>
+class RecordingDevice : public PassThroughRecorder {
+public:
+	RecordingDevice(GLDevice & device, std::ostream & stream) : PassThroughRecorder(device, stream) {}
+
+	// Drawing.
+	void drawElements(GLenum mode, GLsizei count, GLenum type, const void * indices) override;
+
+	// Synchronization.
+	GLsync fenceSync(GLenum condition, GLbitfield flags) override;
+	void deleteSync(GLsync sync) override;
+
+	// Programs and shaders.
+	void getProgramResourceiv(GLuint program, GLenum programInterface, GLuint index, GLsizei propertyCount, const GLenum * properties,
+		GLsizei size, GLsizei * length, GLint * values) override;
+	void programBinary(GLuint program, GLenum binaryFormat, const void * binary, GLsizei length) override;
+	void shaderSource(GLuint shader, GLsizei count, const GLchar * const * source, const GLint * length) override;
+
+	// Uniforms.
+	void programUniform2fv(GLuint program, GLint location, GLsizei count, const GLfloat * values) override;
+	void programUniform3fv(GLuint program, GLint location, GLsizei count, const GLfloat * values) override;
+	void programUniform4fv(GLuint program, GLint location, GLsizei count, const GLfloat * values) override;
+	void programUniformMatrix4fv(GLuint program, GLint location, GLsizei count, GLboolean transpose, const GLfloat * values) override;
+
+	// Buffers.
+	void genBuffers(GLsizei count, GLuint * buffers) override;
+	void deleteBuffers(GLsizei count, const GLuint * buffers) override;
+	void bufferData(GLenum target, GLsizeiptr size, const void * data, GLenum usage) override;
+	void bufferStorage(GLenum target, GLsizeiptr size, const void * data, GLbitfield flags) override;
+	void bufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void * data) override;
+	void clearBufferData(GLenum target, GLenum internalFormat, GLenum format, GLenum type, const void * data) override;
+	void * mapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) override;
+
+	// Vertex arrays.
+	void genVertexArrays(GLsizei count, GLuint * arrays) override;
+	void deleteVertexArrays(GLsizei count, const GLuint * arrays) override;
+
+	// Textures.
+	void genTextures(GLsizei count, GLuint * textures) override;
+	void deleteTextures(GLsizei count, const GLuint * textures) override;
+	void texImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type,
+		const void * pixels) override;
+	void texSubImage3D(GLenum target, GLint level, GLint x, GLint y, GLint z, GLsizei width, GLsizei height, GLsizei depth, GLenum format,
+		GLenum type, const void * pixels) override;
+	void clearTexImage(GLuint texture, GLint level, GLenum format, GLenum type, const void * data) override;
+	void clearTexSubImage(GLuint texture, GLint level, GLint x, GLint y, GLint z, GLsizei width, GLsizei height, GLsizei depth, GLenum format,
+		GLenum type, const void * data) override;
+
+	// Framebuffers.
+	void genFramebuffers(GLsizei count, GLuint * framebuffers) override;
+	void deleteFramebuffers(GLsizei count, const GLuint * framebuffers) override;
+	void genRenderbuffers(GLsizei count, GLuint * renderbuffers) override;
+};
@@ -2,35 +2,39 @@
 
 #include <iostream>
 
+#include "../Material/Material.h"
+#include "../GLState.h"
+#include "../Device/GLDevice.h"
+
 FBO::FBO(GLuint w, GLuint h, GLenum magFilter, GLenum minFilter, GLint internalFormat, GLint format, GLint wrap)
 	: width(w), height(h)
 {
-	GLint previousFrameBuffer;
-	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFrameBuffer);
+	GLState & state = GLState::getInstance();
+	const GLuint previousFrameBuffer = state.getFramebuffer();
 
 	// Init framebuffer.
-	glGenFramebuffers(1, &frameBuffer);
-	glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
+	gl::genFramebuffers(1, &frameBuffer);
+	state.bindFramebuffer(frameBuffer);
 
-	glGenTextures(1, &textureColorBuffer);
-	glBindTexture(GL_TEXTURE_2D, textureColorBuffer);
+	gl::genTextures(1, &textureColorBuffer);
+	state.bindTexture(GL_TEXTURE_2D, textureColorBuffer);
 
 	// Texture parameters.
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, magFilter);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+	gl::texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
+	gl::texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, magFilter);
+	gl::texParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+	gl::texParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
 
-	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, w, h, 0, GL_RGBA, format, NULL);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textureColorBuffer, 0);
+	gl::texImage2D(GL_TEXTURE_2D, 0, internalFormat, w, h, 0, GL_RGBA, format, NULL);
+	gl::framebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textureColorBuffer, 0);
 
-	glGenRenderbuffers(1, &rbo);
-	glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, w, h); // Use a single rbo for both depth and stencil buffer.
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rbo);
-	glBindRenderbuffer(GL_RENDERBUFFER, 0);
-	glBindFramebuffer(GL_FRAMEBUFFER, previousFrameBuffer);
-	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) { std::cerr << "FBO failed to initialize correctly." << std::endl; }
+	gl::genRenderbuffers(1, &rbo);
+	gl::bindRenderbuffer(GL_RENDERBUFFER, rbo);
+	gl::renderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, w, h); // Use a single rbo for both depth and stencil buffer.
+	gl::framebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rbo);
+	gl::bindRenderbuffer(GL_RENDERBUFFER, 0);
+	state.bindFramebuffer(previousFrameBuffer == GLState::UNKNOWN ? 0 : previousFrameBuffer);
+	if (gl::checkFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) { std::cerr << "FBO failed to initialize correctly." << std::endl; }
 }
 
 GLuint FBO::generateAttachment(GLuint w, GLuint h, GLboolean depth, GLboolean stencil, GLenum magFilter, GLenum minFilter, GLenum wrap)
@@ -46,32 +50,33 @@ GLuint FBO::generateAttachment(GLuint w, GLuint h, GLboolean depth, GLboolean st
 		attachment_type = GL_STENCIL_INDEX;
 	}
 	GLuint textureID;
-	glGenTextures(1, &textureID);
-	glBindTexture(GL_TEXTURE_2D, textureID);
+	gl::genTextures(1, &textureID);
+	GLState::getInstance().bindTexture(GL_TEXTURE_2D, textureID);
 	if (!depth && !stencil) {
-		glTexImage2D(GL_TEXTURE_2D, 0, attachment_type, w, h, 0, attachment_type, GL_UNSIGNED_BYTE, NULL);
+		gl::texImage2D(GL_TEXTURE_2D, 0, attachment_type, w, h, 0, attachment_type, GL_UNSIGNED_BYTE, NULL);
 	}
 	else {
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, w, h, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
+		gl::texImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, w, h, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
 	}
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, magFilter);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	gl::texParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+	gl::texParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+	gl::texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
+	gl::texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, magFilter);
+	GLState::getInstance().bindTexture(GL_TEXTURE_2D, 0);
 
 	return textureID;
 }
 
-void FBO::ActivateAsTexture(const int shaderProgram, const std::string glSamplerName, const int textureUnit)
+void FBO::ActivateAsTexture(const Material & material, const char * glSamplerName, const int textureUnit)
 {
-	glActiveTexture(GL_TEXTURE0 + textureUnit);
-	glBindTexture(GL_TEXTURE_2D, textureColorBuffer);
-	glUniform1i(glGetUniformLocation(shaderProgram, glSamplerName.c_str()), textureUnit);
+	GLState::getInstance().bindTexture(textureUnit, GL_TEXTURE_2D, textureColorBuffer);
+	material.setUniform(glSamplerName, textureUnit);
 }
 
 FBO::~FBO()
 {
-	glDeleteTextures(1, &textureColorBuffer);
-	glDeleteFramebuffers(1, &frameBuffer);
+	GLState::getInstance().forgetTexture(textureColorBuffer);
+	GLState::getInstance().forgetFramebuffer(frameBuffer);
+	gl::deleteTextures(1, &textureColorBuffer);
+	gl::deleteFramebuffers(1, &frameBuffer);
 }
\ No newline at end of file
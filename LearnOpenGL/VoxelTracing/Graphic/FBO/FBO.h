@@ -5,12 +5,14 @@
 
 #include <vector>
 
+class Material;
+
 // https://www.opengl.org/wiki/Framebuffer_Object_Examples
 /// <summary> An FBO. Manages important OpenGL calls. </summary>
 class FBO {
 public:
 	GLuint width, height, frameBuffer, textureColorBuffer, attachment, rbo;
-	void ActivateAsTexture(const int shaderProgram, const std::string glSamplerName, const int textureUnit = GL_TEXTURE0);
+	void ActivateAsTexture(const Material & material, const char * glSamplerName, const int textureUnit = GL_TEXTURE0);
 	FBO(
 		GLuint w, GLuint h, GLenum magFilter = GL_NEAREST, GLenum minFilter = GL_NEAREST,
 		GLint internalFormat = GL_RGB16F, GLint format = GL_FLOAT, GLint wrap = GL_REPEAT);
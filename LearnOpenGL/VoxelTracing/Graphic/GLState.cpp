@@ -0,0 +1,177 @@
+#include "GLState.h"
+
+#include <cassert>
+
+#include "Device/GLDevice.h"
+
+namespace {
+	const GLenum CACHED_CAPABILITIES[] = { GL_DEPTH_TEST, GL_CULL_FACE, GL_BLEND, GL_MULTISAMPLE };
+	const GLenum CACHED_TARGETS[] = { GL_TEXTURE_2D, GL_TEXTURE_3D };
+
+	template<size_t N> int indexOf(const GLenum (&values)[N], const GLenum value) {
+		for (size_t i = 0; i < N; ++i) if (values[i] == value) return int(i);
+		return -1;
+	}
+}
+
+GLState & GLState::getInstance()
+{
+	static GLState instance;
+	return instance;
+}
+
+// ----------------------
+// Bindings.
+// ----------------------
+void GLState::useProgram(const GLuint _program)
+{
+	if (change(program, _program)) gl::useProgram(_program);
+}
+
+void GLState::bindFramebuffer(const GLuint _framebuffer)
+{
+	if (change(framebuffer, _framebuffer)) gl::bindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+}
+
+void GLState::bindVertexArray(const GLuint _vertexArray)
+{
+	if (change(vertexArray, _vertexArray)) gl::bindVertexArray(_vertexArray);
+}
+
+void GLState::activate(const int unit)
+{
+	if (change(activeUnit, unit)) gl::activeTexture(GL_TEXTURE0 + unit);
+}
+
+void GLState::bindTexture(const int unit, const GLenum target, const GLuint texture)
+{
+	assert(unit >= 0 && unit < TEXTURE_UNITS);
+	const int slot = indexOf(CACHED_TARGETS, target);
+	if (slot >= 0 && textures[unit][slot] == texture) { ++redundantChanges; return; }
+	activate(unit);
+	if (slot >= 0) textures[unit][slot] = texture;
+	++stateChanges;
+	gl::bindTexture(target, texture);
+}
+
+void GLState::bindTexture(const GLenum target, const GLuint texture)
+{
+	// The active unit is unknown after invalidate, editing then uses unit 0.
+	bindTexture(activeUnit >= 0 ? activeUnit : 0, target, texture);
+}
+
+void GLState::bindImageTexture(const int unit, const GLuint texture, const GLint level, const GLboolean layered, const GLint layer, const GLenum access, const GLenum format)
+{
+	assert(unit >= 0 && unit < IMAGE_UNITS);
+	ImageUnit & image = images[unit];
+	if (image.texture == texture && image.level == level && image.layered == layered && image.layer == layer && image.access == access && image.format == format) {
+		++redundantChanges;
+		return;
+	}
+	image = { texture, level, layered, layer, access, format };
+	++stateChanges;
+	gl::bindImageTexture(unit, texture, level, layered, layer, access, format);
+}
+
+// ----------------------
+// Fixed function state.
+// ----------------------
+void GLState::setEnabled(const GLenum capability, const bool enable)
+{
+	const int slot = indexOf(CACHED_CAPABILITIES, capability);
+	if (slot >= 0 && !change(enabled[slot], int(enable))) return;
+	if (slot < 0) ++stateChanges;
+	if (enable) gl::enable(capability);
+	else gl::disable(capability);
+}
+
+void GLState::blendFunc(const GLenum source, const GLenum destination)
+{
+	if (blendSource == source && blendDestination == destination) { ++redundantChanges; return; }
+	blendSource = source;
+	blendDestination = destination;
+	++stateChanges;
+	gl::blendFunc(source, destination);
+}
+
+void GLState::cullFace(const GLenum face)
+{
+	if (change(cullFaceMode, face)) gl::cullFace(face);
+}
+
+void GLState::viewport(const GLint x, const GLint y, const GLsizei width, const GLsizei height)
+{
+	if (viewportBox[0] == x && viewportBox[1] == y && viewportBox[2] == width && viewportBox[3] == height) { ++redundantChanges; return; }
+	viewportBox[0] = x; viewportBox[1] = y; viewportBox[2] = width; viewportBox[3] = height;
+	++stateChanges;
+	gl::viewport(x, y, width, height);
+}
+
+void GLState::colorMask(const bool write)
+{
+	const GLboolean w = write ? GL_TRUE : GL_FALSE;
+	if (change(colorWrite, int(write))) gl::colorMask(w, w, w, w);
+}
+
+void GLState::depthMask(const bool write)
+{
+	if (change(depthWrite, int(write))) gl::depthMask(write ? GL_TRUE : GL_FALSE);
+}
+
+// ----------------------
+// Cache.
+// ----------------------
+void GLState::invalidate()
+{
+	program = framebuffer = vertexArray = UNKNOWN;
+	for (auto & unit : textures) for (GLuint & texture : unit) texture = UNKNOWN;
+	activeUnit = -1;
+	for (ImageUnit & image : images) image = { UNKNOWN, -1, GL_FALSE, -1, GL_NONE, GL_NONE };
+	for (int & capability : enabled) capability = -1;
+	blendSource = blendDestination = cullFaceMode = GL_NONE;
+	viewportBox[0] = viewportBox[1] = viewportBox[2] = viewportBox[3] = -1;
+	colorWrite = depthWrite = -1;
+}
+
+// Deleting a bound object binds 0 in its place (except for programs, which stay in use until replaced).
+void GLState::forgetProgram(const GLuint _program)
+{
+	if (program == _program) program = UNKNOWN;
+}
+
+void GLState::forgetFramebuffer(const GLuint _framebuffer)
+{
+	if (framebuffer == _framebuffer) framebuffer = 0;
+}
+
+void GLState::forgetVertexArray(const GLuint _vertexArray)
+{
+	if (vertexArray == _vertexArray) vertexArray = 0;
+}
+
+void GLState::forgetTexture(const GLuint texture)
+{
+	for (auto & unit : textures) for (GLuint & bound : unit) if (bound == texture) bound = 0;
+	for (ImageUnit & image : images) if (image.texture == texture) image.texture = UNKNOWN;
+}
+
+void GLState::forgetTweakBarState()
+{
+	program = vertexArray = UNKNOWN;
+	// AntTweakBar binds its font texture on the active unit (every unit may be the active one if it isn't known).
+	for (int unit = 0; unit < TEXTURE_UNITS; ++unit) if (activeUnit < 0 || unit == activeUnit) textures[unit][TEXTURE_2D] = UNKNOWN;
+	activeUnit = -1;
+	enabled[DEPTH_TEST] = enabled[CULL_FACE] = enabled[BLEND] = -1;
+	blendSource = blendDestination = GL_NONE;
+	viewportBox[0] = viewportBox[1] = viewportBox[2] = viewportBox[3] = -1;
+}
+
+// ----------------------
+// Statistics.
+// ----------------------
+void GLState::beginFrame()
+{
+	lastFrameStateChanges = stateChanges;
+	lastFrameRedundantChanges = redundantChanges;
+	stateChanges = redundantChanges = 0;
+}
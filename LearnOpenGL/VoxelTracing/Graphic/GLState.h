@@ -0,0 +1,92 @@
+#pragma once
+
+#define GLEW_STATIC
+#include <glew.h>
+
+/// <summary> A shadow copy of the GL state the renderer changes: program, textures per unit, image units, framebuffer,
+/// vertex array, enables, blend function, cull face, viewport and write masks. Every change goes through here, calls that
+/// would set a value the context already has are filtered, and nothing is ever read back from the driver.
+/// State starts unknown (the first set always reaches GL) and stays cached across frames. Code that changes state behind
+/// the cache's back must forget it: forgetTweakBarState after AntTweakBar draws, invalidate for anything else. Deleting an object that may be bound must go through the forget functions,
+/// since GL unbinds it and a new object may get the same name. </summary>
+class GLState {
+public:
+	static GLState & getInstance();
+
+	static const int TEXTURE_UNITS = 16;
+	static const int IMAGE_UNITS = 8;
+
+	// ----------------
+	// Bindings.
+	// ----------------
+	void useProgram(const GLuint program);
+	void bindFramebuffer(const GLuint framebuffer); // GL_FRAMEBUFFER (draw and read).
+	void bindVertexArray(const GLuint vertexArray);
+	/// <summary> Binds a texture to a unit. Only GL_TEXTURE_2D and GL_TEXTURE_3D are cached, other targets always reach GL. </summary>
+	void bindTexture(const int unit, const GLenum target, const GLuint texture);
+	/// <summary> Binds a texture to the active unit, to create or edit it. </summary>
+	void bindTexture(const GLenum target, const GLuint texture);
+	void bindImageTexture(const int unit, const GLuint texture, const GLint level, const GLboolean layered, const GLint layer, const GLenum access, const GLenum format);
+
+	// ----------------
+	// Fixed function state.
+	// ----------------
+	/// <summary> glEnable / glDisable. Only GL_DEPTH_TEST, GL_CULL_FACE, GL_BLEND and GL_MULTISAMPLE are cached. </summary>
+	void setEnabled(const GLenum capability, const bool enabled);
+	void blendFunc(const GLenum source, const GLenum destination);
+	void cullFace(const GLenum face);
+	void viewport(const GLint x, const GLint y, const GLsizei width, const GLsizei height);
+	void colorMask(const bool write); // All four channels.
+	void depthMask(const bool write);
+
+	// ----------------
+	// Cache.
+	// ----------------
+	/// <summary> Forgets every value, the next set of each reaches GL. </summary>
+	void invalidate();
+	void forgetProgram(const GLuint program);
+	void forgetFramebuffer(const GLuint framebuffer);
+	void forgetVertexArray(const GLuint vertexArray);
+	void forgetTexture(const GLuint texture);
+	/// <summary> Forgets the state TwDraw changes: program, vertex array, active unit and its 2D texture, the depth test, cull face
+	/// and blend enables, blend function and viewport. Framebuffers, image units and the other texture units stay cached. </summary>
+	void forgetTweakBarState();
+
+	/// <summary> Returns the bound framebuffer, or UNKNOWN. </summary>
+	GLuint getFramebuffer() const { return framebuffer; }
+	static const GLuint UNKNOWN = ~GLuint(0);
+
+	// ----------------
+	// Statistics.
+	// ----------------
+	/// <summary> Starts counting the state changes of a new frame. </summary>
+	void beginFrame();
+	unsigned int stateChanges = 0, redundantChanges = 0; // This frame: calls that reached GL, calls that were filtered.
+	unsigned int lastFrameStateChanges = 0, lastFrameRedundantChanges = 0;
+private:
+	GLState() { invalidate(); }
+	GLState(GLState const &) = delete;
+	void operator=(GLState const &) = delete;
+
+	enum Capability { DEPTH_TEST, CULL_FACE, BLEND, MULTISAMPLE, CAPABILITIES };
+	enum Target { TEXTURE_2D, TEXTURE_3D, TARGETS };
+	struct ImageUnit { GLuint texture; GLint level; GLboolean layered; GLint layer; GLenum access, format; };
+
+	GLuint program, framebuffer, vertexArray;
+	GLuint textures[TEXTURE_UNITS][TARGETS];
+	int activeUnit;
+	ImageUnit images[IMAGE_UNITS];
+	int enabled[CAPABILITIES]; // -1 is unknown.
+	GLenum blendSource, blendDestination, cullFaceMode;
+	GLint viewportBox[4];
+	int colorWrite, depthWrite; // -1 is unknown.
+
+	/// <summary> Counts a set, returns true if it changes the cached value (and updates it). </summary>
+	template<typename T> bool change(T & cached, const T & value) {
+		if (cached == value) { ++redundantChanges; return false; }
+		cached = value;
+		++stateChanges;
+		return true;
+	}
+	void activate(const int unit);
+};
@@ -4,6 +4,9 @@
 #include <queue>
 #include <algorithm>
 #include <vector>
+#include <cfloat>
+#include <cmath>
+#include <iostream>
 
 // External.
 #include <glm.hpp>
@@ -21,22 +24,77 @@
 #include "../Utility/ObjLoader.h"
 #include "../Shape/Shape.h"
 #include "../Application.h"
+#include "Voxel/VoxelBrickTracker.h"
+#include "../Utility/BlueNoise.h"
+#include "Voxel/VoxelOccupancy.h"
+#include "ShaderBlocks.h"
+#include "Device/GLDevice.h"
+
+namespace {
+	/// <summary> Creates a buffer with immutable storage that only the GPU writes to (by copies). </summary>
+	GLuint createCopyDestination(const size_t size) {
+		GLuint buffer;
+		gl::genBuffers(1, &buffer);
+		gl::bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		gl::bufferStorage(GL_COPY_WRITE_BUFFER, size, nullptr, 0);
+		gl::bindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		return buffer;
+	}
+
+	/// <summary> Returns true if two material settings voxelize to the same colors. </summary>
+	bool sameVoxelizedMaterial(const MaterialSetting & a, const MaterialSetting & b) {
+		return a.diffuseColor == b.diffuseColor && a.specularColor == b.specularColor &&
+			a.diffuseReflectivity == b.diffuseReflectivity && a.specularReflectivity == b.specularReflectivity &&
+			a.emissivity == b.emissivity && a.specularDiffusion == b.specularDiffusion &&
+			a.transparency == b.transparency && a.refractiveIndex == b.refractiveIndex;
+	}
+
+	/// <summary> Transforms a local bounding box and returns the world space bounding box around it. </summary>
+	void transformBounds(const glm::mat4 & transform, const glm::vec3 & localMin, const glm::vec3 & localMax, glm::vec3 & worldMin, glm::vec3 & worldMax) {
+		worldMin = glm::vec3(FLT_MAX);
+		worldMax = glm::vec3(-FLT_MAX);
+		for (int i = 0; i < 8; ++i) {
+			const glm::vec3 corner(i & 1 ? localMax.x : localMin.x, i & 2 ? localMax.y : localMin.y, i & 4 ? localMax.z : localMin.z);
+			const glm::vec3 p = glm::vec3(transform * glm::vec4(corner, 1.0f));
+			worldMin = glm::min(worldMin, p);
+			worldMax = glm::max(worldMax, p);
+		}
+	}
+}
 
 // ----------------------
 // Rendering pipeline.
 // ----------------------
 void Graphics::init(unsigned int viewportWidth, unsigned int viewportHeight)
 {
-	glHint(GL_PERSPECTIVE_CORRECTION_HINT, GL_NICEST);
-	glEnable(GL_MULTISAMPLE); // MSAA. Set MSAA level using GLFW (see Application.cpp).
+	gl::hint(GL_PERSPECTIVE_CORRECTION_HINT, GL_NICEST);
+	glState.setEnabled(GL_MULTISAMPLE, true); // MSAA. Set MSAA level using GLFW (see Application.cpp).
 	voxelConeTracingMaterial = MaterialStore::getInstance().findMaterialWithName("voxel_cone_tracing");
+	assert(voxelConeTracingMaterial != nullptr);
 	voxelCamera = OrthographicCamera(viewportWidth / float(viewportHeight));
+	initConeTables();
+	initShaderBlocks();
 	initVoxelization();
+	initDistanceField();
+	initOccupancy();
+	initIrradianceProbes();
+	initLightVisibility();
 	initVoxelVisualization(viewportWidth, viewportHeight);
+	initReducedIndirectDiffuse();
+	initSpecularReflections();
 }
 
 void Graphics::render(Scene & renderingScene, unsigned int viewportWidth, unsigned int viewportHeight, RenderingMode renderingMode)
 {
+	glState.beginFrame();
+
+	// Transforms are updated once (and only if they changed), every pass records the same matrices.
+	updateVersions(renderingScene);
+
+	// Shared blocks, read by every pass of the frame.
+	streamBuffer->beginFrame();
+	uploadShaderBlocks(renderingScene, viewportWidth, viewportHeight);
+
 	// Voxelize.
 	bool voxelizeNow = voxelizationQueued || (automaticallyVoxelize && voxelizationSparsity > 0 && ++ticksSinceLastVoxelization >= voxelizationSparsity);
 	if (voxelizeNow) {
@@ -54,6 +112,7 @@ void Graphics::render(Scene & renderingScene, unsigned int viewportWidth, unsign
 		renderScene(renderingScene, viewportWidth, viewportHeight);
 		break;
 	}
+	streamBuffer->endFrame();
 }
 
 // ----------------------
@@ -61,76 +120,620 @@ void Graphics::render(Scene & renderingScene, unsigned int viewportWidth, unsign
 // ----------------------
 void Graphics::renderScene(Scene & renderingScene, unsigned int viewportWidth, unsigned int viewportHeight)
 {
+	// Round-robin probe updates after the voxels changed.
+	if (irradianceProbesEnabled && irradianceProbesPending > 0) updateIrradianceProbes();
+
+	// Indirect diffuse light at a reduced resolution (or accumulated over time, or denoised, or from the probes) is traced first and composited last.
+	const bool reducedIndirectDiffuse = indirectDiffuseLight && (indirectDiffuseResolution > 1 || temporalIndirectDiffuse ||
+		indirectDiffuseRingCones < ConeSets::DIFFUSE_RING_CONES || denoiserIterations > 0 || irradianceProbesEnabled);
+	if (reducedIndirectDiffuse) renderReducedIndirectDiffuse(renderingScene, viewportWidth, viewportHeight);
+	else indirectHistoryValid = false;
+
+	// Screen space reflections march against the forward pass, so indirect specular light is traced after it and composited last.
+	const bool specularReflections = indirectSpecularLight && screenSpaceReflections;
+	if (specularReflections && !reducedIndirectDiffuse) {
+		updateReducedIndirectTargets(viewportWidth, viewportHeight);
+		renderGuides(renderingScene);
+	}
+	const bool composited = reducedIndirectDiffuse || specularReflections;
+
 	// Fetch references.
 	auto & camera = *renderingScene.renderingCamera;
-	const Material * material = voxelConeTracingMaterial;
-	const GLuint program = material->program;
+	const Material & material = *voxelConeTracingMaterial;
 
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	glUseProgram(program);
+	glState.bindFramebuffer(composited ? sceneFBO->frameBuffer : 0);
+	glState.useProgram(material.program);
 
 	// GL Settings.
-	glViewport(0, 0, viewportWidth, viewportHeight);
-	glClearColor(0.0f, 0.0f, 0.0f, 1.0);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_CULL_FACE);
-	glCullFace(GL_BACK);
-	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glState.viewport(0, 0, viewportWidth, viewportHeight);
+	gl::clearColor(0.0f, 0.0f, 0.0f, 1.0);
+	gl::clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glState.setEnabled(GL_DEPTH_TEST, true);
+	glState.setEnabled(GL_CULL_FACE, true);
+	glState.cullFace(GL_BACK);
+	glState.colorMask(true);
+	glState.setEnabled(GL_BLEND, true);
+	glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	// Upload uniforms.
-	uploadCamera(camera, program);
-	uploadGlobalConstants(program, viewportWidth, viewportHeight);
-	uploadLighting(renderingScene, program);
-	uploadRenderingSettings(program);
+	uploadCamera(camera, material);
+	uploadGlobalConstants(material, viewportWidth, viewportHeight);
+	uploadLighting(renderingScene, material);
+	uploadRenderingSettings(material);
+	if (reducedIndirectDiffuse) material.setUniform("settings.indirectDiffuseLight", false);
+	if (specularReflections) material.setUniform("settings.indirectSpecularLight", false);
+	activateEmptySpaceSkipping(material, 3);
+	activateLightVisibility(material, 4);
 
 	// Render.
-	renderQueue(renderingScene.renderers, material->program, true);
+	renderQueue(FORWARD_PASS, renderingScene, material, true);
+	if (specularReflections) renderSpecularReflections(renderingScene, viewportWidth, viewportHeight);
+	if (composited) compositeIndirectLight(viewportWidth, viewportHeight, reducedIndirectDiffuse, specularReflections);
 }
 
-void Graphics::uploadLighting(Scene & renderingScene, const GLuint program) const
+void Graphics::uploadLighting(Scene & renderingScene, const Material & material)
 {
+	if (material.hasBlock("Lights") && material.hasBlock("Frame")) return; // Uploaded once per frame, see uploadShaderBlocks.
+	LegacyUniforms & uploaded = legacyUniforms[material.program];
+	if (uploaded.lightsGeneration == lightsGeneration) return;
+	uploaded.lightsGeneration = lightsGeneration;
+
 	// Point lights.
-	for (unsigned int i = 0; i < renderingScene.pointLights.size(); ++i) renderingScene.pointLights[i].Upload(program, i);
+	for (unsigned int i = 0; i < renderingScene.pointLights.size(); ++i) {
+		const GLint position = material.getUniformLocation("pointLights[].position", i), color = material.getUniformLocation("pointLights[].color", i);
+		renderingScene.pointLights[i].Upload(material.program, position, color);
+	}
 
 	// Number of point lights.
-	glUniform1i(glGetUniformLocation(program, NUMBER_OF_LIGHTS_NAME), renderingScene.pointLights.size());
+	material.setUniform(NUMBER_OF_LIGHTS_NAME, int(renderingScene.pointLights.size()));
 }
 
-void Graphics::uploadRenderingSettings(const GLuint glProgram) const
+void Graphics::uploadRenderingSettings(const Material & material) const
 {
-	glUniform1i(glGetUniformLocation(glProgram, "settings.shadows"), shadows);
-	glUniform1i(glGetUniformLocation(glProgram, "settings.indirectDiffuseLight"), indirectDiffuseLight);
-	glUniform1i(glGetUniformLocation(glProgram, "settings.indirectSpecularLight"), indirectSpecularLight);
-	glUniform1i(glGetUniformLocation(glProgram, "settings.directLight"), directLight);
+	material.setUniform("settings.shadows", shadows);
+	material.setUniform("settings.indirectDiffuseLight", indirectDiffuseLight);
+	material.setUniform("settings.indirectSpecularLight", indirectSpecularLight);
+	material.setUniform("settings.directLight", directLight);
 }
 
-void Graphics::uploadGlobalConstants(const GLuint program, unsigned int viewportWidth, unsigned int viewportHeight) const
+
+void Graphics::uploadGlobalConstants(const Material & material, unsigned int viewportWidth, unsigned int viewportHeight) const
 {
-	glUniform1i(glGetUniformLocation(program, APP_STATE_NAME), Application::getInstance().state);
+	if (material.hasBlock("Frame")) return;
+	material.setUniform(APP_STATE_NAME, Application::getInstance().state);
 	glm::vec2 screenSize(viewportWidth, viewportHeight);
 }
 
-void Graphics::uploadCamera(Camera & camera, const GLuint program)
+void Graphics::uploadCamera(Camera & camera, const Material & material)
 {
-	glUniformMatrix4fv(glGetUniformLocation(program, VIEW_MATRIX_NAME), 1, GL_FALSE, glm::value_ptr(camera.viewMatrix));
-	glUniformMatrix4fv(glGetUniformLocation(program, PROJECTION_MATRIX_NAME), 1, GL_FALSE, glm::value_ptr(camera.getProjectionMatrix()));
-	glUniform3fv(glGetUniformLocation(program, CAMERA_POSITION_NAME), 1, glm::value_ptr(camera.position));
+	if (material.hasBlock("Frame")) return;
+	material.setUniform(VIEW_MATRIX_NAME, camera.viewMatrix);
+	material.setUniform(PROJECTION_MATRIX_NAME, camera.getProjectionMatrix());
+	material.setUniform(CAMERA_POSITION_NAME, camera.position);
 }
 
-void Graphics::renderQueue(RenderingQueue renderingQueue, const GLuint program, bool uploadMaterialSettings) const
+void Graphics::renderQueue(RenderPass pass, Scene & renderingScene, const Material & material, bool uploadMaterialSettings)
 {
-	for (unsigned int i = 0; i < renderingQueue.size(); ++i) if (renderingQueue[i]->enabled)
-		renderingQueue[i]->transform.updateTransformMatrix();
+	// Only view dependent passes sort by depth.
+	const Camera * camera = pass == VOXELIZATION_PASS ? nullptr : renderingScene.renderingCamera;
+	const RenderCommandBuffer & commands = recordPass(pass, renderingScene, material, camera);
+	RenderingQueue renderingQueue = renderingScene.renderers;
+
+	// Programs with the 'Materials' block only need the index of the draw's material (the queue is the scene's renderers),
+	// programs with the 'Draw' block get it and the model matrix in a range of the stream buffer.
+	const bool materialBlock = uploadMaterialSettings && material.hasBlock("Materials");
+	const bool drawBlock = material.hasBlock("Draw");
+	const GLint materialIndex = material.getUniformLocation("materialIndex");
+	LegacyUniforms & uploaded = legacyUniforms[material.program];
+	unsigned int uploadedMaterial = uploaded.materialsGeneration == materialsGeneration ? uploaded.materialKey : ~0u;
+	for (const RenderCommandBuffer::Packet & packet : commands.getPackets()) {
+		const unsigned int i = packet.index;
+		MeshRenderer * renderer = renderingQueue[i];
+		if (drawBlock) {
+			ShaderBlocks::Draw draw = {};
+			draw.M = renderer->transform.getTransformMatrix();
+			draw.materialIndex = int(i);
+			const RingBuffer::Allocation range = streamBuffer->write(draw, uniformBlockAlignment);
+			gl::bindBufferRange(GL_UNIFORM_BUFFER, ShaderBlocks::DRAW_BINDING, range.buffer, range.offset, range.size);
+		}
+		else if (materialBlock) {
+			material.setUniform(materialIndex, int(i));
+		}
+		if (!materialBlock && uploadMaterialSettings && materialKeys[i] != uploadedMaterial) {
+			const MaterialSetting setting = renderer->materialSetting ? *renderer->materialSetting : MaterialSetting();
+			setting.Upload(material.program, material.getMaterialSettingLocations());
+			uploadedMaterial = materialKeys[i];
+		}
+		renderer->render(material, streamBuffer);
+	}
+	if (!materialBlock && uploadMaterialSettings) {
+		uploaded.materialsGeneration = materialsGeneration;
+		uploaded.materialKey = uploadedMaterial;
+	}
+}
+
+const RenderCommandBuffer & Graphics::recordPass(RenderPass pass, Scene & renderingScene, const Material & material, const Camera * camera)
+{
+	RenderingQueue renderingQueue = renderingScene.renderers;
+
+	// FNV-1a over everything the keys depend on.
+	uint64_t signature = 14695981039346656037ull;
+	const auto hash = [&signature](const void * data, size_t size) {
+		for (size_t i = 0; i < size; ++i) signature = (signature ^ static_cast<const unsigned char *>(data)[i]) * 1099511628211ull;
+	};
+	hash(&material.program, sizeof(material.program));
+	if (camera) hash(&camera->viewMatrix, sizeof(camera->viewMatrix));
+	for (unsigned int i = 0; i < renderingQueue.size(); ++i) {
+		const MeshRenderer * renderer = renderingQueue[i];
+		const bool translucent = renderer->materialSetting && renderer->materialSetting->transparency > 0.0f;
+		const unsigned int draw[] = { i, unsigned(renderer->enabled), materialKeys[i], meshKeys[i], unsigned(translucent) };
+		hash(draw, sizeof(draw));
+		if (camera && renderer->enabled) hash(&renderingQueue[i]->transform.getTransformMatrix()[3], sizeof(glm::vec4));
+	}
+
+	RecordedPass & recorded = recordedPasses[pass];
+	if (recorded.recorded && recorded.signature == signature) return recorded.commands;
 
+	// Draws with the same material and mesh end up next to each other, opaque ones front to back, translucent ones back to front.
+	RenderCommandBuffer & commands = recorded.commands;
+	commands.clear();
 	for (unsigned int i = 0; i < renderingQueue.size(); ++i) if (renderingQueue[i]->enabled) {
-		if (uploadMaterialSettings && renderingQueue[i]->materialSetting != nullptr) {
-			renderingQueue[i]->materialSetting->Upload(program, false);
+		MeshRenderer * renderer = renderingQueue[i];
+		const float viewDepth = camera ? -(camera->viewMatrix * renderer->transform.getTransformMatrix()[3]).z : 0.0f;
+		const bool translucent = renderer->materialSetting && renderer->materialSetting->transparency > 0.0f;
+		commands.record(translucent ?
+			RenderCommandBuffer::translucentKey(material.program, materialKeys[i], meshKeys[i], viewDepth) :
+			RenderCommandBuffer::opaqueKey(material.program, materialKeys[i], meshKeys[i], viewDepth), i);
+	}
+	commands.sort();
+	recorded.signature = signature;
+	recorded.recorded = true;
+	return commands;
+}
+
+// ----------------------
+// Change tracking.
+// ----------------------
+void Graphics::updateVersions(Scene & renderingScene)
+{
+	const auto & renderers = renderingScene.renderers;
+	bool materialsChanged = trackedRenderers.size() != renderers.size();
+	trackedRenderers.resize(renderers.size());
+	for (size_t i = 0; i < renderers.size(); ++i) {
+		MeshRenderer * renderer = renderers[i];
+		renderer->transform.updateTransformMatrixIfChanged();
+		if (renderer->materialSetting && renderer->materialSetting->updateVersion()) materialsChanged = true;
+		TrackedRenderer & tracked = trackedRenderers[i];
+		if (tracked.renderer != renderer || tracked.materialSetting != renderer->materialSetting || tracked.mesh != renderer->mesh) {
+			tracked = { renderer, renderer->materialSetting, renderer->mesh };
+			materialsChanged = true;
+		}
+	}
+	if (materialsChanged) ++materialsGeneration;
+
+	bool lightsChanged = trackedLightCount != renderingScene.pointLights.size();
+	trackedLightCount = renderingScene.pointLights.size();
+	for (PointLight & light : renderingScene.pointLights) if (light.updateVersion()) lightsChanged = true;
+	if (lightsChanged) ++lightsGeneration;
+}
+
+// ----------------------
+// Shader blocks.
+// ----------------------
+void Graphics::initShaderBlocks()
+{
+	GLint alignment;
+	gl::getIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	uniformBlockAlignment = size_t(alignment);
+	gl::getIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	storageBlockAlignment = size_t(alignment);
+	streamBuffer = new RingBuffer(STREAM_REGION_SIZE);
+	lightBuffer = createCopyDestination(sizeof(ShaderBlocks::Lights));
+}
+
+void Graphics::copyToBuffer(const GLuint buffer, const void * data, const size_t size)
+{
+	const RingBuffer::Allocation range = streamBuffer->write(data, size, 4);
+	gl::bindBuffer(GL_COPY_READ_BUFFER, range.buffer);
+	gl::bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	gl::copyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, range.offset, 0, range.size);
+	gl::bindBuffer(GL_COPY_READ_BUFFER, 0);
+	gl::bindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void Graphics::uploadShaderBlocks(Scene & renderingScene, unsigned int viewportWidth, unsigned int viewportHeight)
+{
+	// Frame.
+	Camera & camera = *renderingScene.renderingCamera;
+	const auto & lights = renderingScene.pointLights;
+	ShaderBlocks::Frame frame = {};
+	frame.V = camera.viewMatrix;
+	frame.P = camera.getProjectionMatrix();
+	frame.cameraPosition = camera.position;
+	frame.state = Application::getInstance().state;
+	frame.screenSize = glm::ivec2(viewportWidth, viewportHeight);
+	frame.numberOfLights = int(std::min<size_t>(lights.size(), ShaderBlocks::MAX_LIGHTS));
+	RingBuffer::Allocation range = streamBuffer->write(frame, uniformBlockAlignment);
+	gl::bindBufferRange(GL_UNIFORM_BUFFER, ShaderBlocks::FRAME_BINDING, range.buffer, range.offset, range.size);
+
+	// Lights, rewritten when a light changed.
+	if (uploadedLightsGeneration != lightsGeneration) {
+		ShaderBlocks::Lights lightBlock = {};
+		for (int i = 0; i < frame.numberOfLights; ++i) lightBlock.pointLights[i] = ShaderBlocks::light(lights[i]);
+		copyToBuffer(lightBuffer, &lightBlock, sizeof(lightBlock));
+		gl::bindBufferBase(GL_UNIFORM_BUFFER, ShaderBlocks::LIGHTS_BINDING, lightBuffer);
+		uploadedLightsGeneration = lightsGeneration;
+	}
+
+	// Everything below depends on the materials only.
+	if (uploadedMaterialsGeneration == materialsGeneration) return;
+	uploadedMaterialsGeneration = materialsGeneration;
+
+	// Materials, one per renderer (renderers without a setting use the default one).
+	const auto & renderers = renderingScene.renderers;
+	shaderBlockMaterials.resize(std::max<size_t>(renderers.size(), 1));
+	for (size_t i = 0; i < renderers.size(); ++i)
+		shaderBlockMaterials[i] = ShaderBlocks::material(renderers[i]->materialSetting ? *renderers[i]->materialSetting : MaterialSetting());
+	if (shaderBlockMaterials.size() > materialBufferCapacity) {
+		// Draws already submitted keep reading the old buffer, GL frees it once they are done.
+		if (materialBuffer) gl::deleteBuffers(1, &materialBuffer);
+		materialBufferCapacity = std::max(shaderBlockMaterials.size(), 2 * materialBufferCapacity);
+		materialBuffer = createCopyDestination(materialBufferCapacity * sizeof(ShaderBlocks::Material));
+	}
+	copyToBuffer(materialBuffer, shaderBlockMaterials.data(), shaderBlockMaterials.size() * sizeof(ShaderBlocks::Material));
+	gl::bindBufferBase(GL_SHADER_STORAGE_BUFFER, ShaderBlocks::MATERIALS_BINDING, materialBuffer);
+
+	// Sort keys of the render commands: equal materials (every setting, see sameVoxelizedMaterial) and meshes share a key.
+	materialKeys.resize(renderers.size());
+	meshKeys.resize(renderers.size());
+	std::vector<unsigned int> uniqueMaterials;
+	std::unordered_map<const Mesh *, unsigned int> uniqueMeshes;
+	const MaterialSetting defaultSetting;
+	for (unsigned int i = 0; i < renderers.size(); ++i) {
+		const MaterialSetting & setting = renderers[i]->materialSetting ? *renderers[i]->materialSetting : defaultSetting;
+		materialKeys[i] = i;
+		for (unsigned int j : uniqueMaterials) if (sameVoxelizedMaterial(setting, renderers[j]->materialSetting ? *renderers[j]->materialSetting : defaultSetting)) {
+			materialKeys[i] = j;
+			break;
+		}
+		if (materialKeys[i] == i) uniqueMaterials.push_back(i);
+		meshKeys[i] = uniqueMeshes.emplace(renderers[i]->mesh, i).first->second;
+	}
+}
+
+// ----------------------
+// Reduced resolution indirect diffuse light.
+// ----------------------
+void Graphics::initReducedIndirectDiffuse()
+{
+	geometryBufferMaterial = MaterialStore::getInstance().findMaterialWithName("geometry_buffer");
+	indirectUpsampleMaterial = MaterialStore::getInstance().findMaterialWithName("indirect_upsample");
+	indirectDenoiseMaterial = MaterialStore::getInstance().findMaterialWithName("indirect_denoise");
+
+	assert(geometryBufferMaterial != nullptr);
+	assert(indirectUpsampleMaterial != nullptr);
+	assert(indirectDenoiseMaterial != nullptr);
+
+	// The 4 permutations compile while the scene loads (the current one first), so a toggle doesn't compile in renderScene.
+	findIndirectDiffuseMaterial();
+	for (unsigned int features = 0; features < INDIRECT_DIFFUSE_PERMUTATIONS; ++features)
+		MaterialStore::getInstance().findPermutation("indirect_diffuse", features);
+
+	// Blue noise for per-pixel cone rotations.
+	const int blueNoiseSize = 32;
+	const std::vector<float> blueNoise = BlueNoise::generate(blueNoiseSize);
+	gl::genTextures(1, &blueNoiseTexture);
+	glState.bindTexture(GL_TEXTURE_2D, blueNoiseTexture);
+	gl::texImage2D(GL_TEXTURE_2D, 0, GL_R16F, blueNoiseSize, blueNoiseSize, 0, GL_RED, GL_FLOAT, blueNoise.data());
+	gl::texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	gl::texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	gl::texParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	gl::texParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glState.bindTexture(GL_TEXTURE_2D, 0);
+}
+
+Material * Graphics::findIndirectDiffuseMaterial() const
+{
+	unsigned int features = 0;
+	if (temporalIndirectDiffuse) features |= INDIRECT_DIFFUSE_TEMPORAL;
+	if (irradianceProbesEnabled) features |= INDIRECT_DIFFUSE_IRRADIANCE_PROBES;
+	return MaterialStore::getInstance().findPermutation("indirect_diffuse", features);
+}
+
+void Graphics::updateReducedIndirectTargets(unsigned int viewportWidth, unsigned int viewportHeight)
+{
+	if (indirectTargetFactor == indirectDiffuseResolution && indirectTargetWidth == viewportWidth && indirectTargetHeight == viewportHeight) return;
+	deleteReducedIndirectTargets();
+
+	const int factor = indirectDiffuseResolution;
+	const GLuint lowWidth = std::max(1u, (viewportWidth + factor - 1) / factor), lowHeight = std::max(1u, (viewportHeight + factor - 1) / factor);
+	sceneFBO = new FBO(viewportWidth, viewportHeight, GL_NEAREST, GL_NEAREST, GL_RGB16F, GL_FLOAT, GL_CLAMP_TO_EDGE);
+	guideFBO = new FBO(viewportWidth, viewportHeight, GL_NEAREST, GL_NEAREST, GL_RGBA16F, GL_FLOAT, GL_CLAMP_TO_EDGE);
+	lowResolutionGuideFBO = new FBO(lowWidth, lowHeight, GL_NEAREST, GL_NEAREST, GL_RGBA16F, GL_FLOAT, GL_CLAMP_TO_EDGE);
+	indirectDiffuseFBO = new FBO(lowWidth, lowHeight, GL_NEAREST, GL_NEAREST, GL_RGBA16F, GL_FLOAT, GL_CLAMP_TO_EDGE);
+	previousLowResolutionGuideFBO = new FBO(lowWidth, lowHeight, GL_NEAREST, GL_NEAREST, GL_RGBA16F, GL_FLOAT, GL_CLAMP_TO_EDGE);
+	indirectHistoryFBO = new FBO(lowWidth, lowHeight, GL_NEAREST, GL_NEAREST, GL_RGBA16F, GL_FLOAT, GL_CLAMP_TO_EDGE);
+	for (FBO *& fbo : denoiseFBOs) fbo = new FBO(lowWidth, lowHeight, GL_NEAREST, GL_NEAREST, GL_RGBA16F, GL_FLOAT, GL_CLAMP_TO_EDGE);
+	indirectHistoryValid = false;
+
+	indirectTargetFactor = factor;
+	indirectTargetWidth = viewportWidth;
+	indirectTargetHeight = viewportHeight;
+}
+
+void Graphics::renderReducedIndirectDiffuse(Scene & renderingScene, unsigned int viewportWidth, unsigned int viewportHeight)
+{
+	updateReducedIndirectTargets(viewportWidth, viewportHeight);
+	auto & camera = *renderingScene.renderingCamera;
+
+	// Last frame's guide and indirect light become the history.
+	std::swap(lowResolutionGuideFBO, previousLowResolutionGuideFBO);
+	std::swap(indirectDiffuseFBO, indirectHistoryFBO);
+
+	// Guides: normals and view depth at full and reduced resolution.
+	renderGuides(renderingScene);
+
+	// Indirect diffuse light, one cone set per reduced resolution pixel.
+	const Material & material = *findIndirectDiffuseMaterial();
+	glState.useProgram(material.program);
+	uploadCamera(camera, material);
+	voxelTexture->Activate(material, "texture3D", 0);
+
+	// Ring cones rotated per pixel with blue noise, and in temporal mode per frame with a golden ratio sequence.
+	const float frameOffset = temporalIndirectDiffuse ? float(std::fmod(temporalFrame * 0.6180339887, 1.0)) : 0.0f;
+	material.setUniform("ringCones", std::min(std::max(indirectDiffuseRingCones, 1), ConeSets::DIFFUSE_RING_CONES));
+	glState.bindTexture(3, GL_TEXTURE_2D, blueNoiseTexture);
+	material.setUniform("blueNoise", 3);
+	material.setUniform("frameOffset", frameOffset);
+	material.setUniform("historyValid", temporalIndirectDiffuse && indirectHistoryValid);
+	material.setUniform("previousViewProjection", camera.previousViewProjectionMatrix);
+	indirectHistoryFBO->ActivateAsTexture(material, "history", 1);
+	previousLowResolutionGuideFBO->ActivateAsTexture(material, "previousGuide", 2);
+	activateIrradianceProbes(material, 4);
+
+	glState.bindFramebuffer(indirectDiffuseFBO->frameBuffer);
+	glState.viewport(0, 0, indirectDiffuseFBO->width, indirectDiffuseFBO->height);
+	gl::clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	renderQueue(INDIRECT_DIFFUSE_PASS, renderingScene, material, true);
+
+	camera.previousViewProjectionMatrix = camera.getViewProjectionMatrix();
+	indirectHistoryValid = temporalIndirectDiffuse;
+	++temporalFrame;
+
+	denoiseIndirectDiffuse();
+}
+
+void Graphics::denoiseIndirectDiffuse()
+{
+	// The history keeps the noisy light, the filter ping-pongs between its own targets.
+	filteredIndirectDiffuseFBO = indirectDiffuseFBO;
+	if (denoiserIterations <= 0) return;
+
+	const Material & material = *indirectDenoiseMaterial;
+	glState.useProgram(material.program);
+	glState.setEnabled(GL_DEPTH_TEST, false);
+	glState.setEnabled(GL_BLEND, false);
+	glState.viewport(0, 0, indirectDiffuseFBO->width, indirectDiffuseFBO->height);
+	lowResolutionGuideFBO->ActivateAsTexture(material, "guide", 1);
+	for (int i = 0; i < denoiserIterations; ++i) {
+		FBO * destination = denoiseFBOs[i % 2];
+		filteredIndirectDiffuseFBO->ActivateAsTexture(material, "source", 0);
+		material.setUniform("stepSize", 1 << i);
+		glState.bindFramebuffer(destination->frameBuffer);
+		quadMeshRenderer->render(material);
+		filteredIndirectDiffuseFBO = destination;
+	}
+}
+
+void Graphics::renderGuides(Scene & renderingScene)
+{
+	// Settings.
+	glState.setEnabled(GL_DEPTH_TEST, true);
+	glState.setEnabled(GL_CULL_FACE, true);
+	glState.cullFace(GL_BACK);
+	glState.setEnabled(GL_BLEND, false);
+	glState.colorMask(true);
+	gl::clearColor(0.0f, 0.0f, 0.0f, 0.0f); // Zero depth marks the background.
+
+	const Material & material = *geometryBufferMaterial;
+	glState.useProgram(material.program);
+	uploadCamera(*renderingScene.renderingCamera, material);
+	for (FBO * fbo : { guideFBO, lowResolutionGuideFBO }) {
+		glState.bindFramebuffer(fbo->frameBuffer);
+		glState.viewport(0, 0, fbo->width, fbo->height);
+		gl::clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		renderQueue(GUIDE_PASS, renderingScene, material);
+	}
+}
+
+void Graphics::compositeIndirectLight(unsigned int viewportWidth, unsigned int viewportHeight, bool reducedIndirectDiffuse, bool specularReflections)
+{
+	const Material & material = *indirectUpsampleMaterial;
+	glState.useProgram(material.program);
+	glState.bindFramebuffer(0);
+
+	// Settings.
+	glState.viewport(0, 0, viewportWidth, viewportHeight);
+	glState.setEnabled(GL_DEPTH_TEST, false);
+	glState.setEnabled(GL_BLEND, false);
+	glState.setEnabled(GL_CULL_FACE, true);
+
+	// Textures.
+	sceneFBO->ActivateAsTexture(material, "sceneColor", 0);
+	guideFBO->ActivateAsTexture(material, "guide", 1);
+	lowResolutionGuideFBO->ActivateAsTexture(material, "lowResolutionGuide", 2);
+	if (reducedIndirectDiffuse) filteredIndirectDiffuseFBO->ActivateAsTexture(material, "indirectDiffuse", 3);
+	if (specularReflections) specularFBO->ActivateAsTexture(material, "specular", 4);
+	material.setUniform("reducedIndirectDiffuse", reducedIndirectDiffuse);
+	material.setUniform("specularReflections", specularReflections);
+	material.setUniform("resolutionFactor", indirectTargetFactor);
+	material.setUniform("visualizeTemporalReuse", temporalIndirectDiffuse && visualizeTemporalReuse);
+
+	// Render.
+	quadMeshRenderer->render(material);
+}
+
+void Graphics::deleteReducedIndirectTargets()
+{
+	if (sceneFBO) delete sceneFBO;
+	if (guideFBO) delete guideFBO;
+	if (lowResolutionGuideFBO) delete lowResolutionGuideFBO;
+	if (indirectDiffuseFBO) delete indirectDiffuseFBO;
+	if (previousLowResolutionGuideFBO) delete previousLowResolutionGuideFBO;
+	if (indirectHistoryFBO) delete indirectHistoryFBO;
+	for (FBO *& fbo : denoiseFBOs) {
+		if (fbo) delete fbo;
+		fbo = nullptr;
+	}
+	filteredIndirectDiffuseFBO = nullptr;
+	sceneFBO = guideFBO = lowResolutionGuideFBO = indirectDiffuseFBO = nullptr;
+	previousLowResolutionGuideFBO = indirectHistoryFBO = nullptr;
+	indirectHistoryValid = false;
+	indirectTargetFactor = 0;
+}
+
+// ----------------------
+// Screen space reflections.
+// ----------------------
+void Graphics::initSpecularReflections()
+{
+	hiZMaterial = MaterialStore::getInstance().findMaterialWithName("hi_z");
+	specularReflectionsMaterial = MaterialStore::getInstance().findMaterialWithName("specular_reflections");
+
+	assert(hiZMaterial != nullptr);
+	assert(specularReflectionsMaterial != nullptr);
+
+	// Cleared counters, the CPU reads and clears them through the mapping from then on.
+	const GLsizeiptr size = (REFLECTION_COUNTER_SLOTS + 1) * REFLECTION_COUNTER_STRIDE;
+	const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	const std::vector<unsigned char> zeros(size_t(size), 0);
+	gl::genBuffers(1, &reflectionCounterBuffer);
+	gl::bindBuffer(GL_SHADER_STORAGE_BUFFER, reflectionCounterBuffer);
+	gl::bufferStorage(GL_SHADER_STORAGE_BUFFER, size, zeros.data(), flags);
+	reflectionCounters = static_cast<GLuint *>(gl::mapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, size, flags));
+	gl::bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	assert(reflectionCounters != nullptr);
+}
+
+void Graphics::updateSpecularReflectionTargets(unsigned int viewportWidth, unsigned int viewportHeight)
+{
+	if (specularFBO && specularFBO->width == viewportWidth && specularFBO->height == viewportHeight) return;
+	deleteSpecularReflectionTargets();
+
+	specularFBO = new FBO(viewportWidth, viewportHeight, GL_NEAREST, GL_NEAREST, GL_RGBA16F, GL_FLOAT, GL_CLAMP_TO_EDGE);
+
+	// Every level halves the padded size, down to 1x1 (like HiZBuffer::build).
+	hiZWidth = hiZHeight = 1;
+	while (hiZWidth < viewportWidth) hiZWidth <<= 1;
+	while (hiZHeight < viewportHeight) hiZHeight <<= 1;
+	hiZLevels = 1;
+	while ((hiZWidth >> (hiZLevels - 1)) > 1 || (hiZHeight >> (hiZLevels - 1)) > 1) ++hiZLevels;
+	gl::genTextures(1, &hiZTexture);
+	glState.bindTexture(GL_TEXTURE_2D, hiZTexture);
+	gl::texStorage2D(GL_TEXTURE_2D, hiZLevels, GL_R32F, hiZWidth, hiZHeight);
+	gl::texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	gl::texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	gl::texParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	gl::texParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glState.bindTexture(GL_TEXTURE_2D, 0);
+}
+
+void Graphics::buildHiZ()
+{
+	const Material & material = *hiZMaterial;
+	glState.useProgram(material.program);
+	guideFBO->ActivateAsTexture(material, "guide", 0);
+
+	for (int level = 0; level < hiZLevels; ++level) {
+		const GLuint width = std::max(hiZWidth >> level, 1u), height = std::max(hiZHeight >> level, 1u);
+		glState.bindImageTexture(0, hiZTexture, std::max(level - 1, 0), GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+		glState.bindImageTexture(1, hiZTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+		material.setUniform("level", level);
+		gl::dispatchCompute((width + 7) / 8, (height + 7) / 8, 1);
+		gl::memoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT); // The next level reads this one.
+	}
+	gl::memoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT); // The reflections fetch the levels.
+}
+
+void Graphics::renderSpecularReflections(Scene & renderingScene, unsigned int viewportWidth, unsigned int viewportHeight)
+{
+	updateSpecularReflectionTargets(viewportWidth, viewportHeight);
+	buildHiZ();
+
+	// The counters of the frame that last used this slot if the GPU is done with them (never waits), then count into it again.
+	unsigned int slot = reflectionCounterSlot;
+	reflectionCounterSlot = (reflectionCounterSlot + 1) % REFLECTION_COUNTER_SLOTS;
+	if (reflectionCounterFences[slot]) {
+		const GLenum status = gl::clientWaitSync(reflectionCounterFences[slot], 0, 0);
+		if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+			gl::deleteSync(reflectionCounterFences[slot]);
+			reflectionCounterFences[slot] = nullptr;
+			GLuint * counters = reflectionCounters + slot * REFLECTION_COUNTER_STRIDE / sizeof(GLuint);
+			reflectionRays = counters[0];
+			reflectionHits = counters[1];
+			reflectionHitRate = reflectionRays > 0 ? 100.0f * reflectionHits / reflectionRays : 0.0f;
+			counters[0] = counters[1] = 0; // Coherent, the next commands see it.
 		}
-		renderingQueue[i]->render(program);
+		else {
+			slot = REFLECTION_COUNTER_SLOTS; // Still in flight, this frame isn't counted.
+		}
+	}
+	gl::bindBufferRange(GL_SHADER_STORAGE_BUFFER, 2, reflectionCounterBuffer, slot * REFLECTION_COUNTER_STRIDE, 2 * sizeof(GLuint));
+
+	const Material & material = *specularReflectionsMaterial;
+	glState.useProgram(material.program);
+	uploadCamera(*renderingScene.renderingCamera, material);
+	voxelTexture->Activate(material, "texture3D", 0);
+	sceneFBO->ActivateAsTexture(material, "sceneColor", 1);
+	guideFBO->ActivateAsTexture(material, "guide", 2);
+	glState.bindTexture(3, GL_TEXTURE_2D, hiZTexture);
+	material.setUniform("hiZ", 3);
+	material.setUniform("reflectionDiffusionCutoff", reflectionDiffusionCutoff);
+
+	// Settings.
+	glState.bindFramebuffer(specularFBO->frameBuffer);
+	glState.viewport(0, 0, viewportWidth, viewportHeight);
+	glState.setEnabled(GL_DEPTH_TEST, true);
+	glState.setEnabled(GL_CULL_FACE, true);
+	glState.cullFace(GL_BACK);
+	glState.setEnabled(GL_BLEND, false);
+	gl::clearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	gl::clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	// Render.
+	renderQueue(SPECULAR_PASS, renderingScene, material, true);
+	gl::memoryBarrier(GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT); // The counters are read through the mapping once the fence signals.
+	if (slot < REFLECTION_COUNTER_SLOTS) reflectionCounterFences[slot] = gl::fenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void Graphics::deleteSpecularReflectionTargets()
+{
+	if (specularFBO) delete specularFBO;
+	if (hiZTexture) {
+		glState.forgetTexture(hiZTexture);
+		gl::deleteTextures(1, &hiZTexture);
 	}
+	specularFBO = nullptr;
+	hiZTexture = 0;
+	hiZWidth = hiZHeight = 0;
+	hiZLevels = 0;
+}
+
+// ----------------------
+// Cone tables.
+// ----------------------
+void Graphics::initConeTables()
+{
+	// Generated at compile time, the shaders only read them (see 'ConeSets.h').
+	assert(voxelTextureSize == ConeSets::VOLUME_SIZE);
+	const ConeSets::UniformBlock block = ConeSets::uniformBlock();
+	gl::genBuffers(1, &coneTableBuffer);
+	gl::bindBuffer(GL_UNIFORM_BUFFER, coneTableBuffer);
+	gl::bufferData(GL_UNIFORM_BUFFER, sizeof(block), &block, GL_STATIC_DRAW);
+	gl::bindBuffer(GL_UNIFORM_BUFFER, 0);
+	gl::bindBufferBase(GL_UNIFORM_BUFFER, 0, coneTableBuffer);
+	std::cout << "- Cone tables: " << ConeSets::DIFFUSE_CONES.SIZE << " diffuse cones, " << ConeSets::DIFFUSE_MARCHES[0].steps << " diffuse and "
+		<< ConeSets::SHADOW_MARCH.steps << " shadow steps, " << sizeof(block) << " bytes." << std::endl;
 }
 
 // ----------------------
@@ -142,8 +745,15 @@ void Graphics::initVoxelization()
 
 	assert(voxelizationMaterial != nullptr);
 
-	const std::vector<GLfloat> texture3D(4 * voxelTextureSize * voxelTextureSize * voxelTextureSize, 0.0f);
-	voxelTexture = new Texture3D(texture3D, voxelTextureSize, voxelTextureSize, voxelTextureSize, true);
+	voxelTexture = new Texture3D(voxelTextureSize, voxelTextureSize, voxelTextureSize, Texture3D::Format::RGBA8);
+	std::cout << "- Voxel texture: " << voxelTextureSize << "^3, " << voxelTexture->GetLevelCount() << " levels, "
+		<< voxelTexture->GetResidentMemory() / 1024 << " KB resident." << std::endl;
+
+	// Incremental mipmapping.
+	voxelMipmapMaterial = MaterialStore::getInstance().findMaterialWithName("voxel_mipmap");
+	assert(voxelMipmapMaterial != nullptr);
+	voxelBricks = new VoxelBrickTracker(voxelTextureSize, voxelTexture->GetLevelCount());
+	gl::genBuffers(1, &dirtyBrickBuffer);
 }
 
 void Graphics::voxelize(Scene & renderingScene, bool clearVoxelization)
@@ -153,32 +763,361 @@ void Graphics::voxelize(Scene & renderingScene, bool clearVoxelization)
 		voxelTexture->Clear(clearColor);
 	}
 
-	Material * material = voxelizationMaterial;
+	const Material & material = *voxelizationMaterial;
 
-	glUseProgram(material->program);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glState.useProgram(material.program);
+	glState.bindFramebuffer(0);
 
 	// Settings.
-	glViewport(0, 0, voxelTextureSize, voxelTextureSize);
-	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
-	glDisable(GL_CULL_FACE);
-	glDisable(GL_DEPTH_TEST);
-	glDisable(GL_BLEND);
+	glState.viewport(0, 0, voxelTextureSize, voxelTextureSize);
+	glState.colorMask(false);
+	glState.setEnabled(GL_CULL_FACE, false);
+	glState.setEnabled(GL_DEPTH_TEST, false);
+	glState.setEnabled(GL_BLEND, false);
 
 	// Texture.
-	voxelTexture->Activate(material->program, "texture3D", 0);
-	glBindImageTexture(0, voxelTexture->textureID, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA8);
+	voxelTexture->Activate(material, "texture3D", 0);
+	glState.bindImageTexture(0, voxelTexture->textureID, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA8);
 
 	// Lighting.
-	uploadLighting(renderingScene, material->program);
+	uploadLighting(renderingScene, material);
 
 	// Render.
-	renderQueue(renderingScene.renderers, material->program, true);
+	markChangedVoxelBricks(renderingScene);
+	distanceFieldDirty = distanceFieldDirty || voxelBricks->isDirty();
+	occupancyDirty = occupancyDirty || voxelBricks->isDirty();
+	irradianceProbesDirty = irradianceProbesDirty || voxelBricks->isDirty();
+	lightVisibilityDirty = lightVisibilityDirty || voxelBricks->isDirty(); // Also when lights move, see markChangedVoxelBricks.
+	renderQueue(VOXELIZATION_PASS, renderingScene, material, true);
 	if (automaticallyRegenerateMipmap || regenerateMipmapQueued) {
-		glGenerateMipmap(GL_TEXTURE_3D);
+		if (incrementalMipmapping && !regenerateMipmapQueued) {
+			if (voxelBricks->isDirty()) regenerateDirtyMipmaps();
+		}
+		else {
+			gl::generateTextureMipmap(voxelTexture->textureID); // Direct state access, whatever texture unit is active.
+		}
+		voxelBricks->clear();
 		regenerateMipmapQueued = false;
 	}
-	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	if (distanceFieldEnabled && distanceFieldDirty) updateDistanceField();
+	if (occupancyEnabled && occupancyDirty) updateOccupancy();
+	if (irradianceProbesEnabled && irradianceProbesDirty) {
+		// Every probe is traced again (or removed) over the next frames. Until then, probes keep their old light.
+		irradianceProbesPending = irradianceProbesPerAxis * irradianceProbesPerAxis * irradianceProbesPerAxis;
+		irradianceProbesDirty = false;
+	}
+	if (cachedShadows && lightVisibilityDirty && readsLightVisibility()) updateLightVisibility(renderingScene);
+	glState.colorMask(true);
+}
+
+void Graphics::markChangedVoxelBricks(Scene & renderingScene)
+{
+	++voxelizationCount;
+
+	// Lights affect the voxelized radiance everywhere.
+	if (voxelizedLightsGeneration != lightsGeneration) {
+		voxelBricks->markAllDirty();
+		voxelizedLightsGeneration = lightsGeneration;
+	}
+
+	// Renderers that were added, moved, toggled or changed material dirty both their old and new bounds.
+	for (auto * renderer : renderingScene.renderers) {
+		renderer->transform.updateTransformMatrixIfChanged();
+		const glm::mat4 & transform = renderer->transform.getTransformMatrix();
+		const unsigned int materialVersion = renderer->materialSetting ? renderer->materialSetting->getVersion() : 0;
+
+		auto it = voxelizedRenderers.find(renderer);
+		if (it == voxelizedRenderers.end()) {
+			VoxelizedRendererState state;
+			state.localMin = glm::vec3(FLT_MAX);
+			state.localMax = glm::vec3(-FLT_MAX);
+			for (const auto & vertex : renderer->mesh->vertexData) {
+				state.localMin = glm::min(state.localMin, vertex.position);
+				state.localMax = glm::max(state.localMax, vertex.position);
+			}
+			state.enabled = false;
+			it = voxelizedRenderers.emplace(renderer, state).first;
+		}
+		else {
+			const auto & state = it->second;
+			const bool unchanged = state.enabled == renderer->enabled && state.transformVersion == renderer->transform.getVersion() &&
+				state.materialSetting == renderer->materialSetting && state.materialVersion == materialVersion;
+			if (unchanged) {
+				it->second.lastSeen = voxelizationCount;
+				continue;
+			}
+		}
+
+		auto & state = it->second;
+		if (state.enabled) voxelBricks->markDirty(state.worldMin, state.worldMax);
+		state.enabled = renderer->enabled;
+		state.transformVersion = renderer->transform.getVersion();
+		state.materialSetting = renderer->materialSetting;
+		state.materialVersion = materialVersion;
+		state.lastSeen = voxelizationCount;
+		transformBounds(transform, state.localMin, state.localMax, state.worldMin, state.worldMax);
+		if (state.enabled) voxelBricks->markDirty(state.worldMin, state.worldMax);
+	}
+
+	// Renderers that have been removed from the scene.
+	for (auto it = voxelizedRenderers.begin(); it != voxelizedRenderers.end();) {
+		if (it->second.lastSeen == voxelizationCount) { ++it; continue; }
+		if (it->second.enabled) voxelBricks->markDirty(it->second.worldMin, it->second.worldMax);
+		it = voxelizedRenderers.erase(it);
+	}
+}
+
+void Graphics::regenerateDirtyMipmaps()
+{
+	const Material & material = *voxelMipmapMaterial;
+	voxelBricks->propagate();
+
+	glState.useProgram(material.program);
+	gl::memoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT); // Voxelization writes must be visible.
+	gl::bindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, dirtyBrickBuffer);
+
+	for (int level = 1; level < voxelTexture->GetLevelCount(); ++level) {
+		const auto & bricks = voxelBricks->getDirtyBricks(level);
+		if (bricks.empty()) break;
+
+		gl::bufferData(GL_SHADER_STORAGE_BUFFER, bricks.size() * sizeof(GLuint), bricks.data(), GL_STREAM_DRAW);
+		glState.bindImageTexture(0, voxelTexture->textureID, level - 1, GL_TRUE, 0, GL_READ_ONLY, GL_RGBA8);
+		glState.bindImageTexture(1, voxelTexture->textureID, level, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA8);
+		material.setUniform("bricksPerAxis", voxelBricks->getBricksPerAxis(level));
+		material.setUniform("destinationSize", std::max(1, int(voxelTextureSize) >> level));
+		gl::dispatchCompute(GLuint(bricks.size()), 1, 1);
+		gl::memoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT); // The next level reads this one.
+	}
+
+	gl::memoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT); // Cone tracing samples the texture.
+	gl::bindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+}
+
+// ----------------------
+// Distance field.
+// ----------------------
+void Graphics::initDistanceField()
+{
+	distanceFieldMaterial = MaterialStore::getInstance().findMaterialWithName("voxel_distance_field");
+	assert(distanceFieldMaterial != nullptr);
+	assert(voxelTextureSize <= 256); // Seeds store voxel coordinates in RGBA8.
+
+	const int size = voxelTextureSize;
+	distanceTexture = new Texture3D(size, size, size, Texture3D::Format::R8, 1);
+	jumpFloodTextures[0] = new Texture3D(size, size, size, Texture3D::Format::RGBA8, 1);
+	jumpFloodTextures[1] = new Texture3D(size, size, size, Texture3D::Format::RGBA8, 1);
+}
+
+void Graphics::updateDistanceField()
+{
+	// Jump flooding: seed with the occupied voxels, propagate with halving steps,
+	// do one extra step of 1 (JFA+1) to fix most of the remaining errors and resolve to free radii.
+	const Material & material = *distanceFieldMaterial;
+	const GLuint groups = (voxelTextureSize + 3) / 4;
+	int current = 0;
+
+	glState.useProgram(material.program);
+	material.setUniform("volumeSize", int(voxelTextureSize));
+	gl::memoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT); // Voxelization writes must be visible.
+	glState.bindImageTexture(0, voxelTexture->textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_RGBA8);
+
+	// Seed.
+	glState.bindImageTexture(2, jumpFloodTextures[current]->textureID, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA8);
+	material.setUniform("pass", 0);
+	gl::dispatchCompute(groups, groups, groups);
+	gl::memoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+	// Jump.
+	std::vector<int> steps;
+	for (int step = voxelTextureSize / 2; step >= 1; step /= 2) steps.push_back(step);
+	steps.push_back(1);
+	material.setUniform("pass", 1);
+	for (int step : steps) {
+		glState.bindImageTexture(1, jumpFloodTextures[current]->textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_RGBA8);
+		glState.bindImageTexture(2, jumpFloodTextures[1 - current]->textureID, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA8);
+		material.setUniform("jumpStep", step);
+		gl::dispatchCompute(groups, groups, groups);
+		gl::memoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+		current = 1 - current;
+	}
+
+	// Resolve.
+	glState.bindImageTexture(1, jumpFloodTextures[current]->textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_RGBA8);
+	glState.bindImageTexture(3, distanceTexture->textureID, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_R8);
+	material.setUniform("pass", 2);
+	gl::dispatchCompute(groups, groups, groups);
+	gl::memoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT); // Marchers sample the field.
+
+	distanceFieldDirty = false;
+}
+
+// ----------------------
+// Occupancy bitmask.
+// ----------------------
+void Graphics::initOccupancy()
+{
+	occupancyMaterial = MaterialStore::getInstance().findMaterialWithName("voxel_occupancy");
+	assert(occupancyMaterial != nullptr);
+
+	voxelOccupancy = new VoxelOccupancy(voxelTextureSize);
+	gl::genBuffers(1, &occupancyBuffer);
+	gl::bindBuffer(GL_SHADER_STORAGE_BUFFER, occupancyBuffer);
+	gl::bufferData(GL_SHADER_STORAGE_BUFFER, voxelOccupancy->getByteSize(), nullptr, GL_DYNAMIC_COPY);
+	gl::bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	std::cout << "- Occupancy bitmask: " << voxelOccupancy->getLevelCount() << " levels, " << voxelOccupancy->getByteSize() << " bytes." << std::endl;
+}
+
+void Graphics::updateOccupancy()
+{
+	const Material & material = *occupancyMaterial;
+	const GLuint zero = 0;
+
+	glState.useProgram(material.program);
+	gl::bindBuffer(GL_SHADER_STORAGE_BUFFER, occupancyBuffer);
+	gl::clearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+	gl::bindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, occupancyBuffer); // Stays bound for the marchers.
+	gl::memoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT); // Voxelization writes must be visible.
+	glState.bindImageTexture(0, voxelTexture->textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_RGBA8);
+	material.setUniform("volumeSize", int(voxelTextureSize));
+
+	// Level 0 from the voxels.
+	GLuint groups = (voxelTextureSize + 3) / 4;
+	material.setUniform("pass", 0);
+	gl::dispatchCompute(groups, groups, groups);
+
+	// OR-reduce the coarser levels.
+	material.setUniform("pass", 1);
+	for (int level = 1; level < voxelOccupancy->getLevelCount(); ++level) {
+		const int sourceBlocks = voxelOccupancy->getBlocksPerAxis(level - 1);
+		gl::memoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+		material.setUniform("sourceBlocks", sourceBlocks);
+		material.setUniform("sourceOffset", int(voxelOccupancy->getLevelOffset(level - 1)));
+		material.setUniform("destinationOffset", int(voxelOccupancy->getLevelOffset(level)));
+		groups = (sourceBlocks + 3) / 4;
+		gl::dispatchCompute(groups, groups, groups);
+	}
+	gl::memoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	gl::bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	occupancyDirty = false;
+}
+
+void Graphics::activateEmptySpaceSkipping(const Material & material, const int textureUnit)
+{
+	distanceTexture->Activate(material, "distanceField", textureUnit);
+	material.setUniform("distanceFieldEnabled", distanceFieldEnabled);
+	material.setUniform("occupancyEnabled", occupancyEnabled);
+	material.setUniform("occupancyLevels", voxelOccupancy->getLevelCount());
+}
+
+// ----------------------
+// Irradiance probes.
+// ----------------------
+void Graphics::initIrradianceProbes()
+{
+	irradianceProbeMaterial = MaterialStore::getInstance().findMaterialWithName("irradiance_probes");
+	assert(irradianceProbeMaterial != nullptr);
+	assert(voxelTextureSize % irradianceProbesPerAxis == 0 && (voxelTextureSize / irradianceProbesPerAxis) % 2 == 0);
+
+	const int size = irradianceProbesPerAxis;
+	for (int i = 0; i < 3; ++i) irradianceProbeTextures[i] = new Texture3D(size, size, size, Texture3D::Format::RGBA16F, 1);
+	irradianceProbeTextures[3] = new Texture3D(size, size, size, Texture3D::Format::R8, 1);
+}
+
+void Graphics::updateIrradianceProbes()
+{
+	const Material & material = *irradianceProbeMaterial;
+	const int probeCount = irradianceProbesPerAxis * irradianceProbesPerAxis * irradianceProbesPerAxis;
+	const int batch = std::min(std::max(irradianceProbeBatch, 1), irradianceProbesPending);
+
+	glState.useProgram(material.program);
+	gl::memoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT); // Voxels and mipmaps must be complete.
+	voxelTexture->Activate(material, "texture3D", 0);
+	for (int i = 0; i < 4; ++i) {
+		const GLenum format = i < 3 ? GL_RGBA16F : GL_R8;
+		glState.bindImageTexture(i, irradianceProbeTextures[i]->textureID, 0, GL_TRUE, 0, GL_WRITE_ONLY, format);
+	}
+	material.setUniform("probesPerAxis", irradianceProbesPerAxis);
+	material.setUniform("batchOffset", irradianceProbeCursor);
+	material.setUniform("batchSize", batch);
+	gl::dispatchCompute((batch + 63) / 64, 1, 1);
+	gl::memoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT); // Shading samples the probes.
+
+	irradianceProbeCursor = (irradianceProbeCursor + batch) % probeCount;
+	irradianceProbesPending -= batch;
+}
+
+void Graphics::activateIrradianceProbes(const Material & material, const int textureUnit)
+{
+	const char * names[] = { "probeRed", "probeGreen", "probeBlue", "probeWeight" };
+	for (int i = 0; i < 4; ++i) irradianceProbeTextures[i]->Activate(material, names[i], textureUnit + i);
+	material.setUniform("probesPerAxis", irradianceProbesPerAxis);
+}
+
+// ----------------------
+// Light visibility.
+// ----------------------
+void Graphics::initLightVisibility()
+{
+	lightVisibilityMaterial = MaterialStore::getInstance().findMaterialWithName("light_visibility");
+	assert(lightVisibilityMaterial != nullptr);
+}
+
+void Graphics::updateLightVisibility(Scene & renderingScene)
+{
+	const size_t lights = std::min<size_t>(renderingScene.pointLights.size(), ShaderBlocks::MAX_LIGHTS); // Read from the 'Lights' block.
+	const size_t textureCount = (lights + 3) / 4;
+	if (lightVisibilityTextures.size() != textureCount) {
+		deleteLightVisibilityTextures();
+		const int size = lightVisibilitySize;
+		for (size_t i = 0; i < textureCount; ++i) {
+			Texture3D * texture = new Texture3D(size, size, size, Texture3D::Format::RGBA8, 1);
+			glState.bindTexture(GL_TEXTURE_3D, texture->textureID);
+			gl::texParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR); // Shading interpolates between cells.
+			gl::texParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			gl::texParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			gl::texParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+			lightVisibilityTextures.push_back(texture);
+		}
+		glState.bindTexture(GL_TEXTURE_3D, 0);
+	}
+
+	const Material & material = *lightVisibilityMaterial;
+	const GLuint groups = (lightVisibilitySize + 3) / 4;
+	glState.useProgram(material.program);
+	gl::memoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT); // Voxels and mipmaps must be complete.
+	voxelTexture->Activate(material, "texture3D", 0);
+	material.setUniform("resolution", int(lightVisibilitySize));
+	for (size_t i = 0; i < textureCount; ++i) {
+		material.setUniform("firstLight", int(4 * i));
+		const int lightCount = int(std::min<size_t>(4, lights - 4 * i));
+		material.setUniform("lightCount", lightCount);
+		glState.bindImageTexture(0, lightVisibilityTextures[i]->textureID, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA8);
+		gl::dispatchCompute(groups, groups, groups);
+	}
+	gl::memoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT); // Shading samples the visibility.
+
+	lightVisibilityDirty = false;
+}
+
+bool Graphics::readsLightVisibility() const
+{
+	return voxelConeTracingMaterial->getUniformLocation("lightVisibility[]", 0) >= 0;
+}
+
+void Graphics::activateLightVisibility(const Material & material, const int textureUnit)
+{
+	const bool enabled = cachedShadows && !lightVisibilityDirty;
+	material.setUniform("cachedShadows", enabled);
+	if (!enabled) return;
+	for (size_t i = 0; i < lightVisibilityTextures.size(); ++i)
+		lightVisibilityTextures[i]->Activate(material, material.getUniformLocation("lightVisibility[]", i), textureUnit + int(i));
+}
+
+void Graphics::deleteLightVisibilityTextures()
+{
+	for (Texture3D * texture : lightVisibilityTextures) delete texture;
+	lightVisibilityTextures.clear();
 }
 
 // ----------------------
@@ -213,52 +1152,53 @@ void Graphics::renderVoxelVisualization(Scene & renderingScene, unsigned int vie
 	// Render cube to FBOs.
 	// -------------------------------------------------------
 	Camera & camera = *renderingScene.renderingCamera;
-	auto program = worldPositionMaterial->program;
-	glUseProgram(program);
-	uploadCamera(camera, program);
+	const Material * material = worldPositionMaterial;
+	glState.useProgram(material->program);
+	uploadCamera(camera, *material);
 
 	// Settings.
-	glClearColor(0.0, 0.0, 0.0, 1.0);
-	glEnable(GL_CULL_FACE);
-	glEnable(GL_DEPTH_TEST);
+	gl::clearColor(0.0, 0.0, 0.0, 1.0);
+	glState.setEnabled(GL_CULL_FACE, true);
+	glState.setEnabled(GL_DEPTH_TEST, true);
 
 	// Back.
-	glCullFace(GL_FRONT);
-	glBindFramebuffer(GL_FRAMEBUFFER, vvfbo1->frameBuffer);
-	glViewport(0, 0, vvfbo1->width, vvfbo1->height);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	cubeMeshRenderer->render(program);
+	glState.cullFace(GL_FRONT);
+	glState.bindFramebuffer(vvfbo1->frameBuffer);
+	glState.viewport(0, 0, vvfbo1->width, vvfbo1->height);
+	gl::clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	cubeMeshRenderer->render(*material, streamBuffer);
 
 	// Front.
-	glCullFace(GL_BACK);
-	glBindFramebuffer(GL_FRAMEBUFFER, vvfbo2->frameBuffer);
-	glViewport(0, 0, vvfbo2->width, vvfbo2->height);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	cubeMeshRenderer->render(program);
+	glState.cullFace(GL_BACK);
+	glState.bindFramebuffer(vvfbo2->frameBuffer);
+	glState.viewport(0, 0, vvfbo2->width, vvfbo2->height);
+	gl::clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	cubeMeshRenderer->render(*material, streamBuffer);
 
 	// -------------------------------------------------------
 	// Render 3D texture to screen.
 	// -------------------------------------------------------
-	program = voxelVisualizationMaterial->program;
-	glUseProgram(program);
-	uploadCamera(camera, program);
-	glBindRenderbuffer(GL_RENDERBUFFER, 0);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	material = voxelVisualizationMaterial;
+	glState.useProgram(material->program);
+	uploadCamera(camera, *material);
+	gl::bindRenderbuffer(GL_RENDERBUFFER, 0);
+	glState.bindFramebuffer(0);
 
 	// Settings.
-	uploadGlobalConstants(voxelVisualizationMaterial->program, viewportWidth, viewportHeight);
-	glDisable(GL_DEPTH_TEST);
-	glEnable(GL_CULL_FACE);
+	uploadGlobalConstants(*material, viewportWidth, viewportHeight);
+	glState.setEnabled(GL_DEPTH_TEST, false);
+	glState.setEnabled(GL_CULL_FACE, true);
 
 	// Activate textures.
-	vvfbo1->ActivateAsTexture(program, "textureBack", 0);
-	vvfbo2->ActivateAsTexture(program, "textureFront", 1);
-	voxelTexture->Activate(program, "texture3D", 2);
+	vvfbo1->ActivateAsTexture(*material, "textureBack", 0);
+	vvfbo2->ActivateAsTexture(*material, "textureFront", 1);
+	voxelTexture->Activate(*material, "texture3D", 2);
+	activateEmptySpaceSkipping(*material, 3);
 
 	// Render.
-	glViewport(0, 0, viewportWidth, viewportHeight);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	quadMeshRenderer->render(program);
+	glState.viewport(0, 0, viewportWidth, viewportHeight);
+	gl::clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	quadMeshRenderer->render(*material);
 }
 
 Graphics::~Graphics()
@@ -269,4 +1209,25 @@ Graphics::~Graphics()
 	if (cubeMeshRenderer) delete cubeMeshRenderer;
 	if (cubeShape) delete cubeShape;
 	if (voxelTexture) delete voxelTexture;
+	if (voxelBricks) delete voxelBricks;
+	if (dirtyBrickBuffer) gl::deleteBuffers(1, &dirtyBrickBuffer);
+	if (distanceTexture) delete distanceTexture;
+	if (jumpFloodTextures[0]) delete jumpFloodTextures[0];
+	if (jumpFloodTextures[1]) delete jumpFloodTextures[1];
+	if (voxelOccupancy) delete voxelOccupancy;
+	if (occupancyBuffer) gl::deleteBuffers(1, &occupancyBuffer);
+	for (Texture3D * texture : irradianceProbeTextures) if (texture) delete texture;
+	deleteLightVisibilityTextures();
+	deleteReducedIndirectTargets();
+	if (blueNoiseTexture) {
+		glState.forgetTexture(blueNoiseTexture);
+		gl::deleteTextures(1, &blueNoiseTexture);
+	}
+	if (coneTableBuffer) gl::deleteBuffers(1, &coneTableBuffer);
+	if (lightBuffer) gl::deleteBuffers(1, &lightBuffer);
+	if (materialBuffer) gl::deleteBuffers(1, &materialBuffer);
+	if (streamBuffer) delete streamBuffer;
+	deleteSpecularReflectionTargets();
+	for (GLsync fence : reflectionCounterFences) if (fence) gl::deleteSync(fence);
+	if (reflectionCounterBuffer) gl::deleteBuffers(1, &reflectionCounterBuffer); // Also unmaps it.
 }
\ No newline at end of file
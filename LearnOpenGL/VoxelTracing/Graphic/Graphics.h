@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vector>
+#include <unordered_map>
 
 #define GLEW_STATIC
 #include <glew.h>
@@ -12,9 +13,17 @@
 #include "Camera\OrthographicCamera.h"
 #include "../Shape/Mesh.h"
 #include "Texture3D.h"
+#include "Material/MaterialSetting.h"
+#include "Voxel/ConeSets.h"
+#include "ShaderBlocks.h"
+#include "Buffer/RingBuffer.h"
+#include "GLState.h"
+#include "Renderer/RenderCommandBuffer.h"
 
 class MeshRenderer;
 class Shape;
+class VoxelBrickTracker;
+class VoxelOccupancy;
 
 /// <summary> A graphical context used for rendering. </summary>
 class Graphics {
@@ -41,6 +50,19 @@ public:
 	bool indirectDiffuseLight = true;
 	bool indirectSpecularLight = true;
 	bool directLight = true;
+	int indirectDiffuseResolution = 1; // 1 traces indirect diffuse light per pixel, 2 or 4 at 1/2 or 1/4 resolution (then upsamples).
+	bool temporalIndirectDiffuse = false; // Traces a few jittered diffuse cones per frame and accumulates them with the reprojected history.
+	int indirectDiffuseRingCones = ConeSets::DIFFUSE_RING_CONES; // Diffuse cones around the normal cone (1 to the whole ring). Fewer are rotated per pixel with blue noise.
+	int denoiserIterations = 0; // Edge-avoiding a-trous iterations over the indirect diffuse light (0 disables the denoiser).
+	bool visualizeTemporalReuse = false; // Shows the number of reused frames per pixel instead of the scene.
+	bool irradianceProbesEnabled = false; // Interpolates indirect diffuse light from a probe grid that is only traced when the voxels change.
+	int irradianceProbeBatch = 512; // Probes traced per frame after the voxels change (round-robin).
+	bool cachedShadows = false; // Marches shadow cones per cell and light when the voxels or lights change, shading fetches them.
+	// Not in the tweak bar: no forward shader in this tree samples 'lightVisibility' yet (see readsLightVisibility), the CPU reference is VoxelLightVisibility.
+	bool screenSpaceReflections = false; // Glossy reflections march the hierarchical view depth first, misses trace the specular cone.
+	float reflectionDiffusionCutoff = 2.0f; // Opaque materials up to this specular diffusion try screen space reflections.
+	unsigned int reflectionRays = 0, reflectionHits = 0; // Screen space reflection rays of a recent frame (read without waiting), and how many of them hit.
+	float reflectionHitRate = 0.0f; // In percent.
 
 	// ----------------
 	// Voxelization.
@@ -51,9 +73,14 @@ public:
 	bool voxelizationQueued = true;
 	int voxelizationSparsity = 1; // Number of ticks between mipmap generation. 
 	// (voxelization sparsity gives unstable framerates, so not sure if it's worth it in interactive applications.)
+	bool incrementalMipmapping = true; // Only rebuilds the mipmaps above bricks that changed since the last voxelization.
+	bool distanceFieldEnabled = true; // Rebuilds the empty space skipping distance field when the voxels change.
+	bool occupancyEnabled = true; // Rebuilds the hierarchical occupancy bitmask when the voxels change.
 
 	~Graphics();
 private:
+	GLState & glState = GLState::getInstance(); // Every state change of the passes goes through the cache.
+
 	// ----------------
 	// GLSL uniform names.
 	// ----------------
@@ -68,16 +95,131 @@ private:
 	// Rendering.
 	// ----------------
 	void renderScene(Scene & renderingScene, unsigned int viewportWidth, unsigned int viewportHeight);
-	void renderQueue(RenderingQueue renderingQueue, const GLuint program, bool uploadMaterialSettings = false) const;
-	void uploadGlobalConstants(const GLuint program, unsigned int viewportWidth, unsigned int viewportHeight) const;
-	void uploadCamera(Camera & camera, const GLuint program);
-	void uploadLighting(Scene & renderingScene, const GLuint glProgram) const;
-	void uploadRenderingSettings(const GLuint glProgram) const;
+	void uploadGlobalConstants(const Material & material, unsigned int viewportWidth, unsigned int viewportHeight) const;
+	void uploadCamera(Camera & camera, const Material & material);
+	void uploadLighting(Scene & renderingScene, const Material & material);
+	void uploadRenderingSettings(const Material & material) const;
+
+	// ----------------
+	// Change tracking.
+	// ----------------
+	/// <summary> Material settings, lights and transforms are written directly (scene scripts, the tweak bar's pointers), so
+	/// updateVersions compares them with their snapshots once per frame (see 'Utility/ChangeSnapshot.h').
+	/// A generation is bumped in every frame where any material (or light) changed, uploads that depend on them are skipped until then. </summary>
+	unsigned int materialsGeneration = 0, lightsGeneration = 0;
+	/// <summary> The scene's renderers when the materials were last tracked. Added, removed or reordered renderers and replaced
+	/// settings or meshes also bump the materials generation (the material and mesh keys of the draws depend on them). </summary>
+	struct TrackedRenderer {
+		const MeshRenderer * renderer;
+		const MaterialSetting * materialSetting;
+		const Mesh * mesh;
+	};
+	std::vector<TrackedRenderer> trackedRenderers;
+	size_t trackedLightCount = 0;
+	/// <summary> The generations a program's plain uniforms were last set from (programs without the shader blocks). </summary>
+	struct LegacyUniforms {
+		unsigned int materialsGeneration = ~0u, materialKey = ~0u, lightsGeneration = ~0u;
+	};
+	std::unordered_map<GLuint, LegacyUniforms> legacyUniforms;
+	void updateVersions(Scene & renderingScene);
+
+	// ----------------
+	// Render commands.
+	// ----------------
+	enum RenderPass { VOXELIZATION_PASS, GUIDE_PASS, INDIRECT_DIFFUSE_PASS, FORWARD_PASS, SPECULAR_PASS, RENDER_PASSES };
+	/// <summary> The sorted draws of a pass, replayed as long as the draws, and the view they were sorted for, stay the same
+	/// (the voxelization pass doesn't depend on the view, so a static scene never sorts it again). </summary>
+	struct RecordedPass {
+		RenderCommandBuffer commands;
+		uint64_t signature = 0;
+		bool recorded = false;
+	};
+	RecordedPass recordedPasses[RENDER_PASSES];
+	std::vector<unsigned int> materialKeys, meshKeys; // Per renderer, the first renderer with the same material or mesh (see uploadShaderBlocks).
+	const RenderCommandBuffer & recordPass(RenderPass pass, Scene & renderingScene, const Material & material, const Camera * camera);
+	/// <summary> Draws the scene's renderers in the sorted order of a pass. Material settings are uploaded when the material changes. </summary>
+	void renderQueue(RenderPass pass, Scene & renderingScene, const Material & material, bool uploadMaterialSettings = false);
+
+	// ----------------
+	// Shader blocks.
+	// ----------------
+	/// <summary> Uniform and storage buffers shared by the programs, see 'ShaderBlocks.h'. Programs that don't declare
+	/// a block still get its values as plain uniforms (uploadCamera, uploadGlobalConstants, uploadLighting, renderQueue). </summary>
+	const size_t STREAM_REGION_SIZE = 1 << 20; // Bytes a frame can stream before the buffer grows.
+	RingBuffer * streamBuffer = nullptr; // Every block and the vertices of dynamic meshes, written once per frame or draw.
+	size_t uniformBlockAlignment = 256, storageBlockAlignment = 256; // Offset alignments of bound ranges.
+	std::vector<ShaderBlocks::Material> shaderBlockMaterials;
+	GLuint lightBuffer = 0, materialBuffer = 0; // The 'Lights' and 'Materials' blocks (immutable storage), copied to when their generation changes.
+	size_t materialBufferCapacity = 0; // In materials. Replaced by a larger buffer when renderers are added.
+	unsigned int uploadedLightsGeneration = ~0u, uploadedMaterialsGeneration = ~0u;
+	void initShaderBlocks();
+	void uploadShaderBlocks(Scene & renderingScene, unsigned int viewportWidth, unsigned int viewportHeight);
+	/// <summary> Writes data into the stream buffer and copies it to the start of a buffer on the GPU. The copy is ordered
+	/// with the draws, so nothing waits and the buffer is never re-specified. </summary>
+	void copyToBuffer(const GLuint buffer, const void * data, const size_t size);
+
+	// ----------------
+	// Reduced resolution indirect diffuse light.
+	// ----------------
+	Material * geometryBufferMaterial, * indirectUpsampleMaterial, * indirectDenoiseMaterial;
+	/// <summary> The bits of the 'indirect_diffuse' permutations, in the order of their defines (see MaterialStore). </summary>
+	enum IndirectDiffuseFeature {
+		INDIRECT_DIFFUSE_TEMPORAL = 1 << 0,
+		INDIRECT_DIFFUSE_IRRADIANCE_PROBES = 1 << 1,
+		INDIRECT_DIFFUSE_PERMUTATIONS = 1 << 2 // Every bitmask is below.
+	};
+	/// <summary> The indirect diffuse program specialized for the current settings. </summary>
+	Material * findIndirectDiffuseMaterial() const;
+	FBO * sceneFBO = nullptr, * guideFBO = nullptr, * lowResolutionGuideFBO = nullptr, * indirectDiffuseFBO = nullptr;
+	FBO * previousLowResolutionGuideFBO = nullptr, * indirectHistoryFBO = nullptr; // Last frame's targets (temporal mode).
+	FBO * denoiseFBOs[2] = { nullptr, nullptr };
+	FBO * filteredIndirectDiffuseFBO = nullptr; // What gets upsampled: indirectDiffuseFBO or the last denoised target.
+	GLuint blueNoiseTexture = 0;
+	bool indirectHistoryValid = false;
+	unsigned int temporalFrame = 0;
+	int indirectTargetFactor = 0;
+	unsigned int indirectTargetWidth = 0, indirectTargetHeight = 0;
+	void initReducedIndirectDiffuse();
+	void updateReducedIndirectTargets(unsigned int viewportWidth, unsigned int viewportHeight);
+	void renderReducedIndirectDiffuse(Scene & renderingScene, unsigned int viewportWidth, unsigned int viewportHeight);
+	void denoiseIndirectDiffuse();
+	void deleteReducedIndirectTargets();
+
+	/// <summary> Renders the full and reduced resolution guides (normal and view depth). </summary>
+	void renderGuides(Scene & renderingScene);
+
+	/// <summary> Composites the indirect light of the enabled passes onto the forward pass (sceneFBO). </summary>
+	void compositeIndirectLight(unsigned int viewportWidth, unsigned int viewportHeight, bool reducedIndirectDiffuse, bool specularReflections);
+
+	// ----------------
+	// Screen space reflections.
+	// ----------------
+	Material * hiZMaterial, * specularReflectionsMaterial;
+	FBO * specularFBO = nullptr;
+	GLuint hiZTexture = 0; // R32F, padded to power of 2 sizes, see 'ScreenSpace/HiZBuffer.h'.
+	GLuint hiZWidth = 0, hiZHeight = 0;
+	int hiZLevels = 0;
+	/// <summary> Rays and hits, read back without waiting for the GPU. Each frame counts into the next of the persistently mapped slots
+	/// and fences it, the slot is read (and cleared) when its turn comes again if the fence signaled. Otherwise that frame counts into
+	/// a spare slot that is never read. Bound to shader storage binding 2. </summary>
+	static const unsigned int REFLECTION_COUNTER_SLOTS = RingBuffer::REGIONS;
+	static const GLsizeiptr REFLECTION_COUNTER_STRIDE = 256; // Shader storage offsets must be aligned (GL requires at most 256 bytes).
+	GLuint reflectionCounterBuffer = 0;
+	GLuint * reflectionCounters = nullptr; // Mapping of every slot, then the spare one.
+	GLsync reflectionCounterFences[REFLECTION_COUNTER_SLOTS] = {};
+	unsigned int reflectionCounterSlot = 0;
+	void initSpecularReflections();
+	void updateSpecularReflectionTargets(unsigned int viewportWidth, unsigned int viewportHeight);
+	void buildHiZ();
+	void renderSpecularReflections(Scene & renderingScene, unsigned int viewportWidth, unsigned int viewportHeight);
+	void deleteSpecularReflectionTargets();
 
 	// ----------------
 	// Voxel cone tracing.
 	// ----------------
 	Material * voxelConeTracingMaterial;
+	GLuint coneTableBuffer = 0; // The 'ConeTables' uniform block (ConeSets::UniformBlock), bound to uniform buffer binding 0.
+	void initConeTables();
 
 	// ----------------
 	// Voxelization.
@@ -90,6 +232,81 @@ private:
 	void initVoxelization();
 	void voxelize(Scene & renderingScene, bool clearVoxelizationFirst = true);
 
+	// ----------------
+	// Incremental mipmapping.
+	// ----------------
+	/// <summary> What a renderer looked like when it was last voxelized. </summary>
+	struct VoxelizedRendererState {
+		bool enabled;
+		unsigned int transformVersion, materialVersion; // See Transform::getVersion and MaterialSetting::getVersion.
+		const MaterialSetting * materialSetting;
+		glm::vec3 localMin, localMax, worldMin, worldMax;
+		unsigned long long lastSeen;
+	};
+	std::unordered_map<const MeshRenderer *, VoxelizedRendererState> voxelizedRenderers;
+	unsigned int voxelizedLightsGeneration = ~0u;
+	unsigned long long voxelizationCount = 0;
+	VoxelBrickTracker * voxelBricks = nullptr;
+	Material * voxelMipmapMaterial;
+	GLuint dirtyBrickBuffer = 0;
+	void markChangedVoxelBricks(Scene & renderingScene);
+	void regenerateDirtyMipmaps();
+
+	// ----------------
+	// Distance field.
+	// ----------------
+	Material * distanceFieldMaterial;
+	Texture3D * distanceTexture = nullptr; // R8 free radius in voxels, see 'Voxel/VoxelDistanceField.h'.
+	Texture3D * jumpFloodTextures[2] = { nullptr, nullptr };
+	bool distanceFieldDirty = true;
+	void initDistanceField();
+	void updateDistanceField();
+
+	// ----------------
+	// Occupancy bitmask.
+	// ----------------
+	Material * occupancyMaterial;
+	VoxelOccupancy * voxelOccupancy = nullptr; // Only used for its layout, the bitmask itself lives in occupancyBuffer.
+	GLuint occupancyBuffer = 0;
+	bool occupancyDirty = true;
+	void initOccupancy();
+	void updateOccupancy();
+
+	/// <summary> Binds the distance field and the occupancy bitmask for the marchers of a program. </summary>
+	void activateEmptySpaceSkipping(const Material & material, const int textureUnit);
+
+	// ----------------
+	// Irradiance probes.
+	// ----------------
+	const int irradianceProbesPerAxis = 16; // Must divide voxelTextureSize into an even number of voxels.
+	Material * irradianceProbeMaterial;
+	Texture3D * irradianceProbeTextures[4] = { nullptr, nullptr, nullptr, nullptr }; // Red, green and blue L1 coefficients and weights, see 'Voxel/IrradianceProbeGrid.h'.
+	bool irradianceProbesDirty = true;
+	int irradianceProbeCursor = 0; // Next probe of the round-robin.
+	int irradianceProbesPending = 0; // Probes left to trace since the voxels last changed.
+	void initIrradianceProbes();
+	void updateIrradianceProbes();
+
+	/// <summary> Binds the probe textures to four texture units, starting at textureUnit. </summary>
+	void activateIrradianceProbes(const Material & material, const int textureUnit);
+
+	// ----------------
+	// Light visibility.
+	// ----------------
+	GLuint lightVisibilitySize = 32; // Cells per axis.
+	Material * lightVisibilityMaterial;
+	std::vector<Texture3D *> lightVisibilityTextures; // RGBA8, one light per channel, see 'Voxel/VoxelLightVisibility.h'.
+	bool lightVisibilityDirty = true;
+	void initLightVisibility();
+	void updateLightVisibility(Scene & renderingScene);
+	void deleteLightVisibilityTextures();
+
+	/// <summary> False while the program renderScene binds has no active 'lightVisibility' samplers, the cache isn't rebuilt then. </summary>
+	bool readsLightVisibility() const;
+
+	/// <summary> Binds one visibility texture per 4 lights, starting at textureUnit. </summary>
+	void activateLightVisibility(const Material & material, const int textureUnit);
+
 	// ----------------
 	// Voxelization visualization.
 	// ----------------
@@ -8,6 +8,10 @@
 
 #include <iostream>
 #include <string>
+#include <array>
+
+#include "../Device/GLDevice.h"
+#include "../../Utility/ChangeSnapshot.h"
 
 /// <summary> A simple point light. </summary>
 class PointLight {
@@ -15,8 +19,14 @@ public:
 	bool tweakable = true;
 	glm::vec3 position, color;
 	PointLight(glm::vec3 _position = { 0, 0, 0 }, glm::vec3 _color = { 1, 1, 1 }) : position(_position), color(_color) {}
-	void Upload(GLuint program, GLuint index) const {
-		glUniform3fv(glGetUniformLocation(program, ("pointLights[" + std::to_string(index) + "].position").c_str()), 1, glm::value_ptr(position));
-		glUniform3fv(glGetUniformLocation(program, ("pointLights[" + std::to_string(index) + "].color").c_str()), 1, glm::value_ptr(color));
+	/// <summary> Uploads to the 'pointLights' element at the given member locations (see Material::getUniformLocation). </summary>
+	void Upload(GLuint program, GLint positionLocation, GLint colorLocation) const {
+		gl::programUniform3fv(program, positionLocation, 1, glm::value_ptr(position));
+		gl::programUniform3fv(program, colorLocation, 1, glm::value_ptr(color));
 	}
+	/// <summary> Takes a new version if the light moved or changed color since the last call (see Graphics::updateVersions). </summary>
+	bool updateVersion() { return snapshot.update({ position.x, position.y, position.z, color.x, color.y, color.z }); }
+	unsigned int getVersion() const { return snapshot.getVersion(); }
+private:
+	ChangeSnapshot<std::array<float, 6>> snapshot;
 };
\ No newline at end of file
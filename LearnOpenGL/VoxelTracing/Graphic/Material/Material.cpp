@@ -3,14 +3,24 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
+#include <algorithm>
+#include <cstring>
 
 #include <gtc/type_ptr.hpp>
 
 #include "Shader.h"
+#include "ProgramCache.h"
+#include "../GLState.h"
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1 // KHR_parallel_shader_compile, missing from older GLEW headers.
+#endif
 
 Material::~Material()
 {
-	glDeleteProgram(program);
+	for (const PendingStage & stage : pendingStages) gl::deleteShader(stage.shader);
+	GLState::getInstance().forgetProgram(program);
+	gl::deleteProgram(program);
 }
 
 Material::Material(
@@ -19,63 +29,198 @@ Material::Material(
 	Shader * fragmentShader,
 	Shader * geometryShader,
 	Shader * tessEvaluationShader,
-	Shader * tessControlShader) : name(_name)
+	Shader * tessControlShader,
+	ProgramCache * cache) : name(_name)
 {
 	assert(vertexShader != nullptr);
 	assert(fragmentShader != nullptr);
+	assert(vertexShader->shaderType == Shader::ShaderType::VERTEX);
+	assert(fragmentShader->shaderType == Shader::ShaderType::FRAGMENT);
+	assert(geometryShader == nullptr || geometryShader->shaderType == Shader::ShaderType::GEOMETRY);
+	assert(tessEvaluationShader == nullptr || tessEvaluationShader->shaderType == Shader::ShaderType::TESSELATION_EVALUATION);
+	assert(tessControlShader == nullptr || tessControlShader->shaderType == Shader::ShaderType::TESSELATION_CONTROL);
 
-	GLuint vertexShaderID, fragmentShaderID, geometryShaderID, tessEvaluationShaderID, tessControlShaderID;
-	program = glCreateProgram();
+	std::vector<Shader *> shaders = { vertexShader, fragmentShader };
+	if (geometryShader != nullptr) shaders.push_back(geometryShader);
+	if (tessEvaluationShader != nullptr) shaders.push_back(tessEvaluationShader);
+	if (tessControlShader != nullptr) shaders.push_back(tessControlShader);
+	createProgram(shaders, cache);
+}
 
-	// Vertex shader.
-	assert(vertexShader->shaderType == Shader::ShaderType::VERTEX);
-	vertexShaderID = vertexShader->compile();
-	glAttachShader(program, vertexShaderID);
+Material::Material(std::string _name, Shader * computeShader, ProgramCache * cache) : name(_name)
+{
+	assert(computeShader != nullptr);
+	assert(computeShader->shaderType == Shader::ShaderType::COMPUTE);
+	createProgram({ computeShader }, cache);
+}
 
-	// Fragment shader.
-	assert(fragmentShader->shaderType == Shader::ShaderType::FRAGMENT);
-	fragmentShaderID = fragmentShader->compile();
-	glAttachShader(program, fragmentShaderID);
-
-	// Geometry shader.
-	if (geometryShader != nullptr) {
-		assert(geometryShader->shaderType == Shader::ShaderType::GEOMETRY);
-		geometryShaderID = geometryShader->compile();
-		glAttachShader(program, geometryShaderID);
-	}
+void Material::createProgram(const std::vector<Shader *> & shaders, ProgramCache * _cache)
+{
+	program = gl::createProgram();
 
-	// Tesselation evaluation shader.
-	if (tessEvaluationShader != nullptr) {
-		assert(tessEvaluationShader->shaderType == Shader::ShaderType::TESSELATION_EVALUATION);
-		tessEvaluationShaderID = tessEvaluationShader->compile();
-		glAttachShader(program, tessEvaluationShaderID);
+	// A cached binary skips compiling and linking.
+	cache = _cache;
+	cacheKey = cache ? cache->key(shaders) : 0;
+	if (cache && cache->load(program, cacheKey)) {
+		std::cout << "- Material '" << name << "' (program " << program << ") loaded from the program cache." << std::endl;
+		reflectUniforms();
+		return;
 	}
 
-	// Tesselation control shader.
-	if (tessControlShader != nullptr) {
-		assert(tessControlShader->shaderType == Shader::ShaderType::TESSELATION_CONTROL);
-		tessControlShaderID = tessControlShader->compile();
-		glAttachShader(program, tessControlShaderID);
+	// Compiling and linking only start here, nothing waits for the driver until the program is resolved.
+	for (Shader * shader : shaders) {
+		const GLuint shaderID = shader->compile();
+		gl::attachShader(program, shaderID);
+		std::string files = shader->path; // Compile logs number the included files.
+		for (size_t i = 1; i < shader->getFiles().size(); ++i) files += "', " + std::to_string(i) + " = '" + shader->getFiles()[i];
+		pendingStages.push_back({ shaderID, files, shader->GetShaderTypeName() });
 	}
+	if (cache) cache->prepare(program);
+	gl::linkProgram(program);
+	pending = true;
+}
 
-	glLinkProgram(program);
+bool Material::isCompleted() const
+{
+	if (!pending) return true;
+	GLint completed = GL_FALSE;
+	gl::getProgramiv(program, GL_COMPLETION_STATUS_KHR, &completed);
+	return completed == GL_TRUE;
+}
+
+void Material::finishProgram() const
+{
+	pending = false;
 
 	// Check if we succeeded.
 	GLint success;
-	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	gl::getProgramiv(program, GL_LINK_STATUS, &success);
 	if (!success) {
+		// Every failing stage and the link log go to the report, the program stays unusable (every uniform is inactive).
 		GLchar log[1024];
-		glGetProgramInfoLog(program, 1024, nullptr, log);
-		std::cerr << "- Failed to link program and material '" << name << "' (" << program << ")." << std::endl;
-		std::cerr << "LOG: " << std::endl << log << std::endl;
+		for (const PendingStage & stage : pendingStages) {
+			GLint compiled;
+			gl::getShaderiv(stage.shader, GL_COMPILE_STATUS, &compiled);
+			if (compiled) continue;
+			gl::getShaderInfoLog(stage.shader, 1024, nullptr, log);
+			errors += "Failed to compile shader '" + stage.path + "' (" + stage.typeName + "):\n" + log + "\n";
+		}
+		gl::getProgramInfoLog(program, 1024, nullptr, log);
+		errors += "Failed to link program (" + std::to_string(program) + "):\n" + log + "\n";
+		std::cerr << "- Material '" << name << "' failed:" << std::endl << errors << std::endl;
 	}
 	else {
 		std::cout << "- Material '" << name << "' (program " << program << ") sucessfully created." << std::endl;
+		reflectUniforms();
+		if (cache) cache->store(program, cacheKey);
 	}
 
-	glDeleteShader(vertexShaderID);
-	glDeleteShader(fragmentShaderID);
-	if (geometryShader != nullptr) { glDeleteShader(geometryShaderID); }
-	if (tessControlShader != nullptr) { glDeleteShader(tessControlShaderID); }
-	if (tessEvaluationShader != nullptr) { glDeleteShader(tessEvaluationShaderID); }
+	for (const PendingStage & stage : pendingStages) gl::deleteShader(stage.shader);
+	pendingStages.clear();
+}
+
+// ----------------------
+// Uniforms.
+// ----------------------
+namespace {
+	// The 'material' struct members (see MaterialSetting::Locations).
+	const char * diffuseColorName = "material.diffuseColor";
+	const char * specularColorName = "material.specularColor";
+	const char * emissivityName = "material.emissivity";
+	const char * transparencyName = "material.transparency";
+	const char * refractiveIndexName = "material.refractiveIndex";
+	const char * specularReflectanceName = "material.specularReflectivity";
+	const char * diffuseReflectanceName = "material.diffuseReflectivity";
+	const char * specularDiffusionName = "material.specularDiffusion";
+
+	template<typename T> bool nameLess(const T & a, const char * b) { return std::strcmp(a.name.c_str(), b) < 0; }
+}
+
+void Material::reflectUniforms() const
+{
+	GLint count = 0;
+	gl::getProgramInterfaceiv(program, GL_UNIFORM, GL_ACTIVE_RESOURCES, &count);
+	const GLenum properties[4] = { GL_NAME_LENGTH, GL_LOCATION, GL_ARRAY_SIZE, GL_BLOCK_INDEX };
+	std::vector<char> buffer;
+	for (GLint i = 0; i < count; ++i) {
+		GLint values[4];
+		gl::getProgramResourceiv(program, GL_UNIFORM, i, 4, properties, 4, nullptr, values);
+		const GLint location = values[1], size = values[2];
+		if (location < 0 || values[3] != -1) continue; // Members of uniform blocks have no location.
+		buffer.resize(values[0]);
+		gl::getProgramResourceName(program, GL_UNIFORM, i, values[0], nullptr, buffer.data());
+		const std::string uniformName(buffer.data());
+
+		// Arrays of basic types are reported once, as "name[0]", with consecutive locations.
+		const bool array = uniformName.size() > 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0;
+		if (!array) {
+			uniforms.push_back({ uniformName, location });
+			continue;
+		}
+		const std::string base = uniformName.substr(0, uniformName.size() - 3);
+		uniforms.push_back({ base, location });
+		for (GLint element = 0; element < size; ++element) uniforms.push_back({ base + "[" + std::to_string(element) + "]", location + element });
+	}
+	std::sort(uniforms.begin(), uniforms.end(), [](const Uniform & a, const Uniform & b) { return a.name < b.name; });
+
+	// Array elements, by the name without indices and their first index.
+	for (const Uniform & uniform : uniforms) {
+		const size_t open = uniform.name.find('[');
+		if (open == std::string::npos) continue;
+		std::string arrayName;
+		size_t index = 0;
+		bool first = true;
+		for (size_t c = 0; c < uniform.name.size(); ++c) {
+			arrayName += uniform.name[c];
+			if (uniform.name[c] != '[') continue;
+			const size_t close = uniform.name.find(']', c);
+			if (first) index = std::stoul(uniform.name.substr(c + 1, close - c - 1));
+			first = false;
+			c = close - 1;
+		}
+		auto it = std::lower_bound(uniformArrays.begin(), uniformArrays.end(), arrayName.c_str(), nameLess<UniformArray>);
+		if (it == uniformArrays.end() || it->name != arrayName) it = uniformArrays.insert(it, { arrayName, std::vector<GLint>() });
+		if (it->locations.size() <= index) it->locations.resize(index + 1, -1);
+		it->locations[index] = uniform.location;
+	}
+
+	for (const GLenum blockInterface : { GL_UNIFORM_BLOCK, GL_SHADER_STORAGE_BLOCK }) {
+		gl::getProgramInterfaceiv(program, blockInterface, GL_ACTIVE_RESOURCES, &count);
+		for (GLint i = 0; i < count; ++i) {
+			const GLenum property = GL_NAME_LENGTH;
+			GLint length = 0;
+			gl::getProgramResourceiv(program, blockInterface, i, 1, &property, 1, nullptr, &length);
+			buffer.resize(length);
+			gl::getProgramResourceName(program, blockInterface, i, length, nullptr, buffer.data());
+			blocks.push_back(buffer.data());
+		}
+	}
+
+	materialSettingLocations = {
+		getUniformLocation(diffuseColorName), getUniformLocation(specularColorName),
+		getUniformLocation(emissivityName), getUniformLocation(specularReflectanceName),
+		getUniformLocation(diffuseReflectanceName), getUniformLocation(specularDiffusionName),
+		getUniformLocation(transparencyName), getUniformLocation(refractiveIndexName)
+	};
+}
+
+GLint Material::getUniformLocation(const char * uniformName) const
+{
+	resolve();
+	const auto it = std::lower_bound(uniforms.begin(), uniforms.end(), uniformName, nameLess<Uniform>);
+	return it != uniforms.end() && std::strcmp(it->name.c_str(), uniformName) == 0 ? it->location : -1;
+}
+
+bool Material::hasBlock(const char * blockName) const
+{
+	resolve();
+	return std::find(blocks.begin(), blocks.end(), blockName) != blocks.end();
+}
+
+GLint Material::getUniformLocation(const char * arrayName, const size_t index) const
+{
+	resolve();
+	const auto it = std::lower_bound(uniformArrays.begin(), uniformArrays.end(), arrayName, nameLess<UniformArray>);
+	if (it == uniformArrays.end() || std::strcmp(it->name.c_str(), arrayName) != 0 || index >= it->locations.size()) return -1;
+	return it->locations[index];
 }
\ No newline at end of file
@@ -4,13 +4,18 @@
 #include <vector>
 #include <memory>
 #include <unordered_map>
+#include <cstdint>
 
 #define GLEW_STATIC
 #include <glew.h>
 #include <glfw3.h>
 #include <glm.hpp>
 
+#include "MaterialSetting.h"
+#include "../Device/GLDevice.h"
+
 class Shader;
+class ProgramCache;
 
 /// <summary> Represents a material that references a gl program, textures and settings. </summary>
 class Material {
@@ -21,11 +26,95 @@ public:
 		Shader * fragmentShader,
 		Shader * geometryShader = nullptr,
 		Shader * tessEvaluationShader = nullptr,
-		Shader * tessControlShader = nullptr);
+		Shader * tessControlShader = nullptr,
+		ProgramCache * cache = nullptr);
+
+	/// <summary> Creates a compute material (a program with a single compute shader). </summary>
+	Material(std::string _name, Shader * computeShader, ProgramCache * cache = nullptr);
 
 	/// <summary> The actual OpenGL / GLSL program identifier. </summary>
 	GLuint program;
 
 	/// <summary> A name. Just an identifier. Doesn't do anything practical. </summary>
 	std::string name;
+
+	// ----------------
+	// Program creation.
+	// ----------------
+	/// <summary> Programs compile and link in the background (in parallel with KHR_parallel_shader_compile, see MaterialStore)
+	/// and are resolved the first time a uniform or block is looked up: that waits for the driver, reports errors and
+	/// builds the uniform tables. The program can be bound before that. </summary>
+	void resolve() const { if (pending) finishProgram(); }
+
+	/// <summary> True when the driver is done with the program, without waiting. Needs KHR_parallel_shader_compile. </summary>
+	bool isCompleted() const;
+
+	bool isResolved() const { return !pending; }
+
+	/// <summary> The compile and link logs of a program that failed, empty otherwise. Known once resolved. </summary>
+	const std::string & getErrors() const { return errors; }
+
+	// ----------------
+	// Uniforms.
+	// ----------------
+	/// <summary> The location of an active uniform ("settings.shadows", "pointLights[2].color", "lightVisibility[1]"), or -1.
+	/// Looked up in the table built after linking, never in the driver. </summary>
+	GLint getUniformLocation(const char * uniformName) const;
+
+	/// <summary> The location of an element of an array, or -1. Arrays are named with empty brackets ("pointLights[].position",
+	/// "lightVisibility[]") and indexed by their first index. </summary>
+	GLint getUniformLocation(const char * arrayName, const size_t index) const;
+
+	/// <summary> True if the program declares a uniform or shader storage block with this name (see 'ShaderBlocks.h'). </summary>
+	bool hasBlock(const char * blockName) const;
+
+	/// <summary> The locations of the 'material' struct (see MaterialSetting::Upload). </summary>
+	const MaterialSetting::Locations & getMaterialSettingLocations() const { resolve(); return materialSettingLocations; }
+
+	// Typed setters. They write to this program whether it's in use or not, and ignore inactive uniforms (location -1).
+	void setUniform(const GLint location, const int value) const { gl::programUniform1i(program, location, value); }
+	void setUniform(const GLint location, const float value) const { gl::programUniform1f(program, location, value); }
+	void setUniform(const GLint location, const glm::vec2 & value) const { gl::programUniform2fv(program, location, 1, &value[0]); }
+	void setUniform(const GLint location, const glm::vec3 & value) const { gl::programUniform3fv(program, location, 1, &value[0]); }
+	void setUniform(const GLint location, const glm::vec4 & value) const { gl::programUniform4fv(program, location, 1, &value[0]); }
+	void setUniform(const GLint location, const glm::mat4 & value) const { gl::programUniformMatrix4fv(program, location, 1, GL_FALSE, &value[0][0]); }
+	template<typename T> void setUniform(const char * uniformName, const T & value) const { setUniform(getUniformLocation(uniformName), value); }
+private:
+	/// <summary> An active uniform outside of uniform blocks. </summary>
+	struct Uniform {
+		std::string name;
+		GLint location;
+	};
+
+	/// <summary> The locations of the elements of an array (-1 for inactive elements). </summary>
+	struct UniformArray {
+		std::string name;
+		std::vector<GLint> locations;
+	};
+
+	// Built when the program is resolved.
+	mutable std::vector<Uniform> uniforms; // Sorted by name.
+	mutable std::vector<UniformArray> uniformArrays; // Sorted by name.
+	mutable std::vector<std::string> blocks; // Uniform and shader storage blocks.
+	mutable MaterialSetting::Locations materialSettingLocations;
+
+	/// <summary> A stage of a program that hasn't been resolved yet. </summary>
+	struct PendingStage {
+		GLuint shader;
+		std::string path, typeName;
+	};
+	mutable bool pending = false;
+	mutable std::vector<PendingStage> pendingStages;
+	mutable std::string errors;
+	ProgramCache * cache = nullptr; // Gets the binary once the program linked.
+	uint64_t cacheKey = 0;
+
+	/// <summary> Loads the program from the cache, or starts compiling and linking it. </summary>
+	void createProgram(const std::vector<Shader *> & shaders, ProgramCache * cache);
+
+	/// <summary> Waits for the link, reports errors or reflects the uniforms (and stores the binary in the cache). </summary>
+	void finishProgram() const;
+
+	/// <summary> Builds the uniform tables from the active uniforms of the linked program. </summary>
+	void reflectUniforms() const;
 };
\ No newline at end of file
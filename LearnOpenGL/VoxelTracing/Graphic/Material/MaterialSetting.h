@@ -6,16 +6,10 @@
 #include <gtc/type_ptr.hpp>
 #include <glm.hpp>
 
-namespace {
-	const char * diffuseColorName = "material.diffuseColor";
-	const char * specularColorName = "material.specularColor";
-	const char * emissivityName = "material.emissivity";
-	const char * transparencyName = "material.transparency";
-	const char * refractiveIndexName = "material.refractiveIndex";
-	const char * specularReflectanceName = "material.specularReflectivity";
-	const char * diffuseReflectanceName = "material.diffuseReflectivity";
-	const char * specularDiffusionName = "material.specularDiffusion";
-}
+#include <array>
+
+#include "../Device/GLDevice.h"
+#include "../../Utility/ChangeSnapshot.h"
 
 /// <summary> Represents a setting for a material that can be used along with voxel cone tracing GI. </summary>
 struct MaterialSetting {
@@ -23,24 +17,34 @@ struct MaterialSetting {
 	float specularReflectivity, diffuseReflectivity, emissivity, specularDiffusion = 2.0f;
 	float transparency = 0.0f, refractiveIndex = 1.4f;
 
-	void Upload(GLuint program, bool useProgram = true) {
-		if (useProgram) glUseProgram(program);
+	/// <summary> Locations of the 'material' struct members in a program, found once (see Material::getMaterialSettingLocations). </summary>
+	struct Locations {
+		GLint diffuseColor, specularColor, emissivity, specularReflectivity, diffuseReflectivity, specularDiffusion, transparency, refractiveIndex;
+	};
 
+	void Upload(GLuint program, const Locations & locations) const {
 		// Vec3s.
-		glUniform3fv(glGetUniformLocation(program, diffuseColorName), 1, glm::value_ptr(diffuseColor));
-		glUniform3fv(glGetUniformLocation(program, specularColorName), 1, glm::value_ptr(specularColor));
+		gl::programUniform3fv(program, locations.diffuseColor, 1, glm::value_ptr(diffuseColor));
+		gl::programUniform3fv(program, locations.specularColor, 1, glm::value_ptr(specularColor));
 
 		// Floats.
-		glUniform1f(glGetUniformLocation(program, emissivityName), emissivity);
-		glUniform1f(glGetUniformLocation(program, specularReflectanceName), specularReflectivity);
-		glUniform1f(glGetUniformLocation(program, diffuseReflectanceName), diffuseReflectivity);
-		glUniform1f(glGetUniformLocation(program, specularDiffusionName), specularDiffusion);
-		glUniform1f(glGetUniformLocation(program, transparencyName), transparency);
-		glUniform1f(glGetUniformLocation(program, refractiveIndexName), refractiveIndex);
+		gl::programUniform1f(program, locations.emissivity, emissivity);
+		gl::programUniform1f(program, locations.specularReflectivity, specularReflectivity);
+		gl::programUniform1f(program, locations.diffuseReflectivity, diffuseReflectivity);
+		gl::programUniform1f(program, locations.specularDiffusion, specularDiffusion);
+		gl::programUniform1f(program, locations.transparency, transparency);
+		gl::programUniform1f(program, locations.refractiveIndex, refractiveIndex);
 	}
 
 	bool IsEmissive() { return emissivity > 0.00001f; }
 
+	/// <summary> Takes a new version if a setting changed since the last call. Called once per frame (see Graphics::updateVersions). </summary>
+	bool updateVersion() {
+		return snapshot.update({ diffuseColor.x, diffuseColor.y, diffuseColor.z, specularColor.x, specularColor.y, specularColor.z,
+			specularReflectivity, diffuseReflectivity, emissivity, specularDiffusion, transparency, refractiveIndex });
+	}
+	unsigned int getVersion() const { return snapshot.getVersion(); }
+
 	// Basic constructor.
 	MaterialSetting(
 		glm::vec3 _diffuseColor = glm::vec3(1),
@@ -100,4 +104,6 @@ struct MaterialSetting {
 			1.0f
 		);
 	}
+private:
+	ChangeSnapshot<std::array<float, 12>> snapshot;
 };
\ No newline at end of file
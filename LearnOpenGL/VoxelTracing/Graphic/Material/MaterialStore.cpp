@@ -1,14 +1,27 @@
 #include "MaterialStore.h"
 
 #include <iostream>
+#include <chrono>
+#include <cassert>
 
 #include "Material.h"
 #include "Shader.h"
+#include "ProgramCache.h"
 
 MaterialStore::MaterialStore()
 {
+	startTime = std::chrono::high_resolution_clock::now();
+	programCache = new ProgramCache(PROGRAM_CACHE_PATH);
+
+	// Every program is submitted at once and compiles while the scene loads, see Material::resolve.
+	parallelCompile = GLEW_KHR_parallel_shader_compile == GL_TRUE;
+	if (parallelCompile) gl::maxShaderCompilerThreadsKHR(0xFFFFFFFF); // As many threads as the driver likes.
+
 	// Voxelization.
 	AddNewMaterial("voxelization", "Voxelization\\voxelization.vert", "Voxelization\\voxelization.frag", "Voxelization\\voxelization.geom");
+	AddNewComputeMaterial("voxel_mipmap", "Voxelization\\voxel_mipmap.comp");
+	AddNewComputeMaterial("voxel_distance_field", "Voxelization\\voxel_distance_field.comp");
+	AddNewComputeMaterial("voxel_occupancy", "Voxelization\\voxel_occupancy.comp");
 
 	// Voxelization visualization.
 	AddNewMaterial("voxel_visualization", "Voxelization\\Visualization\\voxel_visualization.vert", "Voxelization\\Visualization\\voxel_visualization.frag");
@@ -16,6 +29,30 @@ MaterialStore::MaterialStore()
 
 	// Cone tracing.
 	AddNewMaterial("voxel_cone_tracing", "Voxel Cone Tracing\\voxel_cone_tracing.vert", "Voxel Cone Tracing\\voxel_cone_tracing.frag");
+
+	// Reduced resolution indirect diffuse light.
+	AddNewMaterial("geometry_buffer", "Voxel Cone Tracing\\geometry_buffer.vert", "Voxel Cone Tracing\\geometry_buffer.frag");
+	// Specialized for the indirect diffuse settings (see Graphics::IndirectDiffuseFeature for the bit order).
+	AddNewPermutations("indirect_diffuse", { "TEMPORAL", "IRRADIANCE_PROBES" },
+		"Voxel Cone Tracing\\geometry_buffer.vert", "Voxel Cone Tracing\\indirect_diffuse.frag");
+	AddNewMaterial("indirect_upsample", "Voxel Cone Tracing\\indirect_upsample.vert", "Voxel Cone Tracing\\indirect_upsample.frag");
+	AddNewMaterial("indirect_denoise", "Voxel Cone Tracing\\indirect_upsample.vert", "Voxel Cone Tracing\\indirect_denoise.frag");
+
+	// Irradiance probes.
+	AddNewComputeMaterial("irradiance_probes", "Voxel Cone Tracing\\irradiance_probes.comp");
+
+	// Cached shadows.
+	AddNewComputeMaterial("light_visibility", "Voxel Cone Tracing\\light_visibility.comp");
+
+	// Screen space reflections.
+	AddNewComputeMaterial("hi_z", "Voxel Cone Tracing\\hi_z.comp");
+	AddNewMaterial("specular_reflections", "Voxel Cone Tracing\\geometry_buffer.vert", "Voxel Cone Tracing\\specular_reflections.frag");
+
+	// Compiled programs are only submitted here, the startup cost is known once they are resolved (see reportStartup).
+	// Their binaries are saved then (see report and the destructor).
+	programCache->save();
+	const double took = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+	std::cout << "- " << materials.size() << " materials submitted in " << took << " ms." << std::endl;
 }
 
 void MaterialStore::AddNewMaterial(
@@ -32,10 +69,101 @@ void MaterialStore::AddNewMaterial(
 	if (geometryPath) { g = new Shader(shaderPath + geometryPath, ST::GEOMETRY); }
 	if (tessEvalPath) { te = new Shader(shaderPath + tessEvalPath, ST::TESSELATION_EVALUATION); }
 	if (tessCtrlPath) { tc = new Shader(shaderPath + tessCtrlPath, ST::TESSELATION_CONTROL); }
-	materials.push_back(new Material(name, v, f, g, te, tc));
+	materials.push_back(new Material(name, v, f, g, te, tc, programCache));
 	delete v, f, g, te, tc;
 }
 
+void MaterialStore::AddNewComputeMaterial(std::string name, const char * computePath)
+{
+	Shader * c = new Shader("Shaders\\" + std::string(computePath), Shader::ShaderType::COMPUTE);
+	materials.push_back(new Material(name, c, programCache));
+	delete c;
+}
+
+void MaterialStore::AddNewPermutations(std::string name, std::vector<std::string> features, const char * vertexPath, const char * fragmentPath)
+{
+	assert(features.size() < 32);
+	permutations[name] = { features, vertexPath, fragmentPath, std::unordered_map<unsigned int, Material *>() };
+}
+
+Material * MaterialStore::findPermutation(const std::string & name, unsigned int features)
+{
+	const auto it = permutations.find(name);
+	if (it == permutations.end()) {
+		std::cerr << "Couldn't find permutations with name " << name << std::endl;
+		return nullptr;
+	}
+	Permutations & program = it->second;
+	features &= (1u << program.features.size()) - 1;
+	Material *& permutation = program.built[features];
+	if (permutation) return permutation;
+
+	// Every feature is defined either way, shaders test them with '#if'.
+	std::vector<std::string> defines;
+	std::string permutationName = name + " [";
+	for (size_t i = 0; i < program.features.size(); ++i) {
+		const bool enabled = (features >> i & 1) != 0;
+		defines.push_back(program.features[i] + (enabled ? " 1" : " 0"));
+		if (enabled) permutationName += (permutationName.back() == '[' ? "" : " ") + program.features[i];
+	}
+	permutationName += "]";
+
+	const std::string shaderPath = "Shaders\\";
+	Shader v(shaderPath + program.vertexPath, Shader::ShaderType::VERTEX, defines);
+	Shader f(shaderPath + program.fragmentPath, Shader::ShaderType::FRAGMENT, defines);
+	permutation = new Material(permutationName, &v, &f, nullptr, nullptr, nullptr, programCache);
+	materials.push_back(permutation);
+	return permutation;
+}
+
+void MaterialStore::report()
+{
+	unsigned int ready = 0, compiling = 0;
+	std::string failed;
+	for (Material * material : materials) {
+		if (!material->isResolved() && parallelCompile && !material->isCompleted()) {
+			++compiling;
+			continue;
+		}
+		material->resolve();
+		if (material->getErrors().empty()) ++ready;
+		else failed += " '" + material->name + "'";
+	}
+	programCache->save();
+	std::cout << "- Materials: " << ready << " ready, " << compiling << " still compiling." << std::endl;
+	if (!failed.empty()) std::cerr << "- Materials that failed (see the log above):" << failed << std::endl;
+	if (!startupReported) startupPending = true;
+	reportStartup();
+}
+
+void MaterialStore::poll()
+{
+	if (!startupPending) return;
+	for (Material * material : materials) if (!material->isResolved() && material->isCompleted()) material->resolve();
+	reportStartup();
+}
+
+void MaterialStore::reportStartup()
+{
+	if (!startupPending) return;
+	for (const Material * material : materials) if (!material->isResolved()) return;
+	startupPending = false;
+	startupReported = true;
+	programCache->save();
+
+	// Cold (compiled) or warm (from the program cache).
+	const double took = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+	std::cout << "- Every program ready " << took << " ms after startup";
+	if (programCache->isEnabled()) {
+		std::cout << " (" << programCache->getHits() << " from the program cache, " << programCache->getMisses() << " compiled, " <<
+			programCache->getRejected() << " rejected by the driver and compiled)";
+	}
+	else {
+		std::cout << " (no program binary formats, the program cache is off)";
+	}
+	std::cout << "." << std::endl;
+}
+
 Material * MaterialStore::findMaterialWithName(std::string name)
 {
 	for (unsigned int i = 0; i < materials.size(); ++i) {
@@ -65,8 +193,10 @@ MaterialStore& MaterialStore::getInstance()
 }
 
 MaterialStore::~MaterialStore() {
+	if (programCache) programCache->save(true); // Programs resolved since the last report, without the ones this run didn't use.
 	for (unsigned int i = 0; i < materials.size(); ++i)
 	{
 		delete materials[i];
 	}
+	if (programCache) delete programCache;
 }
\ No newline at end of file
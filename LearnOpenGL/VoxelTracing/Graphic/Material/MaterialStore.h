@@ -1,8 +1,12 @@
 #pragma once
 
 #include <vector>
+#include <string>
+#include <chrono>
+#include <unordered_map>
 
 class Material;
+class ProgramCache;
 
 /// <summary> Manages all loaded materials and shader programs. </summary>
 class MaterialStore {
@@ -14,8 +18,42 @@ public:
 	void AddNewMaterial(
 		std::string name, const char * vertexPath = nullptr, const char * fragmentPath = nullptr,
 		const char * geometryPath = nullptr, const char * tessEvalPath = nullptr, const char * tessCtrlPath = nullptr);
+	void AddNewComputeMaterial(std::string name, const char * computePath);
+
+	/// <summary> Registers a program that is specialized at compile time: feature i is injected as '#define <features[i]> 1'
+	/// in the permutations where bit i is set ('0' otherwise), so disabled features are compiled out. </summary>
+	void AddNewPermutations(std::string name, std::vector<std::string> features, const char * vertexPath, const char * fragmentPath);
+	/// <summary> The permutation of a program for a feature bitmask. It is built (and added to the materials) the first time it is asked for. </summary>
+	Material * findPermutation(const std::string & name, unsigned int features);
+
+	/// <summary> Prints how many programs are ready, still compiling or failed. Doesn't wait for programs that are still
+	/// compiling when KHR_parallel_shader_compile can tell (otherwise every program is resolved). </summary>
+	void report();
+	/// <summary> Once per frame until every startup program is resolved: resolves the programs the driver finished
+	/// (without waiting), then prints the startup cost. </summary>
+	void poll();
 	~MaterialStore();
 private:
+	/// <summary> Program binaries from earlier runs (see ProgramCache). </summary>
+	const char * PROGRAM_CACHE_PATH = "Shaders\\program_cache.bin";
+	ProgramCache * programCache = nullptr;
+	bool parallelCompile = false; // KHR_parallel_shader_compile.
+
+	/// <summary> Prints the startup cost (from the store's creation until every program is resolved) and the program cache
+	/// hits and misses, once, the first time nothing is left compiling after the first report (every startup program
+	/// was submitted by then). The cold and warm cache numbers to compare. </summary>
+	void reportStartup();
+	std::chrono::high_resolution_clock::time_point startTime;
+	bool startupPending = false; // Between the first report and reportStartup.
+	bool startupReported = false;
+
+	struct Permutations {
+		std::vector<std::string> features;
+		std::string vertexPath, fragmentPath;
+		std::unordered_map<unsigned int, Material *> built; // By feature bitmask.
+	};
+	std::unordered_map<std::string, Permutations> permutations;
+
 	MaterialStore();
 	MaterialStore(MaterialStore const &) = delete;
 	void operator=(MaterialStore const &) = delete;
@@ -0,0 +1,137 @@
+#include "ProgramCache.h"
+
+#include <iostream>
+#include <fstream>
+#include <utility>
+
+#include "Shader.h"
+#include "../Device/GLDevice.h"
+
+namespace {
+	void hash(uint64_t & h, const void * data, const size_t size) {
+		for (size_t i = 0; i < size; ++i) h = (h ^ static_cast<const unsigned char *>(data)[i]) * 1099511628211ull; // FNV-1a.
+	}
+
+	template<typename T> bool read(std::istream & stream, T & value) {
+		return bool(stream.read(reinterpret_cast<char *>(&value), sizeof(T)));
+	}
+
+	template<typename T> void write(std::ostream & stream, const T & value) {
+		stream.write(reinterpret_cast<const char *>(&value), sizeof(T));
+	}
+
+	std::string glString(const GLenum name) {
+		const GLubyte * value = gl::getString(name);
+		return value ? reinterpret_cast<const char *>(value) : "";
+	}
+}
+
+ProgramCache::ProgramCache(const std::string & _path) : path(_path)
+{
+	GLint formats = 0;
+	gl::getIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	enabled = formats > 0;
+	if (!enabled) return;
+	driver = glString(GL_VENDOR) + "\n" + glString(GL_RENDERER) + "\n" + glString(GL_VERSION);
+
+	std::ifstream file(path, std::ios::in | std::ios::binary);
+	if (!file.is_open()) return;
+	uint32_t magic = 0, version = 0, count = 0;
+	if (!read(file, magic) || !read(file, version) || !read(file, count) || magic != MAGIC || version != FORMAT_VERSION) return;
+	for (uint32_t i = 0; i < count; ++i) {
+		uint64_t key;
+		uint32_t format, size;
+		if (!read(file, key) || !read(file, format) || !read(file, size) || size > MAX_BINARY_SIZE) break;
+		Entry entry = { GLenum(format), std::vector<char>(size), false };
+		if (!file.read(entry.binary.data(), size)) break;
+		entries[key] = std::move(entry);
+	}
+}
+
+uint64_t ProgramCache::key(const std::vector<Shader *> & shaders) const
+{
+	uint64_t h = 14695981039346656037ull;
+	hash(h, driver.data(), driver.size());
+	for (const Shader * shader : shaders) {
+		const GLenum type = shader->shaderType;
+		const std::string & source = shader->getSource();
+		const uint64_t length = source.size();
+		hash(h, &type, sizeof(type));
+		hash(h, &length, sizeof(length));
+		hash(h, source.data(), source.size());
+	}
+	return h;
+}
+
+bool ProgramCache::load(const GLuint program, const uint64_t key)
+{
+	if (!enabled) return false;
+	auto it = entries.find(key);
+	if (it == entries.end()) {
+		++misses;
+		return false;
+	}
+
+	Entry & entry = it->second;
+	gl::programBinary(program, entry.format, entry.binary.data(), GLsizei(entry.binary.size()));
+	GLint success = GL_FALSE;
+	gl::getProgramiv(program, GL_LINK_STATUS, &success);
+	if (!success) {
+		// Another driver build can reject the binary, the caller links from source and stores a new one.
+		++rejected;
+		entries.erase(it);
+		dirty = true;
+		return false;
+	}
+	entry.used = true;
+	++hits;
+	return true;
+}
+
+void ProgramCache::prepare(const GLuint program) const
+{
+	if (enabled) gl::programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+void ProgramCache::store(const GLuint program, const uint64_t key)
+{
+	if (!enabled) return;
+	GLint length = 0;
+	gl::getProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) return;
+
+	Entry entry = { GL_NONE, std::vector<char>(length), true };
+	GLsizei written = 0;
+	gl::getProgramBinary(program, length, &written, &entry.format, entry.binary.data());
+	if (written <= 0) return;
+	entry.binary.resize(written);
+	entries[key] = std::move(entry);
+	dirty = true;
+}
+
+void ProgramCache::save(const bool prune)
+{
+	if (!enabled) return;
+	for (auto it = entries.begin(); prune && it != entries.end();) {
+		if (it->second.used) { ++it; continue; }
+		it = entries.erase(it);
+		dirty = true;
+	}
+	if (!dirty) return;
+
+	std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		std::cerr << "Couldn't write the program cache '" << path << "'." << std::endl;
+		return;
+	}
+	write(file, uint32_t(MAGIC));
+	write(file, uint32_t(FORMAT_VERSION));
+	write(file, uint32_t(entries.size()));
+	for (const auto & entry : entries) {
+		write(file, entry.first);
+		write(file, uint32_t(entry.second.format));
+		write(file, uint32_t(entry.second.binary.size()));
+		file.write(entry.second.binary.data(), entry.second.binary.size());
+	}
+	dirty = false;
+}
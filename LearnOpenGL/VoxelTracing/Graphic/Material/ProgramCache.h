@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+#define GLEW_STATIC
+#include <glew.h>
+
+class Shader;
+
+/// <summary> Linked program binaries (glGetProgramBinary) kept on disk between runs, so a warm start skips compiling and linking.
+/// Entries are keyed by a hash of the stage types and sources and of the driver's vendor, renderer and version strings, so
+/// editing a shader or updating the driver misses the cache. A binary the driver rejects is compiled from source again.
+/// Everything lives in one file, written by save. The last save (at exit) drops the entries that weren't used since the cache was opened. </summary>
+class ProgramCache {
+public:
+	/// <summary> Opens the cache file (a missing or unreadable file is an empty cache). Needs a current context. </summary>
+	ProgramCache(const std::string & path);
+
+	/// <summary> The key of a program made of these shaders on this driver. </summary>
+	uint64_t key(const std::vector<Shader *> & shaders) const;
+
+	/// <summary> Loads the cached binary into program. False if there is none or the driver rejected it (the program must then be linked). </summary>
+	bool load(const GLuint program, const uint64_t key);
+
+	/// <summary> Call before linking a program that will be stored. </summary>
+	void prepare(const GLuint program) const;
+
+	/// <summary> Keeps the binary of a linked program. </summary>
+	void store(const GLuint program, const uint64_t key);
+
+	/// <summary> Writes the file if anything changed. Prune drops the entries that weren't used since the cache was opened first: only
+	/// prune once no more programs will be asked for, otherwise the binaries of programs built later (permutations) are lost. </summary>
+	void save(const bool prune = false);
+
+	/// <summary> False if the driver supports no binary formats (nothing is cached then). </summary>
+	bool isEnabled() const { return enabled; }
+
+	unsigned int getHits() const { return hits; }
+	unsigned int getMisses() const { return misses; }
+	unsigned int getRejected() const { return rejected; }
+private:
+	static const uint32_t MAGIC = 0x43504356; // "VCPC".
+	static const uint32_t FORMAT_VERSION = 1;
+	static const uint32_t MAX_BINARY_SIZE = 64 << 20; // Larger sizes mean the file is corrupt.
+
+	struct Entry {
+		GLenum format;
+		std::vector<char> binary;
+		bool used;
+	};
+
+	std::string path, driver;
+	std::unordered_map<uint64_t, Entry> entries;
+	bool enabled = false, dirty = false;
+	unsigned int hits = 0, misses = 0, rejected = 0;
+};
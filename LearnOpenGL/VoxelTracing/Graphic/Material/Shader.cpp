@@ -3,51 +3,92 @@
 #include <cassert>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <vector>
+#include <cstring>
+
+#include "../Device/GLDevice.h"
 
 GLuint Shader::compile() {
-	// Create and compile shader.
-	GLuint id = glCreateShader(shaderType);
-	const char * source = rawShader.c_str();
-	glShaderSource(id, 1, &source, nullptr);
-	glCompileShader(id);
-
-	// Check if we succeeded.
-	std::string typeName = " (" + GetShaderTypeName() + ")";
-	GLint success;
-	glGetShaderiv(id, GL_COMPILE_STATUS, &success);
-	if (!success) {
-		GLchar log[1024];
-		glGetShaderInfoLog(id, 1024, nullptr, log);
-		std::cerr << "- Failed to compile shader '" << path << "' : " << shaderType << typeName << "!" << std::endl;
-		std::cerr << "LOG: " << std::endl << log << std::endl;
-		std::getchar();
-		return 0;
-	}
+	GLuint id = gl::createShader(shaderType);
 	if (id == 0) {
-		std::cerr << "- Could not compile shader '" << path << "' : " << shaderType << typeName << "!" << std::endl;
-		std::getchar();
+		std::cerr << "- Could not create shader '" << path << "' : " << shaderType << " (" << GetShaderTypeName() << ")!" << std::endl;
 		return 0;
 	}
-	std::cout << "- Shader '" << path << "' : " << shaderType << typeName << " compiled successfully." << std::endl;
+	const char * source = rawShader.c_str();
+	gl::shaderSource(id, 1, &source, nullptr);
+	gl::compileShader(id);
 	return id;
 }
 
-Shader::Shader(std::string _path, ShaderType _type) : path(_path), shaderType(_type) {
+Shader::Shader(std::string _path, ShaderType _type, const std::vector<std::string> & defines) : path(_path), shaderType(_type) {
 	// Load the shader instantly.
-	std::ifstream fileStream(path, std::ios::in);
-	if (!fileStream.is_open()) {
-		std::cerr << "Couldn't load shader '" + std::string(path) + "'." << std::endl;
-		fileStream.close();
-		return;
+	appendFile(path, defines, 0);
+}
+
+// ----------------------
+// Preprocessing.
+// ----------------------
+namespace {
+	bool startsWith(const std::string & line, const size_t offset, const char * directive) {
+		return line.compare(offset, std::strlen(directive), directive) == 0;
 	}
-	std::string line = "";
-	rawShader = "";
-	while (!fileStream.eof()) {
-		std::getline(fileStream, line);
-		rawShader.append(line + "\n");
+
+	std::string directoryOf(const std::string & filePath) {
+		const size_t separator = filePath.find_last_of("\\/");
+		return separator == std::string::npos ? "" : filePath.substr(0, separator + 1);
+	}
+
+	std::string lineDirective(const int line, const size_t file) {
+		return "#line " + std::to_string(line) + " " + std::to_string(file) + "\n";
 	}
+}
+
+bool Shader::appendFile(const std::string & filePath, const std::vector<std::string> & defines, const int depth)
+{
+	if (depth > MAX_INCLUDE_DEPTH) {
+		std::cerr << "Includes of shader '" << path << "' are nested too deep (does '" << filePath << "' include itself?)." << std::endl;
+		return false;
+	}
+	std::ifstream fileStream(filePath, std::ios::in);
+	if (!fileStream.is_open()) {
+		std::cerr << "Couldn't load shader '" + filePath + "'." << std::endl;
+		return false;
+	}
+	std::ostringstream contents;
+	contents << fileStream.rdbuf(); // The whole file at once.
 	fileStream.close();
+
+	const size_t file = files.size();
+	files.push_back(filePath);
+	if (depth > 0) rawShader += lineDirective(1, file);
+
+	std::istringstream lines(contents.str());
+	std::string line;
+	bool defined = defines.empty();
+	for (int lineNumber = 1; std::getline(lines, line); ++lineNumber) {
+		const size_t first = line.find_first_not_of(" \t");
+		if (first != std::string::npos && startsWith(line, first, "#include")) {
+			const size_t open = line.find('"', first), close = open == std::string::npos ? open : line.find('"', open + 1);
+			if (close == std::string::npos) {
+				std::cerr << "Malformed include in shader '" << filePath << "' (line " << lineNumber << ")." << std::endl;
+				return false;
+			}
+			if (!appendFile(directoryOf(filePath) + line.substr(open + 1, close - open - 1), defines, depth + 1)) return false;
+			rawShader += lineDirective(lineNumber + 1, file);
+			continue;
+		}
+		rawShader += line + "\n";
+
+		// Defines can only follow the version.
+		if (depth == 0 && !defined && first != std::string::npos && startsWith(line, first, "#version")) {
+			for (const std::string & define : defines) rawShader += "#define " + define + "\n";
+			rawShader += lineDirective(lineNumber + 1, file);
+			defined = true;
+		}
+	}
+	if (depth == 0 && !defined) std::cerr << "Shader '" << filePath << "' has no #version, its defines were dropped." << std::endl;
+	return true;
 }
 
 std::string Shader::GetShaderTypeName()
@@ -58,6 +99,7 @@ std::string Shader::GetShaderTypeName()
 	case ShaderType::GEOMETRY:					return "geometry";
 	case ShaderType::TESSELATION_CONTROL:		return "tesselation control";
 	case ShaderType::TESSELATION_EVALUATION:	return "tesselation evaluation";
+	case ShaderType::COMPUTE:					return "compute";
 	default:									return "unknown";
 	}
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 #define GLEW_STATIC
 #include <glew.h>
@@ -14,7 +15,8 @@ public:
 		FRAGMENT = GL_FRAGMENT_SHADER,
 		GEOMETRY = GL_GEOMETRY_SHADER,
 		TESSELATION_EVALUATION = GL_TESS_EVALUATION_SHADER,
-		TESSELATION_CONTROL = GL_TESS_CONTROL_SHADER
+		TESSELATION_CONTROL = GL_TESS_CONTROL_SHADER,
+		COMPUTE = GL_COMPUTE_SHADER
 	};
 
 	ShaderType shaderType;
@@ -25,12 +27,28 @@ public:
 	/// <summary> The shader path. </summary>
 	std::string path;
 
-	/// <summary> Compiles the shader. Returns the OpenGL shader ID. </summary>
+	/// <summary> The source as compiled: includes expanded and defines injected (so the program cache tells permutations apart). </summary>
+	const std::string & getSource() const { return rawShader; }
+
+	/// <summary> The shader file and every file it included, in the order of the source string numbers that
+	/// compile logs print ("1(12)" is line 12 of the second file). </summary>
+	const std::vector<std::string> & getFiles() const { return files; }
+
+	/// <summary> Starts compiling the shader. Returns the OpenGL shader ID. The compile status is checked when
+	/// the program is resolved (see Material::resolve), so this doesn't wait for the driver. </summary>
 	GLuint compile();
 
-	/// <summary> Creates and loads a shader from disk. Does not compile it. </summary>
-	Shader(std::string path, ShaderType shaderType);
+	/// <summary> Creates and loads a shader from disk. Does not compile it.
+	/// Lines like '#include "file"' are replaced by that file (relative to the including one, included again every time).
+	/// Every define ("NAME" or "NAME VALUE") is injected right after the '#version' line. </summary>
+	Shader(std::string path, ShaderType shaderType, const std::vector<std::string> & defines = std::vector<std::string>());
 private:
+	const int MAX_INCLUDE_DEPTH = 16; // Deeper means a file includes itself.
+
 	std::string rawShader;
+	std::vector<std::string> files;
 	Shader();
+
+	/// <summary> Appends a file to the source, with its includes expanded. False (and logged) if a file couldn't be read. </summary>
+	bool appendFile(const std::string & filePath, const std::vector<std::string> & defines, const int depth);
 };
\ No newline at end of file
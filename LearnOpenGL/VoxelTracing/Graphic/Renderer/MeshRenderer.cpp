@@ -8,10 +8,15 @@
 #include "../../Graphic/Graphics.h"
 #include "../../Graphic/Lighting/PointLight.h"
 #include "../../Graphic/Texture2D.h"
+#include "../../Graphic/Buffer/RingBuffer.h"
+#include "../../Graphic/GLState.h"
+#include "../../Graphic/Device/GLDevice.h"
 
 // ... shader variable names.
 namespace {
 	const char * MODEL_MATRIX_NAME = "M";
+	const GLuint VERTEX_BINDING = 0;
+	const size_t VERTEX_ALIGNMENT = 16;
 }
 
 MeshRenderer::MeshRenderer(Mesh * _mesh, MaterialSetting * _materialSetting) : materialSetting(_materialSetting)
@@ -28,9 +33,9 @@ void MeshRenderer::setupMeshRenderer()
 	if (mesh->meshUploaded) { return; }
 
 	// Initialize VBO, VAO and EBO.
-	glGenVertexArrays(1, &mesh->vao);
-	glGenBuffers(1, &mesh->vbo);
-	glGenBuffers(1, &mesh->ebo);
+	gl::genVertexArrays(1, &mesh->vao);
+	gl::genBuffers(1, &mesh->vbo);
+	gl::genBuffers(1, &mesh->ebo);
 
 	// Upload to GPU.
 	reuploadIndexDataToGPU();
@@ -41,34 +46,46 @@ void MeshRenderer::setupMeshRenderer()
 
 MeshRenderer::~MeshRenderer()
 {
-	glDeleteBuffers(1, &mesh->vbo);
-	glDeleteVertexArrays(1, &mesh->vao);
+	GLState::getInstance().forgetVertexArray(mesh->vao);
+	gl::deleteBuffers(1, &mesh->vbo);
+	gl::deleteVertexArrays(1, &mesh->vao);
 	if (materialSetting != nullptr) delete materialSetting;
 }
 
-void MeshRenderer::render(const GLuint program)
+void MeshRenderer::render(const Material & material, RingBuffer * stream)
 {
-	
-	glUniformMatrix4fv(glGetUniformLocation(program, MODEL_MATRIX_NAME), 1, GL_FALSE, glm::value_ptr(transform.getTransformMatrix()));
-	glBindVertexArray(mesh->vao);
-	glDrawElements(GL_TRIANGLES, mesh->indices.size(), GL_UNSIGNED_INT, 0);
+	material.setUniform(MODEL_MATRIX_NAME, transform.getTransformMatrix());
+	GLState::getInstance().bindVertexArray(mesh->vao);
+	if (!mesh->staticMesh) {
+		if (stream != nullptr) {
+			const RingBuffer::Allocation range = stream->write(mesh->vertexData.data(), mesh->vertexData.size() * sizeof(VertexData), VERTEX_ALIGNMENT);
+			gl::bindVertexBuffer(VERTEX_BINDING, range.buffer, range.offset, sizeof(VertexData));
+		}
+		else gl::bindVertexBuffer(VERTEX_BINDING, mesh->vbo, 0, sizeof(VertexData)); // May still point into the ring buffer.
+	}
+	gl::drawElements(GL_TRIANGLES, mesh->indices.size(), GL_UNSIGNED_INT, 0);
 }
 
 void MeshRenderer::reuploadIndexDataToGPU()
 {
-	glBindVertexArray(mesh->vao);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh->indices.size() * sizeof(GLuint), mesh->indices.data(), mesh->staticMesh ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW);
+	GLState::getInstance().bindVertexArray(mesh->vao);
+	gl::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->ebo);
+	gl::bufferData(GL_ELEMENT_ARRAY_BUFFER, mesh->indices.size() * sizeof(GLuint), mesh->indices.data(), mesh->staticMesh ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW);
 }
 
 void MeshRenderer::reuploadVertexDataToGPU()
 {
 	auto dataSize = sizeof(VertexData);
-	glBindVertexArray(mesh->vao);
-	glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
-	glBufferData(GL_ARRAY_BUFFER, mesh->vertexData.size() * dataSize, mesh->vertexData.data(), mesh->staticMesh ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW);
-	glEnableVertexAttribArray(0); // Positions.
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, dataSize, 0);
-	glEnableVertexAttribArray(1); // Normals.
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, dataSize, (GLvoid*)offsetof(VertexData, VertexData::normal));
+	GLState::getInstance().bindVertexArray(mesh->vao);
+	gl::bindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
+	gl::bufferData(GL_ARRAY_BUFFER, mesh->vertexData.size() * dataSize, mesh->vertexData.data(), mesh->staticMesh ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW);
+
+	// The attribute formats are separate from the buffer, so dynamic meshes can rebind the buffer (see render).
+	gl::enableVertexAttribArray(0); // Positions.
+	gl::vertexAttribFormat(0, 3, GL_FLOAT, GL_FALSE, offsetof(VertexData, VertexData::position));
+	gl::vertexAttribBinding(0, VERTEX_BINDING);
+	gl::enableVertexAttribArray(1); // Normals.
+	gl::vertexAttribFormat(1, 3, GL_FLOAT, GL_FALSE, offsetof(VertexData, VertexData::normal));
+	gl::vertexAttribBinding(1, VERTEX_BINDING);
+	gl::bindVertexBuffer(VERTEX_BINDING, mesh->vbo, 0, dataSize);
 }
@@ -10,6 +10,8 @@
 #include <glm.hpp>
 
 class Mesh;
+class Material;
+class RingBuffer;
 
 /// <summary> A renderer that can be used to render a mesh. </summary>
 class MeshRenderer {
@@ -27,7 +29,8 @@ public:
 
 	// Rendering.
 	MaterialSetting * materialSetting = nullptr;
-	void render(const GLuint program);
+	/// <summary> Dynamic meshes (Mesh::staticMesh = false) stream their vertices through the ring buffer if there is one. </summary>
+	void render(const Material & material, RingBuffer * stream = nullptr);
 private:
 	void setupMeshRenderer();
 	void reuploadIndexDataToGPU();
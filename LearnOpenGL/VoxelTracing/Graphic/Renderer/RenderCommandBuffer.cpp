@@ -0,0 +1,60 @@
+#include "RenderCommandBuffer.h"
+
+#include <cstring>
+
+namespace {
+	uint64_t field(const unsigned int value, const int bits) { return uint64_t(value) & ((uint64_t(1) << bits) - 1); }
+}
+
+uint64_t RenderCommandBuffer::opaqueKey(const unsigned int program, const unsigned int material, const unsigned int mesh, const float viewDepth)
+{
+	uint64_t key = field(OPAQUE_LAYER, LAYER_BITS);
+	key = (key << PROGRAM_BITS) | field(program, PROGRAM_BITS);
+	key = (key << MATERIAL_BITS) | field(material, MATERIAL_BITS);
+	key = (key << MESH_BITS) | field(mesh, MESH_BITS);
+	return (key << DEPTH_BITS) | quantizeDepth(viewDepth);
+}
+
+uint64_t RenderCommandBuffer::translucentKey(const unsigned int program, const unsigned int material, const unsigned int mesh, const float viewDepth)
+{
+	// Same fields, with the inverted depth right below the layer.
+	const unsigned int farToNear = ((1u << DEPTH_BITS) - 1) - quantizeDepth(viewDepth);
+	uint64_t key = field(TRANSLUCENT_LAYER, LAYER_BITS);
+	key = (key << DEPTH_BITS) | farToNear;
+	key = (key << PROGRAM_BITS) | field(program, PROGRAM_BITS);
+	key = (key << MATERIAL_BITS) | field(material, MATERIAL_BITS);
+	return (key << MESH_BITS) | field(mesh, MESH_BITS);
+}
+
+unsigned int RenderCommandBuffer::quantizeDepth(const float viewDepth)
+{
+	// Positive floats order like their bit patterns.
+	if (!(viewDepth > 0.0f)) return 0;
+	uint32_t bits;
+	std::memcpy(&bits, &viewDepth, sizeof(bits));
+	return bits >> (32 - DEPTH_BITS);
+}
+
+void RenderCommandBuffer::sort()
+{
+	if (packets.size() < 2) return;
+
+	uint64_t differing = 0;
+	for (const Packet & packet : packets) differing |= packet.key ^ packets[0].key;
+
+	scratch.resize(packets.size());
+	for (int shift = 0; shift < 64; shift += 8) {
+		if (((differing >> shift) & 0xFF) == 0) continue;
+
+		size_t offsets[256] = {};
+		for (const Packet & packet : packets) ++offsets[(packet.key >> shift) & 0xFF];
+		size_t sum = 0;
+		for (size_t & offset : offsets) {
+			const size_t count = offset;
+			offset = sum;
+			sum += count;
+		}
+		for (const Packet & packet : packets) scratch[offsets[(packet.key >> shift) & 0xFF]++] = packet;
+		packets.swap(scratch);
+	}
+}
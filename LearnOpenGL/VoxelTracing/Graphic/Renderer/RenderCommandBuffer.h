@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/// <summary> The draws of a pass as packets with 64 bit sort keys. A pass records a packet per draw, sorts them and replays them
+/// in key order, so draws that share a program, material and mesh are adjacent and their binds and uploads happen once.
+/// Recording only reads the scene, so it could be spread over threads (one buffer each, merged before sorting).
+/// Key, most significant bits first: layer | program | material | mesh | depth. The translucent layer sorts by depth first. </summary>
+class RenderCommandBuffer {
+public:
+	enum Layer { OPAQUE_LAYER = 0, TRANSLUCENT_LAYER = 1 };
+
+	static const int LAYER_BITS = 4, PROGRAM_BITS = 12, MATERIAL_BITS = 16, MESH_BITS = 16, DEPTH_BITS = 16;
+
+	struct Packet {
+		uint64_t key;
+		unsigned int index; // Of the draw in the recorded queue.
+	};
+
+	/// <summary> Opaque draws: state first, then front to back. </summary>
+	static uint64_t opaqueKey(const unsigned int program, const unsigned int material, const unsigned int mesh, const float viewDepth);
+
+	/// <summary> Translucent draws: back to front, then state. </summary>
+	static uint64_t translucentKey(const unsigned int program, const unsigned int material, const unsigned int mesh, const float viewDepth);
+
+	/// <summary> Maps a view depth to DEPTH_BITS bits that keep its order (the top bits of the float, behind the camera is 0). </summary>
+	static unsigned int quantizeDepth(const float viewDepth);
+
+	void clear() { packets.clear(); }
+	void record(const uint64_t key, const unsigned int index) { packets.push_back({ key, index }); }
+
+	/// <summary> Stable LSD radix sort, a byte per pass. Skips the bytes every key shares. </summary>
+	void sort();
+
+	const std::vector<Packet> & getPackets() const { return packets; }
+	size_t size() const { return packets.size(); }
+private:
+	std::vector<Packet> packets, scratch;
+};
@@ -0,0 +1,114 @@
+#include "HiZBuffer.h"
+
+// Stdlib.
+#include <cmath>
+#include <cassert>
+
+namespace {
+	// ----------------
+	// Shader constants (see 'hi_z.comp' and 'specular_reflections.frag').
+	// ----------------
+	const float BACKGROUND_DEPTH = 1e30f;
+	const float CELL_EPSILON = 1e-3f; // In pixels, past the cell boundary.
+
+	inline int nextPowerOf2(const int x) {
+		int p = 1;
+		while (p < x) p <<= 1;
+		return p;
+	}
+}
+
+// ----------------------
+// Levels.
+// ----------------------
+void HiZBuffer::build(const std::vector<float> & depth, const int _width, const int _height)
+{
+	assert(depth.size() == size_t(_width) * _height);
+	width = _width;
+	height = _height;
+	paddedWidth = nextPowerOf2(width);
+	paddedHeight = nextPowerOf2(height);
+
+	int levelCount = 1;
+	while ((paddedWidth >> (levelCount - 1)) > 1 || (paddedHeight >> (levelCount - 1)) > 1) ++levelCount;
+	levels.assign(levelCount, std::vector<float>());
+
+	levels[0].assign(size_t(paddedWidth) * paddedHeight, BACKGROUND_DEPTH);
+	for (int y = 0; y < height; ++y) for (int x = 0; x < width; ++x) {
+		const float d = depth[size_t(y) * width + x];
+		if (d > 0.0f) levels[0][size_t(y) * paddedWidth + x] = d;
+	}
+
+	// The closest depth of the 2x2 texels below (a level of size 1 along an axis reuses its single row or column).
+	for (int level = 1; level < levelCount; ++level) {
+		const int w = getLevelWidth(level), h = getLevelHeight(level);
+		const int sourceWidth = getLevelWidth(level - 1), sourceHeight = getLevelHeight(level - 1);
+		levels[level].resize(size_t(w) * h);
+		for (int y = 0; y < h; ++y) for (int x = 0; x < w; ++x) {
+			float closest = BACKGROUND_DEPTH;
+			for (int tap = 0; tap < 4; ++tap) {
+				const int sx = std::min(2 * x + (tap & 1), sourceWidth - 1), sy = std::min(2 * y + (tap >> 1), sourceHeight - 1);
+				closest = std::min(closest, fetch(level - 1, sx, sy));
+			}
+			levels[level][size_t(y) * w + x] = closest;
+		}
+	}
+}
+
+// ----------------------
+// Ray marching.
+// ----------------------
+bool HiZBuffer::trace(const glm::vec2 & start, const glm::vec2 & end, const float startInverseDepth, const float endInverseDepth,
+	const float thickness, glm::ivec2 & hit, unsigned int & steps) const
+{
+	const glm::vec2 delta = end - start;
+	const float length = std::max(std::abs(delta.x), std::abs(delta.y));
+	if (length < 1.0f || levels.empty()) return false;
+	const float epsilon = CELL_EPSILON / length;
+	auto depthAt = [&](const float t) { return 1.0f / (startInverseDepth + t * (endInverseDepth - startInverseDepth)); };
+
+	// Parameter where the segment leaves the cell around a point.
+	auto cellExit = [&](const glm::vec2 & p, const int level) {
+		const float size = float(1 << level);
+		float exit = 1.0f;
+		for (int axis = 0; axis < 2; ++axis) {
+			if (delta[axis] == 0.0f) continue;
+			const float cell = std::floor(p[axis] / size);
+			const float boundary = (delta[axis] > 0.0f ? cell + 1.0f : cell) * size;
+			exit = std::min(exit, (boundary - start[axis]) / delta[axis]);
+		}
+		return exit;
+	};
+
+	// Leave the start pixel first, its surface is where the segment starts.
+	float t = cellExit(start, 0) + epsilon;
+	int level = 0;
+	for (int i = 0; i < MAX_ITERATIONS && t < 1.0f; ++i) {
+		const glm::vec2 p = start + t * delta;
+		if (p.x < 0.0f || p.y < 0.0f || p.x >= width || p.y >= height) return false;
+		++steps;
+
+		const int size = 1 << level;
+		const glm::ivec2 cell(int(p.x) / size, int(p.y) / size);
+		const float exit = cellExit(p, level);
+		const float depth0 = depthAt(t), depth1 = depthAt(exit);
+		const float nearest = std::min(depth0, depth1), farthest = std::max(depth0, depth1);
+		const float surface = fetch(level, cell.x, cell.y);
+
+		// In front of every surface of the cell: skip it and try a coarser level.
+		if (farthest < surface) {
+			t = exit + epsilon;
+			level = std::min(level + 1, getLevelCount() - 1);
+			continue;
+		}
+		if (level > 0) { --level; continue; }
+
+		// A pixel the segment reaches: a hit, unless the segment is more than thickness behind its surface (and passes under it).
+		if (nearest <= surface + thickness) {
+			hit = cell;
+			return true;
+		}
+		t = exit + epsilon;
+	}
+	return false;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+#include <glm.hpp>
+
+/// <summary> A hierarchical depth buffer for screen space ray marching. Level 0 holds the linear view depth of every pixel
+/// (the background is farther than anything), every coarser level the closest depth of the 2x2 texels below it.
+/// Level 0 is padded with background up to power of 2 sizes, so every texel covers exactly 2x2 texels of the level below.
+/// A CPU reference of 'hi_z.comp' and of the ray march of 'specular_reflections.frag', keep them in sync. </summary>
+class HiZBuffer {
+public:
+	static const int MAX_ITERATIONS = 256;
+
+	/// <summary> Builds every level from the view depths of a width x height image (row by row). Zero depth marks the background. </summary>
+	void build(const std::vector<float> & depth, const int width, const int height);
+
+	/// <summary> Marches a screen space segment (in pixels) from the pixel of its start, skipping the largest cells the segment
+	/// passes in front of. The inverse view depths of the end points interpolate linearly along the segment.
+	/// Returns true and the pixel hit if the segment reaches a surface less than thickness in front of it before
+	/// leaving the screen, the segment or MAX_ITERATIONS iterations. Adds the number of iterations to steps. </summary>
+	bool trace(const glm::vec2 & start, const glm::vec2 & end, const float startInverseDepth, const float endInverseDepth,
+		const float thickness, glm::ivec2 & hit, unsigned int & steps) const;
+
+	// ----------------
+	// Accessors.
+	// ----------------
+	int getLevelCount() const { return int(levels.size()); }
+	int getWidth() const { return width; } // Of the image, without the padding.
+	int getHeight() const { return height; }
+	int getLevelWidth(const int level) const { return std::max(paddedWidth >> level, 1); }
+	int getLevelHeight(const int level) const { return std::max(paddedHeight >> level, 1); }
+	float fetch(const int level, const int x, const int y) const { return levels[level][size_t(y) * getLevelWidth(level) + x]; }
+private:
+	int width = 0, height = 0;
+	int paddedWidth = 0, paddedHeight = 0;
+	std::vector<std::vector<float>> levels;
+};
@@ -0,0 +1,99 @@
+#pragma once
+
+// Stdlib.
+#include <cstddef>
+
+// External.
+#include <glm.hpp>
+
+// Internal.
+#include "Material/MaterialSetting.h"
+#include "Lighting/PointLight.h"
+
+/// <summary> The buffer blocks the shaders share, bound to fixed binding points so every program that declares a block reads the same data.
+/// Graphics writes 'Frame' (once per frame) and 'Draw' (once per draw) into its RingBuffer, 'Lights' and 'Materials' live in immutable
+/// buffers that Graphics copies to from the RingBuffer, on the GPU, when their generation changes. The structs mirror the GLSL layouts member by member
+/// (std140 for the uniform blocks, std430 for the storage block), the static_asserts below check the packing. </summary>
+namespace ShaderBlocks {
+	// ----------------
+	// Binding points.
+	// ----------------
+	const unsigned int FRAME_BINDING = 1;		// Uniform buffer (0 is 'ConeTables').
+	const unsigned int LIGHTS_BINDING = 2;		// Uniform buffer.
+	const unsigned int MATERIALS_BINDING = 3;	// Shader storage buffer (0 to 2 are the dirty bricks, the occupancy and the reflection counters).
+	const unsigned int DRAW_BINDING = 4;		// Uniform buffer, rebound for every draw.
+
+	const int MAX_LIGHTS = 16;
+
+	// ----------------
+	// Blocks.
+	// ----------------
+	/// <summary> layout(std140) uniform Frame { mat4 V; mat4 P; vec3 cameraPosition; int state; ivec2 screenSize; int numberOfLights; }; </summary>
+	struct Frame {
+		glm::mat4 V;
+		glm::mat4 P;
+		glm::vec3 cameraPosition;
+		int state;
+		glm::ivec2 screenSize;
+		int numberOfLights;
+		int padding;
+	};
+
+	/// <summary> struct PointLight { vec3 position; vec3 color; }; (std140, every vec3 starts a new vec4) </summary>
+	struct Light {
+		glm::vec3 position;
+		float padding0;
+		glm::vec3 color;
+		float padding1;
+	};
+
+	/// <summary> layout(std140) uniform Lights { PointLight pointLights[MAX_LIGHTS]; }; </summary>
+	struct Lights {
+		Light pointLights[MAX_LIGHTS];
+	};
+
+	/// <summary> One element of layout(std430) buffer Materials { Material materials[]; }; indexed by the 'materialIndex' of a draw.
+	/// Same members and order as the 'Material' struct of the shaders. </summary>
+	struct Material {
+		glm::vec3 diffuseColor;
+		float diffuseReflectivity;
+		glm::vec3 specularColor;
+		float specularDiffusion;
+		float specularReflectivity;
+		float emissivity;
+		float refractiveIndex;
+		float transparency;
+	};
+
+	/// <summary> layout(std140) uniform Draw { mat4 M; int materialIndex; }; </summary>
+	struct Draw {
+		glm::mat4 M;
+		int materialIndex;
+		int padding[3];
+	};
+
+	static_assert(offsetof(Frame, P) == 64, "std140: mat4 is 4 vec4 columns.");
+	static_assert(offsetof(Frame, cameraPosition) == 128 && offsetof(Frame, state) == 140, "std140: a scalar packs after a vec3.");
+	static_assert(offsetof(Frame, screenSize) == 144 && offsetof(Frame, numberOfLights) == 152, "std140: ivec2 aligns to 8 bytes.");
+	static_assert(sizeof(Frame) == 160, "std140: blocks round up to 16 bytes.");
+	static_assert(offsetof(Light, color) == 16 && sizeof(Light) == 32, "std140: vec3 aligns to 16 bytes, so do structs.");
+	static_assert(sizeof(Lights) == MAX_LIGHTS * 32, "std140: array stride of a struct.");
+	static_assert(offsetof(Material, diffuseReflectivity) == 12 && offsetof(Material, specularColor) == 16, "std430: a scalar packs after a vec3.");
+	static_assert(offsetof(Material, specularReflectivity) == 32 && offsetof(Material, transparency) == 44, "std430: scalars are 4 bytes.");
+	static_assert(sizeof(Material) == 48, "std430: array stride of a struct (aligned to its vec3s).");
+	static_assert(offsetof(Draw, materialIndex) == 64 && sizeof(Draw) == 80, "std140: blocks round up to 16 bytes.");
+
+	// ----------------
+	// Conversions.
+	// ----------------
+	inline Light light(const PointLight & pointLight) {
+		return { pointLight.position, 0.0f, pointLight.color, 0.0f };
+	}
+
+	inline Material material(const MaterialSetting & setting) {
+		return {
+			setting.diffuseColor, setting.diffuseReflectivity, setting.specularColor, setting.specularDiffusion,
+			setting.specularReflectivity, setting.emissivity, setting.refractiveIndex, setting.transparency
+		};
+	}
+}
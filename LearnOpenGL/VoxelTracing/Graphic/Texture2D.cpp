@@ -2,6 +2,9 @@
 
 #include <iostream>
 
+#include "GLState.h"
+#include "Device/GLDevice.h"
+
 Texture2D::Texture2D(
 	const std::string _shaderTextureName,
 	const std::string path,
@@ -20,38 +23,38 @@ Texture2D::Texture2D(
 	}
 
 	// Generate texture on GPU.
-	glGenTextures(1, &textureID);
-	glBindTexture(GL_TEXTURE_2D, textureID);
+	gl::genTextures(1, &textureID);
+	GLState::getInstance().bindTexture(GL_TEXTURE_2D, textureID);
 
 	// Parameter options.
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	gl::texParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	gl::texParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
 	// Set texture filtering options.
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, generateMipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	gl::texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, generateMipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	gl::texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
 	// Upload texture buffer.
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, textureBuffer);
+	gl::texImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, textureBuffer);
 
 	// Mip maps.
 	if (generateMipmaps) {
-		glGenerateMipmap(GL_TEXTURE_2D);
+		gl::generateMipmap(GL_TEXTURE_2D);
 	}
 
 	// Clean up.
 	SOIL_free_image_data(textureBuffer);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	GLState::getInstance().bindTexture(GL_TEXTURE_2D, 0);
 }
 
 Texture2D::~Texture2D()
 {
-	glDeleteTextures(1, &textureID);
+	GLState::getInstance().forgetTexture(textureID);
+	gl::deleteTextures(1, &textureID);
 }
 
 void Texture2D::Activate(int shaderProgram, int textureUnit)
 {
-	glActiveTexture(textureUnit);
-	glBindTexture(GL_TEXTURE_2D, textureID);
-	glUniform1i(glGetUniformLocation(shaderProgram, shaderTextureSamplerName.c_str()), textureUnit);
+	GLState::getInstance().bindTexture(textureUnit, GL_TEXTURE_2D, textureID);
+	gl::uniform1i(gl::getUniformLocation(shaderProgram, shaderTextureSamplerName.c_str()), textureUnit);
 }
\ No newline at end of file
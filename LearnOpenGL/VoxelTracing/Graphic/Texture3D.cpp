@@ -1,44 +1,121 @@
 #include "Texture3D.h"
 
 #include <vector>
+#include <cassert>
+#include <algorithm>
 
-Texture3D::Texture3D(const std::vector<GLfloat> & textureBuffer, const int _width, const int _height, const int _depth, const bool generateMipmaps) :
-	width(_width), height(_height), depth(_depth), clearData(4 * _width * _height * _depth, 0.0f)
+#include "Material/Material.h"
+#include "GLState.h"
+#include "Device/GLDevice.h"
+
+Texture3D::Texture3D(const int _width, const int _height, const int _depth, const Format _format, const int _levels) :
+	width(_width), height(_height), depth(_depth), levels(_levels), format(_format)
 {
+	if (levels <= 0) {
+		levels = 1;
+		while ((std::max(width, std::max(height, depth)) >> levels) > 0) ++levels;
+	}
+
 	// Generate texture on GPU.
-	glGenTextures(1, &textureID);
-	glBindTexture(GL_TEXTURE_3D, textureID);
+	gl::genTextures(1, &textureID);
+	GLState::getInstance().bindTexture(GL_TEXTURE_3D, textureID);
 
 	// Parameter options.
 	const auto wrap = GL_CLAMP_TO_BORDER;
-	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, wrap);
-	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, wrap);
-	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, wrap);
+	gl::texParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, wrap);
+	gl::texParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, wrap);
+	gl::texParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, wrap);
+
+	const auto filter = levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR;
+	gl::texParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, filter);
+	gl::texParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	// Allocate immutable storage. The contents are undefined until cleared.
+	gl::texStorage3D(GL_TEXTURE_3D, levels, format, width, height, depth);
+	GLState::getInstance().bindTexture(GL_TEXTURE_3D, 0);
+
+	GLfloat zero[4] = { 0, 0, 0, 0 };
+	ClearAllLevels(zero);
+}
+
+Texture3D::~Texture3D()
+{
+	GLState::getInstance().forgetTexture(textureID);
+	gl::deleteTextures(1, &textureID);
+}
+
+void Texture3D::Activate(const Material & material, const char * glSamplerName, const int textureUnit)
+{
+	Activate(material, material.getUniformLocation(glSamplerName), textureUnit);
+}
+
+void Texture3D::Activate(const Material & material, const GLint samplerLocation, const int textureUnit)
+{
+	GLState::getInstance().bindTexture(textureUnit, GL_TEXTURE_3D, textureID);
+	material.setUniform(samplerLocation, textureUnit);
+}
+
+void Texture3D::Clear(GLfloat clearColor[4], const int level)
+{
+	assert(level >= 0 && level < levels);
+	gl::clearTexImage(textureID, level, GetPixelFormat(format), GL_FLOAT, clearColor);
+}
 
-	const auto filter = GL_LINEAR_MIPMAP_LINEAR;
-	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, filter);
-	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+void Texture3D::ClearAllLevels(GLfloat clearColor[4])
+{
+	for (int level = 0; level < levels; ++level) Clear(clearColor, level);
+}
 
-	// Upload texture buffer.
-	const int levels = 7;
-	glTexStorage3D(GL_TEXTURE_3D, levels, GL_RGBA8, width, height, depth);
-	glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA8, width, height, depth, 0, GL_RGBA, GL_FLOAT, &textureBuffer[0]);
-	if (generateMipmaps) glGenerateMipmap(GL_TEXTURE_3D);
-	glBindTexture(GL_TEXTURE_3D, 0);
+void Texture3D::ClearRegion(GLfloat clearColor[4], const int level, const int x, const int y, const int z, const int w, const int h, const int d)
+{
+	assert(level >= 0 && level < levels);
+	gl::clearTexSubImage(textureID, level, x, y, z, w, h, d, GetPixelFormat(format), GL_FLOAT, clearColor);
 }
 
-void Texture3D::Activate(const int shaderProgram, const std::string glSamplerName, const int textureUnit)
+void Texture3D::UploadLevel(const int level, const void * levelData, const GLenum type)
 {
-	glActiveTexture(GL_TEXTURE0 + textureUnit);
-	glBindTexture(GL_TEXTURE_3D, textureID);
-	glUniform1i(glGetUniformLocation(shaderProgram, glSamplerName.c_str()), textureUnit);
+	UploadRegion(level, 0, 0, 0, std::max(1, width >> level), std::max(1, height >> level), std::max(1, depth >> level), levelData, type);
 }
 
-void Texture3D::Clear(GLfloat clearColor[4])
+void Texture3D::UploadRegion(const int level, const int x, const int y, const int z, const int w, const int h, const int d, const void * data, const GLenum type)
 {
-	GLint previousBoundTextureID;
-	glGetIntegerv(GL_TEXTURE_BINDING_3D, &previousBoundTextureID);
-	glBindTexture(GL_TEXTURE_3D, textureID);
-	glClearTexImage(textureID, 0, GL_RGBA, GL_FLOAT, &clearColor);
-	glBindTexture(GL_TEXTURE_3D, previousBoundTextureID);
-}
\ No newline at end of file
+	assert(level >= 0 && level < levels);
+	GLState::getInstance().bindTexture(GL_TEXTURE_3D, textureID);
+	gl::pixelStorei(GL_UNPACK_ALIGNMENT, 1); // Rows of R8 regions are not 4 byte aligned.
+	gl::texSubImage3D(GL_TEXTURE_3D, level, x, y, z, w, h, d, GetPixelFormat(format), type, data);
+	gl::pixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	GLState::getInstance().bindTexture(GL_TEXTURE_3D, 0);
+}
+
+size_t Texture3D::GetLevelMemory(const int level) const
+{
+	const size_t w = std::max(1, width >> level), h = std::max(1, height >> level), d = std::max(1, depth >> level);
+	return w * h * d * GetBytesPerTexel(format);
+}
+
+size_t Texture3D::GetResidentMemory() const
+{
+	size_t bytes = 0;
+	for (int level = 0; level < levels; ++level) bytes += GetLevelMemory(level);
+	return bytes;
+}
+
+size_t Texture3D::GetBytesPerTexel(const Format format)
+{
+	switch (format) {
+	case Format::RGBA8:			return 4;
+	case Format::RGBA16F:		return 8;
+	case Format::R11G11B10F:	return 4;
+	case Format::R8:			return 1;
+	default:					return 4;
+	}
+}
+
+GLenum Texture3D::GetPixelFormat(const Format format)
+{
+	switch (format) {
+	case Format::R11G11B10F:	return GL_RGB;
+	case Format::R8:			return GL_RED;
+	default:					return GL_RGBA;
+	}
+}
@@ -1,30 +1,80 @@
 #pragma once
 
 #include <vector>
+#include <cstddef>
 
 #define GLEW_STATIC
 #include <glew.h>
 #include <glfw3.h>
 #include <SOIL\SOIL.h>
 
-/// <summary> A 3D texture wrapper class. Handles important OpenGL calls. </summary>
+class Material;
+
+/// <summary> A 3D texture wrapper class. Handles important OpenGL calls.
+/// Storage is immutable and allocated on the GPU only, nothing is staged in host memory. </summary>
 class Texture3D {
 public:
-	unsigned char * textureBuffer = nullptr;
+	enum Format {
+		RGBA8 = GL_RGBA8,
+		RGBA16F = GL_RGBA16F,
+		R11G11B10F = GL_R11F_G11F_B10F,
+		R8 = GL_R8
+	};
+
 	GLuint textureID;
 
 	/// <summary> Activates this texture and passes it on to a texture unit on the GPU. </summary>
-	void Activate(const int shaderProgram, const std::string glSamplerName, const int textureUnit = GL_TEXTURE0);
+	void Activate(const Material & material, const char * glSamplerName, const int textureUnit = GL_TEXTURE0);
+
+	/// <summary> Same, for a sampler at a known location (an element of a sampler array). </summary>
+	void Activate(const Material & material, const GLint samplerLocation, const int textureUnit);
+
+	/// <summary> Clears a mip level of this texture using a given clear color (only the channels of the format are used). </summary>
+	void Clear(GLfloat clearColor[4], const int level = 0);
+
+	/// <summary> Clears every mip level of this texture. </summary>
+	void ClearAllLevels(GLfloat clearColor[4]);
+
+	/// <summary> Clears a box of texels [offset, offset + size) in a mip level. </summary>
+	void ClearRegion(GLfloat clearColor[4], const int level, const int x, const int y, const int z, const int width, const int height, const int depth);
+
+	/// <summary> Uploads a whole mip level. Data is tightly packed, with the channels of the format and the given GL type. </summary>
+	void UploadLevel(const int level, const void * levelData, const GLenum type = GL_UNSIGNED_BYTE);
 
-	/// <summary> Clears this texture using a given clear color. </summary>
-	void Clear(GLfloat clearColor[4]);
+	/// <summary> Uploads a box of texels [offset, offset + size) in a mip level. </summary>
+	void UploadRegion(const int level, const int x, const int y, const int z, const int width, const int height, const int depth,
+		const void * data, const GLenum type = GL_UNSIGNED_BYTE);
 
+	/// <summary> Returns the number of bytes the GPU storage of a mip level takes. </summary>
+	size_t GetLevelMemory(const int level) const;
+
+	/// <summary> Returns the number of bytes the GPU storage of all mip levels takes. </summary>
+	size_t GetResidentMemory() const;
+
+	/// <summary> Returns the number of mip levels allocated for this texture. </summary>
+	int GetLevelCount() const { return levels; }
+
+	/// <summary> Returns the internal format of this texture. </summary>
+	Format GetFormat() const { return format; }
+
+	/// <summary> Returns the number of bytes per texel of a format. </summary>
+	static size_t GetBytesPerTexel(const Format format);
+
+	/// <summary> Returns the pixel transfer format (GL_RGBA, GL_RGB or GL_RED) that matches a format. </summary>
+	static GLenum GetPixelFormat(const Format format);
+
+	/// <summary> Allocates an immutable texture and clears it to zero.
+	/// A level count of 0 allocates the full mip chain. </summary>
 	Texture3D(
-		const std::vector<GLfloat> & textureBuffer,
 		const int width, const int height, const int depth,
-		const bool generateMipmaps = true
+		const Format format = Format::RGBA8, const int levels = 0
 	);
+	~Texture3D();
+
+	// Delete copy constructors.
+	Texture3D(Texture3D const &) = delete;
+	void operator=(Texture3D const &) = delete;
 private:
-	int width, height, depth;
-	std::vector<GLfloat> clearData;
-};
\ No newline at end of file
+	int width, height, depth, levels;
+	Format format;
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <array>
+#include <algorithm>
+
+/// <summary> The cones a screen tile of VoxelConeTracer may trace. Level 0 is the full cone set of 'voxel_cone_tracing.frag',
+/// every level after it trades quality for fewer diffuse cones, wider diffuse apertures and shorter marches. </summary>
+struct ConeBudget {
+	/// <summary> The kinds of cones, for classification and counters. </summary>
+	enum Category {
+		DIFFUSE = 0,	// Indirect diffuse light (the normal cone and the ring around it).
+		SPECULAR = 1,	// Indirect specular light.
+		REFRACTION = 2,	// Transparency.
+		SHADOW = 3,		// One per light.
+		CATEGORY_COUNT = 4
+	};
+	static const int LEVEL_COUNT = 4;
+
+	int level = 0;
+	int diffuseRingCones = 8; // Cones around the normal cone, out of a ring of 8 (rotated per pixel when fewer, see ringConesOf).
+	float diffuseApertureScale = 1.0f; // Wider cones reach coarser mipmaps (and their end) in fewer steps.
+	float diffuseMaxDistance = 1.414213f;
+	float specularDistanceScale = 1.0f; // Of the specular and refraction cones' march length.
+
+	/// <summary> Returns the ring cones to trace out of a ring of another size (the ring of ConeSets::DIFFUSE_CONES). </summary>
+	int ringConesOf(const int ringSize) const { return diffuseRingCones >= 8 ? ringSize : std::max(1, diffuseRingCones * ringSize / 8); }
+
+	/// <summary> The diffuse cone shape of a level, constexpr for the march tables of 'ConeSets.h'. </summary>
+	static constexpr float diffuseApertureScaleAt(const int level) { return level <= 1 ? 1.0f : level == 2 ? 1.25f : 1.5f; }
+	static constexpr float diffuseMaxDistanceAt(const int level) { return level <= 1 ? 1.414213f : level == 2 ? 1.0f : 0.75f; }
+
+	/// <summary> Returns the budget of a quality level in [0, LEVEL_COUNT). </summary>
+	static ConeBudget atLevel(const int level) {
+		static const ConeBudget LEVELS[LEVEL_COUNT] = {
+			{ 0, 8, diffuseApertureScaleAt(0), diffuseMaxDistanceAt(0), 1.0f },
+			{ 1, 4, diffuseApertureScaleAt(1), diffuseMaxDistanceAt(1), 1.0f },
+			{ 2, 2, diffuseApertureScaleAt(2), diffuseMaxDistanceAt(2), 0.75f },
+			{ 3, 1, diffuseApertureScaleAt(3), diffuseMaxDistanceAt(3), 0.5f }
+		};
+		return LEVELS[level < 0 ? 0 : level >= LEVEL_COUNT ? LEVEL_COUNT - 1 : level];
+	}
+};
+
+/// <summary> Number of cones traced per ConeBudget::Category. </summary>
+using ConeCounters = std::array<unsigned long long, ConeBudget::CATEGORY_COUNT>;
@@ -0,0 +1,62 @@
+#include "ConeBudgetScheduler.h"
+
+// Stdlib.
+#include <cassert>
+#include <algorithm>
+
+ConeBudgetScheduler::ConeBudgetScheduler(const int _tileSize) : tileSize(_tileSize) { assert(tileSize > 0); }
+
+unsigned long long ConeBudgetScheduler::schedule(
+	const std::vector<VoxelConeTracer::GBufferTexel> & gBuffer, const int width, const int height,
+	const glm::vec3 & cameraPosition, const VoxelConeTracer::Settings & settings, const int lightCount,
+	const float diffuseDensity, const unsigned long long coneBudget, std::vector<Tile> & tiles) const
+{
+	assert(gBuffer.size() == size_t(width) * height);
+	const int tilesX = (width + tileSize - 1) / tileSize, tilesY = (height + tileSize - 1) / tileSize;
+	tiles.assign(size_t(tilesX) * tilesY, Tile());
+
+	// Classification.
+	unsigned long long total = 0;
+	for (int t = 0; t < int(tiles.size()); ++t) {
+		Tile & tile = tiles[t];
+		tile.pixels.fill(0);
+		const int x0 = (t % tilesX) * tileSize, y0 = (t / tilesX) * tileSize;
+		int surfaces = 0;
+		for (int y = y0; y < std::min(y0 + tileSize, height); ++y) {
+			for (int x = x0; x < std::min(x0 + tileSize, width); ++x) {
+				const VoxelConeTracer::GBufferTexel & texel = gBuffer[size_t(y) * width + x];
+				if (texel.material == nullptr) continue;
+				for (int c = 0; c < ConeBudget::CATEGORY_COUNT; ++c)
+					tile.pixels[c] += VoxelConeTracer::needsCones(ConeBudget::Category(c), *texel.material, settings);
+				tile.distance += glm::length(texel.position - cameraPosition);
+				++surfaces;
+			}
+		}
+		if (surfaces > 0) tile.distance /= surfaces;
+		tile.budget = ConeBudget::atLevel(0);
+		total += estimateCones(tile, 0, lightCount, diffuseDensity);
+	}
+	if (coneBudget == 0 || total <= coneBudget) return total;
+
+	// Drop the farthest tiles a level at a time until the estimate fits.
+	std::vector<int> order(tiles.size());
+	for (int t = 0; t < int(order.size()); ++t) order[t] = t;
+	std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return tiles[a].distance > tiles[b].distance; });
+	for (int level = 1; level < ConeBudget::LEVEL_COUNT && total > coneBudget; ++level) {
+		for (int t : order) {
+			if (total <= coneBudget) break;
+			total -= estimateCones(tiles[t], level - 1, lightCount, diffuseDensity);
+			total += estimateCones(tiles[t], level, lightCount, diffuseDensity);
+			tiles[t].budget = ConeBudget::atLevel(level);
+		}
+	}
+	return total;
+}
+
+unsigned long long ConeBudgetScheduler::estimateCones(const Tile & tile, const int level, const int lightCount, const float diffuseDensity)
+{
+	const ConeBudget budget = ConeBudget::atLevel(level);
+	const double diffuse = diffuseDensity * tile.pixels[ConeBudget::DIFFUSE] * (1 + budget.ringConesOf(ConeSets::DIFFUSE_RING_CONES));
+	return (unsigned long long)(diffuse + 0.5) + tile.pixels[ConeBudget::SPECULAR] + tile.pixels[ConeBudget::REFRACTION]
+		+ (unsigned long long)(tile.pixels[ConeBudget::SHADOW]) * lightCount;
+}
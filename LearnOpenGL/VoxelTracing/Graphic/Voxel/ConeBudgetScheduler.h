@@ -0,0 +1,40 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include <glm.hpp>
+
+#include "ConeBudget.h"
+#include "VoxelConeTracer.h"
+
+/// <summary> Chooses a ConeBudget for every screen tile of VoxelConeTracer. Tiles are classified by the cones their materials
+/// need (see VoxelConeTracer::needsCones) and their mean distance to the camera. All tiles start at full quality, and
+/// while the estimated number of cones is above the frame's budget, the farthest tiles drop a level first. </summary>
+class ConeBudgetScheduler {
+public:
+	/// <summary> One scheduled tile. </summary>
+	struct Tile {
+		ConeBudget budget;
+		float distance = 0.0f; // Mean distance of the tile's surfaces to the camera.
+		std::array<int, ConeBudget::CATEGORY_COUNT> pixels; // Pixels that need each kind of cone.
+	};
+
+	ConeBudgetScheduler(const int tileSize = VoxelConeTracer::TILE_SIZE);
+
+	/// <summary> Schedules a width x height G-buffer. A cone budget of 0 keeps every tile at full quality.
+	/// Diffuse density scales the diffuse cones (1 / factor^2 when they are traced at a reduced resolution).
+	/// Returns the estimated number of cones. </summary>
+	unsigned long long schedule(
+		const std::vector<VoxelConeTracer::GBufferTexel> & gBuffer, const int width, const int height,
+		const glm::vec3 & cameraPosition, const VoxelConeTracer::Settings & settings, const int lightCount,
+		const float diffuseDensity, const unsigned long long coneBudget, std::vector<Tile> & tiles
+	) const;
+
+	/// <summary> Returns the estimated number of cones of a tile at a quality level. </summary>
+	static unsigned long long estimateCones(const Tile & tile, const int level, const int lightCount, const float diffuseDensity);
+
+	int getTileSize() const { return tileSize; }
+private:
+	int tileSize;
+};
@@ -0,0 +1,336 @@
+#pragma once
+
+#include "ConeBudget.h"
+
+/// <summary> The diffuse cone set, selected at compile time: 6 (one normal cone and a ring of 5), 9 (the layout
+/// 'voxel_cone_tracing.frag' was tuned with: a ring of 4 side and 4 corner cones), 16 (rings of 5 and 10) or 12 (a Fibonacci spiral). </summary>
+#ifndef __DIFFUSE_CONE_SET
+#define __DIFFUSE_CONE_SET 9
+#endif
+
+/// <summary> Cone direction sets and march tables, generated at compile time (constexpr, no trigonometry at runtime).
+/// Graphics uploads the selected tables as the 'ConeTables' uniform block (see UniformBlock) for the shaders,
+/// and VoxelConeTracer and IrradianceProbeGrid use the same tables, so the CPU and the GPU trace the same cones. </summary>
+namespace ConeSets {
+	// ----------------
+	// Compile time math.
+	// ----------------
+	namespace Math {
+		constexpr double PI = 3.14159265358979323846;
+
+		constexpr double sine(double x) {
+			while (x > PI) x -= 2 * PI;
+			while (x < -PI) x += 2 * PI;
+			double term = x, sum = x;
+			for (int n = 1; n < 12; ++n) {
+				term *= -x * x / ((2 * n) * (2 * n + 1));
+				sum += term;
+			}
+			return sum;
+		}
+
+		constexpr double cosine(const double x) { return sine(x + PI / 2); }
+
+		constexpr double squareRoot(const double x) {
+			if (x <= 0) return 0;
+			double r = x > 1 ? x : 1;
+			for (int i = 0; i < 64; ++i) r = 0.5 * (r + x / r);
+			return r;
+		}
+
+		constexpr double log2(double x) {
+			if (x <= 0) return -1e30;
+			int exponent = 0;
+			while (x >= 2) { x *= 0.5; ++exponent; }
+			while (x < 1) { x *= 2; --exponent; }
+			// ln(x) = 2 atanh((x - 1) / (x + 1)), which converges quickly for x in [1, 2).
+			const double y = (x - 1) / (x + 1), y2 = y * y;
+			double term = y, sum = 0;
+			for (int n = 0; n < 24; ++n) {
+				sum += term / (2 * n + 1);
+				term *= y2;
+			}
+			return exponent + 2 * sum / 0.69314718055994530942;
+		}
+	}
+
+	// ----------------
+	// Cone sets.
+	// ----------------
+	/// <summary> A cone in tangent space (z along the normal). </summary>
+	struct Cone {
+		float direction[3];	// Normalized.
+		float offset[3];	// Where the cone starts, in units of the cone offset of the tracers.
+		float weight;		// Cosine weighted solid angle fraction. The weights of a set add up to 1.
+	};
+
+	/// <summary> A cone set. The first cone is always traced, the others form the ring that may be traced in part. </summary>
+	template<int N>
+	struct ConeSet {
+		static const int SIZE = N;
+		Cone cones[N];
+		float aperture; // Diffuse cone spread (see traceDiffuseVoxelCone).
+	};
+
+	/// <summary> The diffuse cone spread for a set of cones covering the hemisphere, relative to the 0.325 of the 9 cone layout. </summary>
+	constexpr float coverageAperture(const int coneCount) {
+		// Half angle of a cone with 1 / coneCount of the hemisphere's solid angle.
+		const double c = 1.0 - 1.0 / coneCount, c9 = 1.0 - 1.0 / 9;
+		return float(0.325 * (Math::squareRoot(1 - c * c) / c) / (Math::squareRoot(1 - c9 * c9) / c9));
+	}
+
+	template<int N>
+	constexpr void setCone(ConeSet<N> & set, const int i, double x, double y, double z, const double ox, const double oy, const double oz, const double weight) {
+		const double length = Math::squareRoot(x * x + y * y + z * z);
+		x /= length; y /= length; z /= length;
+		set.cones[i] = { { float(x), float(y), float(z) }, { float(ox), float(oy), float(oz) }, float(weight) };
+	}
+
+	/// <summary> Fills cones [first, first + count) with a ring at a polar angle, starting at an azimuth.
+	/// The ring's weight is the cosine weighted solid angle between two polar angles (sin^2 of the outer minus the inner). </summary>
+	template<int N>
+	constexpr void setRing(ConeSet<N> & set, const int first, const int count, const double polar, const double azimuth,
+		const double innerPolar, const double outerPolar) {
+		const double s = Math::sine(polar), c = Math::cosine(polar);
+		const double sInner = Math::sine(innerPolar), sOuter = Math::sine(outerPolar);
+		for (int k = 0; k < count; ++k) {
+			const double a = azimuth + 2 * Math::PI * k / count;
+			const double x = Math::cosine(a), y = Math::sine(a);
+			setCone(set, first + k, s * x, s * y, c, x, y, 0, (sOuter * sOuter - sInner * sInner) / count);
+		}
+	}
+
+	/// <summary> The layout 'voxel_cone_tracing.frag' was tuned with. Ring cone k is a side cone (even k) or a corner cone
+	/// (odd k, tilted less), halfway between the normal and (cos, sin) of k * pi / 4. All cones weigh the same. </summary>
+	constexpr ConeSet<9> nine() {
+		ConeSet<9> set = {};
+		const double ISQRT2 = 0.707106;
+		setCone(set, 0, 0, 0, 1, 0, 0, 1, 1.0 / 9);
+		for (int k = 0; k < 8; ++k) {
+			const double a = k * Math::PI / 4, scale = k % 2 == 0 ? 1.0 : ISQRT2;
+			const double x = scale * Math::cosine(a), y = scale * Math::sine(a);
+			setCone(set, 1 + k, 0.5 * x, 0.5 * y, 0.5, x, y, 0, 1.0 / 9);
+		}
+		set.aperture = 0.325f;
+		return set;
+	}
+
+	/// <summary> The normal cone and a ring of 5 at 60 degrees (weights 0.25 and 0.15, the classic 6 cone layout). </summary>
+	constexpr ConeSet<6> six() {
+		ConeSet<6> set = {};
+		setCone(set, 0, 0, 0, 1, 0, 0, 1, 0.25);
+		setRing(set, 1, 5, Math::PI / 3, 0, Math::PI / 6, Math::PI / 2);
+		set.aperture = coverageAperture(6);
+		return set;
+	}
+
+	/// <summary> The normal cone, a ring of 5 at 30 degrees and a ring of 10 at 60 degrees. </summary>
+	constexpr ConeSet<16> sixteen() {
+		ConeSet<16> set = {};
+		const double s = Math::sine(Math::PI / 12);
+		setCone(set, 0, 0, 0, 1, 0, 0, 1, s * s);
+		setRing(set, 1, 5, Math::PI / 6, 0, Math::PI / 12, Math::PI / 4);
+		setRing(set, 6, 10, Math::PI / 3, Math::PI / 10, Math::PI / 4, Math::PI / 2);
+		set.aperture = coverageAperture(16);
+		return set;
+	}
+
+	/// <summary> N cones on a cosine weighted Fibonacci spiral over the hemisphere (equal weights). The first cone is closest to the normal. </summary>
+	template<int N>
+	constexpr ConeSet<N> fibonacci() {
+		ConeSet<N> set = {};
+		const double GOLDEN_ANGLE = 2.39996322972865332;
+		for (int i = 0; i < N; ++i) {
+			const double z = Math::squareRoot(1.0 - (i + 0.5) / N), r = Math::squareRoot(1.0 - z * z);
+			const double x = Math::cosine(GOLDEN_ANGLE * i), y = Math::sine(GOLDEN_ANGLE * i);
+			setCone(set, i, r * x, r * y, z, x, y, 0, 1.0 / N);
+		}
+		set.aperture = coverageAperture(N);
+		return set;
+	}
+
+	/// <summary> A set rotated around the normal by an angle (in radians). </summary>
+	template<int N>
+	constexpr ConeSet<N> rotated(ConeSet<N> set, const double angle) {
+		const double c = Math::cosine(angle), s = Math::sine(angle);
+		for (int i = 0; i < N; ++i) {
+			Cone & cone = set.cones[i];
+			const double dx = cone.direction[0], dy = cone.direction[1], ox = cone.offset[0], oy = cone.offset[1];
+			cone.direction[0] = float(c * dx - s * dy);
+			cone.direction[1] = float(s * dx + c * dy);
+			cone.offset[0] = float(c * ox - s * oy);
+			cone.offset[1] = float(s * ox + c * oy);
+		}
+		return set;
+	}
+
+	/// <summary> N directions on a Fibonacci spiral over the whole sphere, each with 4 pi / N of its solid angle. </summary>
+	template<int N>
+	struct SphereDirections { float directions[N][3]; };
+
+	template<int N>
+	constexpr SphereDirections<N> fibonacciSphere() {
+		SphereDirections<N> set = {};
+		const double GOLDEN_ANGLE = 2.39996322972865332;
+		for (int i = 0; i < N; ++i) {
+			const double z = 1.0 - (2.0 * i + 1.0) / N, r = Math::squareRoot(1.0 - z * z);
+			set.directions[i][0] = float(r * Math::cosine(GOLDEN_ANGLE * i));
+			set.directions[i][1] = float(r * Math::sine(GOLDEN_ANGLE * i));
+			set.directions[i][2] = float(z);
+		}
+		return set;
+	}
+
+	// ----------------
+	// March tables.
+	// ----------------
+	const int MAX_DIFFUSE_STEPS = 16;
+	const int MAX_SHADOW_STEPS = 256;
+
+	/// <summary> The samples of a diffuse cone (see traceDiffuseVoxelCone): they only depend on the spread and the voxel size. </summary>
+	struct DiffuseMarch {
+		int steps;
+		float distance[MAX_DIFFUSE_STEPS];	// From the cone's origin.
+		float lod[MAX_DIFFUSE_STEPS];
+		float weight[MAX_DIFFUSE_STEPS];	// Of the sample in the accumulated color.
+	};
+
+	/// <summary> The samples of a shadow cone (see traceShadowCone), up to the diagonal of the volume. </summary>
+	struct ShadowMarch {
+		int steps;
+		float distance[MAX_SHADOW_STEPS];
+		float nearLod[MAX_SHADOW_STEPS], farLod[MAX_SHADOW_STEPS];
+	};
+
+	constexpr DiffuseMarch diffuseMarch(const double spread, const double voxelSize, const double maxDistance) {
+		const double MIPMAP_HARDCAP = 5.4;
+		DiffuseMarch march = {};
+		double dist = 0.1953125; // The start distance controls bleeding from close surfaces.
+		while (dist < maxDistance && march.steps < MAX_DIFFUSE_STEPS) {
+			const double level = Math::log2(1 + spread * dist / voxelSize);
+			const double ll = (level + 1) * (level + 1);
+			march.distance[march.steps] = float(dist);
+			march.lod[march.steps] = float(level < MIPMAP_HARDCAP ? level : MIPMAP_HARDCAP);
+			march.weight[march.steps] = float(0.075 * ll);
+			++march.steps;
+			dist += ll * voxelSize * 2;
+		}
+		return march;
+	}
+
+	constexpr ShadowMarch shadowMarch(const double voxelSize) {
+		const double MAX_DISTANCE = 3.4641016; // Diagonal of [-1, 1]^3.
+		ShadowMarch march = {};
+		double dist = 3 * voxelSize;
+		while (dist < MAX_DISTANCE && march.steps < MAX_SHADOW_STEPS) {
+			const double l = dist * dist;
+			march.distance[march.steps] = float(dist);
+			march.nearLod[march.steps] = float(1 + 0.75 * l);
+			march.farLod[march.steps] = float(4.5 * l);
+			++march.steps;
+			dist += 0.9 * voxelSize * (1 + 0.05 * l);
+		}
+		return march;
+	}
+
+	// ----------------
+	// Selected tables.
+	// ----------------
+	/// <summary> The volume size the tables are generated for (the shaders' VOXEL_SIZE). Other sizes march without tables. </summary>
+	const int VOLUME_SIZE = 64;
+
+#if __DIFFUSE_CONE_SET == 6
+	constexpr ConeSet<6> DIFFUSE_CONES = six();
+#elif __DIFFUSE_CONE_SET == 16
+	constexpr ConeSet<16> DIFFUSE_CONES = sixteen();
+#elif __DIFFUSE_CONE_SET == 12
+	constexpr ConeSet<12> DIFFUSE_CONES = fibonacci<12>();
+#else
+	constexpr ConeSet<9> DIFFUSE_CONES = nine();
+#endif
+	const int MAX_DIFFUSE_CONES = 16;
+	static_assert(DIFFUSE_CONES.SIZE <= MAX_DIFFUSE_CONES, "The uniform block has room for 16 diffuse cones.");
+	const int DIFFUSE_RING_CONES = DIFFUSE_CONES.SIZE - 1;
+
+	/// <summary> The diffuse indirect factor was tuned with 9 equally weighted cones, the weights are scaled back to that total. </summary>
+	constexpr float DIFFUSE_CONE_SCALE = 9.0f;
+
+	/// <summary> The scaled sum of the cone weights, and of the weighted cone directions along the normal
+	/// (used to add up the L1 radiance of all cones in closed form, see IrradianceProbeGrid). </summary>
+	template<int N>
+	constexpr float weightSum(const ConeSet<N> & set) {
+		double sum = 0;
+		for (int i = 0; i < N; ++i) sum += set.cones[i].weight;
+		return float(DIFFUSE_CONE_SCALE * sum);
+	}
+
+	template<int N>
+	constexpr float normalSum(const ConeSet<N> & set) {
+		double sum = 0;
+		for (int i = 0; i < N; ++i) sum += set.cones[i].weight * set.cones[i].direction[2];
+		return float(DIFFUSE_CONE_SCALE * sum);
+	}
+
+	constexpr float DIFFUSE_CONE_WEIGHT_SUM = weightSum(DIFFUSE_CONES);
+	constexpr float DIFFUSE_CONE_NORMAL_SUM = normalSum(DIFFUSE_CONES);
+
+	/// <summary> One march per ConeBudget level. </summary>
+	constexpr DiffuseMarch DIFFUSE_MARCHES[ConeBudget::LEVEL_COUNT] = {
+		diffuseMarch(DIFFUSE_CONES.aperture * ConeBudget::diffuseApertureScaleAt(0), 1.0 / VOLUME_SIZE, ConeBudget::diffuseMaxDistanceAt(0)),
+		diffuseMarch(DIFFUSE_CONES.aperture * ConeBudget::diffuseApertureScaleAt(1), 1.0 / VOLUME_SIZE, ConeBudget::diffuseMaxDistanceAt(1)),
+		diffuseMarch(DIFFUSE_CONES.aperture * ConeBudget::diffuseApertureScaleAt(2), 1.0 / VOLUME_SIZE, ConeBudget::diffuseMaxDistanceAt(2)),
+		diffuseMarch(DIFFUSE_CONES.aperture * ConeBudget::diffuseApertureScaleAt(3), 1.0 / VOLUME_SIZE, ConeBudget::diffuseMaxDistanceAt(3))
+	};
+
+	constexpr ShadowMarch SHADOW_MARCH = shadowMarch(1.0 / VOLUME_SIZE);
+
+	const int PROBE_DIRECTION_COUNT = 32;
+	constexpr SphereDirections<PROBE_DIRECTION_COUNT> PROBE_DIRECTIONS = fibonacciSphere<PROBE_DIRECTION_COUNT>();
+
+	// ----------------
+	// Uniform block.
+	// ----------------
+	/// <summary> The std140 layout of the 'ConeTables' uniform block of the shaders (every member is a vec4 or ivec4). </summary>
+	struct UniformBlock {
+		float diffuseCones[2 * MAX_DIFFUSE_CONES][4];	// Direction and weight, then offset and 0.
+		int diffuseConeCount[4];						// Cone count, then 0.
+		float diffuseConeSums[4];						// DIFFUSE_CONE_WEIGHT_SUM, DIFFUSE_CONE_NORMAL_SUM, then 0.
+		float diffuseMarch[MAX_DIFFUSE_STEPS][4];		// Distance, lod, weight and 0 (ConeBudget level 0).
+		int diffuseMarchSteps[4];
+		float shadowMarch[MAX_SHADOW_STEPS][4];			// Distance, near lod, far lod and 0.
+		int shadowMarchSteps[4];
+		float probeDirections[PROBE_DIRECTION_COUNT][4];
+	};
+
+	/// <summary> Returns the selected tables in the layout of the uniform block. </summary>
+	inline UniformBlock uniformBlock() {
+		UniformBlock block = {};
+		for (int i = 0; i < DIFFUSE_CONES.SIZE; ++i) {
+			const Cone & cone = DIFFUSE_CONES.cones[i];
+			for (int c = 0; c < 3; ++c) {
+				block.diffuseCones[2 * i][c] = cone.direction[c];
+				block.diffuseCones[2 * i + 1][c] = cone.offset[c];
+			}
+			block.diffuseCones[2 * i][3] = cone.weight;
+		}
+		block.diffuseConeCount[0] = DIFFUSE_CONES.SIZE;
+		block.diffuseConeSums[0] = DIFFUSE_CONE_WEIGHT_SUM;
+		block.diffuseConeSums[1] = DIFFUSE_CONE_NORMAL_SUM;
+		const DiffuseMarch & diffuse = DIFFUSE_MARCHES[0];
+		for (int i = 0; i < diffuse.steps; ++i) {
+			block.diffuseMarch[i][0] = diffuse.distance[i];
+			block.diffuseMarch[i][1] = diffuse.lod[i];
+			block.diffuseMarch[i][2] = diffuse.weight[i];
+		}
+		block.diffuseMarchSteps[0] = diffuse.steps;
+		for (int i = 0; i < SHADOW_MARCH.steps; ++i) {
+			block.shadowMarch[i][0] = SHADOW_MARCH.distance[i];
+			block.shadowMarch[i][1] = SHADOW_MARCH.nearLod[i];
+			block.shadowMarch[i][2] = SHADOW_MARCH.farLod[i];
+		}
+		block.shadowMarchSteps[0] = SHADOW_MARCH.steps;
+		for (int i = 0; i < PROBE_DIRECTION_COUNT; ++i)
+			for (int c = 0; c < 3; ++c) block.probeDirections[i][c] = PROBE_DIRECTIONS.directions[i][c];
+		return block;
+	}
+}
@@ -0,0 +1,150 @@
+#include "IrradianceProbeGrid.h"
+
+// Stdlib.
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+
+// Internal.
+#include "VoxelMipChain.h"
+#include "VoxelConeTracer.h"
+#include "ConeSets.h"
+#include "../../Utility/Parallel.h"
+
+namespace {
+	const float PI = 3.14159265f;
+	const float SH_Y0 = 0.282095f; // L0 basis function, 1 / (2 sqrt(pi)).
+	const float SH_Y1 = 0.488603f; // L1 basis functions are this times x, y and z.
+	const float BACKFACE_WEIGHT = 0.2f; // Least weight of a probe behind the surface.
+	static_assert(IrradianceProbeGrid::DIRECTION_COUNT == ConeSets::PROBE_DIRECTION_COUNT, "The probe directions are tabulated in ConeSets.");
+}
+
+IrradianceProbeGrid::IrradianceProbeGrid(const int _probesPerAxis) : probesPerAxis(_probesPerAxis)
+{
+	assert(probesPerAxis > 0);
+	const size_t count = size_t(probesPerAxis) * probesPerAxis * probesPerAxis;
+	states.assign(count, EMPTY);
+	coefficients.assign(count * COEFFICIENT_COUNT, glm::vec3(0.0f));
+}
+
+// ----------------------
+// Placement and updates.
+// ----------------------
+void IrradianceProbeGrid::invalidate(const VoxelMipChain & volume, const float alphaThreshold)
+{
+	const int size = volume.getSize();
+	assert(size % probesPerAxis == 0);
+	const int spacing = size / probesPerAxis; // In voxels.
+	std::vector<unsigned char> occupancy;
+	volume.getOccupancy(occupancy, alphaThreshold);
+	auto occupied = [&](const int x, const int y, const int z) {
+		if (x < 0 || y < 0 || z < 0 || x >= size || y >= size || z >= size) return false;
+		return occupancy[(size_t(z) * size + y) * size + x] != 0;
+	};
+
+	// A probe needs free voxels around its center and an occupied voxel within two spacings (what a surface point
+	// moved half a spacing along its normal can interpolate from).
+	placed.clear();
+	pendingCount = 0;
+	for (int z = 0; z < probesPerAxis; ++z) for (int y = 0; y < probesPerAxis; ++y) for (int x = 0; x < probesPerAxis; ++x) {
+		const glm::ivec3 center = glm::ivec3(x, y, z) * spacing + spacing / 2; // First voxel above the probe's center.
+		bool free = true, near = false;
+		for (int i = 0; i < 8 && free; ++i)
+			free = !occupied(center.x - 1 + (i & 1), center.y - 1 + ((i >> 1) & 1), center.z - 1 + (i >> 2));
+		for (int vz = center.z - 2 * spacing; vz < center.z + 2 * spacing && free && !near; ++vz)
+			for (int vy = center.y - 2 * spacing; vy < center.y + 2 * spacing && !near; ++vy)
+				for (int vx = center.x - 2 * spacing; vx < center.x + 2 * spacing && !near; ++vx)
+					near = occupied(vx, vy, vz);
+
+		const int index = (z * probesPerAxis + y) * probesPerAxis + x;
+		State & state = states[index];
+		if (!(free && near)) { state = EMPTY; continue; }
+		state = state == TRACED || state == OUTDATED ? OUTDATED : UNTRACED;
+		placed.push_back(index);
+		++pendingCount;
+	}
+	cursor = 0;
+}
+
+int IrradianceProbeGrid::update(const VoxelConeTracer & tracer, const int maxProbes, const unsigned int threadCount)
+{
+	// The next batch of pending probes in round-robin order.
+	std::vector<int> batch;
+	const size_t budget = maxProbes > 0 ? size_t(maxProbes) : placed.size();
+	for (size_t visited = 0; visited < placed.size() && batch.size() < budget && int(batch.size()) < pendingCount; ++visited) {
+		const int index = placed[cursor];
+		cursor = (cursor + 1) % placed.size();
+		if (states[index] != TRACED) batch.push_back(index);
+	}
+
+	// Project the cone radiance onto L1 spherical harmonics: c = 4 pi / N * sum(f(d) * Y(d)).
+	Parallel::forEachTask(int(batch.size()), [&](int task) {
+		const int index = batch[task];
+		const int x = index % probesPerAxis, y = (index / probesPerAxis) % probesPerAxis, z = index / (probesPerAxis * probesPerAxis);
+		const glm::vec3 position = getPosition(x, y, z);
+		glm::vec3 projected[COEFFICIENT_COUNT] = {};
+		unsigned int steps = 0;
+		for (int i = 0; i < DIRECTION_COUNT; ++i) {
+			const glm::vec3 direction = getDirection(i);
+			const glm::vec3 radiance = tracer.traceDiffuseCone(position, direction, steps);
+			projected[0] += radiance * SH_Y0;
+			projected[1] += radiance * (SH_Y1 * direction.x);
+			projected[2] += radiance * (SH_Y1 * direction.y);
+			projected[3] += radiance * (SH_Y1 * direction.z);
+		}
+		for (int c = 0; c < COEFFICIENT_COUNT; ++c) coefficients[size_t(index) * COEFFICIENT_COUNT + c] = projected[c] * (4.0f * PI / DIRECTION_COUNT);
+		states[index] = TRACED;
+	}, threadCount);
+
+	pendingCount -= int(batch.size());
+	return int(batch.size());
+}
+
+// ----------------------
+// Sampling.
+// ----------------------
+bool IrradianceProbeGrid::sample(const glm::vec3 & position, const glm::vec3 & normal, glm::vec3 result[COEFFICIENT_COUNT]) const
+{
+	const float spacing = getSpacing();
+	const glm::vec3 grid = (position + 0.5f * spacing * normal + glm::vec3(1.0f)) / spacing - glm::vec3(0.5f);
+	const glm::ivec3 base(int(std::floor(grid.x)), int(std::floor(grid.y)), int(std::floor(grid.z)));
+	const glm::vec3 f = grid - glm::vec3(base);
+
+	for (int c = 0; c < COEFFICIENT_COUNT; ++c) result[c] = glm::vec3(0.0f);
+	float weightSum = 0.0f;
+	for (int corner = 0; corner < 8; ++corner) {
+		const glm::ivec3 offset(corner & 1, (corner >> 1) & 1, corner >> 2);
+		const glm::ivec3 p = base + offset;
+		if (p.x < 0 || p.y < 0 || p.z < 0 || p.x >= probesPerAxis || p.y >= probesPerAxis || p.z >= probesPerAxis) continue;
+		const int index = (p.z * probesPerAxis + p.y) * probesPerAxis + p.x;
+		if (states[index] == EMPTY || states[index] == UNTRACED) continue;
+
+		// Trilinear weight, lowered for probes behind the surface.
+		float weight = (offset.x ? f.x : 1 - f.x) * (offset.y ? f.y : 1 - f.y) * (offset.z ? f.z : 1 - f.z);
+		const glm::vec3 toProbe = getPosition(p.x, p.y, p.z) - position;
+		const float distance = glm::length(toProbe);
+		if (distance > 1e-6f) {
+			const float facing = 0.5f * (glm::dot(toProbe / distance, normal) + 1.0f);
+			weight *= facing * facing + BACKFACE_WEIGHT;
+		}
+		if (weight <= 0.0f) continue;
+		for (int c = 0; c < COEFFICIENT_COUNT; ++c) result[c] += weight * coefficients[size_t(index) * COEFFICIENT_COUNT + c];
+		weightSum += weight;
+	}
+	if (weightSum < 1e-6f) return false;
+	for (int c = 0; c < COEFFICIENT_COUNT; ++c) result[c] /= weightSum;
+	return true;
+}
+
+glm::vec3 IrradianceProbeGrid::evaluate(const glm::vec3 c[COEFFICIENT_COUNT], const glm::vec3 & direction)
+{
+	const glm::vec3 radiance = SH_Y0 * c[0] + SH_Y1 * (direction.x * c[1] + direction.y * c[2] + direction.z * c[3]);
+	return glm::max(radiance, glm::vec3(0.0f));
+}
+
+glm::vec3 IrradianceProbeGrid::getDirection(const int i)
+{
+	assert(i >= 0 && i < DIRECTION_COUNT);
+	const float * direction = ConeSets::PROBE_DIRECTIONS.directions[i];
+	return glm::vec3(direction[0], direction[1], direction[2]);
+}
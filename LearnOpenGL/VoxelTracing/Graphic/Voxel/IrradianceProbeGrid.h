@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vector>
+
+#include <glm.hpp>
+
+class VoxelMipChain;
+class VoxelConeTracer;
+
+/// <summary> A sparse grid of irradiance probes over the voxel volume ([-1, 1]^3), cached from voxel cone tracing.
+/// Every probe stores the diffuse cone radiance around its center as L1 spherical harmonics (4 RGB coefficients),
+/// projected from DIRECTION_COUNT diffuse cones. Probes are only placed near non-empty voxels: their center must be free
+/// and an occupied voxel must lie within two probe spacings. When the voxels change, invalidate() marks every probe pending
+/// and update() re-traces them in round-robin batches, so the cost is spread over frames and does not depend on the
+/// screen resolution. Pending probes keep their old light until they are traced again.
+/// Matches the textures written by 'irradiance_probes.comp'. </summary>
+class IrradianceProbeGrid {
+public:
+	static const int DIRECTION_COUNT = 32;
+	static const int COEFFICIENT_COUNT = 4; // L0, then L1 along x, y and z.
+
+	/// <summary> Creates a grid without probes. The number of probes per axis must divide the volume size. </summary>
+	IrradianceProbeGrid(const int probesPerAxis = 16);
+
+	/// <summary> Places the probes for a volume (a voxel is occupied if its alpha is above the threshold) and marks them all pending.
+	/// Probes that stay in place keep their light until update() reaches them. </summary>
+	void invalidate(const VoxelMipChain & volume, const float alphaThreshold = 0.0f);
+
+	/// <summary> Traces at most maxProbes pending probes (all of them if 0), continuing from where the last call stopped.
+	/// The tracer must sample the volume passed to invalidate. Returns the number of probes traced. </summary>
+	int update(const VoxelConeTracer & tracer, const int maxProbes = 0, const unsigned int threadCount = 0);
+
+	/// <summary> Interpolates the coefficients of the 8 probes around a surface point, moved half a probe spacing along its normal.
+	/// Probes that are not placed, not traced yet or behind the surface weigh less or nothing. Returns false if no probe contributes. </summary>
+	bool sample(const glm::vec3 & position, const glm::vec3 & normal, glm::vec3 coefficients[COEFFICIENT_COUNT]) const;
+
+	/// <summary> Evaluates the L1 radiance of a set of coefficients in a normalized direction. </summary>
+	static glm::vec3 evaluate(const glm::vec3 coefficients[COEFFICIENT_COUNT], const glm::vec3 & direction);
+
+	/// <summary> Returns the direction of cone i of the DIRECTION_COUNT cones traced per probe (a spherical Fibonacci set). </summary>
+	static glm::vec3 getDirection(const int i);
+
+	// ----------------
+	// Accessors.
+	// ----------------
+	int getProbesPerAxis() const { return probesPerAxis; }
+	float getSpacing() const { return 2.0f / probesPerAxis; }
+	int getProbeCount() const { return int(states.size()); }
+	int getPlacedProbeCount() const { return int(placed.size()); }
+	int getPendingProbeCount() const { return pendingCount; }
+	glm::vec3 getPosition(const int x, const int y, const int z) const { return glm::vec3(x, y, z) * getSpacing() + glm::vec3(0.5f * getSpacing() - 1.0f); }
+private:
+	enum State : unsigned char {
+		EMPTY = 0,		// Not placed.
+		UNTRACED = 1,	// Placed, never traced.
+		OUTDATED = 2,	// Placed and traced, but the voxels changed since.
+		TRACED = 3
+	};
+	int probesPerAxis;
+	std::vector<State> states;
+	std::vector<glm::vec3> coefficients; // COEFFICIENT_COUNT per probe.
+	std::vector<int> placed; // Indices of the placed probes, in the round-robin order.
+	size_t cursor = 0; // Next entry of placed to look at.
+	int pendingCount = 0; // Untraced and outdated probes.
+};
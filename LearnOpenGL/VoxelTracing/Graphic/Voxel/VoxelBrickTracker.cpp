@@ -0,0 +1,91 @@
+#include "VoxelBrickTracker.h"
+
+#include <cassert>
+#include <algorithm>
+
+VoxelBrickTracker::VoxelBrickTracker(const int _size, const int _levelCount) : size(_size), levelCount(_levelCount)
+{
+	assert(size > 0 && (size & (size - 1)) == 0);
+	dirtyFlags.resize(levelCount);
+	dirtyBricks.resize(levelCount);
+	for (int level = 0; level < levelCount; ++level) {
+		const int n = getBricksPerAxis(level);
+		dirtyFlags[level].assign(size_t(n) * n * n, 0);
+	}
+	markAllDirty();
+}
+
+int VoxelBrickTracker::getBricksPerAxis(const int level) const
+{
+	return std::max(1, (size >> level) / BRICK_SIZE);
+}
+
+void VoxelBrickTracker::getBrickTexels(const int level, const unsigned int brick, glm::ivec3 & begin, glm::ivec3 & end) const
+{
+	const unsigned int n = getBricksPerAxis(level);
+	const int levelSize = std::max(1, size >> level);
+	const glm::ivec3 b(brick % n, (brick / n) % n, brick / (n * n));
+	begin = b * BRICK_SIZE;
+	end = glm::min(begin + glm::ivec3(BRICK_SIZE), glm::ivec3(levelSize));
+}
+
+void VoxelBrickTracker::markDirty(glm::ivec3 voxelMin, glm::ivec3 voxelMax)
+{
+	voxelMin = glm::max(voxelMin, glm::ivec3(0));
+	voxelMax = glm::min(voxelMax, glm::ivec3(size - 1));
+	if (voxelMin.x > voxelMax.x || voxelMin.y > voxelMax.y || voxelMin.z > voxelMax.z) return;
+
+	const int n = getBricksPerAxis(0);
+	const glm::ivec3 brickMin = voxelMin / BRICK_SIZE, brickMax = glm::min(voxelMax / BRICK_SIZE, glm::ivec3(n - 1));
+	auto & flags = dirtyFlags[0];
+	for (int z = brickMin.z; z <= brickMax.z; ++z) {
+		for (int y = brickMin.y; y <= brickMax.y; ++y) {
+			for (int x = brickMin.x; x <= brickMax.x; ++x) {
+				const unsigned int index = x + n * (y + n * z);
+				if (flags[index]) continue;
+				flags[index] = 1;
+				dirtyBricks[0].push_back(index);
+			}
+		}
+	}
+	anyDirty = true;
+}
+
+void VoxelBrickTracker::markDirty(const glm::vec3 & worldMin, const glm::vec3 & worldMax)
+{
+	// Voxel space is [-1, 1]^3, pad by a voxel to cover conservative rasterization and filtering.
+	const glm::vec3 scale(0.5f * size);
+	const glm::ivec3 voxelMin = glm::ivec3(glm::floor((worldMin + glm::vec3(1.0f)) * scale)) - glm::ivec3(1);
+	const glm::ivec3 voxelMax = glm::ivec3(glm::floor((worldMax + glm::vec3(1.0f)) * scale)) + glm::ivec3(1);
+	markDirty(voxelMin, voxelMax);
+}
+
+void VoxelBrickTracker::markAllDirty()
+{
+	markDirty(glm::ivec3(0), glm::ivec3(size - 1));
+}
+
+void VoxelBrickTracker::propagate()
+{
+	for (int level = 1; level < levelCount; ++level) {
+		const int n = getBricksPerAxis(level), childN = getBricksPerAxis(level - 1);
+		auto & flags = dirtyFlags[level];
+		for (const unsigned int child : dirtyBricks[level - 1]) {
+			const glm::ivec3 c(child % childN, (child / childN) % childN, child / (childN * childN));
+			const glm::ivec3 p = glm::min(c / 2, glm::ivec3(n - 1));
+			const unsigned int index = p.x + n * (p.y + n * p.z);
+			if (flags[index]) continue;
+			flags[index] = 1;
+			dirtyBricks[level].push_back(index);
+		}
+	}
+}
+
+void VoxelBrickTracker::clear()
+{
+	for (int level = 0; level < levelCount; ++level) {
+		for (const unsigned int index : dirtyBricks[level]) dirtyFlags[level][index] = 0;
+		dirtyBricks[level].clear();
+	}
+	anyDirty = false;
+}
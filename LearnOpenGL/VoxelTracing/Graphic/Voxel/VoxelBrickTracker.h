@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+
+#include <glm.hpp>
+
+/// <summary> Tracks which 8x8x8 bricks of a cubic voxel volume have changed since the mipmaps were last built.
+/// Every mip level has its own brick grid. Dirty bricks at level 0 are propagated to their parent bricks,
+/// so only the parent texels above a local edit have to be rebuilt. </summary>
+class VoxelBrickTracker {
+public:
+	static const int BRICK_SIZE = 8;
+
+	/// <summary> Creates a tracker for a volume with the given size (a power of 2). Everything starts out dirty. </summary>
+	VoxelBrickTracker(const int size, const int levelCount);
+
+	/// <summary> Marks all level 0 bricks overlapping an inclusive voxel box as dirty. The box is clamped to the volume. </summary>
+	void markDirty(glm::ivec3 voxelMin, glm::ivec3 voxelMax);
+
+	/// <summary> Marks all level 0 bricks overlapping a box in voxel space [-1, 1]^3 as dirty (see 'voxelization.frag'). </summary>
+	void markDirty(const glm::vec3 & worldMin, const glm::vec3 & worldMax);
+
+	/// <summary> Marks the whole volume as dirty. </summary>
+	void markAllDirty();
+
+	/// <summary> Propagates the level 0 dirty bricks to every mip level. Call before reading getDirtyBricks(level > 0). </summary>
+	void propagate();
+
+	/// <summary> Resets the tracker after the mipmaps have been rebuilt. </summary>
+	void clear();
+
+	/// <summary> Returns true if any brick has been marked since the last clear. </summary>
+	bool isDirty() const { return anyDirty; }
+
+	/// <summary> Returns the linear indices (x + n * (y + n * z)) of the dirty bricks of a level. </summary>
+	const std::vector<unsigned int> & getDirtyBricks(const int level) const { return dirtyBricks[level]; }
+
+	/// <summary> Returns the number of bricks along each axis of a level. </summary>
+	int getBricksPerAxis(const int level) const;
+
+	/// <summary> Returns the first texel and one past the last texel of a brick. </summary>
+	void getBrickTexels(const int level, const unsigned int brick, glm::ivec3 & begin, glm::ivec3 & end) const;
+
+	int getLevelCount() const { return levelCount; }
+private:
+	int size, levelCount;
+	bool anyDirty = true;
+	std::vector<std::vector<unsigned char>> dirtyFlags;		// One flag per brick and level.
+	std::vector<std::vector<unsigned int>> dirtyBricks;		// Dirty brick indices per level.
+};
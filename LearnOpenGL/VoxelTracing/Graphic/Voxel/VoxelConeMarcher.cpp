@@ -0,0 +1,228 @@
+#include "VoxelConeMarcher.h"
+
+// Stdlib.
+#include <cmath>
+#include <algorithm>
+
+// External.
+#include <immintrin.h>
+
+// Internal.
+#include "VoxelMipChain.h"
+
+namespace {
+	inline bool insideVolume(const glm::vec3 & p) {
+		return p.x >= 0.0f && p.y >= 0.0f && p.z >= 0.0f && p.x <= 1.0f && p.y <= 1.0f && p.z <= 1.0f;
+	}
+
+#if __CONE_MARCHER_USE_AVX2
+	/// <summary> log2 for positive normal floats, exponent plus a polynomial for the mantissa (error < 2.1e-4). </summary>
+	inline __m256 log2Approx(const __m256 x) {
+		const __m256i bits = _mm256_castps_si256(x);
+		const __m256 exponent = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127)));
+		const __m256 m = _mm256_sub_ps(_mm256_or_ps(_mm256_castsi256_ps(_mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff))), _mm256_set1_ps(1.0f)), _mm256_set1_ps(1.0f));
+		__m256 p = _mm256_set1_ps(-0.0791581658f);
+		p = _mm256_fmadd_ps(p, m, _mm256_set1_ps(0.3122409870f));
+		p = _mm256_fmadd_ps(p, m, _mm256_set1_ps(-0.6695422910f));
+		p = _mm256_fmadd_ps(p, m, _mm256_set1_ps(1.4361078326f));
+		p = _mm256_fmadd_ps(p, m, _mm256_set1_ps(0.0002031792f));
+		return _mm256_add_ps(exponent, p);
+	}
+
+	/// <summary> RGBA (premultiplied by nothing, channels in [0, 1]) of eight texels, one per lane. </summary>
+	struct Texels8 { __m256 r, g, b, a; };
+
+	/// <summary> Gathers eight RGBA8 texels and unpacks them to floats. Inactive lanes (and lanes outside
+	/// their level) read zero without touching memory. </summary>
+	inline Texels8 gatherRGBA8(const int * texels, const __m256i index, const __m256i mask) {
+		const __m256i packed = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), texels, index, mask, 4);
+		const __m256i byte = _mm256_set1_epi32(0xff);
+		const __m256 scale = _mm256_set1_ps(1.0f / 255.0f);
+		Texels8 t;
+		t.r = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(packed, byte)), scale);
+		t.g = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(packed, 8), byte)), scale);
+		t.b = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(packed, 16), byte)), scale);
+		t.a = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(packed, 24)), scale);
+		return t;
+	}
+
+	/// <summary> Trilinear sample of one mip level per lane (levels may differ between lanes), zero border. </summary>
+	inline Texels8 sampleLevel8(const int * texels, const int * levelOffsets, const int size,
+		const __m256 u, const __m256 v, const __m256 w, const __m256i level, const __m256i active) {
+		const __m256i levelSize = _mm256_srlv_epi32(_mm256_set1_epi32(size), level);
+		const __m256i offset = _mm256_i32gather_epi32(levelOffsets, level, 4);
+		const __m256 sizeF = _mm256_cvtepi32_ps(levelSize);
+		const __m256 half = _mm256_set1_ps(0.5f);
+
+		const __m256 px = _mm256_fmsub_ps(u, sizeF, half), py = _mm256_fmsub_ps(v, sizeF, half), pz = _mm256_fmsub_ps(w, sizeF, half);
+		const __m256 bx = _mm256_floor_ps(px), by = _mm256_floor_ps(py), bz = _mm256_floor_ps(pz);
+		const __m256 fx = _mm256_sub_ps(px, bx), fy = _mm256_sub_ps(py, by), fz = _mm256_sub_ps(pz, bz);
+		const __m256i x0 = _mm256_cvttps_epi32(bx), y0 = _mm256_cvttps_epi32(by), z0 = _mm256_cvttps_epi32(bz);
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256i minusOne = _mm256_set1_epi32(-1);
+
+		Texels8 result = { _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps() };
+		for (int corner = 0; corner < 8; ++corner) {
+			const int dx = corner & 1, dy = (corner >> 1) & 1, dz = corner >> 2;
+			const __m256i x = _mm256_add_epi32(x0, _mm256_set1_epi32(dx));
+			const __m256i y = _mm256_add_epi32(y0, _mm256_set1_epi32(dy));
+			const __m256i z = _mm256_add_epi32(z0, _mm256_set1_epi32(dz));
+
+			// Inside if 0 <= c < size for every axis.
+			__m256i inside = active;
+			inside = _mm256_and_si256(inside, _mm256_cmpgt_epi32(x, minusOne));
+			inside = _mm256_and_si256(inside, _mm256_cmpgt_epi32(y, minusOne));
+			inside = _mm256_and_si256(inside, _mm256_cmpgt_epi32(z, minusOne));
+			inside = _mm256_and_si256(inside, _mm256_cmpgt_epi32(levelSize, x));
+			inside = _mm256_and_si256(inside, _mm256_cmpgt_epi32(levelSize, y));
+			inside = _mm256_and_si256(inside, _mm256_cmpgt_epi32(levelSize, z));
+
+			const __m256i index = _mm256_add_epi32(offset, _mm256_add_epi32(
+				_mm256_mullo_epi32(_mm256_add_epi32(_mm256_mullo_epi32(z, levelSize), y), levelSize), x));
+			const Texels8 t = gatherRGBA8(texels, index, inside);
+
+			const __m256 weight = _mm256_mul_ps(_mm256_mul_ps(
+				dx ? fx : _mm256_sub_ps(one, fx), dy ? fy : _mm256_sub_ps(one, fy)), dz ? fz : _mm256_sub_ps(one, fz));
+			result.r = _mm256_fmadd_ps(weight, t.r, result.r);
+			result.g = _mm256_fmadd_ps(weight, t.g, result.g);
+			result.b = _mm256_fmadd_ps(weight, t.b, result.b);
+			result.a = _mm256_fmadd_ps(weight, t.a, result.a);
+		}
+		return result;
+	}
+#endif
+}
+
+VoxelConeMarcher::VoxelConeMarcher(const VoxelMipChain & _volume, const float _stepScale) :
+	volume(_volume), stepScale(_stepScale), voxelSize(1.0f / _volume.getSize()), maxLod(float(_volume.getLevelCount() - 1))
+{
+	// Texel offsets of every level, padded so lanes can always gather level + 1.
+	const int bpv = volume.getBytesPerVoxel();
+	for (int level = 0; level <= volume.getLevelCount(); ++level) {
+		const int l = std::min(level, volume.getLevelCount() - 1);
+		levelOffsets.push_back(int((volume.getLevelData(l) - volume.getLevelData(0)) / bpv));
+	}
+}
+
+bool VoxelConeMarcher::usesPackets() const
+{
+	return __CONE_MARCHER_USE_AVX2 && volume.getFormat() == VoxelMipChain::Format::RGBA8;
+}
+
+void VoxelConeMarcher::march(const Cone * cones, Result * results, const int count) const
+{
+	int i = 0;
+#if __CONE_MARCHER_USE_AVX2
+	if (usesPackets()) {
+		for (; i + PACKET_SIZE <= count; i += PACKET_SIZE) marchPacket(cones + i, results + i);
+	}
+#endif
+	for (; i < count; ++i) results[i] = marchCone(cones[i]);
+}
+
+void VoxelConeMarcher::marchScalar(const Cone * cones, Result * results, const int count) const
+{
+	for (int i = 0; i < count; ++i) results[i] = marchCone(cones[i]);
+}
+
+VoxelConeMarcher::Result VoxelConeMarcher::marchCone(const Cone & cone) const
+{
+	Result result;
+	result.color = glm::vec4(0.0f);
+	float dist = cone.startDistance;
+	for (;;) {
+		const glm::vec3 p = cone.origin + dist * cone.direction;
+		if (result.color.a >= 1.0f || dist >= cone.maxDistance || !insideVolume(p)) break;
+
+		// Footprint of the cone, at least one voxel, decides the mip level and the step length.
+		const float diameter = std::max(voxelSize, 2.0f * cone.aperture * dist);
+		const float lod = std::min(std::log2(diameter / voxelSize), maxLod);
+		const glm::vec4 sample = volume.sampleLod(p, lod);
+
+		// Front to back compositing.
+		const float weight = (1.0f - result.color.a) * sample.a;
+		result.color += glm::vec4(weight * glm::vec3(sample), weight);
+		dist += stepScale * diameter;
+		++result.steps;
+	}
+	return result;
+}
+
+#if __CONE_MARCHER_USE_AVX2
+void VoxelConeMarcher::marchPacket(const Cone * cones, Result * results) const
+{
+	// Transpose the packet into one register per component.
+	alignas(32) float lanes[9][PACKET_SIZE];
+	for (int i = 0; i < PACKET_SIZE; ++i) {
+		const Cone & c = cones[i];
+		lanes[0][i] = c.origin.x; lanes[1][i] = c.origin.y; lanes[2][i] = c.origin.z;
+		lanes[3][i] = c.direction.x; lanes[4][i] = c.direction.y; lanes[5][i] = c.direction.z;
+		lanes[6][i] = c.aperture; lanes[7][i] = c.startDistance; lanes[8][i] = c.maxDistance;
+	}
+	const __m256 ox = _mm256_load_ps(lanes[0]), oy = _mm256_load_ps(lanes[1]), oz = _mm256_load_ps(lanes[2]);
+	const __m256 dx = _mm256_load_ps(lanes[3]), dy = _mm256_load_ps(lanes[4]), dz = _mm256_load_ps(lanes[5]);
+	const __m256 twoAperture = _mm256_add_ps(_mm256_load_ps(lanes[6]), _mm256_load_ps(lanes[6]));
+	const __m256 maxDistance = _mm256_load_ps(lanes[8]);
+	__m256 dist = _mm256_load_ps(lanes[7]);
+
+	const int * texels = reinterpret_cast<const int *>(volume.getLevelData(0));
+	const int size = volume.getSize();
+	const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+	const __m256 voxel = _mm256_set1_ps(voxelSize), inverseVoxel = _mm256_set1_ps(1.0f / voxelSize);
+	const __m256 maxLodV = _mm256_set1_ps(maxLod), step = _mm256_set1_ps(stepScale);
+
+	__m256 r = zero, g = zero, b = zero, a = zero;
+	__m256i steps = _mm256_setzero_si256();
+	for (;;) {
+		const __m256 u = _mm256_fmadd_ps(dist, dx, ox), v = _mm256_fmadd_ps(dist, dy, oy), w = _mm256_fmadd_ps(dist, dz, oz);
+
+		// Lanes stay active until they are opaque, reach their max distance or leave the volume.
+		__m256 activeF = _mm256_and_ps(_mm256_cmp_ps(a, one, _CMP_LT_OQ), _mm256_cmp_ps(dist, maxDistance, _CMP_LT_OQ));
+		activeF = _mm256_and_ps(activeF, _mm256_and_ps(_mm256_cmp_ps(u, zero, _CMP_GE_OQ), _mm256_cmp_ps(u, one, _CMP_LE_OQ)));
+		activeF = _mm256_and_ps(activeF, _mm256_and_ps(_mm256_cmp_ps(v, zero, _CMP_GE_OQ), _mm256_cmp_ps(v, one, _CMP_LE_OQ)));
+		activeF = _mm256_and_ps(activeF, _mm256_and_ps(_mm256_cmp_ps(w, zero, _CMP_GE_OQ), _mm256_cmp_ps(w, one, _CMP_LE_OQ)));
+		if (_mm256_movemask_ps(activeF) == 0) break;
+		const __m256i active = _mm256_castps_si256(activeF);
+
+		// Footprint and mip levels.
+		const __m256 diameter = _mm256_max_ps(voxel, _mm256_mul_ps(twoAperture, dist));
+		const __m256 lod = _mm256_max_ps(zero, _mm256_min_ps(log2Approx(_mm256_mul_ps(diameter, inverseVoxel)), maxLodV));
+		const __m256 lodFloor = _mm256_floor_ps(lod);
+		const __m256 t = _mm256_sub_ps(lod, lodFloor);
+		const __m256i level = _mm256_cvttps_epi32(lodFloor);
+
+		// Quadrilinear sample. The second level is only fetched by lanes that blend into it.
+		const Texels8 s0 = sampleLevel8(texels, levelOffsets.data(), size, u, v, w, level, active);
+		const __m256i blend = _mm256_and_si256(active, _mm256_castps_si256(_mm256_cmp_ps(t, zero, _CMP_GT_OQ)));
+		Texels8 s = s0;
+		if (!_mm256_testz_si256(blend, blend)) {
+			const Texels8 s1 = sampleLevel8(texels, levelOffsets.data(), size, u, v, w, _mm256_add_epi32(level, _mm256_set1_epi32(1)), blend);
+			s.r = _mm256_fmadd_ps(t, _mm256_sub_ps(s1.r, s0.r), s0.r);
+			s.g = _mm256_fmadd_ps(t, _mm256_sub_ps(s1.g, s0.g), s0.g);
+			s.b = _mm256_fmadd_ps(t, _mm256_sub_ps(s1.b, s0.b), s0.b);
+			s.a = _mm256_fmadd_ps(t, _mm256_sub_ps(s1.a, s0.a), s0.a);
+		}
+
+		// Front to back compositing, masked to the active lanes.
+		const __m256 weight = _mm256_and_ps(activeF, _mm256_mul_ps(_mm256_sub_ps(one, a), s.a));
+		r = _mm256_fmadd_ps(weight, s.r, r);
+		g = _mm256_fmadd_ps(weight, s.g, g);
+		b = _mm256_fmadd_ps(weight, s.b, b);
+		a = _mm256_add_ps(a, weight);
+		dist = _mm256_add_ps(dist, _mm256_and_ps(activeF, _mm256_mul_ps(step, diameter)));
+		steps = _mm256_sub_epi32(steps, active); // Active lanes are -1.
+	}
+
+	alignas(32) float out[4][PACKET_SIZE];
+	alignas(32) int outSteps[PACKET_SIZE];
+	_mm256_store_ps(out[0], r);
+	_mm256_store_ps(out[1], g);
+	_mm256_store_ps(out[2], b);
+	_mm256_store_ps(out[3], a);
+	_mm256_store_si256(reinterpret_cast<__m256i *>(outSteps), steps);
+	for (int i = 0; i < PACKET_SIZE; ++i) {
+		results[i].color = glm::vec4(out[0][i], out[1][i], out[2][i], out[3][i]);
+		results[i].steps = outSteps[i];
+	}
+}
+#endif
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vector>
+
+#include <glm.hpp>
+
+class VoxelMipChain;
+
+#if defined(__AVX2__)
+#define __CONE_MARCHER_USE_AVX2 1
+#else
+#define __CONE_MARCHER_USE_AVX2 0
+#endif
+
+/// <summary> A generic CPU cone marching kernel over a VoxelMipChain (the Texture3D layout).
+/// Every sample is a quadrilinear fetch (trilinear in the two mip levels around the cone's footprint, zero border)
+/// that is composited front to back. With AVX2 and an RGBA8 volume, cones are marched in packets of 8 in lockstep
+/// using gathers, and lanes that terminate are masked out until the whole packet is done.
+/// Otherwise (and for the tail of a batch) the scalar path marches one cone at a time with the same math. </summary>
+class VoxelConeMarcher {
+public:
+	static const int PACKET_SIZE = 8;
+
+	/// <summary> A cone in texture space [0, 1]^3. The aperture is tan(half angle). Distances are in texture space too. </summary>
+	struct Cone {
+		glm::vec3 origin, direction;
+		float aperture = 0.577f;
+		float startDistance = 0.0f, maxDistance = 1.732f;
+	};
+
+	/// <summary> Accumulated color (rgb weighted by alpha) and opacity, and the number of samples taken. </summary>
+	struct Result {
+		glm::vec4 color;
+		int steps = 0;
+	};
+
+	/// <summary> Creates a marcher for a volume with mipmaps. Each step advances by stepScale times the cone diameter
+	/// (at least one voxel). The volume must outlive the marcher. </summary>
+	VoxelConeMarcher(const VoxelMipChain & volume, const float stepScale = 0.5f);
+
+	/// <summary> Marches a batch of cones with normalized directions. Uses packets when possible. </summary>
+	void march(const Cone * cones, Result * results, const int count) const;
+
+	/// <summary> Marches a batch of cones one at a time (the baseline for the packet path). </summary>
+	void marchScalar(const Cone * cones, Result * results, const int count) const;
+
+	/// <summary> Returns true if march() uses packets for this volume. </summary>
+	bool usesPackets() const;
+private:
+	const VoxelMipChain & volume;
+	float stepScale, voxelSize, maxLod;
+	std::vector<int> levelOffsets; // First texel of every level.
+
+	Result marchCone(const Cone & cone) const;
+	glm::vec4 sampleLevel(const glm::vec3 & uvw, const int level) const;
+#if __CONE_MARCHER_USE_AVX2
+	void marchPacket(const Cone * cones, Result * results) const;
+#endif
+};
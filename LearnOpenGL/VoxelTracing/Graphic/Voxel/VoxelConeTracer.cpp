@@ -0,0 +1,656 @@
+#include "VoxelConeTracer.h"
+
+// Stdlib.
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+#include <mutex>
+
+// Internal.
+#include "VoxelMipChain.h"
+#include "ConeBudgetScheduler.h"
+#include "IrradianceProbeGrid.h"
+#include "VoxelLightVisibility.h"
+#include "../Camera/Camera.h"
+#include "../Lighting/PointLight.h"
+#include "../Material/MaterialSetting.h"
+#include "../Denoising/AtrousFilter.h"
+#include "../ScreenSpace/HiZBuffer.h"
+#include "../../Utility/Parallel.h"
+#include "../../Utility/BlueNoise.h"
+
+namespace {
+	// ----------------
+	// Shader constants (see 'voxel_cone_tracing.frag').
+	// ----------------
+	const float SQRT2 = 1.414213f;
+	const float ISQRT2 = 0.707106f;
+	const float MIPMAP_HARDCAP = 5.4f;
+	const float DIFFUSE_INDIRECT_FACTOR = 0.52f;
+	const float SPECULAR_FACTOR = 4.0f;
+	const float SPECULAR_POWER = 65.0f;
+	const float DIRECT_LIGHT_INTENSITY = 0.96f;
+	const unsigned int MAX_LIGHTS = 1;
+	const float DIST_FACTOR = 1.1f;
+	const float CONSTANT = 1.0f, LINEAR = 0.0f, QUADRATIC = 1.0f;
+	const float SHADOW_OFFSET = 0.05f; // Along the normal, removes self shadowing artifacts.
+	const float GAMMA = 2.2f;
+
+	// Screen space reflections (see 'specular_reflections.frag').
+	const float REFLECTION_MAX_DISTANCE = 3.4641016f; // Diagonal of the voxel volume.
+	const float REFLECTION_THICKNESS = 0.1f; // In view depth, how far behind a surface a ray still hits it.
+	const float REFLECTION_NEAR = 0.01f; // Rays are clipped to this view depth.
+
+	// Joint bilateral upsampling (see 'indirect_upsample.frag').
+	const float UPSAMPLE_DEPTH_SIGMA = 0.05f;
+	const float UPSAMPLE_NORMAL_POWER = 16.0f;
+
+	// Temporal accumulation (see 'indirect_diffuse.frag').
+	const float PI = 3.14159265f;
+	const float MAX_HISTORY = 16.0f;
+	const float HISTORY_DEPTH_TOLERANCE = 0.05f;
+	const float HISTORY_NORMAL_TOLERANCE = 0.9f;
+
+	inline float attenuate(float dist) {
+		dist *= DIST_FACTOR;
+		return 1.0f / (CONSTANT + LINEAR * dist + QUADRATIC * dist * dist);
+	}
+
+	inline glm::vec3 orthogonal(glm::vec3 u) {
+		u = glm::normalize(u);
+		const glm::vec3 v(0.99146f, 0.11664f, 0.05832f); // Any normalized vector.
+		return std::abs(glm::dot(u, v)) > 0.99999f ? glm::cross(u, glm::vec3(0, 1, 0)) : glm::cross(u, v);
+	}
+
+	/// <summary> A tangent space vector of a ConeSets::Cone, rotated around the normal by an angle (its cosine and sine), in world space. </summary>
+	inline glm::vec3 toWorld(const float v[3], const float cosine, const float sine,
+		const glm::vec3 & ortho, const glm::vec3 & ortho2, const glm::vec3 & normal) {
+		return (cosine * v[0] - sine * v[1]) * ortho + (sine * v[0] + cosine * v[1]) * ortho2 + v[2] * normal;
+	}
+
+	inline glm::vec3 scaleAndBias(const glm::vec3 & p) { return 0.5f * p + glm::vec3(0.5f); }
+
+	inline bool isInsideCube(const glm::vec3 & p, const float e) {
+		return std::abs(p.x) < 1 + e && std::abs(p.y) < 1 + e && std::abs(p.z) < 1 + e;
+	}
+
+	inline glm::vec3 pow3(const glm::vec3 & v, const float e) {
+		return glm::vec3(std::pow(std::max(v.x, 0.0f), e), std::pow(std::max(v.y, 0.0f), e), std::pow(std::max(v.z, 0.0f), e));
+	}
+
+	inline float smoothstep(const float a, const float b, const float x) {
+		const float t = std::min(1.0f, std::max(0.0f, (x - a) / (b - a)));
+		return t * t * (3.0f - 2.0f * t);
+	}
+}
+
+VoxelConeTracer::VoxelConeTracer(const VoxelMipChain & _volume)
+	: volume(_volume), voxelSize(1.0f / _volume.getSize()), blueNoise(BlueNoise::generate()) {}
+
+// ----------------------
+// Rendering.
+// ----------------------
+void VoxelConeTracer::render(
+	const std::vector<GBufferTexel> & gBuffer, const int width, const int height,
+	const Camera & camera, const std::vector<PointLight> & pointLights,
+	const Settings & settings, Image & image, const unsigned int threadCount, History * history) const
+{
+	assert(gBuffer.size() == size_t(width) * height);
+	image.width = width;
+	image.height = height;
+	image.color.assign(gBuffer.size(), glm::vec3(0));
+	image.steps.assign(gBuffer.size(), 0);
+	image.cones.fill(0);
+	image.reflectionRays = image.reflectionHits = 0;
+	std::mutex conesMutex;
+	auto addCones = [&](const ConeCounters & cones) {
+		std::lock_guard<std::mutex> lock(conesMutex);
+		for (int c = 0; c < ConeBudget::CATEGORY_COUNT; ++c) image.cones[c] += cones[c];
+	};
+	const int blueNoiseSize = int(std::sqrt(float(blueNoise.size())));
+
+	// Indirect diffuse light at a reduced resolution (or accumulated over time, or with fewer cones and denoised): the
+	// texel in the middle of every block is traced and stands in for the block, like rasterizing the low resolution target.
+	// Irradiance probes are cheap enough to interpolate for every pixel instead.
+	const bool probes = settings.indirectDiffuseLight && settings.irradianceProbes && irradianceProbes != nullptr;
+	const bool temporal = settings.temporalIndirectDiffuse && history != nullptr && !probes;
+	const int RING_CONES = ConeSets::DIFFUSE_RING_CONES;
+	const int ringCones = std::min(std::max(settings.ringCones, 1), RING_CONES);
+	const bool reduced = settings.indirectDiffuseLight && !probes &&
+		(settings.indirectDiffuseResolution > 1 || temporal || ringCones < RING_CONES || settings.denoiseIterations > 0);
+	const int factor = reduced ? std::max(settings.indirectDiffuseResolution, 1) : 1;
+	const int lowWidth = (width + factor - 1) / factor, lowHeight = (height + factor - 1) / factor;
+	std::vector<glm::vec4> lowIndirect;
+	std::vector<GBufferTexel> lowGuide;
+	const glm::vec3 & cameraPosition = camera.position;
+
+	// Cone budgets per tile (diffuse cones are traced once per factor x factor block when reduced).
+	const int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE, tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+	const int lightCount = int(std::min<size_t>(pointLights.size(), MAX_LIGHTS));
+	std::vector<ConeBudgetScheduler::Tile> tiles;
+	const bool cachedShadows = settings.cachedShadows && lightVisibility != nullptr && lightVisibility->getLightCount() >= lightCount;
+	ConeBudgetScheduler(TILE_SIZE).schedule(gBuffer, width, height, cameraPosition, settings, cachedShadows ? 0 : lightCount,
+		probes ? 0.0f : 1.0f / (factor * factor), settings.coneBudget, tiles);
+	image.tileLevels.resize(tiles.size());
+	for (size_t t = 0; t < tiles.size(); ++t) image.tileLevels[t] = tiles[t].budget.level;
+
+	if (reduced) {
+		lowIndirect.assign(size_t(lowWidth) * lowHeight, glm::vec4(0, 0, 0, 1));
+		lowGuide.assign(size_t(lowWidth) * lowHeight, GBufferTexel());
+
+		// Fewer ring cones (or temporal mode) rotate them per pixel with blue noise, offset by a golden ratio sequence over the frames.
+		const unsigned int frame = temporal ? history->frame : 0;
+		const float frameOffset = float(std::fmod(frame * 0.6180339887, 1.0));
+		const bool historyValid = temporal && history->width == lowWidth && history->height == lowHeight && !history->indirect.empty();
+
+		Parallel::forEachTask(lowHeight, [&](int y) {
+			ConeCounters cones = {};
+			for (int x = 0; x < lowWidth; ++x) {
+				const int fx = std::min(x * factor + factor / 2, width - 1), fy = std::min(y * factor + factor / 2, height - 1);
+				const size_t i = size_t(fy) * width + fx, lowIndex = size_t(y) * lowWidth + x;
+				const GBufferTexel & texel = gBuffer[i];
+				lowGuide[lowIndex] = texel;
+				if (texel.material == nullptr) continue;
+				const ConeBudget & budget = tiles[size_t(fy / TILE_SIZE) * tilesX + fx / TILE_SIZE].budget;
+				const int pixelRingCones = std::min(ringCones, budget.ringConesOf(RING_CONES));
+				const bool jitter = temporal || pixelRingCones < RING_CONES;
+				const float u = jitter ? RING_CONES * std::fmod(blueNoise[(y % blueNoiseSize) * blueNoiseSize + x % blueNoiseSize] + frameOffset, 1.0f) : 0.0f;
+				Fragment fragment = { texel.position, glm::normalize(texel.normal), *texel.material, image.steps[i], budget, cones };
+				glm::vec3 indirect = shadeIndirectDiffuse(fragment, pixelRingCones, int(u), (u - std::floor(u)) * 2 * PI / RING_CONES);
+				if (!temporal) { lowIndirect[lowIndex] = glm::vec4(indirect, 1); continue; }
+
+				// Reproject into the previous frame and reject the history if disoccluded.
+				glm::vec4 previous(0.0f);
+				const glm::vec4 previousClip = history->viewProjection * glm::vec4(texel.position, 1);
+				if (historyValid && previousClip.w > 0) {
+					const glm::vec2 uv = 0.5f * glm::vec2(previousClip.x, previousClip.y) / previousClip.w + 0.5f;
+					if (uv.x >= 0 && uv.y >= 0 && uv.x < 1 && uv.y < 1) {
+						const int hx = int(uv.x * lowWidth), hy = int((1 - uv.y) * lowHeight); // Rows go top to bottom.
+						const size_t historyIndex = size_t(std::min(hy, lowHeight - 1)) * lowWidth + hx;
+						const GBufferTexel & g = history->guide[historyIndex];
+						if (g.material != nullptr) {
+							const float previousDepth = (history->viewProjection * glm::vec4(g.position, 1)).w;
+							if (std::abs(previousDepth - previousClip.w) <= HISTORY_DEPTH_TOLERANCE * previousClip.w &&
+								glm::dot(glm::normalize(g.normal), glm::normalize(texel.normal)) >= HISTORY_NORMAL_TOLERANCE)
+								previous = history->indirect[historyIndex];
+						}
+					}
+				}
+				const float frames = std::min(previous.w + 1, MAX_HISTORY);
+				lowIndirect[lowIndex] = glm::vec4(glm::mix(glm::vec3(previous), indirect, 1.0f / frames), frames);
+			}
+			addCones(cones);
+		}, threadCount);
+	}
+	// Denoising (the history keeps the noisy light).
+	std::vector<glm::vec4> filteredIndirect;
+	if (reduced && settings.denoiseIterations > 0) {
+		std::vector<AtrousFilter::GuideTexel> guide(lowGuide.size());
+		for (size_t i = 0; i < guide.size(); ++i) if (lowGuide[i].material != nullptr) {
+			guide[i].normal = glm::normalize(lowGuide[i].normal);
+			guide[i].depth = glm::length(lowGuide[i].position - cameraPosition);
+		}
+		filteredIndirect = lowIndirect;
+		AtrousFilter::apply(filteredIndirect, guide, lowWidth, lowHeight, settings.denoiseIterations, threadCount);
+	}
+	const std::vector<glm::vec4> & upsampledIndirect = filteredIndirect.empty() ? lowIndirect : filteredIndirect;
+
+	Settings fullResolution = settings;
+	fullResolution.indirectDiffuseLight = settings.indirectDiffuseLight && !reduced;
+
+	// Screen space reflections march against the lit scene: their pixels skip the specular cone here,
+	// and get their reflection added to the linear colors afterwards (before gamma correction).
+	const bool screenSpace = settings.indirectSpecularLight && settings.screenSpaceReflections;
+	Settings withoutReflections = fullResolution;
+	withoutReflections.indirectSpecularLight = false;
+
+	Parallel::forEachTask(tilesX * tilesY, [&](int tile) {
+		const int x0 = (tile % tilesX) * TILE_SIZE, y0 = (tile / tilesX) * TILE_SIZE;
+		const ConeBudget & budget = tiles[tile].budget;
+		ConeCounters cones = {};
+		for (int y = y0; y < std::min(y0 + TILE_SIZE, height); ++y) {
+			for (int x = x0; x < std::min(x0 + TILE_SIZE, width); ++x) {
+				const size_t i = size_t(y) * width + x;
+				const GBufferTexel & texel = gBuffer[i];
+				if (texel.material == nullptr) continue;
+				Fragment fragment = { texel.position, glm::normalize(texel.normal), *texel.material, image.steps[i], budget, cones };
+				const float jitter = blueNoise[(y % blueNoiseSize) * blueNoiseSize + x % blueNoiseSize];
+				const bool reflected = screenSpace && needsScreenSpaceReflection(*texel.material, settings);
+				glm::vec3 color = shadeFragment(fragment, cameraPosition, pointLights, reflected ? withoutReflections : fullResolution, jitter);
+
+				// Joint bilateral upsampling, same weights as 'indirect_upsample.frag' (view distance as depth).
+				if (reduced) {
+					const float depth = glm::length(texel.position - cameraPosition);
+					const glm::vec2 lowPosition = (glm::vec2(x, y) + 0.5f) / float(factor) - 0.5f;
+					const int bx = int(std::floor(lowPosition.x)), by = int(std::floor(lowPosition.y));
+					const float fx = lowPosition.x - bx, fy = lowPosition.y - by;
+					glm::vec3 sum(0.0f);
+					float weightSum = 0.0f;
+					for (int tap = 0; tap < 4; ++tap) {
+						const int ox = tap & 1, oy = tap >> 1;
+						const int tx = std::min(std::max(bx + ox, 0), lowWidth - 1), ty = std::min(std::max(by + oy, 0), lowHeight - 1);
+						const size_t lowIndex = size_t(ty) * lowWidth + tx;
+						const GBufferTexel & g = lowGuide[lowIndex];
+						if (g.material == nullptr) continue;
+						const float bilinear = (ox ? fx : 1 - fx) * (oy ? fy : 1 - fy);
+						const float depthWeight = std::exp(-std::abs(depth - glm::length(g.position - cameraPosition)) / (UPSAMPLE_DEPTH_SIGMA * depth));
+						const float normalWeight = std::pow(std::max(glm::dot(glm::normalize(texel.normal), glm::normalize(g.normal)), 0.0f), UPSAMPLE_NORMAL_POWER);
+						const float w = std::max(bilinear, 1e-3f) * depthWeight * normalWeight;
+						sum += w * glm::vec3(upsampledIndirect[lowIndex]);
+						weightSum += w;
+					}
+					if (weightSum > 1e-6f) color += sum / weightSum;
+				}
+				image.color[i] = screenSpace ? color : pow3(color, 1.0f / GAMMA);
+			}
+		}
+		addCones(cones);
+	}, threadCount);
+
+	// Screen space reflections, through the hierarchical view depth of the G-buffer. Misses trace the tile's specular cone.
+	if (screenSpace) {
+		const glm::mat4 viewProjection = camera.getViewProjectionMatrix();
+		std::vector<float> depth(gBuffer.size(), 0.0f);
+		for (size_t i = 0; i < gBuffer.size(); ++i)
+			if (gBuffer[i].material != nullptr) depth[i] = (viewProjection * glm::vec4(gBuffer[i].position, 1)).w;
+		HiZBuffer hiZ;
+		hiZ.build(depth, width, height);
+		const std::vector<glm::vec3> sceneColor = image.color;
+		const Screen screen = { hiZ, viewProjection, gBuffer, sceneColor };
+
+		Parallel::forEachTask(tilesX * tilesY, [&](int tile) {
+			const int x0 = (tile % tilesX) * TILE_SIZE, y0 = (tile / tilesX) * TILE_SIZE;
+			ConeCounters cones = {};
+			unsigned long long rays = 0, hits = 0;
+			for (int y = y0; y < std::min(y0 + TILE_SIZE, height); ++y) {
+				for (int x = x0; x < std::min(x0 + TILE_SIZE, width); ++x) {
+					const size_t i = size_t(y) * width + x;
+					const GBufferTexel & texel = gBuffer[i];
+					if (texel.material != nullptr && needsScreenSpaceReflection(*texel.material, settings)) {
+						Fragment fragment = { texel.position, glm::normalize(texel.normal), *texel.material, image.steps[i], tiles[tile].budget, cones };
+						bool hit = false;
+						image.color[i] += screenSpaceReflection(fragment, glm::normalize(texel.position - cameraPosition), screen, hit);
+						++rays;
+						if (hit) ++hits;
+					}
+					image.color[i] = pow3(image.color[i], 1.0f / GAMMA);
+				}
+			}
+			addCones(cones);
+			std::lock_guard<std::mutex> lock(conesMutex);
+			image.reflectionRays += rays;
+			image.reflectionHits += hits;
+		}, threadCount);
+	}
+
+	if (temporal && reduced) {
+		history->width = lowWidth;
+		history->height = lowHeight;
+		history->indirect.swap(lowIndirect);
+		history->guide.swap(lowGuide);
+		++history->frame;
+	}
+	if (history != nullptr) {
+		if (!(temporal && reduced)) history->indirect.clear(); // Stale, like Graphics::indirectHistoryValid.
+		history->viewProjection = camera.getViewProjectionMatrix();
+	}
+}
+
+bool VoxelConeTracer::needsCones(const ConeBudget::Category category, const MaterialSetting & material, const Settings & settings)
+{
+	const float opacity = 1.0f - material.transparency;
+	switch (category) {
+	case ConeBudget::DIFFUSE: return settings.indirectDiffuseLight && material.diffuseReflectivity * opacity > 0.01f;
+	case ConeBudget::SPECULAR: return settings.indirectSpecularLight && material.specularReflectivity * opacity > 0.01f;
+	case ConeBudget::REFRACTION: return material.transparency > 0.01f;
+	case ConeBudget::SHADOW: // Shadows only darken direct light the material reflects.
+		return settings.directLight && settings.shadows && opacity > 0.0f &&
+			(material.diffuseReflectivity * opacity > 0.01f || material.specularReflectivity > 0.01f);
+	default: return false;
+	}
+}
+
+bool VoxelConeTracer::needsScreenSpaceReflection(const MaterialSetting & material, const Settings & settings)
+{
+	return settings.screenSpaceReflections && needsCones(ConeBudget::SPECULAR, material, settings) &&
+		material.specularDiffusion <= settings.reflectionDiffusionCutoff && material.transparency <= 0.01f;
+}
+
+glm::vec3 VoxelConeTracer::shade(const GBufferTexel & texel, const glm::vec3 & cameraPosition,
+	const std::vector<PointLight> & pointLights, const Settings & settings, unsigned int & steps) const
+{
+	const ConeBudget budget;
+	ConeCounters cones = {};
+	Fragment fragment = { texel.position, glm::normalize(texel.normal), *texel.material, steps, budget, cones };
+	return shadeFragment(fragment, cameraPosition, pointLights, settings, 0.0f);
+}
+
+glm::vec3 VoxelConeTracer::shadeIndirectDiffuse(const GBufferTexel & texel, unsigned int & steps,
+	const int ringCones, const int firstRingCone, const float ringRotation) const
+{
+	const ConeBudget budget;
+	ConeCounters cones = {};
+	Fragment fragment = { texel.position, glm::normalize(texel.normal), *texel.material, steps, budget, cones };
+	return shadeIndirectDiffuse(fragment, ringCones, firstRingCone, ringRotation);
+}
+
+glm::vec3 VoxelConeTracer::shadeFragment(Fragment & fragment, const glm::vec3 & cameraPosition,
+	const std::vector<PointLight> & pointLights, const Settings & settings, const float jitter) const
+{
+	const MaterialSetting & material = fragment.material;
+	const glm::vec3 viewDirection = glm::normalize(fragment.position - cameraPosition);
+	glm::vec3 color(0.0f);
+
+	// Indirect diffuse light, from the probes or traced. Fewer ring cones than the whole ring are rotated by the pixel's jitter.
+	glm::vec3 probeLight;
+	if (needsCones(ConeBudget::DIFFUSE, material, settings)) {
+		if (settings.irradianceProbes && indirectDiffuseProbeLight(fragment, probeLight)) {
+			color += probeLight;
+		}
+		else {
+			const int RING_CONES = ConeSets::DIFFUSE_RING_CONES;
+			const int ringCones = fragment.budget.ringConesOf(RING_CONES);
+			const float u = ringCones < RING_CONES ? RING_CONES * jitter : 0.0f;
+			color += indirectDiffuseLight(fragment, ringCones, int(u), (u - std::floor(u)) * 2 * PI / RING_CONES);
+		}
+	}
+
+	// Indirect specular light (glossy reflections).
+	if (needsCones(ConeBudget::SPECULAR, material, settings))
+		color += indirectSpecularLight(fragment, viewDirection);
+
+	// Emissivity.
+	color += material.emissivity * material.diffuseColor;
+
+	// Transparency.
+	if (needsCones(ConeBudget::REFRACTION, material, settings))
+		color = glm::mix(color, indirectRefractiveLight(fragment, viewDirection), material.transparency);
+
+	// Direct light.
+	if (settings.directLight) {
+		glm::vec3 direct(0.0f);
+		const unsigned int lights = std::min<unsigned int>(unsigned(pointLights.size()), MAX_LIGHTS);
+		for (unsigned int i = 0; i < lights; ++i) direct += calculateDirectLight(fragment, pointLights[i], int(i), viewDirection, settings);
+		color += DIRECT_LIGHT_INTENSITY * direct;
+	}
+
+	return color;
+}
+
+glm::vec3 VoxelConeTracer::shadeIndirectDiffuse(Fragment & fragment, const int ringCones, const int firstRingCone, const float ringRotation) const
+{
+	const MaterialSetting & material = fragment.material;
+	if (material.diffuseReflectivity * (1.0f - material.transparency) <= 0.01f) return glm::vec3(0.0f);
+	glm::vec3 indirect = indirectDiffuseLight(fragment, ringCones, firstRingCone, ringRotation);
+	if (material.transparency > 0.01f) indirect *= 1.0f - material.transparency; // Refraction is mixed in afterwards.
+	return indirect;
+}
+
+// ----------------------
+// Cones.
+// ----------------------
+float VoxelConeTracer::traceShadowCone(const glm::vec3 & from, const glm::vec3 & direction, const float targetDistance, unsigned int & steps) const
+{
+	static const MaterialSetting material;
+	const ConeBudget budget;
+	ConeCounters cones = {};
+	Fragment fragment = { from, glm::vec3(0.0f), material, steps, budget, cones };
+	return traceShadowCone(fragment, from, direction, targetDistance);
+}
+
+glm::vec3 VoxelConeTracer::traceDiffuseCone(const glm::vec3 & from, const glm::vec3 & direction, unsigned int & steps) const
+{
+	static const MaterialSetting material;
+	const ConeBudget budget;
+	ConeCounters cones = {};
+	Fragment fragment = { from, glm::normalize(direction), material, steps, budget, cones };
+	return traceDiffuseVoxelCone(fragment, from, direction);
+}
+
+glm::vec3 VoxelConeTracer::traceDiffuseVoxelCone(Fragment & fragment, const glm::vec3 & from, glm::vec3 direction) const
+{
+	direction = glm::normalize(direction);
+	glm::vec4 acc(0.0f);
+	++fragment.cones[ConeBudget::DIFFUSE];
+
+	// The samples of the budget's level, from the table.
+	if (volume.getSize() == ConeSets::VOLUME_SIZE) {
+		assert(fragment.budget.level >= 0 && fragment.budget.level < ConeBudget::LEVEL_COUNT);
+		const ConeSets::DiffuseMarch & march = ConeSets::DIFFUSE_MARCHES[fragment.budget.level];
+		for (int i = 0; i < march.steps && acc.a < 1; ++i) {
+			const glm::vec4 voxel = volume.sampleLod(scaleAndBias(from + march.distance[i] * direction), march.lod[i]);
+			acc += march.weight[i] * voxel * std::pow(1 - voxel.a, 2.0f);
+			++fragment.steps;
+		}
+		return pow3(glm::vec3(acc) * 2.0f, 1.5f);
+	}
+
+	const float CONE_SPREAD = ConeSets::DIFFUSE_CONES.aperture * fragment.budget.diffuseApertureScale;
+	const float MAX_DISTANCE = fragment.budget.diffuseMaxDistance;
+
+	// The start distance controls bleeding from close surfaces.
+	float dist = 0.1953125f;
+	while (dist < MAX_DISTANCE && acc.a < 1) {
+		const glm::vec3 c = scaleAndBias(from + dist * direction);
+		const float l = 1 + CONE_SPREAD * dist / voxelSize;
+		const float level = std::log2(l);
+		const float ll = (level + 1) * (level + 1);
+		const glm::vec4 voxel = volume.sampleLod(c, std::min(MIPMAP_HARDCAP, level));
+		acc += 0.075f * ll * voxel * std::pow(1 - voxel.a, 2.0f);
+		dist += ll * voxelSize * 2;
+		++fragment.steps;
+	}
+	return pow3(glm::vec3(acc) * 2.0f, 1.5f);
+}
+
+glm::vec3 VoxelConeTracer::traceSpecularVoxelCone(Fragment & fragment, glm::vec3 from, glm::vec3 direction) const
+{
+	direction = glm::normalize(direction);
+	const float OFFSET = 8 * voxelSize;
+	const float STEP = voxelSize;
+	const float MAX_DISTANCE = fragment.budget.specularDistanceScale *
+		glm::distance(glm::vec3(std::abs(fragment.position.x), std::abs(fragment.position.y), std::abs(fragment.position.z)), glm::vec3(-1));
+	const float specularDiffusion = fragment.material.specularDiffusion;
+
+	from += OFFSET * fragment.normal;
+	glm::vec4 acc(0.0f);
+	float dist = OFFSET;
+	while (dist < MAX_DISTANCE && acc.a < 1) {
+		const glm::vec3 p = from + dist * direction;
+		if (!isInsideCube(p, 0)) break;
+		const float level = 0.1f * specularDiffusion * std::log2(1 + dist / voxelSize);
+		const glm::vec4 voxel = volume.sampleLod(scaleAndBias(p), std::min(level, MIPMAP_HARDCAP));
+		const float f = 1 - acc.a;
+		acc += glm::vec4(0.25f * (1 + specularDiffusion) * glm::vec3(voxel) * voxel.a * f, 0.25f * voxel.a * f);
+		dist += STEP * (1.0f + 0.125f * level);
+		++fragment.steps;
+	}
+	return std::pow(specularDiffusion + 1, 0.8f) * glm::vec3(acc);
+}
+
+float VoxelConeTracer::traceShadowCone(Fragment & fragment, glm::vec3 from, const glm::vec3 & direction, const float targetDistance) const
+{
+	from += fragment.normal * SHADOW_OFFSET;
+	++fragment.cones[ConeBudget::SHADOW];
+
+	float acc = 0;
+	const float STOP = targetDistance - 16 * voxelSize; // Stop before reaching the light's own voxels.
+	auto sample = [&](const float dist, const float nearLod, const float farLod) {
+		const glm::vec3 p = from + dist * direction;
+		if (!isInsideCube(p, 0)) return false;
+		const glm::vec3 c = scaleAndBias(p);
+		const float s1 = 0.062f * volume.sampleLod(c, nearLod).a;
+		const float s2 = 0.135f * volume.sampleLod(c, farLod).a;
+		const float s = s1 + s2;
+		acc += (1 - acc) * s;
+		fragment.steps += 2;
+		return true;
+	};
+	if (volume.getSize() == ConeSets::VOLUME_SIZE) {
+		const ConeSets::ShadowMarch & march = ConeSets::SHADOW_MARCH;
+		for (int i = 0; i < march.steps && march.distance[i] < STOP && acc < 1; ++i)
+			if (!sample(march.distance[i], march.nearLod[i], march.farLod[i])) break;
+	}
+	else {
+		float dist = 3 * voxelSize;
+		while (dist < STOP && acc < 1) {
+			const float l = dist * dist;
+			if (!sample(dist, 1 + 0.75f * l, 4.5f * l)) break;
+			dist += 0.9f * voxelSize * (1 + 0.05f * l);
+		}
+	}
+	return 1 - std::pow(smoothstep(0, 1, acc * 1.4f), 1.0f / 1.4f);
+}
+
+glm::vec3 VoxelConeTracer::indirectDiffuseLight(Fragment & fragment, const int ringCones, const int firstRingCone, const float ringRotation) const
+{
+	const ConeSets::Cone * CONES = ConeSets::DIFFUSE_CONES.cones;
+	const int RING_CONES = ConeSets::DIFFUSE_RING_CONES;
+	const glm::vec3 & normal = fragment.normal;
+
+	// Find a base for the ring cones with the normal as one of its base vectors.
+	const glm::vec3 ortho = glm::normalize(orthogonal(normal));
+	const glm::vec3 ortho2 = glm::normalize(glm::cross(ortho, normal));
+
+	// Find start position of trace (start with a bit of offset).
+	const glm::vec3 N_OFFSET = normal * (1 + 4 * ISQRT2) * voxelSize;
+	const glm::vec3 C_ORIGIN = fragment.position + N_OFFSET;
+
+	// We offset forward in normal direction, and backward in cone direction.
+	// Backward in cone direction improves GI, and forward direction removes artifacts.
+	const float CONE_OFFSET = -0.01f;
+
+	// The cone set, rotated around the normal.
+	const float cosine = ringRotation == 0.0f ? 1.0f : std::cos(ringRotation), sine = ringRotation == 0.0f ? 0.0f : std::sin(ringRotation);
+	auto trace = [&](const ConeSets::Cone & cone, const float weight) {
+		const glm::vec3 direction = toWorld(cone.direction, cosine, sine, ortho, ortho2, normal);
+		const glm::vec3 offset = toWorld(cone.offset, cosine, sine, ortho, ortho2, normal);
+		return weight * traceDiffuseVoxelCone(fragment, C_ORIGIN + CONE_OFFSET * offset, direction);
+	};
+
+	// Trace front cone.
+	glm::vec3 acc = trace(CONES[0], ConeSets::DIFFUSE_CONE_SCALE * CONES[0].weight);
+
+	// Trace the ring cones (for the 9 cone set, the even ones are the 4 side cones and the odd ones the 4 corner cones of the shader).
+	for (int i = 0; i < ringCones; ++i) {
+		const int k = (firstRingCone + i * RING_CONES / ringCones) % RING_CONES; // Spread evenly around the ring.
+		const ConeSets::Cone & cone = CONES[1 + k];
+		acc += trace(cone, ConeSets::DIFFUSE_CONE_SCALE * cone.weight * RING_CONES / ringCones);
+	}
+
+	// Return result.
+	const MaterialSetting & material = fragment.material;
+	return DIFFUSE_INDIRECT_FACTOR * material.diffuseReflectivity * acc * (material.diffuseColor + glm::vec3(0.001f));
+}
+
+bool VoxelConeTracer::indirectDiffuseProbeLight(Fragment & fragment, glm::vec3 & light) const
+{
+	glm::vec3 coefficients[IrradianceProbeGrid::COEFFICIENT_COUNT];
+	if (irradianceProbes == nullptr || !irradianceProbes->sample(fragment.position, fragment.normal, coefficients)) return false;
+
+	// L1 is linear in the direction, so the cones of indirectDiffuseLight add up in closed form.
+	const float SH_Y0 = 0.282095f, SH_Y1 = 0.488603f;
+	const glm::vec3 & n = fragment.normal;
+	const glm::vec3 acc = glm::max(glm::vec3(0.0f), ConeSets::DIFFUSE_CONE_WEIGHT_SUM * SH_Y0 * coefficients[0] +
+		ConeSets::DIFFUSE_CONE_NORMAL_SUM * SH_Y1 * (n.x * coefficients[1] + n.y * coefficients[2] + n.z * coefficients[3]));
+
+	const MaterialSetting & material = fragment.material;
+	light = DIFFUSE_INDIRECT_FACTOR * material.diffuseReflectivity * acc * (material.diffuseColor + glm::vec3(0.001f));
+	return true;
+}
+
+glm::vec3 VoxelConeTracer::indirectSpecularLight(Fragment & fragment, const glm::vec3 & viewDirection) const
+{
+	const glm::vec3 reflection = glm::normalize(glm::reflect(viewDirection, fragment.normal));
+	const MaterialSetting & material = fragment.material;
+	++fragment.cones[ConeBudget::SPECULAR];
+	return material.specularReflectivity * material.specularColor * traceSpecularVoxelCone(fragment, fragment.position, reflection);
+}
+
+glm::vec3 VoxelConeTracer::screenSpaceReflection(Fragment & fragment, const glm::vec3 & viewDirection, const Screen & screen, bool & hit) const
+{
+	const glm::vec3 reflection = glm::normalize(glm::reflect(viewDirection, fragment.normal));
+	const MaterialSetting & material = fragment.material;
+	hit = false;
+
+	// The reflected ray in clip space, clipped to the near depth.
+	const glm::vec3 from = fragment.position + voxelSize * fragment.normal;
+	const glm::vec4 start = screen.viewProjection * glm::vec4(from, 1);
+	glm::vec4 end = screen.viewProjection * glm::vec4(from + REFLECTION_MAX_DISTANCE * reflection, 1);
+	if (start.w > REFLECTION_NEAR) {
+		if (end.w < REFLECTION_NEAR) end = glm::mix(start, end, (start.w - REFLECTION_NEAR) / (start.w - end.w));
+
+		// Pixels, top row first like the G-buffer.
+		const float width = float(screen.hiZ.getWidth()), height = float(screen.hiZ.getHeight());
+		auto toPixel = [&](const glm::vec4 & clip) { return glm::vec2((0.5f * clip.x / clip.w + 0.5f) * width, (0.5f - 0.5f * clip.y / clip.w) * height); };
+		glm::ivec2 pixel;
+		unsigned int steps = 0;
+		if (screen.hiZ.trace(toPixel(start), toPixel(end), 1.0f / start.w, 1.0f / end.w, REFLECTION_THICKNESS, pixel, steps)) {
+			// Only surfaces facing the ray reflect what they show on screen.
+			const size_t index = size_t(pixel.y) * screen.hiZ.getWidth() + pixel.x;
+			const GBufferTexel & texel = screen.gBuffer[index];
+			hit = texel.material != nullptr && glm::dot(texel.normal, reflection) < 0.0f;
+			if (hit) {
+				// As bright as a specular cone gets on an opaque surface, so hits and misses match (see traceSpecularVoxelCone).
+				const float gain = std::pow(material.specularDiffusion + 1, 1.8f);
+				return material.specularReflectivity * material.specularColor * gain * screen.color[index];
+			}
+		}
+	}
+	return indirectSpecularLight(fragment, viewDirection);
+}
+
+glm::vec3 VoxelConeTracer::indirectRefractiveLight(Fragment & fragment, const glm::vec3 & viewDirection) const
+{
+	const MaterialSetting & material = fragment.material;
+	const glm::vec3 refraction = glm::refract(viewDirection, fragment.normal, 1.0f / material.refractiveIndex);
+	const glm::vec3 cmix = glm::mix(material.specularColor, 0.5f * (material.specularColor + glm::vec3(1)), material.transparency);
+	++fragment.cones[ConeBudget::REFRACTION];
+	return cmix * traceSpecularVoxelCone(fragment, fragment.position, refraction);
+}
+
+glm::vec3 VoxelConeTracer::calculateDirectLight(Fragment & fragment, const PointLight & light, const int lightIndex, const glm::vec3 & viewDirection, const Settings & settings) const
+{
+	const MaterialSetting & material = fragment.material;
+	const glm::vec3 & normal = fragment.normal;
+
+	glm::vec3 lightDirection = light.position - fragment.position;
+	const float distanceToLight = glm::length(lightDirection);
+	lightDirection = lightDirection / distanceToLight;
+	const float lightAngle = glm::dot(normal, lightDirection);
+
+	// Diffuse lighting.
+	float diffuseAngle = std::max(lightAngle, 0.0f); // Lambertian.
+
+	// Specular lighting.
+	const glm::vec3 reflection = glm::normalize(glm::reflect(viewDirection, normal));
+	float specularAngle = std::max(0.0f, glm::dot(reflection, lightDirection));
+
+	// Refraction.
+	float refractiveAngle = 0;
+	if (material.transparency > 0.01f) {
+		const glm::vec3 refraction = glm::refract(viewDirection, normal, 1.0f / material.refractiveIndex);
+		refractiveAngle = std::max(0.0f, material.transparency * glm::dot(refraction, lightDirection));
+	}
+
+	// Shadows, fetched where the shadow cone would start if cached.
+	float shadowBlend = 1;
+	if (diffuseAngle * (1.0f - material.transparency) > 0 && needsCones(ConeBudget::SHADOW, material, settings)) {
+		if (settings.cachedShadows && lightVisibility != nullptr && lightIndex < lightVisibility->getLightCount())
+			shadowBlend = lightVisibility->sample(lightIndex, fragment.position + SHADOW_OFFSET * normal);
+		else
+			shadowBlend = traceShadowCone(fragment, fragment.position, lightDirection, distanceToLight);
+	}
+
+	// Add it all together.
+	diffuseAngle = std::min(shadowBlend, diffuseAngle);
+	specularAngle = std::min(shadowBlend, std::max(specularAngle, refractiveAngle));
+	const float df = 1.0f / (1.0f + 0.25f * material.specularDiffusion); // Diffusion factor.
+	const float specular = SPECULAR_FACTOR * std::pow(specularAngle, df * SPECULAR_POWER);
+	const float diffuse = diffuseAngle * (1.0f - material.transparency);
+
+	const glm::vec3 diff = material.diffuseReflectivity * material.diffuseColor * diffuse;
+	const glm::vec3 spec = material.specularReflectivity * material.specularColor * specular;
+	const glm::vec3 total = light.color * (diff + spec);
+	return attenuate(distanceToLight) * total;
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <vector>
+
+#include <glm.hpp>
+
+#include "ConeBudget.h"
+#include "ConeSets.h"
+
+class VoxelMipChain;
+class Camera;
+class PointLight;
+struct MaterialSetting;
+class IrradianceProbeGrid;
+class VoxelLightVisibility;
+class HiZBuffer;
+
+/// <summary> A multithreaded CPU reference of the 'voxel_cone_tracing' material. Shades a G-buffer with the same cones,
+/// constants and settings as 'voxel_cone_tracing.frag', sampling a VoxelMipChain (the Texture3D layout) with
+/// VoxelMipChain::sampleLod. Lets us regression test and profile cone tracing without a GPU.
+/// Keep the constants in 'VoxelConeTracer.cpp' in sync with the shader. The cones and their marches come from the
+/// tables of 'ConeSets.h' (the shaders' 'ConeTables' block) for 64^3 volumes, other sizes march like the original shader. </summary>
+class VoxelConeTracer {
+public:
+	static const int TILE_SIZE = 16;
+
+	/// <summary> The rendering settings of Graphics (see Graphics::uploadRenderingSettings). </summary>
+	struct Settings {
+		bool shadows = true;
+		bool indirectDiffuseLight = true;
+		bool indirectSpecularLight = true;
+		bool directLight = true;
+		int indirectDiffuseResolution = 1; // Like Graphics: 2 or 4 traces indirect diffuse light at 1/2 or 1/4 resolution.
+		bool temporalIndirectDiffuse = false; // Accumulates indirect diffuse light in the History passed to render.
+		int ringCones = ConeSets::DIFFUSE_RING_CONES; // Diffuse cones around the normal cone. Fewer (or temporal) are rotated per pixel with blue noise.
+		int denoiseIterations = 0; // A-trous iterations over the indirect diffuse light (see AtrousFilter).
+		unsigned long long coneBudget = 0; // Cones per frame for the ConeBudgetScheduler (0 keeps every tile at full quality).
+		bool irradianceProbes = false; // Interpolates indirect diffuse light from the probes set with setIrradianceProbes.
+		bool cachedShadows = false; // Fetches shadows from the VoxelLightVisibility set with setLightVisibility instead of tracing cones.
+		bool screenSpaceReflections = false; // Marches sharp reflections through a HiZBuffer first, specular cones only trace the misses.
+		float reflectionDiffusionCutoff = 2.0f; // Highest specular diffusion reflected in screen space.
+	};
+
+	/// <summary> One pixel of the G-buffer: world space position and normal. Pixels without a material are background. </summary>
+	struct GBufferTexel {
+		glm::vec3 position, normal;
+		const MaterialSetting * material = nullptr;
+	};
+
+	/// <summary> The traced image (gamma corrected, like the shader's output) and the number of
+	/// volume samples each pixel took, summed over all of its cones. </summary>
+	struct Image {
+		int width = 0, height = 0;
+		std::vector<glm::vec3> color;
+		std::vector<unsigned int> steps;
+		ConeCounters cones = {}; // Cones traced per ConeBudget::Category.
+		std::vector<int> tileLevels; // The ConeBudget level of every tile.
+		unsigned long long reflectionRays = 0, reflectionHits = 0; // Screen space reflections, the misses traced a specular cone.
+	};
+
+	/// <summary> The indirect diffuse light of the previous frames for temporal accumulation, like the history targets of Graphics.
+	/// Starts empty, and render updates it every frame. </summary>
+	struct History {
+		int width = 0, height = 0; // Size of the indirect diffuse target.
+		std::vector<glm::vec4> indirect; // Accumulated linear light and the number of accumulated frames (the reuse statistic).
+		std::vector<GBufferTexel> guide;
+		glm::mat4 viewProjection; // Of the camera of the previous frame.
+		unsigned int frame = 0;
+	};
+
+	/// <summary> Creates a tracer for a volume with mipmaps. The volume must outlive the tracer. </summary>
+	VoxelConeTracer(const VoxelMipChain & volume);
+
+	/// <summary> Shades a width x height G-buffer (row by row, top row first) in 16x16 tiles, scheduled dynamically over the threads.
+	/// With a reduced indirect diffuse resolution, indirect diffuse light is traced for one G-buffer texel per block
+	/// and upsampled with the joint bilateral filter of 'indirect_upsample.frag'. In temporal mode, it is accumulated
+	/// with the reprojected history like 'indirect_diffuse.frag' does, and then denoised like 'indirect_denoise.frag'.
+	/// A thread count of 0 uses all hardware threads. </summary>
+	void render(
+		const std::vector<GBufferTexel> & gBuffer, const int width, const int height,
+		const Camera & camera, const std::vector<PointLight> & pointLights,
+		const Settings & settings, Image & image, const unsigned int threadCount = 0, History * history = nullptr
+	) const;
+
+	/// <summary> Sets the probe grid used in irradiance probe mode (nullptr traces diffuse cones per pixel). The grid must outlive its use. </summary>
+	void setIrradianceProbes(const IrradianceProbeGrid * probes) { irradianceProbes = probes; }
+
+	/// <summary> Sets the light visibility cache used for cached shadows (nullptr traces shadow cones). The cache must outlive its use. </summary>
+	void setLightVisibility(const VoxelLightVisibility * visibility) { lightVisibility = visibility; }
+
+	/// <summary> Traces one shadow cone from a point (without the surface offset) toward a light targetDistance away and
+	/// returns its visibility, like the cells of 'light_visibility.comp'. Adds the number of volume samples taken to steps. </summary>
+	float traceShadowCone(const glm::vec3 & from, const glm::vec3 & direction, const float targetDistance, unsigned int & steps) const;
+
+	/// <summary> Traces one diffuse cone from a point (without the surface offsets) and returns its radiance,
+	/// like the probe cones of 'irradiance_probes.comp'. Adds the number of volume samples taken to steps. </summary>
+	glm::vec3 traceDiffuseCone(const glm::vec3 & from, const glm::vec3 & direction, unsigned int & steps) const;
+
+	/// <summary> Returns true if a material needs a kind of cone. Cones whose light would be scaled to (almost) nothing are skipped. </summary>
+	static bool needsCones(const ConeBudget::Category category, const MaterialSetting & material, const Settings & settings);
+
+	/// <summary> Returns true if a material's reflections are marched in screen space first: it needs a specular cone, its specular
+	/// diffusion is at most the cutoff, and it is opaque (its reflection is added after refraction was mixed in). </summary>
+	static bool needsScreenSpaceReflection(const MaterialSetting & material, const Settings & settings);
+
+	/// <summary> Shades one G-buffer texel with the full cone set and returns the linear color (before gamma correction).
+	/// Adds the number of volume samples taken to steps. </summary>
+	glm::vec3 shade(const GBufferTexel & texel, const glm::vec3 & cameraPosition,
+		const std::vector<PointLight> & pointLights, const Settings & settings, unsigned int & steps) const;
+
+	/// <summary> Returns the indirect diffuse light of one G-buffer texel, as it adds up in the linear color.
+	/// Traces the normal cone and ringCones of the ring cones of ConeSets::DIFFUSE_CONES (spread evenly from cone firstRingCone
+	/// and rotated by ringRotation radians around the normal), weighted to the same total as the whole ring. </summary>
+	glm::vec3 shadeIndirectDiffuse(const GBufferTexel & texel, unsigned int & steps,
+		const int ringCones = ConeSets::DIFFUSE_RING_CONES, const int firstRingCone = 0, const float ringRotation = 0.0f) const;
+private:
+	const VoxelMipChain & volume;
+	float voxelSize;
+	std::vector<float> blueNoise; // BlueNoise::generate(), like the table Graphics uploads.
+	const IrradianceProbeGrid * irradianceProbes = nullptr;
+	const VoxelLightVisibility * lightVisibility = nullptr;
+
+	// ----------------
+	// Cones.
+	// ----------------
+	/// <summary> Per-pixel state shared by the cones, like the shader's inputs, and the tile's budget. </summary>
+	struct Fragment {
+		glm::vec3 position, normal;
+		const MaterialSetting & material;
+		unsigned int & steps;
+		const ConeBudget & budget;
+		ConeCounters & cones;
+	};
+	glm::vec3 shadeFragment(Fragment & fragment, const glm::vec3 & cameraPosition, const std::vector<PointLight> & pointLights,
+		const Settings & settings, const float jitter) const;
+	glm::vec3 shadeIndirectDiffuse(Fragment & fragment, const int ringCones, const int firstRingCone, const float ringRotation) const;
+	glm::vec3 traceDiffuseVoxelCone(Fragment & fragment, const glm::vec3 & from, glm::vec3 direction) const;
+	glm::vec3 traceSpecularVoxelCone(Fragment & fragment, glm::vec3 from, glm::vec3 direction) const;
+	float traceShadowCone(Fragment & fragment, glm::vec3 from, const glm::vec3 & direction, const float targetDistance) const;
+	glm::vec3 indirectDiffuseLight(Fragment & fragment, const int ringCones = ConeSets::DIFFUSE_RING_CONES, const int firstRingCone = 0, const float ringRotation = 0.0f) const;
+	bool indirectDiffuseProbeLight(Fragment & fragment, glm::vec3 & light) const;
+	glm::vec3 indirectSpecularLight(Fragment & fragment, const glm::vec3 & viewDirection) const;
+
+	/// <summary> What screen space reflections march against: the lit scene without the reflections of their own pixels. </summary>
+	struct Screen {
+		const HiZBuffer & hiZ;
+		const glm::mat4 & viewProjection;
+		const std::vector<GBufferTexel> & gBuffer;
+		const std::vector<glm::vec3> & color; // Linear.
+	};
+	glm::vec3 screenSpaceReflection(Fragment & fragment, const glm::vec3 & viewDirection, const Screen & screen, bool & hit) const;
+	glm::vec3 indirectRefractiveLight(Fragment & fragment, const glm::vec3 & viewDirection) const;
+	glm::vec3 calculateDirectLight(Fragment & fragment, const PointLight & light, const int lightIndex, const glm::vec3 & viewDirection, const Settings & settings) const;
+};
@@ -0,0 +1,102 @@
+#include "VoxelDistanceField.h"
+
+// Stdlib.
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+
+// Internal.
+#include "VoxelMipChain.h"
+#include "../Texture3D.h"
+#include "../../Utility/Parallel.h"
+
+namespace {
+	const float INF = 1e20f;
+	const float VOXEL_DIAGONAL = 1.7320508f; // Half a diagonal for the voxel we're in and half for the occupied one.
+
+	/// <summary> Scratch memory for one line of the distance transform. </summary>
+	struct LineBuffers {
+		std::vector<float> f, d, z;
+		std::vector<int> v;
+		LineBuffers(int n) : f(n), d(n), z(n + 1), v(n) {}
+	};
+
+	/// <summary> Returns where the parabolas rooted at q and p intersect. </summary>
+	inline float intersection(const LineBuffers & b, const int q, const int p) {
+		return ((b.f[q] + float(q) * q) - (b.f[p] + float(p) * p)) / (2.0f * (q - p));
+	}
+
+	/// <summary> 1D squared Euclidean distance transform of a sampled function (lower envelope of parabolas). </summary>
+	void distanceTransform1D(LineBuffers & b, const int n) {
+		int k = 0;
+		b.v[0] = 0;
+		b.z[0] = -INF;
+		b.z[1] = INF;
+		for (int q = 1; q < n; ++q) {
+			float s = intersection(b, q, b.v[k]);
+			while (k > 0 && s <= b.z[k]) s = intersection(b, q, b.v[--k]);
+			++k;
+			b.v[k] = q;
+			b.z[k] = s;
+			b.z[k + 1] = INF;
+		}
+		k = 0;
+		for (int q = 0; q < n; ++q) {
+			while (b.z[k + 1] < q) ++k;
+			const float dq = float(q - b.v[k]);
+			b.d[q] = dq * dq + b.f[b.v[k]];
+		}
+	}
+
+	/// <summary> Runs the 1D transform along every line of one axis of a size^3 grid. </summary>
+	void transformAxis(std::vector<float> & grid, const int size, const size_t stride, const size_t lineStrideA, const size_t lineStrideB, const unsigned int threadCount) {
+		Parallel::forRange(0, size * size, [&](int first, int last) {
+			LineBuffers buffers(size);
+			for (int line = first; line < last; ++line) {
+				float * start = grid.data() + size_t(line % size) * lineStrideA + size_t(line / size) * lineStrideB;
+				for (int i = 0; i < size; ++i) buffers.f[i] = start[i * stride];
+				distanceTransform1D(buffers, size);
+				for (int i = 0; i < size; ++i) start[i * stride] = buffers.d[i];
+			}
+		}, threadCount);
+	}
+}
+
+VoxelDistanceField::VoxelDistanceField(const int _size) : size(_size), distances(size_t(_size) * _size * _size, (unsigned char)MAX_DISTANCE) {}
+
+void VoxelDistanceField::build(const VoxelMipChain & volume, const float alphaThreshold, const unsigned int threadCount)
+{
+	assert(volume.getSize() == size);
+	std::vector<unsigned char> occupancy;
+	volume.getOccupancy(occupancy, alphaThreshold);
+	build(occupancy, threadCount);
+}
+
+void VoxelDistanceField::build(const std::vector<unsigned char> & occupancy, const unsigned int threadCount)
+{
+	const size_t count = size_t(size) * size * size;
+	assert(occupancy.size() == count);
+
+	// Squared distances, separable along x, y and z.
+	std::vector<float> grid(count);
+	for (size_t i = 0; i < count; ++i) grid[i] = occupancy[i] ? 0.0f : INF;
+	const size_t row = size, slice = size_t(size) * size;
+	transformAxis(grid, size, 1, row, slice, threadCount);		// Along x, lines indexed by (y, z).
+	transformAxis(grid, size, row, 1, slice, threadCount);		// Along y, lines indexed by (x, z).
+	transformAxis(grid, size, slice, 1, row, threadCount);		// Along z, lines indexed by (x, y).
+
+	// Quantize to conservative free radii.
+	Parallel::forRange(0, size, [&](int zBegin, int zEnd) {
+		for (size_t i = size_t(zBegin) * slice; i < size_t(zEnd) * slice; ++i) {
+			if (grid[i] >= 0.5f * INF) { distances[i] = MAX_DISTANCE; continue; }
+			const float radius = std::floor(std::sqrt(grid[i]) - VOXEL_DIAGONAL);
+			distances[i] = (unsigned char)std::min(float(MAX_DISTANCE), std::max(0.0f, radius));
+		}
+	}, threadCount);
+}
+
+void VoxelDistanceField::upload(Texture3D & texture) const
+{
+	assert(texture.GetFormat() == Texture3D::Format::R8);
+	texture.UploadLevel(0, distances.data(), GL_UNSIGNED_BYTE);
+}
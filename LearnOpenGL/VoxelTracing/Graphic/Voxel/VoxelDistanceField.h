@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+
+class VoxelMipChain;
+class Texture3D;
+
+/// <summary> A low precision distance field for empty space skipping, computed from the occupancy of level 0 of a voxel volume.
+/// Each voxel stores a conservative free radius in voxels: the Euclidean distance to the nearest occupied voxel minus
+/// the voxel diagonal, rounded down and clamped to [0, 255]. Any point inside a voxel can move that far in any direction
+/// without entering an occupied voxel. Matches the R8 texture written by 'voxel_distance_field.comp'. </summary>
+class VoxelDistanceField {
+public:
+	/// <summary> Largest distance that can be stored (R8). </summary>
+	static const int MAX_DISTANCE = 255;
+
+	/// <summary> Creates an empty field (no occupied voxels) of a cubic size. </summary>
+	VoxelDistanceField(const int size);
+
+	/// <summary> Builds the field from level 0 of a volume using an exact separable Euclidean distance transform
+	/// (Felzenszwalb and Huttenlocher). A voxel is occupied if its alpha is above the threshold. </summary>
+	void build(const VoxelMipChain & volume, const float alphaThreshold = 0.0f, const unsigned int threadCount = 0);
+
+	/// <summary> Builds the field from an occupancy grid (non-zero means occupied) of size^3 voxels. </summary>
+	void build(const std::vector<unsigned char> & occupancy, const unsigned int threadCount = 0);
+
+	/// <summary> Uploads the field to level 0 of an R8 texture of the same size. </summary>
+	void upload(Texture3D & texture) const;
+
+	/// <summary> Returns the free radius of a voxel in voxels. Coordinates outside the volume return 0. </summary>
+	int getDistance(const int x, const int y, const int z) const {
+		if (x < 0 || y < 0 || z < 0 || x >= size || y >= size || z >= size) return 0;
+		return distances[(size_t(z) * size + y) * size + x];
+	}
+
+	int getSize() const { return size; }
+	const std::vector<unsigned char> & getData() const { return distances; }
+private:
+	int size;
+	std::vector<unsigned char> distances;
+};
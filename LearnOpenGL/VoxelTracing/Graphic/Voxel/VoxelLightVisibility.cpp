@@ -0,0 +1,95 @@
+#include "VoxelLightVisibility.h"
+
+// Stdlib.
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+
+// Internal.
+#include "VoxelMipChain.h"
+#include "VoxelConeTracer.h"
+#include "../Lighting/PointLight.h"
+#include "../../Utility/Parallel.h"
+
+VoxelLightVisibility::VoxelLightVisibility(const int _resolution) : resolution(_resolution)
+{
+	assert(resolution > 0);
+}
+
+// ----------------------
+// Updates.
+// ----------------------
+void VoxelLightVisibility::invalidate(const VoxelMipChain & volume, const float alphaThreshold)
+{
+	// The mip level whose texels are the size of a cell (or level 0 for cells smaller than a voxel).
+	const int size = volume.getSize();
+	int level = 0;
+	while (level + 1 < volume.getLevelCount() && (size >> (level + 1)) >= resolution) ++level;
+	const int levelSize = volume.getSize(level);
+	const float scale = float(levelSize) / resolution; // Texels per cell.
+
+	// A texel of a box filtered mip is non-empty if any voxel below it is. Dilate by two cells.
+	nearCells.clear();
+	const int reach = int(std::ceil(2 * scale));
+	for (int z = 0; z < resolution; ++z) for (int y = 0; y < resolution; ++y) for (int x = 0; x < resolution; ++x) {
+		const glm::ivec3 center = glm::ivec3(glm::vec3(x, y, z) * scale + 0.5f * scale);
+		bool near = false;
+		for (int dz = -reach; dz <= reach && !near; ++dz)
+			for (int dy = -reach; dy <= reach && !near; ++dy)
+				for (int dx = -reach; dx <= reach && !near; ++dx)
+					near = volume.fetch(level, center.x + dx, center.y + dy, center.z + dz).a > alphaThreshold;
+		if (near) nearCells.push_back((z * resolution + y) * resolution + x);
+	}
+
+	for (Light & light : lights) light.outdated = true;
+}
+
+int VoxelLightVisibility::update(const VoxelConeTracer & tracer, const std::vector<PointLight> & pointLights, const unsigned int threadCount)
+{
+	lights.resize(pointLights.size());
+	int marched = 0;
+	for (size_t i = 0; i < pointLights.size(); ++i) {
+		Light & light = lights[i];
+		const glm::vec3 & position = pointLights[i].position;
+		if (!light.outdated && !light.visibility.empty() && light.position == position) continue;
+
+		// Cells far from surfaces are never sampled and stay lit.
+		light.visibility.assign(size_t(resolution) * resolution * resolution, 255);
+		Parallel::forEachTask(int(nearCells.size()), [&](int task) {
+			const int index = nearCells[task];
+			const glm::vec3 from = getPosition(index % resolution, (index / resolution) % resolution, index / (resolution * resolution));
+			const glm::vec3 toLight = position - from;
+			const float distance = glm::length(toLight);
+			unsigned int steps = 0;
+			const float visibility = distance > 1e-6f ? tracer.traceShadowCone(from, toLight / distance, distance, steps) : 1.0f;
+			light.visibility[index] = (unsigned char)(std::min(std::max(visibility, 0.0f), 1.0f) * 255.0f + 0.5f);
+		}, threadCount);
+
+		light.position = position;
+		light.outdated = false;
+		++marched;
+	}
+	return marched;
+}
+
+// ----------------------
+// Sampling.
+// ----------------------
+float VoxelLightVisibility::sample(const int light, const glm::vec3 & position) const
+{
+	assert(light >= 0 && light < int(lights.size()));
+	const std::vector<unsigned char> & visibility = lights[light].visibility;
+	const glm::vec3 grid = (position + 1.0f) * (0.5f * resolution) - 0.5f;
+	const glm::ivec3 base(int(std::floor(grid.x)), int(std::floor(grid.y)), int(std::floor(grid.z)));
+	const glm::vec3 f = grid - glm::vec3(base);
+
+	// Clamped to the edge cells.
+	float result = 0.0f;
+	for (int corner = 0; corner < 8; ++corner) {
+		const glm::ivec3 offset(corner & 1, (corner >> 1) & 1, corner >> 2);
+		const glm::ivec3 p = glm::clamp(base + offset, glm::ivec3(0), glm::ivec3(resolution - 1));
+		const float weight = (offset.x ? f.x : 1 - f.x) * (offset.y ? f.y : 1 - f.y) * (offset.z ? f.z : 1 - f.z);
+		result += weight * visibility[(size_t(p.z) * resolution + p.y) * resolution + p.x];
+	}
+	return result * (1.0f / 255.0f);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+
+#include <glm.hpp>
+
+class VoxelMipChain;
+class VoxelConeTracer;
+class PointLight;
+
+/// <summary> Cached shadow cone visibility of every point light, on a grid of cells over the voxel volume ([-1, 1]^3).
+/// Every cell stores the visibility of a shadow cone marched from its center toward the light, quantized to 8 bits.
+/// Shading then fetches the visibility (trilinearly, where the shadow cone would start) instead of marching.
+/// Only cells within two cells of an occupied voxel are marched, the others are fully lit (no surface samples them).
+/// A light is marched again when it moves or after invalidate(), when the voxels changed.
+/// Matches the RGBA8 textures written by 'light_visibility.comp' (LIGHTS_PER_TEXTURE lights each, one per channel). </summary>
+class VoxelLightVisibility {
+public:
+	static const int LIGHTS_PER_TEXTURE = 4;
+
+	/// <summary> Creates an empty cache with a number of cells per axis. </summary>
+	VoxelLightVisibility(const int resolution = 32);
+
+	/// <summary> Finds the cells near occupied voxels of a volume (alpha above the threshold) and marks every light outdated. </summary>
+	void invalidate(const VoxelMipChain & volume, const float alphaThreshold = 0.0f);
+
+	/// <summary> Marches the lights that moved or are outdated, and drops lights that no longer exist.
+	/// The tracer must sample the volume passed to invalidate. Returns the number of lights marched. </summary>
+	int update(const VoxelConeTracer & tracer, const std::vector<PointLight> & pointLights, const unsigned int threadCount = 0);
+
+	/// <summary> Returns the visibility of a light at a world position, trilinearly interpolated between cell centers. </summary>
+	float sample(const int light, const glm::vec3 & position) const;
+
+	// ----------------
+	// Accessors.
+	// ----------------
+	int getResolution() const { return resolution; }
+	int getLightCount() const { return int(lights.size()); }
+	int getMarchedCellCount() const { return int(nearCells.size()); }
+	const std::vector<unsigned char> & getData(const int light) const { return lights[light].visibility; }
+	glm::vec3 getPosition(const int x, const int y, const int z) const { return (glm::vec3(x, y, z) + 0.5f) * (2.0f / resolution) - 1.0f; }
+private:
+	struct Light {
+		glm::vec3 position;
+		bool outdated = true;
+		std::vector<unsigned char> visibility; // resolution^3, x varies fastest.
+	};
+	int resolution;
+	std::vector<int> nearCells; // Indices of the cells that are marched.
+	std::vector<Light> lights;
+};
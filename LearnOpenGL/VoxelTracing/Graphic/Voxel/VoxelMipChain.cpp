@@ -0,0 +1,251 @@
+#include "VoxelMipChain.h"
+
+// Stdlib.
+#include <cassert>
+#include <cstdint>
+#include <algorithm>
+
+// External.
+#include <emmintrin.h>
+
+// Internal.
+#include "VoxelBrickTracker.h"
+#include "../Texture3D.h"
+#include "../../Utility/Half.h"
+#include "../../Utility/Parallel.h"
+
+namespace {
+	// ----------------
+	// Texel conversion.
+	// ----------------
+	inline __m128 loadTexelRGBA8(const unsigned char * texel) {
+		const __m128i zero = _mm_setzero_si128();
+		__m128i v = _mm_cvtsi32_si128(*reinterpret_cast<const int *>(texel));
+		v = _mm_unpacklo_epi16(_mm_unpacklo_epi8(v, zero), zero);
+		return _mm_mul_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(1.0f / 255.0f));
+	}
+
+	inline void storeTexelRGBA8(unsigned char * texel, __m128 value) {
+		__m128i v = _mm_cvtps_epi32(_mm_mul_ps(value, _mm_set1_ps(255.0f)));
+		v = _mm_packs_epi32(v, v);
+		v = _mm_packus_epi16(v, v);
+		*reinterpret_cast<int *>(texel) = _mm_cvtsi128_si32(v);
+	}
+
+	inline __m128 loadTexel(const unsigned char * texel, VoxelMipChain::Format format) {
+		if (format == VoxelMipChain::Format::RGBA8) return loadTexelRGBA8(texel);
+		return Half::load4(reinterpret_cast<const uint16_t *>(texel));
+	}
+
+	inline void storeTexel(unsigned char * texel, __m128 value, VoxelMipChain::Format format) {
+		if (format == VoxelMipChain::Format::RGBA8) storeTexelRGBA8(texel, value);
+		else Half::store4(reinterpret_cast<uint16_t *>(texel), value);
+	}
+
+	// ----------------
+	// Filters.
+	// ----------------
+	/// <summary> Filters the eight children of one parent voxel. Works on all four channels at once. </summary>
+	inline __m128 filterTexels(const __m128 children[8], VoxelMipChain::Filter filter, bool premultiplyChildren) {
+		using F = VoxelMipChain::Filter;
+		const __m128 eighth = _mm_set1_ps(0.125f);
+		const __m128 alphaMask = _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0, -1));
+
+		if (filter == F::ALPHA_WEIGHTED) {
+			__m128 weighted = _mm_setzero_ps(), alphaSum = _mm_setzero_ps();
+			for (int i = 0; i < 8; ++i) {
+				const __m128 alpha = _mm_shuffle_ps(children[i], children[i], _MM_SHUFFLE(3, 3, 3, 3));
+				weighted = _mm_add_ps(weighted, _mm_mul_ps(children[i], alpha));
+				alphaSum = _mm_add_ps(alphaSum, alpha);
+			}
+			// Color = sum(c * a) / sum(a), alpha = average alpha. Empty parents stay black.
+			const __m128 nonEmpty = _mm_cmpgt_ps(alphaSum, _mm_setzero_ps());
+			const __m128 color = _mm_and_ps(nonEmpty, _mm_div_ps(weighted, _mm_max_ps(alphaSum, _mm_set1_ps(1e-8f))));
+			return _mm_or_ps(_mm_andnot_ps(alphaMask, color), _mm_and_ps(alphaMask, _mm_mul_ps(alphaSum, eighth)));
+		}
+
+		__m128 sum = _mm_setzero_ps();
+		if (filter == F::PREMULTIPLIED && premultiplyChildren) {
+			for (int i = 0; i < 8; ++i) {
+				const __m128 alpha = _mm_shuffle_ps(children[i], children[i], _MM_SHUFFLE(3, 3, 3, 3));
+				const __m128 factor = _mm_or_ps(_mm_andnot_ps(alphaMask, alpha), _mm_and_ps(alphaMask, _mm_set1_ps(1.0f)));
+				sum = _mm_add_ps(sum, _mm_mul_ps(children[i], factor));
+			}
+		}
+		else {
+			for (int i = 0; i < 8; ++i) sum = _mm_add_ps(sum, children[i]);
+		}
+		return _mm_mul_ps(sum, eighth);
+	}
+
+	/// <summary> Box filters four RGBA8 parents from four source rows (32 bytes each) using 16 bit integer math. </summary>
+	inline void boxFilterRGBA8x4(const unsigned char * rows[4], const int offset, unsigned char * destination) {
+		const __m128i zero = _mm_setzero_si128();
+		__m128i s0 = zero, s1 = zero, s2 = zero, s3 = zero;
+		for (int r = 0; r < 4; ++r) {
+			const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[r] + offset));
+			const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[r] + offset + 16));
+			s0 = _mm_add_epi16(s0, _mm_unpacklo_epi8(a, zero));
+			s1 = _mm_add_epi16(s1, _mm_unpackhi_epi8(a, zero));
+			s2 = _mm_add_epi16(s2, _mm_unpacklo_epi8(b, zero));
+			s3 = _mm_add_epi16(s3, _mm_unpackhi_epi8(b, zero));
+		}
+		// Each register holds two neighbouring texels along x, fold them into the low 64 bits.
+		s0 = _mm_add_epi16(s0, _mm_srli_si128(s0, 8));
+		s1 = _mm_add_epi16(s1, _mm_srli_si128(s1, 8));
+		s2 = _mm_add_epi16(s2, _mm_srli_si128(s2, 8));
+		s3 = _mm_add_epi16(s3, _mm_srli_si128(s3, 8));
+		const __m128i rounding = _mm_set1_epi16(4);
+		__m128i lo = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(s0, s1), rounding), 3);
+		__m128i hi = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(s2, s3), rounding), 3);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(destination), _mm_packus_epi16(lo, hi));
+	}
+}
+
+VoxelMipChain::VoxelMipChain(const int _size, const Format _format) : size(_size), format(_format)
+{
+	assert(size > 0 && (size & (size - 1)) == 0);
+
+	levelCount = 1;
+	while ((size >> (levelCount - 1)) > 1) ++levelCount;
+
+	// Single allocation for the whole chain.
+	levelOffsets.resize(levelCount + 1);
+	size_t offset = 0;
+	for (int level = 0; level < levelCount; ++level) {
+		const size_t s = size_t(getSize(level));
+		levelOffsets[level] = offset;
+		offset += s * s * s * getBytesPerVoxel();
+	}
+	levelOffsets[levelCount] = offset;
+	data.assign(offset, 0);
+}
+
+void VoxelMipChain::generateMipmaps(const Filter filter, const unsigned int threadCount)
+{
+	for (int level = 1; level < levelCount; ++level) downsampleLevel(level, filter, threadCount);
+}
+
+void VoxelMipChain::downsampleLevel(const int level, const Filter filter, const unsigned int threadCount)
+{
+	assert(level >= 1 && level < levelCount);
+	const int s = getSize(level);
+	Parallel::forRange(0, s, [this, level, filter, s](int zBegin, int zEnd) {
+		downsampleRegion(level, filter, glm::ivec3(0, 0, zBegin), glm::ivec3(s, s, zEnd));
+	}, threadCount);
+}
+
+void VoxelMipChain::generateMipmaps(VoxelBrickTracker & bricks, const Filter filter, const unsigned int threadCount)
+{
+	assert(bricks.getLevelCount() >= levelCount);
+	bricks.propagate();
+	for (int level = 1; level < levelCount; ++level) {
+		const auto & dirty = bricks.getDirtyBricks(level);
+		Parallel::forRange(0, int(dirty.size()), [this, &bricks, &dirty, level, filter](int first, int last) {
+			glm::ivec3 begin, end;
+			for (int i = first; i < last; ++i) {
+				bricks.getBrickTexels(level, dirty[i], begin, end);
+				downsampleRegion(level, filter, begin, end);
+			}
+		}, threadCount);
+	}
+	bricks.clear();
+}
+
+void VoxelMipChain::downsampleRegion(const int level, const Filter filter, const glm::ivec3 & begin, const glm::ivec3 & end)
+{
+	const int bpv = getBytesPerVoxel();
+	const size_t sourceSize = size_t(getSize(level - 1)), destinationSize = size_t(getSize(level));
+	const unsigned char * source = getLevelData(level - 1);
+	unsigned char * destination = getLevelData(level);
+	const size_t sourceRow = sourceSize * bpv, sourceSlice = sourceSize * sourceRow;
+
+	const bool integerPath = format == Format::RGBA8 && filter == Filter::BOX;
+	const bool premultiplyChildren = level == 1;
+
+	for (int z = begin.z; z < end.z; ++z) {
+		for (int y = begin.y; y < end.y; ++y) {
+			// The four source rows that contribute to this destination row.
+			const unsigned char * row00 = source + (2 * z) * sourceSlice + (2 * y) * sourceRow;
+			const unsigned char * rows[4] = { row00, row00 + sourceRow, row00 + sourceSlice, row00 + sourceSlice + sourceRow };
+			unsigned char * out = destination + (size_t(z) * destinationSize + y) * destinationSize * bpv;
+
+			int x = begin.x;
+			if (integerPath) {
+				for (; x + 4 <= end.x; x += 4) boxFilterRGBA8x4(rows, 2 * x * bpv, out + x * bpv);
+			}
+
+			for (; x < end.x; ++x) {
+				__m128 children[8];
+				for (int r = 0; r < 4; ++r) {
+					children[2 * r + 0] = loadTexel(rows[r] + (2 * x + 0) * bpv, format);
+					children[2 * r + 1] = loadTexel(rows[r] + (2 * x + 1) * bpv, format);
+				}
+				storeTexel(out + x * bpv, filterTexels(children, filter, premultiplyChildren), format);
+			}
+		}
+	}
+}
+
+void VoxelMipChain::upload(Texture3D & texture) const
+{
+	assert(Texture3D::GetPixelFormat(texture.GetFormat()) == GL_RGBA);
+	const GLenum type = format == Format::RGBA8 ? GL_UNSIGNED_BYTE : GL_HALF_FLOAT;
+	const int levels = std::min(levelCount, texture.GetLevelCount());
+	for (int level = 0; level < levels; ++level) texture.UploadLevel(level, getLevelData(level), type);
+}
+
+void VoxelMipChain::getOccupancy(std::vector<unsigned char> & occupancy, const float alphaThreshold) const
+{
+	const size_t count = size_t(size) * size * size;
+	const unsigned char * voxels = getLevelData(0);
+	occupancy.resize(count);
+	if (format == Format::RGBA8) {
+		const int threshold = int(alphaThreshold * 255.0f);
+		for (size_t i = 0; i < count; ++i) occupancy[i] = voxels[4 * i + 3] > threshold;
+	}
+	else {
+		const uint16_t * halves = reinterpret_cast<const uint16_t *>(voxels);
+		for (size_t i = 0; i < count; ++i) occupancy[i] = Half::toFloat(halves[4 * i + 3]) > alphaThreshold;
+	}
+}
+
+// ----------------------
+// Sampling.
+// ----------------------
+glm::vec4 VoxelMipChain::fetch(const int level, const int x, const int y, const int z) const
+{
+	const int s = getSize(level);
+	if (x < 0 || y < 0 || z < 0 || x >= s || y >= s || z >= s) return glm::vec4(0); // Border color.
+	const unsigned char * texel = getVoxel(level, x, y, z);
+	if (format == Format::RGBA8) {
+		return glm::vec4(texel[0], texel[1], texel[2], texel[3]) * (1.0f / 255.0f);
+	}
+	const uint16_t * halves = reinterpret_cast<const uint16_t *>(texel);
+	return glm::vec4(Half::toFloat(halves[0]), Half::toFloat(halves[1]), Half::toFloat(halves[2]), Half::toFloat(halves[3]));
+}
+
+glm::vec4 VoxelMipChain::sampleLevel(const glm::vec3 & uvw, const int level) const
+{
+	const glm::vec3 p = uvw * float(getSize(level)) - 0.5f;
+	const glm::vec3 base = glm::floor(p);
+	const glm::vec3 f = p - base;
+	const int x = int(base.x), y = int(base.y), z = int(base.z);
+
+	glm::vec4 result(0.0f);
+	for (int corner = 0; corner < 8; ++corner) {
+		const int dx = corner & 1, dy = (corner >> 1) & 1, dz = corner >> 2;
+		const float w = (dx ? f.x : 1 - f.x) * (dy ? f.y : 1 - f.y) * (dz ? f.z : 1 - f.z);
+		if (w > 0.0f) result += w * fetch(level, x + dx, y + dy, z + dz);
+	}
+	return result;
+}
+
+glm::vec4 VoxelMipChain::sampleLod(const glm::vec3 & uvw, float lod) const
+{
+	lod = std::min(std::max(lod, 0.0f), float(levelCount - 1));
+	const int level = int(lod);
+	const float t = lod - level;
+	if (t <= 0.0f || level + 1 >= levelCount) return sampleLevel(uvw, level);
+	return glm::mix(sampleLevel(uvw, level), sampleLevel(uvw, level + 1), t);
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+#include <glm.hpp>
+
+class Texture3D;
+class VoxelBrickTracker;
+
+/// <summary> A CPU-side voxel volume together with its full mip chain, stored in one allocation.
+/// Uses the same layout as the voxel Texture3D: four channels per voxel, x varies fastest, then y, then z.
+/// Lets baked or CPU-voxelized volumes get mipmaps without a GL context. </summary>
+class VoxelMipChain {
+public:
+	enum Format {
+		RGBA8 = 0,		// 4 x unsigned normalized byte (GL_RGBA8).
+		RGBA16F = 1		// 4 x half float (GL_RGBA16F).
+	};
+
+	enum Filter {
+		BOX = 0,			// Plain 2x2x2 average of every channel (same as glGenerateMipmap).
+		ALPHA_WEIGHTED = 1,	// Colors are weighted by alpha, so empty voxels don't darken their neighbours.
+		PREMULTIPLIED = 2	// Mips store colors premultiplied by alpha. Level 0 stays straight alpha (it is premultiplied while
+							// filtering level 1), so consumers must premultiply level 0 samples themselves before blending
+							// them with a mip (sampleLod doesn't).
+	};
+
+	/// <summary> Creates a zeroed cubic volume. The size must be a power of 2. </summary>
+	VoxelMipChain(const int size, const Format format = Format::RGBA8);
+
+	/// <summary> Regenerates every mip level from level 0. Each level is split into z-slabs
+	/// that are filtered in parallel. A thread count of 0 uses all hardware threads. </summary>
+	void generateMipmaps(const Filter filter = Filter::BOX, const unsigned int threadCount = 0);
+
+	/// <summary> Rebuilds only the texels above the dirty bricks of a tracker, then clears the tracker.
+	/// The cost scales with the size of the edited region instead of the size of the volume. </summary>
+	void generateMipmaps(VoxelBrickTracker & bricks, const Filter filter = Filter::BOX, const unsigned int threadCount = 0);
+
+	/// <summary> Rebuilds a single mip level (>= 1) from the level below it. </summary>
+	void downsampleLevel(const int level, const Filter filter = Filter::BOX, const unsigned int threadCount = 0);
+
+	/// <summary> Rebuilds the texels [begin, end) of a mip level (>= 1) from the level below it. </summary>
+	void downsampleRegion(const int level, const Filter filter, const glm::ivec3 & begin, const glm::ivec3 & end);
+
+	/// <summary> Uploads every level (that the texture has room for) to a texture of the same size. </summary>
+	void upload(Texture3D & texture) const;
+
+	// ----------------
+	// Sampling.
+	// ----------------
+	/// <summary> Returns a voxel as floats. Coordinates outside the level return zero (like a zero border color). </summary>
+	glm::vec4 fetch(const int level, const int x, const int y, const int z) const;
+
+	/// <summary> Trilinearly samples one level. Texture coordinates are in [0, 1]^3. </summary>
+	glm::vec4 sampleLevel(const glm::vec3 & uvw, const int level) const;
+
+	/// <summary> Samples like textureLod on a GL_LINEAR_MIPMAP_LINEAR, GL_CLAMP_TO_BORDER texture. </summary>
+	glm::vec4 sampleLod(const glm::vec3 & uvw, float lod) const;
+
+	/// <summary> Writes one byte per level 0 voxel: 1 if its alpha is above the threshold, 0 otherwise. </summary>
+	void getOccupancy(std::vector<unsigned char> & occupancy, const float alphaThreshold = 0.0f) const;
+
+	// ----------------
+	// Accessors.
+	// ----------------
+	int getSize(const int level = 0) const { return size >> level; }
+	int getLevelCount() const { return levelCount; }
+	Format getFormat() const { return format; }
+	int getBytesPerVoxel() const { return format == Format::RGBA8 ? 4 : 8; }
+	size_t getLevelByteSize(const int level) const { return levelOffsets[level + 1] - levelOffsets[level]; }
+	size_t getByteSize() const { return data.size(); }
+	unsigned char * getLevelData(const int level) { return data.data() + levelOffsets[level]; }
+	const unsigned char * getLevelData(const int level) const { return data.data() + levelOffsets[level]; }
+
+	/// <summary> Returns a pointer to the first channel of a voxel. </summary>
+	unsigned char * getVoxel(const int level, const int x, const int y, const int z) {
+		const size_t s = size_t(getSize(level));
+		return getLevelData(level) + ((size_t(z) * s + y) * s + x) * getBytesPerVoxel();
+	}
+	const unsigned char * getVoxel(const int level, const int x, const int y, const int z) const {
+		const size_t s = size_t(getSize(level));
+		return getLevelData(level) + ((size_t(z) * s + y) * s + x) * getBytesPerVoxel();
+	}
+private:
+	int size, levelCount;
+	Format format;
+	std::vector<size_t> levelOffsets; // levelCount + 1 entries, the last one is the total size.
+	std::vector<unsigned char> data;
+};
@@ -0,0 +1,145 @@
+#include "VoxelOccupancy.h"
+
+// Stdlib.
+#include <cmath>
+#include <cassert>
+#include <bitset>
+#include <algorithm>
+
+// Internal.
+#include "VoxelMipChain.h"
+#include "../../Utility/Parallel.h"
+
+namespace {
+	inline int bitIndex(const int x, const int y, const int z) { return (x & 3) + 4 * (y & 3) + 16 * (z & 3); }
+
+	/// <summary> Bits of the 2x2x2 sub-block of a word that contains a local coordinate (0 - 3 per axis). </summary>
+	inline uint64_t subBlockMask(const int x, const int y, const int z) {
+		const uint64_t corner = 0x330033ull; // Bits (0, 0, 0) to (1, 1, 1).
+		return corner << bitIndex(x & 2, y & 2, z & 2);
+	}
+}
+
+VoxelOccupancy::VoxelOccupancy(const int _size) : size(_size)
+{
+	assert(size > 0 && size % BLOCK_SIZE == 0);
+
+	size_t offset = 0;
+	int blocks = size / BLOCK_SIZE;
+	for (;;) {
+		blocksPerAxis.push_back(blocks);
+		levelOffsets.push_back(offset);
+		offset += size_t(blocks) * blocks * blocks;
+		if (blocks == 1) break;
+		blocks = (blocks + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	}
+	words.assign(offset, 0);
+}
+
+void VoxelOccupancy::build(const VoxelMipChain & volume, const float alphaThreshold, const unsigned int threadCount)
+{
+	assert(volume.getSize() == size);
+	std::vector<unsigned char> occupancy;
+	volume.getOccupancy(occupancy, alphaThreshold);
+	build(occupancy, threadCount);
+}
+
+void VoxelOccupancy::build(const std::vector<unsigned char> & occupancy, const unsigned int threadCount)
+{
+	assert(occupancy.size() == size_t(size) * size * size);
+	std::fill(words.begin(), words.end(), 0);
+
+	// Level 0, one slab of blocks per task so no two threads write the same word.
+	const int blocks = blocksPerAxis[0];
+	Parallel::forRange(0, blocks, [&](int zBegin, int zEnd) {
+		for (int z = zBegin * BLOCK_SIZE; z < zEnd * BLOCK_SIZE; ++z) {
+			for (int y = 0; y < size; ++y) {
+				const unsigned char * row = occupancy.data() + (size_t(z) * size + y) * size;
+				uint64_t * wordRow = words.data() + (size_t(z / BLOCK_SIZE) * blocks + y / BLOCK_SIZE) * blocks;
+				for (int x = 0; x < size; ++x) {
+					if (row[x]) wordRow[x / BLOCK_SIZE] |= uint64_t(1) << bitIndex(x, y, z);
+				}
+			}
+		}
+	}, threadCount);
+
+	for (int level = 1; level < getLevelCount(); ++level) reduceLevel(level, threadCount);
+}
+
+void VoxelOccupancy::reduceLevel(const int level, const unsigned int threadCount)
+{
+	const int sourceBlocks = blocksPerAxis[level - 1], blocks = blocksPerAxis[level];
+	const uint64_t * source = words.data() + levelOffsets[level - 1];
+	uint64_t * destination = words.data() + levelOffsets[level];
+	Parallel::forRange(0, blocks, [&](int zBegin, int zEnd) {
+		for (int z = zBegin * BLOCK_SIZE; z < std::min(zEnd * BLOCK_SIZE, sourceBlocks); ++z) {
+			for (int y = 0; y < sourceBlocks; ++y) {
+				const uint64_t * row = source + (size_t(z) * sourceBlocks + y) * sourceBlocks;
+				uint64_t * wordRow = destination + (size_t(z / BLOCK_SIZE) * blocks + y / BLOCK_SIZE) * blocks;
+				for (int x = 0; x < sourceBlocks; ++x) {
+					if (row[x]) wordRow[x / BLOCK_SIZE] |= uint64_t(1) << bitIndex(x, y, z);
+				}
+			}
+		}
+	}, threadCount);
+}
+
+bool VoxelOccupancy::isOccupied(const int x, const int y, const int z) const
+{
+	if (x < 0 || y < 0 || z < 0 || x >= size || y >= size || z >= size) return false;
+	return (getWord(0, x / BLOCK_SIZE, y / BLOCK_SIZE, z / BLOCK_SIZE) >> bitIndex(x, y, z)) & 1;
+}
+
+size_t VoxelOccupancy::countOccupied() const
+{
+	size_t count = 0;
+	const size_t levelWords = levelOffsets.size() > 1 ? levelOffsets[1] : words.size();
+	for (size_t i = 0; i < levelWords; ++i) count += std::bitset<64>(words[i]).count();
+	return count;
+}
+
+bool VoxelOccupancy::raycast(const glm::vec3 & origin, const glm::vec3 & direction, glm::ivec3 & hitVoxel, int * steps) const
+{
+	const float EPSILON = 1e-3f; // Pushes samples across the cell boundary they stopped at.
+	const int levelCount = getLevelCount();
+	glm::vec3 position = origin;
+	int count = 0;
+
+	for (;;) {
+		const glm::ivec3 voxel = glm::ivec3(glm::floor(position));
+		if (voxel.x < 0 || voxel.y < 0 || voxel.z < 0 || voxel.x >= size || voxel.y >= size || voxel.z >= size) break;
+		++count;
+
+		// Find the largest empty cell around the voxel, from the coarsest level down. A zero word at level L is an
+		// empty cell of 4^(L + 1) voxels. Inside a non-zero level 0 word, try the 2x2x2 sub-block, then the voxel itself.
+		int cellShift = -1;
+		for (int level = levelCount - 1; level >= 0 && cellShift < 0; --level) {
+			const int shift = 2 * (level + 1);
+			if (getWord(level, voxel.x >> shift, voxel.y >> shift, voxel.z >> shift) == 0) cellShift = shift;
+		}
+		if (cellShift < 0) {
+			const uint64_t word = getWord(0, voxel.x >> 2, voxel.y >> 2, voxel.z >> 2);
+			if ((word & subBlockMask(voxel.x, voxel.y, voxel.z)) == 0) cellShift = 1;
+			else if (((word >> bitIndex(voxel.x, voxel.y, voxel.z)) & 1) == 0) cellShift = 0;
+			else {
+				hitVoxel = voxel;
+				if (steps) *steps = count;
+				return true;
+			}
+		}
+
+		// Move to where the ray leaves the cell.
+		const int cellMask = ~((1 << cellShift) - 1);
+		const glm::vec3 cellMin(voxel.x & cellMask, voxel.y & cellMask, voxel.z & cellMask);
+		const glm::vec3 cellMax = cellMin + float(1 << cellShift);
+		float exit = 1e30f;
+		for (int axis = 0; axis < 3; ++axis) {
+			if (direction[axis] > 0.0f) exit = std::min(exit, (cellMax[axis] - position[axis]) / direction[axis]);
+			else if (direction[axis] < 0.0f) exit = std::min(exit, (cellMin[axis] - position[axis]) / direction[axis]);
+		}
+		position += direction * (std::max(exit, 0.0f) + EPSILON);
+	}
+
+	if (steps) *steps = count;
+	return false;
+}
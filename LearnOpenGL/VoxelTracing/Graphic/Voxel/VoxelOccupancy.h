@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include <glm.hpp>
+
+class VoxelMipChain;
+
+/// <summary> A hierarchical occupancy bitmask of a cubic voxel volume. Level 0 has one bit per voxel, packed into one
+/// 64 bit word per 4x4x4 block. Every coarser level has one bit per word of the level below (set if the word is non-zero),
+/// packed the same way, up to a single word. Bits are ordered x + 4y + 16z inside a word, words x fastest, then y and z.
+/// Matches the buffer written by 'voxel_occupancy.comp', where each word is two uints (low bits first). </summary>
+class VoxelOccupancy {
+public:
+	static const int BLOCK_SIZE = 4;
+
+	/// <summary> Creates an empty bitmask for a volume with the given size (a multiple of 4). </summary>
+	VoxelOccupancy(const int size);
+
+	/// <summary> Builds every level from level 0 of a volume. A voxel is occupied if its alpha is above the threshold. </summary>
+	void build(const VoxelMipChain & volume, const float alphaThreshold = 0.0f, const unsigned int threadCount = 0);
+
+	/// <summary> Builds every level from an occupancy grid (non-zero means occupied) of size^3 voxels. </summary>
+	void build(const std::vector<unsigned char> & occupancy, const unsigned int threadCount = 0);
+
+	/// <summary> Returns true if a voxel is occupied. Coordinates outside the volume are empty. </summary>
+	bool isOccupied(const int x, const int y, const int z) const;
+
+	/// <summary> Returns the number of occupied voxels. </summary>
+	size_t countOccupied() const;
+
+	/// <summary> Walks a ray through the volume (in voxel coordinates, [0, size)^3), skipping the largest empty cell
+	/// around every sample: whole words at any level, 2x2x2 sub-blocks or single voxels.
+	/// Returns true and the first occupied voxel if the ray hits something before leaving the volume. </summary>
+	bool raycast(const glm::vec3 & origin, const glm::vec3 & direction, glm::ivec3 & hitVoxel, int * steps = nullptr) const;
+
+	// ----------------
+	// Accessors.
+	// ----------------
+	int getSize() const { return size; }
+	int getLevelCount() const { return int(blocksPerAxis.size()); }
+	int getBlocksPerAxis(const int level) const { return blocksPerAxis[level]; }
+	uint64_t getWord(const int level, const int x, const int y, const int z) const {
+		const size_t b = size_t(blocksPerAxis[level]);
+		return words[levelOffsets[level] + (size_t(z) * b + y) * b + x];
+	}
+	size_t getLevelOffset(const int level) const { return levelOffsets[level]; }
+	size_t getWordCount() const { return words.size(); }
+	size_t getByteSize() const { return words.size() * sizeof(uint64_t); }
+	const uint64_t * getData() const { return words.data(); }
+private:
+	int size;
+	std::vector<int> blocksPerAxis;
+	std::vector<size_t> levelOffsets; // In words.
+	std::vector<uint64_t> words;
+	void reduceLevel(const int level, const unsigned int threadCount);
+};
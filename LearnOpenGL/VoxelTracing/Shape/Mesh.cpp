@@ -5,19 +5,16 @@
 #include <glfw3.h>
 #include <gtc/type_ptr.hpp>
 
+#include "../Graphic/GLState.h"
+#include "../Graphic/Device/GLDevice.h"
+
 Mesh::Mesh() { }
 
 Mesh::~Mesh() {
 	if (meshUploaded) {
-		GLint curp;
-		glGetIntegerv(GL_CURRENT_PROGRAM, &curp);
-
-		// Delete.
-		glUseProgram(program);
-		glDeleteBuffers(1, &vbo);
-		glDeleteVertexArrays(1, &vao);
-
-		// Reset.
-		glUseProgram(curp);
+		// Deleting buffers doesn't depend on the program in use.
+		GLState::getInstance().forgetVertexArray(vao);
+		gl::deleteBuffers(1, &vbo);
+		gl::deleteVertexArrays(1, &vao);
 	}
 }
\ No newline at end of file
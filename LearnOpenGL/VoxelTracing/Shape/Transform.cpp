@@ -7,6 +7,21 @@ Transform::Transform() {
 }
 
 void Transform::updateTransformMatrix() {
+	snapshot.update(vectors());
+	recalculate();
+}
+
+bool Transform::updateTransformMatrixIfChanged() {
+	const bool changed = snapshot.update(vectors());
+	if (changed || transformIsInvalid) recalculate();
+	return changed;
+}
+
+std::array<float, 9> Transform::vectors() const {
+	return { position.x, position.y, position.z, scale.x, scale.y, scale.z, rotation.x, rotation.y, rotation.z };
+}
+
+void Transform::recalculate() {
 	transform = glm::translate(position) * glm::mat4_cast(glm::quat(rotation)) * glm::scale(scale);
 	transformIsInvalid = false;
 }
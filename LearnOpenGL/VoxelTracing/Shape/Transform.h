@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vector>
+#include <array>
 
 #include <glm.hpp>
 #include <gtc\matrix_transform.hpp>
@@ -8,6 +9,8 @@
 #include <mat4x4.hpp>
 #include <gtc/quaternion.hpp>
 
+#include "../Utility/ChangeSnapshot.h"
+
 /// <summary> Represents a transform: rotation, position and scale. </summary>
 class Transform {
 public:
@@ -22,6 +25,13 @@ public:
 	/// <summary> Recalculates the transform matrix according to the position, scale and rotation vectors. </summary>
 	void updateTransformMatrix();
 
+	/// <summary> Recalculates the transform matrix only if the position, scale or rotation changed since the last update
+	/// (they are written directly, e.g. by the tweak bar). Returns true if they changed. </summary>
+	bool updateTransformMatrixIfChanged();
+
+	/// <summary> Changes whenever the matrix is recalculated from changed vectors. </summary>
+	unsigned int getVersion() const { return snapshot.getVersion(); }
+
 	/// <summary> Returns a reference to the transform matrix </summary>
 	glm::mat4 & getTransformMatrix();
 
@@ -34,4 +44,7 @@ public:
 	glm::vec3 right();
 private:
 	glm::mat4 transform;
+	ChangeSnapshot<std::array<float, 9>> snapshot;
+	std::array<float, 9> vectors() const;
+	void recalculate();
 };
\ No newline at end of file
@@ -0,0 +1,95 @@
+#include "BlueNoise.h"
+
+#include <cmath>
+#include <random>
+#include <algorithm>
+
+namespace {
+	const float SIGMA = 1.5f; // Of the Gaussian energy filter.
+
+	/// <summary> Gaussian energies of a binary pattern on a torus, updated as points are added and removed. </summary>
+	class Energy {
+	public:
+		Energy(const int _size) : size(_size), energy(_size * _size, 0.0f), kernel(_size * _size) {
+			for (int y = 0; y < size; ++y) for (int x = 0; x < size; ++x) {
+				const int dx = std::min(x, size - x), dy = std::min(y, size - y);
+				kernel[y * size + x] = std::exp(-(dx * dx + dy * dy) / (2.0f * SIGMA * SIGMA));
+			}
+		}
+
+		void splat(const int index, const float sign) {
+			const int px = index % size, py = index / size;
+			for (int y = 0; y < size; ++y) for (int x = 0; x < size; ++x)
+				energy[y * size + x] += sign * kernel[((y - py + size) % size) * size + (x - px + size) % size];
+		}
+
+		/// <summary> Returns the point with the highest energy (the tightest cluster). </summary>
+		int tightestCluster(const std::vector<bool> & pattern) const {
+			int best = -1;
+			for (int i = 0; i < int(pattern.size()); ++i) if (pattern[i] && (best < 0 || energy[i] > energy[best])) best = i;
+			return best;
+		}
+
+		/// <summary> Returns the empty cell with the lowest energy (the largest void). </summary>
+		int largestVoid(const std::vector<bool> & pattern) const {
+			int best = -1;
+			for (int i = 0; i < int(pattern.size()); ++i) if (!pattern[i] && (best < 0 || energy[i] < energy[best])) best = i;
+			return best;
+		}
+	private:
+		int size;
+		std::vector<float> energy, kernel;
+	};
+}
+
+std::vector<float> BlueNoise::generate(const int size, const unsigned int seed)
+{
+	const int n = size * size;
+	std::mt19937 random(seed);
+
+	// Initial pattern: 10% random points, relaxed by moving the tightest cluster into the largest void until stable.
+	std::vector<bool> pattern(n, false);
+	Energy energy(size);
+	int ones = 0;
+	while (ones < std::max(1, n / 10)) {
+		const int i = int(random() % unsigned(n));
+		if (pattern[i]) continue;
+		pattern[i] = true;
+		energy.splat(i, 1.0f);
+		++ones;
+	}
+	for (int iteration = 0; iteration < n; ++iteration) {
+		const int cluster = energy.tightestCluster(pattern);
+		pattern[cluster] = false;
+		energy.splat(cluster, -1.0f);
+		const int emptiest = energy.largestVoid(pattern);
+		pattern[emptiest] = true;
+		energy.splat(emptiest, 1.0f);
+		if (emptiest == cluster) break;
+	}
+
+	// Phase 1: rank the initial points by removing the tightest clusters.
+	std::vector<int> rank(n, 0);
+	{
+		std::vector<bool> remaining = pattern;
+		Energy remainingEnergy = energy;
+		for (int r = ones - 1; r >= 0; --r) {
+			const int cluster = remainingEnergy.tightestCluster(remaining);
+			remaining[cluster] = false;
+			remainingEnergy.splat(cluster, -1.0f);
+			rank[cluster] = r;
+		}
+	}
+
+	// Phase 2: rank the rest by filling the largest voids.
+	for (int r = ones; r < n; ++r) {
+		const int emptiest = energy.largestVoid(pattern);
+		pattern[emptiest] = true;
+		energy.splat(emptiest, 1.0f);
+		rank[emptiest] = r;
+	}
+
+	std::vector<float> table(n);
+	for (int i = 0; i < n; ++i) table[i] = (rank[i] + 0.5f) / n;
+	return table;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <vector>
+
+namespace BlueNoise {
+	/// <summary> Generates a size x size tileable blue noise table with the void-and-cluster method (row by row).
+	/// Every value in (0, 1) appears once, and neighbouring values are far apart, so per-pixel rotations drawn
+	/// from it leave little low frequency noise for a spatial filter to remove. O(size^4), meant for small tables. </summary>
+	std::vector<float> generate(const int size = 32, const unsigned int seed = 1);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstring>
+
+/// <summary> Versions are unique over every snapshot, so an object created where another was deleted never reuses its version. </summary>
+inline unsigned int nextChangeVersion() {
+	static unsigned int version = 0;
+	return ++version;
+}
+
+/// <summary> Change detection for values that are written directly (the tweak bar holds raw pointers to them, so setters can't
+/// see the writes). update compares the values with the last snapshot and takes a new version when they differ.
+/// Values must be trivially copyable without padding (a std::array of floats). </summary>
+template<typename Values>
+class ChangeSnapshot {
+public:
+	/// <summary> Returns true (and takes a new version) if the values changed since the last update, or on the first update. </summary>
+	bool update(const Values & values) {
+		if (version != 0 && std::memcmp(&values, &snapshot, sizeof(Values)) == 0) return false;
+		snapshot = values;
+		version = nextChangeVersion();
+		return true;
+	}
+
+	/// <summary> 0 until the first update. </summary>
+	unsigned int getVersion() const { return version; }
+private:
+	Values snapshot;
+	unsigned int version = 0;
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include <immintrin.h>
+
+#if defined(__F16C__) || defined(__AVX2__)
+#define __HALF_USE_F16C 1
+#else
+#define __HALF_USE_F16C 0
+#endif
+
+/// <summary> IEEE 754 half precision conversions (matches GL_HALF_FLOAT).
+/// Uses F16C when the compiler targets it, otherwise falls back to bit manipulation. </summary>
+namespace Half {
+	/// <summary> Converts a float to a half (round to nearest even, overflow saturates to infinity). </summary>
+	inline uint16_t fromFloat(float value) {
+		uint32_t f;
+		std::memcpy(&f, &value, sizeof(f));
+		const uint32_t sign = (f >> 16) & 0x8000u;
+		f &= 0x7fffffffu;
+		if (f >= 0x7f800000u) return uint16_t(sign | 0x7c00u | (f > 0x7f800000u ? 0x200u : 0u)); // Inf / NaN.
+		if (f >= 0x477ff000u) return uint16_t(sign | 0x7c00u); // Overflow.
+		if (f < 0x38800000u) { // Subnormal or zero.
+			if (f < 0x33000000u) return uint16_t(sign);
+			const uint32_t exponent = f >> 23;
+			const uint32_t mantissa = (f & 0x7fffffu) | 0x800000u;
+			const uint32_t shift = 126u - exponent;
+			uint32_t half = mantissa >> shift;
+			const uint32_t rest = mantissa & ((1u << shift) - 1u), halfway = 1u << (shift - 1u);
+			if (rest > halfway || (rest == halfway && (half & 1u))) ++half;
+			return uint16_t(sign | half);
+		}
+		uint32_t half = ((f - 0x38000000u) >> 13);
+		const uint32_t rest = f & 0x1fffu;
+		if (rest > 0x1000u || (rest == 0x1000u && (half & 1u))) ++half;
+		return uint16_t(sign | half);
+	}
+
+	/// <summary> Converts a half to a float. </summary>
+	inline float toFloat(uint16_t value) {
+		const uint32_t sign = uint32_t(value & 0x8000u) << 16;
+		uint32_t exponent = (value >> 10) & 0x1fu, mantissa = value & 0x3ffu, f;
+		if (exponent == 0) {
+			if (mantissa == 0) f = sign;
+			else { // Normalize subnormal.
+				exponent = 113;
+				while ((mantissa & 0x400u) == 0) { mantissa <<= 1; --exponent; }
+				f = sign | (exponent << 23) | ((mantissa & 0x3ffu) << 13);
+			}
+		}
+		else if (exponent == 31) f = sign | 0x7f800000u | (mantissa << 13);
+		else f = sign | ((exponent + 112) << 23) | (mantissa << 13);
+		float result;
+		std::memcpy(&result, &f, sizeof(result));
+		return result;
+	}
+
+	/// <summary> Loads four halves into an SSE register. </summary>
+	inline __m128 load4(const uint16_t * source) {
+#if __HALF_USE_F16C
+		return _mm_cvtph_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(source)));
+#else
+		return _mm_setr_ps(toFloat(source[0]), toFloat(source[1]), toFloat(source[2]), toFloat(source[3]));
+#endif
+	}
+
+	/// <summary> Stores an SSE register as four halves. </summary>
+	inline void store4(uint16_t * destination, __m128 value) {
+#if __HALF_USE_F16C
+		_mm_storel_epi64(reinterpret_cast<__m128i *>(destination), _mm_cvtps_ph(value, _MM_FROUND_TO_NEAREST_INT));
+#else
+		alignas(16) float v[4];
+		_mm_store_ps(v, value);
+		for (int i = 0; i < 4; ++i) destination[i] = fromFloat(v[i]);
+#endif
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+/// <summary> Minimal fork-join helpers used by the CPU-side voxel passes. </summary>
+namespace Parallel {
+	/// <summary> Returns the number of hardware threads (at least 1). </summary>
+	inline unsigned int hardwareThreadCount() {
+		unsigned int n = std::thread::hardware_concurrency();
+		return n == 0 ? 1 : n;
+	}
+
+	/// <summary> Splits [begin, end) into contiguous chunks and calls function(chunkBegin, chunkEnd)
+	/// for each chunk on its own thread. Blocks until all chunks are done.
+	/// A thread count of 0 means one thread per hardware thread. </summary>
+	template<typename Function>
+	void forRange(int begin, int end, Function function, unsigned int threadCount = 0) {
+		if (end <= begin) return;
+		if (threadCount == 0) threadCount = hardwareThreadCount();
+		const int count = end - begin;
+		const int chunks = std::min<int>(count, int(threadCount));
+		if (chunks <= 1) {
+			function(begin, end);
+			return;
+		}
+
+		std::vector<std::thread> workers;
+		workers.reserve(chunks - 1);
+		const int chunkSize = count / chunks, remainder = count % chunks;
+		int chunkBegin = begin;
+		for (int i = 0; i < chunks; ++i) {
+			const int chunkEnd = chunkBegin + chunkSize + (i < remainder ? 1 : 0);
+			if (i == chunks - 1) function(chunkBegin, chunkEnd); // Run the last chunk on the calling thread.
+			else workers.emplace_back(function, chunkBegin, chunkEnd);
+			chunkBegin = chunkEnd;
+		}
+		for (auto & worker : workers) worker.join();
+	}
+
+	/// <summary> Calls function(task) for every task in [0, taskCount). Threads grab the next task from a shared counter,
+	/// so uneven tasks (like image tiles) balance out. Blocks until all tasks are done. </summary>
+	template<typename Function>
+	void forEachTask(int taskCount, Function function, unsigned int threadCount = 0) {
+		if (taskCount <= 0) return;
+		if (threadCount == 0) threadCount = hardwareThreadCount();
+		std::atomic<int> next(0);
+		auto worker = [&]() {
+			for (int task = next++; task < taskCount; task = next++) function(task);
+		};
+
+		std::vector<std::thread> workers;
+		const int threads = std::min<int>(taskCount, int(threadCount));
+		for (int i = 1; i < threads; ++i) workers.emplace_back(worker);
+		worker(); // The calling thread works too.
+		for (auto & w : workers) w.join();
+	}
+}
\ No newline at end of file